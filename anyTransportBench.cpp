@@ -0,0 +1,68 @@
+#include <iostream>
+#include <future>
+#include "include/AnyTransport.h"
+#include "util/bench.h"
+
+using namespace std;
+using namespace l5::transport;
+
+static const size_t MESSAGES = 1024 * 1024;
+static const char *socketName = "/dev/shm/anyTransportBench";
+
+/// Ping pong with small messages, so the dispatch overhead isn't hidden behind copying
+template<typename Server, typename Client>
+void pingPong(Server &server, Client &client, size_t messages) {
+   auto pong = std::async(std::launch::async, [&]() {
+      for (size_t i = 0; i < messages; ++i) {
+         size_t message;
+         server.read(message);
+         server.write(message);
+      }
+   });
+   for (size_t i = 0; i < messages; ++i) {
+      client.write(i);
+      size_t answer;
+      client.read(answer);
+      if (answer != i) {
+         throw std::runtime_error{"received unexpected answer"};
+      }
+   }
+   pong.get();
+}
+
+template<typename Server, typename Client>
+void connect(Server &server, Client &client) {
+   auto accepted = std::async(std::launch::async, [&]() { server.accept(); });
+   client.connect(std::string("shm:") + socketName);
+   accepted.get();
+}
+
+int main() {
+   cout << "connection, dispatch, messages, time, msgps, user, system, total\n";
+   {
+      cout << "shared memory, crtp, ";
+      auto server = SharedMemoryTransportServer<>(socketName);
+      auto client = SharedMemoryTransportClient<>();
+      connect(server, client);
+      bench(MESSAGES, [&]() { pingPong(server, client, MESSAGES); });
+   }
+   {
+      cout << "shared memory, any per call, ";
+      auto server = AnyTransportServer::make<SharedMemoryTransportServer<>>(socketName);
+      auto client = AnyTransportClient::make<SharedMemoryTransportClient<>>();
+      connect(server, client);
+      bench(MESSAGES, [&]() { pingPong(server, client, MESSAGES); });
+   }
+   {
+      cout << "shared memory, any locked in, ";
+      auto server = AnyTransportServer::make<SharedMemoryTransportServer<>>(socketName);
+      auto client = AnyTransportClient::make<SharedMemoryTransportClient<>>();
+      connect(server, client);
+      bench(MESSAGES, [&]() {
+         server.visit([&](auto &concreteServer) {
+            client.visit([&](auto &concreteClient) { pingPong(concreteServer, concreteClient, MESSAGES); });
+         });
+      });
+   }
+   return 0;
+}
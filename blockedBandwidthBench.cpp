@@ -3,11 +3,14 @@
 #include "include/RdmaTransport.h"
 #include <thread>
 #include <include/TcpTransport.h>
+#include <util/copy.h>
 #include <util/doNotOptimize.h>
 #include <util/ycsb.h>
 #include "util/bench.h"
 
 using namespace l5::transport;
+using namespace l5::util;
+using l5::util::domain::FdPassing;
 
 constexpr size_t operator "" _k(unsigned long long i) { return i * 1024; }
 
@@ -57,6 +60,39 @@ struct TestData {
    }
 };
 
+/// Sends the chunks with MSG_ZEROCOPY. The test data isn't modified while sending, so it's enough to wait for the
+/// kernel to release it at the end
+class ZeroCopyTcpTransportServer : public TcpTransportServer {
+   uint64_t lastTicket = 0;
+
+   public:
+   explicit ZeroCopyTcpTransportServer(const std::string &port) : TcpTransportServer(port) {
+      enableZeroCopy();
+   }
+
+   void write(const uint8_t *data, size_t size) {
+      lastTicket = writeZeroCopy(data, size);
+   }
+
+   ~ZeroCopyTcpTransportServer() override {
+      waitUntilReusable(lastTicket);
+   }
+};
+
+/// Domain sockets, that move chunks of 1MB and more through pooled memfds instead of the socket buffers
+static constexpr auto fdPassingOptions = FdPassing{1_m};
+
+class FdPassingDomainSocketsTransportServer : public DomainSocketsTransportServer {
+   public:
+   explicit FdPassingDomainSocketsTransportServer(const std::string &file) :
+         DomainSocketsTransportServer(file, fdPassingOptions) {}
+};
+
+class FdPassingDomainSocketsTransportClient : public DomainSocketsTransportClient {
+   public:
+   FdPassingDomainSocketsTransportClient() : DomainSocketsTransportClient(fdPassingOptions) {}
+};
+
 template<class Server, class Client>
 void
 doRun(const std::string &name, bool isClient, const std::string &connection, TestData &testdata, size_t chunkSize) {
@@ -115,7 +151,8 @@ doRun(const std::string &name, bool isClient, const std::string &connection, Tes
 // in this test, we do a separate measurement with fixed buffersize (e.g. 256M) and varying blocksizes
 int main(int argc, char** argv) {
    if (argc < 2) {
-      std::cout << "Usage: " << argv[0] << " <client / server> <(optional) 127.0.0.1>" << std::endl;
+      std::cout << "Usage: " << argv[0] << " <client / server> <(optional) 127.0.0.1> <(optional) kernels>"
+                << std::endl;
       return -1;
    }
    const auto isClient = argv[1][0] == 'c';
@@ -125,6 +162,8 @@ int main(int argc, char** argv) {
       }
       return strcmp("127.0.0.1", ip) == 0;
    }();
+   // compare the shared memory copy kernels, with and without non-temporal stores, instead of the connection types
+   const auto compareKernels = argc > 3 && strcmp("kernels", argv[3]) == 0;
    const auto connection = [&] {
       if (isClient) {
          return ip + std::string(":") + std::to_string(port);
@@ -140,13 +179,28 @@ int main(int argc, char** argv) {
    for (auto i : {1_k, 2_k, 4_k, 8_k, 16_k, 32_k, 64_k, 128_k, 256_k, 512_k,
                   1_m, 2_m, 4_m, 8_m, 16_m, 32_m, 64_m, 128_m, 256_m, 512_m,
                   1_g, 2_g}) {
-      if (isLocal) {
+      if (isLocal && compareKernels) {
+         for (auto kernel : {CopyKernel::Std, CopyKernel::SSE2, CopyKernel::AVX2, CopyKernel::AVX512}) {
+            if (not isSupported(kernel)) continue;
+            setCopyKernel(kernel);
+            for (auto nonTemporal : {false, true}) {
+               setNonTemporalThreshold(nonTemporal ? 0 : SIZE_MAX);
+               doRun<SharedMemoryTransportServer<BUFFER_SIZE>,
+                     SharedMemoryTransportClient<BUFFER_SIZE>
+               >(std::string("shared memory ") + to_string(kernel) + (nonTemporal ? " nt" : ""),
+                 isClient, "/tmp/testSocket", testdata, i);
+            }
+         }
+      } else if (isLocal) {
          doRun<SharedMemoryTransportServer<BUFFER_SIZE>,
                SharedMemoryTransportClient<BUFFER_SIZE>
          >("shared memory", isClient, "/tmp/testSocket", testdata, i);
          doRun<DomainSocketsTransportServer,
                DomainSocketsTransportClient
          >("domain socket", isClient, "/tmp/testSocket", testdata, i);
+         doRun<FdPassingDomainSocketsTransportServer,
+               FdPassingDomainSocketsTransportClient
+         >("domain socket fd passing", isClient, "/tmp/testSocket", testdata, i);
          doRun<TcpTransportServer,
                TcpTransportClient
          >("          tcp", isClient, connection, testdata, i);
@@ -154,6 +208,12 @@ int main(int argc, char** argv) {
          doRun<RdmaTransportServer<BUFFER_SIZE>,
                RdmaTransportClient<BUFFER_SIZE>
          >("rdma", isClient, connection, testdata, i);
+         doRun<TcpTransportServer,
+               TcpTransportClient
+         >("tcp", isClient, connection, testdata, i);
+         doRun<ZeroCopyTcpTransportServer,
+               TcpTransportClient
+         >("tcp zero copy", isClient, connection, testdata, i);
       }
    }
 }
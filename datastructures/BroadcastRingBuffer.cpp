@@ -0,0 +1,119 @@
+#include "BroadcastRingBuffer.h"
+#include "util/copy.h"
+#include "util/socket/domain.h"
+#include <algorithm>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+namespace l5 {
+namespace datastructure {
+using namespace util;
+namespace {
+static auto uuidGenerator = boost::uuids::random_generator{};
+}
+
+BroadcastRingBufferWriter::BroadcastRingBufferWriter(size_t size, LaggingReaders policy) :
+        size(size), bitmask(size - 1), policy(policy) {
+    const bool powerOfTwo = (size != 0) && !(size & (size - 1));
+    if (not powerOfTwo) {
+        throw std::runtime_error{"size should be a power of 2"};
+    }
+
+    const auto name = to_string(uuidGenerator());
+    info = malloc_shared<BroadcastRingInfo>("/broadcastInfo" + name, sizeof(BroadcastRingInfo));
+    buffer = mmapSharedRingBuffer("/broadcastBuffer" + name, size, true);
+}
+
+void BroadcastRingBufferWriter::addReader(const Socket &sock) {
+    auto &readers = info.data->readers;
+    // a dropped slot still belongs to its reader, until the reader detaches
+    const auto freeSlot = std::find_if(std::begin(readers), std::end(readers), [](const BroadcastReaderInfo &reader) {
+        return reader.state.load() == BroadcastReaderState::Free;
+    });
+    if (freeSlot == std::end(readers)) {
+        throw std::runtime_error{"too many readers"};
+    }
+
+    // only the writer moves written, so the new reader can't miss any flow control
+    freeSlot->read.store(info.data->written.load());
+    freeSlot->state.store(BroadcastReaderState::Attached);
+
+    domain::send_fd(sock, info.fd);
+    domain::send_fd(sock, buffer.fd);
+    domain::write(sock, BroadcastReaderSetup{size, static_cast<size_t>(std::distance(std::begin(readers), freeSlot))});
+}
+
+void BroadcastRingBufferWriter::send(const uint8_t *data, size_t length) {
+    send(length, [&](uint8_t *begin) {
+        copyBytes(data, data + length, begin);
+        return length;
+    });
+}
+
+void BroadcastRingBufferWriter::waitUntilSendFree(size_t written, size_t length) {
+    // Don't scan the readers if we don't have to
+    if ((written - cachedMinRead) <= (size - length)) return;
+    loop_while([&]() {
+        cachedMinRead = slowestReader(written, length);
+    }, [&]() { return (written - cachedMinRead) > (size - length); }); // block until there is some space
+}
+
+size_t BroadcastRingBufferWriter::slowestReader(size_t written, size_t length) {
+    auto minRead = written;
+    for (auto &reader : info.data->readers) {
+        if (reader.state.load(std::memory_order_relaxed) != BroadcastReaderState::Attached) {
+            continue;
+        }
+        const auto read = reader.read.load(std::memory_order_acquire);
+        if (policy == LaggingReaders::Drop && (written - read) > (size - length)) {
+            // the reader might have detached meanwhile. Then its slot is Free again and must stay so
+            auto attached = BroadcastReaderState::Attached;
+            if (not reader.state.compare_exchange_strong(attached, BroadcastReaderState::Dropped,
+                                                         std::memory_order_relaxed)) {
+                continue;
+            }
+            // the reader needs to be able to see it was dropped, before we overwrite its data
+            std::atomic_thread_fence(std::memory_order_release);
+            continue;
+        }
+        minRead = std::min(minRead, read);
+    }
+    return minRead;
+}
+
+BroadcastRingBufferReader::BroadcastRingBufferReader(const Socket &sock) {
+    info = malloc_shared<BroadcastRingInfo>(domain::receive_fd(sock), sizeof(BroadcastRingInfo));
+    const auto bufferFd = domain::receive_fd(sock);
+    const auto setup = domain::read<BroadcastReaderSetup>(sock);
+
+    size = setup.size;
+    bitmask = size - 1;
+    readerId = setup.readerId;
+    if (readerId >= BroadcastRingInfo::MAX_READERS) {
+        throw std::runtime_error{"invalid reader id"};
+    }
+    buffer = mmapRingBuffer(bufferFd, size);
+}
+
+BroadcastRingBufferReader::~BroadcastRingBufferReader() {
+    // give our slot back, so the writer doesn't wait for us anymore. Only a Free slot is handed out again, so as long
+    // as it isn't Free, it's still ours
+    auto state = self().state.load();
+    while (state != BroadcastReaderState::Free &&
+           not self().state.compare_exchange_weak(state, BroadcastReaderState::Free)) {}
+}
+
+size_t BroadcastRingBufferReader::receive(void *whereTo, size_t maxSize) {
+    size_t receiveSize;
+    receive([&](const uint8_t *begin, const uint8_t *end) {
+        receiveSize = static_cast<size_t>(std::distance(begin, end));
+        if (receiveSize > maxSize) {
+            throw std::runtime_error{"received message > maxSize"};
+        }
+        copyBytes(begin, end, reinterpret_cast<uint8_t *>(whereTo));
+    });
+    return receiveSize;
+}
+} // namespace datastructure
+} // namespace l5
@@ -0,0 +1,168 @@
+#ifndef L5RDMA_BROADCASTRINGBUFFER_H
+#define L5RDMA_BROADCASTRINGBUFFER_H
+
+#include <atomic>
+#include <stdexcept>
+#include <type_traits>
+#include "util/busywait.h"
+#include "util/virtualMemory.h"
+
+namespace l5 {
+namespace util {
+class Socket;
+}
+namespace datastructure {
+/// What the writer does, when the slowest reader lags a whole buffer behind
+enum class LaggingReaders {
+    /// wait until the reader caught up
+    Block,
+    /// drop the reader, it notices on its next receive
+    Drop
+};
+
+enum class BroadcastReaderState : uint32_t {
+    Free = 0,
+    Attached,
+    Dropped
+};
+
+/// Each reader's cursor lives in its own cache line, so readers don't interfere with each other
+struct alignas(64) BroadcastReaderInfo {
+    std::atomic<size_t> read;
+    std::atomic<BroadcastReaderState> state;
+};
+
+struct BroadcastRingInfo {
+    /// fill exactly one page
+    static constexpr size_t MAX_READERS = 63;
+
+    alignas(64) std::atomic<size_t> written;
+    BroadcastReaderInfo readers[MAX_READERS];
+};
+
+/// Exchanged after the file descriptors of the info and the buffer
+struct BroadcastReaderSetup {
+    size_t size;
+    size_t readerId;
+};
+
+/**
+ * Single producer, multi consumer ring buffer over shared memory. All readers map the same buffer, so publishing a
+ * message costs a single copy, independent of the number of readers. Messages are framed with their size.
+ */
+class BroadcastRingBufferWriter {
+    const size_t size;
+    const size_t bitmask;
+    const LaggingReaders policy;
+
+    util::ShmMapping<BroadcastRingInfo> info;
+    util::WraparoundBuffer buffer;
+
+    size_t cachedMinRead = 0;
+
+public:
+    BroadcastRingBufferWriter(size_t size, LaggingReaders policy = LaggingReaders::Block);
+
+    /// Attach a new reader on the remote side of sock. It receives all messages sent after this call
+    void addReader(const util::Socket &sock);
+
+    void send(const uint8_t *data, size_t length);
+
+    /// send data via a lambda to enable zerocopy operation, writing at most maxSize bytes
+    /// expected signature: [](uint8_t* begin) -> size_t
+    template<typename SizeReturner>
+    void send(size_t maxSize, SizeReturner &&doWork) {
+        static_assert(std::is_unsigned_v<std::result_of_t<SizeReturner(uint8_t *)>>);
+        const auto maxSizeToWrite = sizeof(size_t) + maxSize;
+        if (maxSizeToWrite > size) throw std::runtime_error{"data > buffersize!"};
+
+        const auto written = info.data->written.load(std::memory_order_relaxed);
+        const auto pos = written & bitmask;
+
+        waitUntilSendFree(written, maxSizeToWrite);
+
+        const auto sizePtr = reinterpret_cast<size_t *>(&buffer.data.get()[pos]);
+        const auto begin = reinterpret_cast<uint8_t *>(sizePtr + 1);
+
+        // let the caller do the data stuff
+        const size_t dataSize = doWork(begin);
+        if (dataSize > maxSize) throw std::runtime_error{"wrote more than maxSize!"};
+        *sizePtr = dataSize;
+
+        info.data->written.store(written + sizeof(size_t) + dataSize, std::memory_order_release);
+    }
+
+private:
+    void waitUntilSendFree(size_t written, size_t length);
+
+    /// Position of the slowest attached reader, possibly dropping readers that are too slow
+    size_t slowestReader(size_t written, size_t length);
+};
+
+class BroadcastRingBufferReader {
+    size_t size;
+    size_t bitmask;
+    size_t readerId;
+
+    util::ShmMapping<BroadcastRingInfo> info;
+    util::WraparoundBuffer buffer;
+
+    BroadcastReaderInfo &self() {
+        return info.data->readers[readerId];
+    }
+
+    void throwIfDropped() {
+        // order all previous reads of the buffer before checking, the writer drops before overwriting
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (self().state.load(std::memory_order_relaxed) != BroadcastReaderState::Attached) {
+            throw std::runtime_error{"reader lagged behind and was dropped"};
+        }
+    }
+
+public:
+    /// Attach to the writer on the remote side of sock
+    explicit BroadcastRingBufferReader(const util::Socket &sock);
+
+    ~BroadcastRingBufferReader();
+
+    BroadcastRingBufferReader(BroadcastRingBufferReader &&) = delete;
+
+    BroadcastRingBufferReader &operator=(BroadcastRingBufferReader &&) = delete;
+
+    /// Receive a whole message, with at most maxSize bytes
+    size_t receive(void *whereTo, size_t maxSize);
+
+    /// receive data via a lambda to enable zerocopy operation
+    /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+    /// With LaggingReaders::Drop, the data might be overwritten while the callback runs. In that case, this throws
+    /// after the callback returns and the data needs to be discarded
+    template<typename RangeConsumer>
+    void receive(RangeConsumer &&callback) {
+        static_assert(std::is_void_v<std::result_of_t<RangeConsumer(const uint8_t *, const uint8_t *)>>);
+        const auto localRead = self().read.load(std::memory_order_relaxed);
+        const auto pos = localRead & bitmask;
+
+        // the writer publishes size and data at once, so the whole message is available with the size
+        loop_while([] {}, [&]() {
+            return info.data->written.load(std::memory_order_acquire) - localRead < sizeof(size_t);
+        });
+
+        const auto receiveSize = *reinterpret_cast<const size_t *>(&buffer.data.get()[pos]);
+        if (receiveSize > size - sizeof(size_t)) {
+            throwIfDropped();
+            throw std::runtime_error{"received invalid message size"};
+        }
+        const auto begin = &buffer.data.get()[pos + sizeof(size_t)];
+        const auto end = begin + receiveSize;
+
+        // let the caller do the data stuff
+        callback(begin, end);
+
+        throwIfDropped();
+        self().read.store(localRead + sizeof(size_t) + receiveSize, std::memory_order_release);
+    }
+};
+} // namespace datastructure
+} // namespace l5
+
+#endif //L5RDMA_BROADCASTRINGBUFFER_H
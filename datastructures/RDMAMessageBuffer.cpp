@@ -1,10 +1,15 @@
 #include "RDMAMessageBuffer.h"
+#include "util/busywait.h"
+#include "util/copy.h"
 #include "util/socket/tcp.h"
+#include <algorithm>
 
 using namespace std;
 using namespace rdma;
 
 static const size_t validity = 0xDEADDEADBEEFBEEF;
+/// wr_id of the signaled writes, waitUntilSendFree uses 42
+static constexpr uint64_t signaledWriteId = 1;
 
 namespace l5 {
 namespace datastructure {
@@ -12,17 +17,18 @@ using namespace util;
 vector<uint8_t> RDMAMessageBuffer::receive() {
     size_t receiveSize = 0;
     auto receiveValidity = static_cast<std::remove_const_t<decltype(validity)>>(0);
-    do {
+    loop_while([&]() {
         readFromReceiveBuffer(readPos, reinterpret_cast<uint8_t *>(&receiveSize), sizeof(receiveSize));
         readFromReceiveBuffer(readPos + sizeof(receiveSize) + receiveSize,
                               reinterpret_cast<uint8_t *>(&receiveValidity), sizeof(receiveValidity));
-    } while (receiveValidity != validity);
+    }, [&]() { return receiveValidity != validity; });
 
     auto result = vector<uint8_t>(receiveSize);
-    readFromReceiveBuffer(readPos + sizeof(receiveSize), result.data(), receiveSize);
+    copyFromReceiveBuffer(readPos + sizeof(receiveSize), result.data(), receiveSize);
     zeroReceiveBuffer(readPos, sizeof(receiveSize) + receiveSize + sizeof(validity));
 
     readPos += sizeof(receiveSize) + receiveSize + sizeof(validity);
+    writeCredits();
 
     return result;
 }
@@ -30,36 +36,42 @@ vector<uint8_t> RDMAMessageBuffer::receive() {
 size_t RDMAMessageBuffer::receive(void *whereTo, size_t maxSize) {
     size_t receiveSize = 0;
     auto receiveValidity = static_cast<std::remove_const_t<decltype(validity)>>(0);
-    do {
+    loop_while([&]() {
         readFromReceiveBuffer(readPos, reinterpret_cast<uint8_t *>(&receiveSize), sizeof(receiveSize));
         readFromReceiveBuffer(readPos + sizeof(receiveSize) + receiveSize,
                               reinterpret_cast<uint8_t *>(&receiveValidity),
                               sizeof(receiveValidity));
-    } while (receiveValidity != validity);
+    }, [&]() { return receiveValidity != validity; });
 
     if (receiveSize > maxSize) {
         throw runtime_error{"plz only read whole messages for now!"}; // probably buffer partially read msgs
     }
-    readFromReceiveBuffer(readPos + sizeof(receiveSize), reinterpret_cast<uint8_t *>(whereTo), receiveSize);
+    copyFromReceiveBuffer(readPos + sizeof(receiveSize), reinterpret_cast<uint8_t *>(whereTo), receiveSize);
     zeroReceiveBuffer(readPos, sizeof(receiveSize) + receiveSize + sizeof(validity));
 
     readPos += sizeof(receiveSize) + receiveSize + sizeof(validity);
+    writeCredits();
 
     return receiveSize;
 }
 
-RDMAMessageBuffer::RDMAMessageBuffer(size_t size, Socket &sock) :
+RDMAMessageBuffer::RDMAMessageBuffer(size_t size, Socket &sock, uint32_t signalingWatermark, size_t creditInterval) :
         size(size),
         net(sock),
+        // leave room for the read of waitUntilSendFree
+        signaling(net.completionQueue, signaledWriteId, net.queuePair.getMaxSendWrs() - 1, signalingWatermark),
         receiveBuffer(make_unique<volatile uint8_t[]>(size)),
         sendBuffer(make_unique<uint8_t[]>(size)),
+        creditInterval(min(creditInterval, size / 2)),
         localSend(net.network.registerMr(sendBuffer.get(), size, {})),
         localReceive(net.network.registerMr(const_cast<uint8_t *>(receiveBuffer.get()), size,
                                             {ibv::AccessFlag::LOCAL_WRITE, ibv::AccessFlag::REMOTE_WRITE})),
         localReadPos(net.network.registerMr(&readPos, sizeof(readPos), {ibv::AccessFlag::REMOTE_READ})),
         localCurrentRemoteReceive(
                 net.network.registerMr(const_cast<size_t *>(&currentRemoteReceive), sizeof(currentRemoteReceive),
-                                       {ibv::AccessFlag::LOCAL_WRITE})) {
+                                       {ibv::AccessFlag::LOCAL_WRITE})),
+        localCreditReadPos(net.network.registerMr(&creditReadPos, sizeof(creditReadPos),
+                                                  {ibv::AccessFlag::LOCAL_WRITE, ibv::AccessFlag::REMOTE_WRITE})) {
     const bool powerOfTwo = (size != 0) && !(size & (size - 1));
     if (not powerOfTwo) {
         throw runtime_error{"size should be a power of 2"};
@@ -69,6 +81,8 @@ RDMAMessageBuffer::RDMAMessageBuffer(size_t size, Socket &sock) :
 
     sendRmrInfo(sock, *localReceive, *localReadPos);
     receiveAndSetupRmr(sock, remoteReceive, remoteReadPos);
+    sendCreditInfo(sock, *localCreditReadPos, this->creditInterval);
+    remoteCreditInterval = receiveCreditInfo(sock, remoteCreditReadPos);
 }
 
 /// Higher order wraparound function. Calls the given function func() once or twice, depending on if a wraparound is needed or not
@@ -105,6 +119,7 @@ void RDMAMessageBuffer::send(const uint8_t *data, size_t length, bool inln) {
 
     const size_t startOfWrite = sendPos;
 
+    waitUntilSendFree(sizeToWrite);
     writeToSendBuffer(reinterpret_cast<const uint8_t *>(&length), sizeof(length));
     writeToSendBuffer(data, length);
     writeToSendBuffer(reinterpret_cast<const uint8_t *>(&validity), sizeof(validity));
@@ -112,44 +127,69 @@ void RDMAMessageBuffer::send(const uint8_t *data, size_t length, bool inln) {
     wraparound(size, sizeToWrite, startOfWrite, [&](auto, auto beginPos, auto endPos) {
         const auto sendSlice = localSend->getSlice(beginPos, endPos - beginPos);
         const auto remoteSlice = remoteReceive.offset(beginPos);
-        // occasionally clear the queue (this can probably also happen only every 16k times)
-        const auto shouldClearQueue = messageCounter % (4 * 1024) == 0;
 
         ibv::workrequest::Simple<ibv::workrequest::Write> wr;
         wr.setLocalAddress(sendSlice);
         wr.setRemoteAddress(remoteSlice);
-        if (shouldClearQueue) {
+        if (signaling.prepare()) {
             wr.setSignaled();
+            wr.setId(signaling.getWrId());
         }
         if (inln && sendSlice.length <= net.queuePair.getMaxInlineSize()) {
             wr.setInline();
         }
         net.queuePair.postWorkRequest(wr);
-
-        if (shouldClearQueue) {
-            net.completionQueue.waitForCompletion();
-        }
-        ++messageCounter;
     });
 }
 
-void RDMAMessageBuffer::writeToSendBuffer(const uint8_t *data, size_t sizeToWrite) {
+void RDMAMessageBuffer::waitUntilSendFree(size_t sizeToWrite) {
     // Make sure, there is enough space
-    size_t safeToWrite = size - (sendPos - currentRemoteReceive);
-    while (sizeToWrite > safeToWrite) {
-        ibv::workrequest::Simple<ibv::workrequest::Read> wr;
-        wr.setLocalAddress(localCurrentRemoteReceive->getSlice());
-        wr.setRemoteAddress(remoteReadPos);
-        wr.setFlags({ibv::workrequest::Flags::SIGNALED});
-        wr.setId(42);
-        net.queuePair.postWorkRequest(wr);
+    size_t safeToWrite = size - (sendPos - knownRemoteReceive());
+    // the remote side writes credits at least every creditInterval bytes. When it consumed everything, but less than
+    // creditInterval since the last credits, only reading its position shows the space
+    const auto fetch = creditInterval == 0 || sizeToWrite > size - creditInterval;
+    if (sizeToWrite <= safeToWrite) return;
+    loop_while([&]() {
+        if (fetch) {
+            ibv::workrequest::Simple<ibv::workrequest::Read> wr;
+            wr.setLocalAddress(localCurrentRemoteReceive->getSlice());
+            wr.setRemoteAddress(remoteReadPos);
+            wr.setFlags({ibv::workrequest::Flags::SIGNALED});
+            wr.setId(42);
+            net.queuePair.postWorkRequest(wr);
+
+            net.completionQueue.waitForSendCompletion(42); // Poll until read has finished, without dropping others
+        }
+        safeToWrite = size - (sendPos - knownRemoteReceive());
+    }, [&]() { return sizeToWrite > safeToWrite; });
+}
+
+size_t RDMAMessageBuffer::knownRemoteReceive() const {
+    // credits and reads land in different variables, so a late read response can't overwrite newer credits
+    const size_t remoteReceive = currentRemoteReceive;
+    return max(remoteReceive, creditReadPos.load());
+}
 
-        while (net.completionQueue.pollSendCompletionQueue() != 42); // Poll until read has finished
-        safeToWrite = size - (sendPos - currentRemoteReceive);
+void RDMAMessageBuffer::writeCredits() {
+    if (remoteCreditInterval == 0 || readPos - lastCreditReadPos < remoteCreditInterval) {
+        return;
     }
+    ibv::workrequest::Simple<ibv::workrequest::Write> wr;
+    wr.setLocalAddress(localReadPos->getSlice());
+    wr.setRemoteAddress(remoteCreditReadPos);
+    // inline, so the value is captured now, not when the device gets to it
+    wr.setInline();
+    if (signaling.prepare()) {
+        wr.setSignaled();
+        wr.setId(signaling.getWrId());
+    }
+    net.queuePair.postWorkRequest(wr);
+    lastCreditReadPos = readPos;
+}
 
+void RDMAMessageBuffer::writeToSendBuffer(const uint8_t *data, size_t sizeToWrite) {
     wraparound(sendBuffer.get(), size, sizeToWrite, sendPos, [&](auto prevBytes, auto begin, auto end) {
-        copy(data + prevBytes, data + prevBytes + distance(begin, end), begin);
+        copyBytes(data + prevBytes, data + prevBytes + distance(begin, end), begin);
     });
 
     sendPos += sizeToWrite;
@@ -162,6 +202,13 @@ void RDMAMessageBuffer::readFromReceiveBuffer(size_t readPos, uint8_t *whereTo,
     // Don't increment currentRead, we might need to read the same position multiple times!
 }
 
+void RDMAMessageBuffer::copyFromReceiveBuffer(size_t readPos, uint8_t *whereTo, size_t sizeToRead) const {
+    // the message is complete, so we don't need to read the data as volatile anymore
+    wraparound(receiveBuffer.get(), size, sizeToRead, readPos, [whereTo](auto prevBytes, auto begin, auto end) {
+        copyBytes(const_cast<const uint8_t *>(begin), const_cast<const uint8_t *>(end), whereTo + prevBytes);
+    });
+}
+
 void RDMAMessageBuffer::zeroReceiveBuffer(size_t beginReceiveCount, size_t sizeToZero) {
     wraparound(receiveBuffer.get(), size, sizeToZero, beginReceiveCount, [](auto, auto begin, auto end) {
         fill(begin, end, 0);
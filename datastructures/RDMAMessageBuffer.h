@@ -4,6 +4,7 @@
 #include <atomic>
 #include <vector>
 #include <memory>
+#include "rdma/SelectiveSignaling.h"
 #include "util/RDMANetworking.h"
 
 namespace l5 {
@@ -26,8 +27,10 @@ public:
     size_t receive(void *whereTo, size_t maxSize);
 
     /// Construct a message buffer of the given size, exchanging RDMA networking information over the given socket
-    /// size _must_ be a power of 2.
-    RDMAMessageBuffer(size_t size, util::Socket &sock);
+    /// size _must_ be a power of 2. Every signalingWatermark-th write is signaled, by default every quarter of the send
+    /// queue. With a creditInterval, the remote side writes its read position to us, whenever it consumed that many
+    /// bytes (at most half of the buffer), instead of us reading it, when the buffer is full
+    RDMAMessageBuffer(size_t size, util::Socket &sock, uint32_t signalingWatermark = 0, size_t creditInterval = 0);
 
     /// whether there is data to be read non-blockingly
     bool hasData() const;
@@ -35,23 +38,43 @@ public:
 private:
     const size_t size;
     util::RDMANetworking net;
+    rdma::SelectiveSignaling signaling;
     std::unique_ptr<volatile uint8_t[]> receiveBuffer;
     std::atomic<size_t> readPos{0};
     std::unique_ptr<uint8_t[]> sendBuffer;
-    size_t messageCounter = 0;
     size_t sendPos = 0;
     volatile size_t currentRemoteReceive = 0;
+    /// Credit based flow control: the remote side writes its read position here, every creditInterval bytes
+    const size_t creditInterval;
+    std::atomic<size_t> creditReadPos{0};
+    /// ... and we write ours to the remote side every remoteCreditInterval bytes, if it asked for it
+    size_t remoteCreditInterval = 0;
+    size_t lastCreditReadPos = 0;
     rdma::MemoryRegion localSend;
     rdma::MemoryRegion localReceive;
     rdma::MemoryRegion localReadPos;
     rdma::MemoryRegion localCurrentRemoteReceive;
+    rdma::MemoryRegion localCreditReadPos;
     ibv::memoryregion::RemoteAddress remoteReceive;
     ibv::memoryregion::RemoteAddress remoteReadPos;
+    ibv::memoryregion::RemoteAddress remoteCreditReadPos;
+
+    /// Wait until sizeToWrite bytes fit, from credits or by reading the remote read position
+    void waitUntilSendFree(size_t sizeToWrite);
+
+    /// The newest known read position of the remote side, fetched or written by it
+    size_t knownRemoteReceive() const;
+
+    /// RDMA write readPos to the remote side's creditReadPos, if it's due
+    void writeCredits();
 
     void writeToSendBuffer(const uint8_t *data, size_t sizeToWrite);
 
     void readFromReceiveBuffer(size_t readPos, uint8_t *whereTo, size_t sizeToRead) const;
 
+    /// Like readFromReceiveBuffer, but with the fast copy kernels. Only for messages that passed the validity check
+    void copyFromReceiveBuffer(size_t readPos, uint8_t *whereTo, size_t sizeToRead) const;
+
     void zeroReceiveBuffer(size_t beginReceiveCount, size_t sizeToZero);
 };
 } // namespace datastructure
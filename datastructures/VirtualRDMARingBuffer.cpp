@@ -1,4 +1,6 @@
 #include "VirtualRDMARingBuffer.h"
+#include "util/copy.h"
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -10,15 +12,24 @@ namespace datastructure {
 static auto uuidGenerator = boost::uuids::random_generator{};
 using namespace util;
 
-VirtualRDMARingBuffer::VirtualRDMARingBuffer(size_t size, const Socket &sock) :
+/// wr_id of the signaled writes, fetchRemoteReadPos uses 42
+static constexpr uint64_t signaledWriteId = 1;
+
+VirtualRDMARingBuffer::VirtualRDMARingBuffer(size_t size, const Socket &sock, uint32_t signalingWatermark,
+                                             size_t creditInterval) :
         size(size), bitmask(size - 1), net(sock),
+        // leave room for the read of fetchRemoteReadPos
+        signaling(net.completionQueue, signaledWriteId, net.queuePair.getMaxSendWrs() - 1, signalingWatermark),
         sendBuf(mmapSharedRingBuffer(to_string(uuidGenerator()), size, true)),
         // Since we mapped twice the virtual memory, we can create memory regions of twice the size of the actual buffer
         localSendMr(net.network.registerMr(sendBuf.data.get(), size * 2, {})),
         localReadPosMr(net.network.registerMr(&localReadPos, sizeof(localReadPos), {Perm::REMOTE_READ})),
         receiveBuf(mmapSharedRingBuffer(to_string(uuidGenerator()), size, true)),
         localReceiveMr(net.network.registerMr(receiveBuf.data.get(), size * 2, {Perm::LOCAL_WRITE, Perm::REMOTE_WRITE})),
-        remoteReadPosMr(net.network.registerMr(&remoteReadPos, sizeof(remoteReadPos), {Perm::LOCAL_WRITE})) {
+        remoteReadPosMr(net.network.registerMr(&remoteReadPos, sizeof(remoteReadPos), {Perm::LOCAL_WRITE})),
+        creditInterval(std::min(creditInterval, size / 2)),
+        creditReadPosMr(net.network.registerMr(&creditReadPos, sizeof(creditReadPos),
+                                               {Perm::LOCAL_WRITE, Perm::REMOTE_WRITE})) {
     const bool powerOfTwo = (size != 0) && !(size & (size - 1));
     if (not powerOfTwo) {
         throw std::runtime_error{"size should be a power of 2"};
@@ -26,11 +37,13 @@ VirtualRDMARingBuffer::VirtualRDMARingBuffer(size_t size, const Socket &sock) :
 
     sendRmrInfo(sock, *localReceiveMr, *localReadPosMr);
     receiveAndSetupRmr(sock, remoteReceiveRmr, remoteReadPosRmr);
+    sendCreditInfo(sock, *creditReadPosMr, this->creditInterval);
+    remoteCreditInterval = receiveCreditInfo(sock, remoteCreditReadPosRmr);
 }
 
 void VirtualRDMARingBuffer::send(const uint8_t *data, size_t length) {
     send([&](auto writeBegin) {
-        std::copy(data, data + length, writeBegin);
+        copyBytes(data, data + length, const_cast<uint8_t *>(writeBegin));
         return length;
     });
 }
@@ -46,27 +59,145 @@ size_t VirtualRDMARingBuffer::receive(void *whereTo, size_t maxSize) {
             throw std::runtime_error{"plz only read whole messages for now!"}; // probably buffer partially read msgs
         }
 
-        std::copy(begin, end, reinterpret_cast<uint8_t *>(whereTo));
+        copyBytes(begin, end, reinterpret_cast<uint8_t *>(whereTo));
     });
 
     return receiveSize;
 }
 
+void VirtualRDMARingBuffer::sendBatch(const ConstSegment *messages, size_t count) {
+    constexpr auto framing = sizeof(size_t) + sizeof(validity);
+    for (size_t first = 0; first < count;) {
+        // take as many messages as fit into the buffer at once
+        size_t sizeToWrite = 0;
+        size_t last = first;
+        for (; last < count && sizeToWrite + framing + messages[last].size <= size; ++last) {
+            sizeToWrite += framing + messages[last].size;
+        }
+        if (last == first) throw std::runtime_error{"data > buffersize!"};
+
+        // frame the messages just like send, one after another. The wraparound mapping keeps them contiguous
+        const auto startOfWrite = sendPos & bitmask;
+        auto frame = &sendBuf.data.get()[startOfWrite];
+        for (size_t i = first; i < last; ++i) {
+            const auto dataSize = messages[i].size;
+            *reinterpret_cast<volatile size_t *>(frame) = dataSize;
+            const auto begin = reinterpret_cast<const uint8_t *>(messages[i].data);
+            copyBytes(begin, begin + dataSize, frame + sizeof(size_t));
+            *reinterpret_cast<volatile size_t *>(frame + sizeof(size_t) + dataSize) = validity;
+            frame += framing + dataSize;
+        }
+
+        const auto sendSlice = localSendMr->getSlice(startOfWrite, sizeToWrite);
+        const auto remoteSlice = remoteReceiveRmr.offset(startOfWrite);
+
+        ibv::workrequest::Simple<ibv::workrequest::Write> wr;
+        wr.setLocalAddress(sendSlice);
+        wr.setRemoteAddress(remoteSlice);
+        if (sendSlice.length <= net.queuePair.getMaxInlineSize()) {
+            wr.setInline();
+        }
+        waitUntilSendFree(sizeToWrite);
+        if (signaling.prepare()) {
+            wr.setSignaled();
+            wr.setId(signaling.getWrId());
+        }
+        net.queuePair.postWorkRequest(wr);
+
+        sendPos += sizeToWrite;
+        first = last;
+    }
+}
+
 void VirtualRDMARingBuffer::waitUntilSendFree(size_t sizeToWrite) {
     // Make sure, there is enough space
-    size_t safeToWrite = size - (sendPos - remoteReadPos.load());
-    while (sizeToWrite > safeToWrite) {
-        ibv::workrequest::Simple<ibv::workrequest::Read> wr;
-        wr.setLocalAddress(remoteReadPosMr->getSlice());
-        wr.setRemoteAddress(remoteReadPosRmr);
-        wr.setFlags({ibv::workrequest::Flags::SIGNALED});
-        wr.setId(42);
-        net.queuePair.postWorkRequest(wr);
+    size_t safeToWrite = size - (sendPos - knownRemoteReadPos());
+    if (sizeToWrite <= safeToWrite) return;
+    const auto fetch = needsFetch(sizeToWrite);
+    loop_while([&]() {
+        if (fetch) {
+            fetchRemoteReadPos();
+        }
+        safeToWrite = size - (sendPos - knownRemoteReadPos());
+    }, [&]() { return sizeToWrite > safeToWrite; });
+}
 
-        while (net.completionQueue.pollSendCompletionQueue() != 42); // Poll until read has finished
-        // Poll until read has finished
-        safeToWrite = size - (sendPos - remoteReadPos.load());
+size_t VirtualRDMARingBuffer::knownRemoteReadPos() const {
+    // credits and fetches land in different variables, so a late read response can't overwrite newer credits
+    return std::max(remoteReadPos.load(), creditReadPos.load());
+}
+
+bool VirtualRDMARingBuffer::needsFetch(size_t sizeToWrite) const {
+    // the remote side writes credits at least every creditInterval bytes. When it consumed everything, but less
+    // than creditInterval since the last credits, only a fetch shows the space
+    return creditInterval == 0 || sizeToWrite > size - creditInterval;
+}
+
+void VirtualRDMARingBuffer::writeCredits() {
+    ibv::workrequest::Simple<ibv::workrequest::Write> wr;
+    wr.setLocalAddress(localReadPosMr->getSlice());
+    wr.setRemoteAddress(remoteCreditReadPosRmr);
+    // inline, so the value is captured now, not when the device gets to it
+    wr.setInline();
+    if (signaling.prepare()) {
+        wr.setSignaled();
+        wr.setId(signaling.getWrId());
+    }
+    net.queuePair.postWorkRequest(wr);
+    lastCreditReadPos = localReadPos.load();
+}
+
+void VirtualRDMARingBuffer::fetchRemoteReadPos() {
+    ibv::workrequest::Simple<ibv::workrequest::Read> wr;
+    wr.setLocalAddress(remoteReadPosMr->getSlice());
+    wr.setRemoteAddress(remoteReadPosRmr);
+    wr.setFlags({ibv::workrequest::Flags::SIGNALED});
+    wr.setId(42);
+    net.queuePair.postWorkRequest(wr);
+
+    net.completionQueue.waitForSendCompletion(42); // Poll until read has finished, without dropping other completions
+    ++remoteReadPosFetches;
+}
+
+bool VirtualRDMARingBuffer::hasData() const {
+    const auto startOfRead = localReadPos.load() & bitmask;
+    const auto receiveSize = *reinterpret_cast<volatile size_t *>(&receiveBuf.data.get()[startOfRead]);
+    // the size might still be incomplete, don't look for the validity outside of the buffer
+    if (receiveSize > size - sizeof(receiveSize) - sizeof(validity)) return false;
+    const auto checkMe = *reinterpret_cast<volatile size_t *>(&receiveBuf.data.get()[startOfRead + sizeof(size_t) +
+                                                                                   receiveSize]);
+    return checkMe == validity;
+}
+
+size_t VirtualRDMARingBuffer::receiveAvailable(void *whereTo, size_t maxSize) {
+    const auto maxMessage = size - sizeof(size_t) - sizeof(validity);
+    size_t received = 0;
+    while (received < maxSize && hasData()) {
+        received += receive(reinterpret_cast<uint8_t *>(whereTo) + received, std::min(maxSize - received, maxMessage));
+    }
+    return received;
+}
+
+size_t VirtualRDMARingBuffer::sendSome(const uint8_t *data, size_t length) {
+    const auto maxMessage = size - sizeof(size_t) - sizeof(validity);
+    size_t sent = 0;
+    while (sent < length) {
+        const auto chunk = std::min(length - sent, maxMessage);
+        if (not canSend(chunk)) break;
+        send(data + sent, chunk);
+        sent += chunk;
     }
+    return sent;
+}
+
+bool VirtualRDMARingBuffer::canSend(size_t length) {
+    const auto sizeToWrite = sizeof(size) + length + sizeof(validity);
+    if (sizeToWrite > size) throw std::runtime_error{"data > buffersize!"};
+    if (sizeToWrite <= size - (sendPos - knownRemoteReadPos())) return true;
+    // with credits, the space shows up without asking
+    if (not needsFetch(sizeToWrite)) return false;
+    fetchRemoteReadPos();
+    return sizeToWrite <= size - (sendPos - knownRemoteReadPos());
 }
 } // namespace datastructure
 } // namespace l5
@@ -2,7 +2,10 @@
 #define L5RDMA_VIRTUALRDMARINGBUFFER_H
 
 #include <atomic>
+#include "rdma/SelectiveSignaling.h"
 #include "util/RDMANetworking.h"
+#include "util/busywait.h"
+#include "util/segments.h"
 #include "util/virtualMemory.h"
 
 namespace l5 {
@@ -13,8 +16,8 @@ class VirtualRDMARingBuffer {
     const size_t size;
     const size_t bitmask;
     util::RDMANetworking net;
+    rdma::SelectiveSignaling signaling;
 
-    size_t messageCounter = 0;
     size_t sendPos = 0;
     std::atomic<size_t> localReadPos = 0;
     util::WraparoundBuffer sendBuf;
@@ -26,16 +29,53 @@ class VirtualRDMARingBuffer {
     rdma::MemoryRegion localReceiveMr;
     rdma::MemoryRegion remoteReadPosMr;
 
+    /// Credit based flow control: the remote side writes its read position here, every creditInterval bytes
+    const size_t creditInterval;
+    std::atomic<size_t> creditReadPos = 0;
+    rdma::MemoryRegion creditReadPosMr;
+    /// ... and we write ours to the remote side every remoteCreditInterval bytes, if it asked for it
+    size_t remoteCreditInterval = 0;
+    size_t lastCreditReadPos = 0;
+    /// RDMA reads of the remote read position so far
+    size_t remoteReadPosFetches = 0;
+
     ibv::memoryregion::RemoteAddress remoteReceiveRmr{};
     ibv::memoryregion::RemoteAddress remoteReadPosRmr{};
+    ibv::memoryregion::RemoteAddress remoteCreditReadPosRmr{};
 public:
-    /// Establish a shared memory region of size with the remote side of sock
-    VirtualRDMARingBuffer(size_t size, const util::Socket &sock);
+    /// Establish a shared memory region of size with the remote side of sock. Every signalingWatermark-th write is
+    /// signaled, by default every quarter of the send queue.
+    /// With a creditInterval, the remote side writes its read position to us, whenever it consumed that many bytes
+    /// (at most half of the buffer), so a full buffer doesn't need a round trip to read it. The writes share the send
+    /// queue with send, so receive must not run concurrently to it then
+    VirtualRDMARingBuffer(size_t size, const util::Socket &sock, uint32_t signalingWatermark = 0,
+                          size_t creditInterval = 0);
 
     void send(const uint8_t *data, size_t length);
 
     size_t receive(void *whereTo, size_t maxSize);
 
+    /// Send each segment as its own message, but place them contiguously and transfer them with a single RDMA write.
+    /// The receiver can't tell the difference. Batches, that don't fit into the buffer at once, are split
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
+    /// Whether a complete message is available, so receive won't block
+    bool hasData() const;
+
+    /// Receive the complete messages, that are available, into whereTo, until maxSize bytes are received. Never
+    /// waits, returns the bytes received, 0 if there is no message yet
+    size_t receiveAvailable(void *whereTo, size_t maxSize);
+
+    /// Send length bytes in as many messages as fit without waiting for the remote side. Returns the bytes sent
+    size_t sendSome(const uint8_t *data, size_t length);
+
+    /// Whether a message with length bytes fits without waiting for the remote side. Might fetch the remote read
+    /// position, which only takes a round trip, but doesn't depend on the remote's progress
+    bool canSend(size_t length);
+
+    /// How often a full buffer needed a round trip to read the remote read position. Credits avoid that
+    size_t getRemoteReadPosFetches() const { return remoteReadPosFetches; }
+
     /// send data via a lambda to enable zerocopy operation
     /// expected signature: [](uint8_t* begin) -> size_t
     template<typename SizeReturner>
@@ -57,24 +97,19 @@ public:
         // actually send the message via rdma (similar to send)
         const auto sendSlice = localSendMr->getSlice(startOfWrite, sizeToWrite);
         const auto remoteSlice = remoteReceiveRmr.offset(startOfWrite);
-        const auto shouldClearQueue = messageCounter % (4 * 1024) == 0;
 
         ibv::workrequest::Simple<ibv::workrequest::Write> wr;
         wr.setLocalAddress(sendSlice);
         wr.setRemoteAddress(remoteSlice);
-        if (shouldClearQueue) {
-            wr.setSignaled();
-        }
         if (sendSlice.length <= net.queuePair.getMaxInlineSize()) {
             wr.setInline();
         }
         waitUntilSendFree(sizeToWrite);
-        net.queuePair.postWorkRequest(wr);
-
-        if (shouldClearQueue) {
-            net.completionQueue.waitForCompletion();
+        if (signaling.prepare()) {
+            wr.setSignaled();
+            wr.setId(signaling.getWrId());
         }
-        ++messageCounter;
+        net.queuePair.postWorkRequest(wr);
 
         // finally, update sendPos
         sendPos += sizeToWrite;
@@ -105,8 +140,6 @@ public:
         // afterwards the size
         const auto sizeSlice = localSendMr->getSlice(startOfWrite, sizeSize);
         const auto remoteSizeSlice = remoteReceiveRmr.offset(startOfWrite);
-        // selective signaling?
-        const auto shouldClearQueue = messageCounter % (4 * 1024) == 0;
 
         auto dataWr = ibv::workrequest::Simple<ibv::workrequest::Write>();
         dataWr.setLocalAddress(dataSlice);
@@ -119,20 +152,17 @@ public:
         sizeWr.setLocalAddress(sizeSlice);
         sizeWr.setRemoteAddress(remoteSizeSlice);
         sizeWr.setInline();
-        if (shouldClearQueue) {
-            sizeWr.setSignaled();
-        }
 
         waitUntilSendFree(sizeSize + dataSizeToWrite);
+        // selective signaling: the size write's completion also confirms the data write
+        if (signaling.prepare(2)) {
+            sizeWr.setSignaled();
+            sizeWr.setId(signaling.getWrId());
+        }
         // significant order: size is only visible after data
         net.queuePair.postWorkRequest(dataWr);
         net.queuePair.postWorkRequest(sizeWr);
 
-        if (shouldClearQueue) {
-            net.completionQueue.waitForCompletion();
-        }
-        ++messageCounter;
-
         // finally, update sendPos
         sendPos += sizeSize + dataSizeToWrite;
     }
@@ -147,11 +177,11 @@ public:
 
         size_t receiveSize;
         size_t checkMe;
-        do {
+        loop_while([&]() {
             receiveSize = *reinterpret_cast<volatile size_t *>(&receiveBuf.data.get()[startOfRead]);
             checkMe = *reinterpret_cast<volatile size_t *>(&receiveBuf.data.get()[startOfRead + sizeof(size_t) +
                     receiveSize]);
-        } while (checkMe != validity);
+        }, [&]() { return checkMe != validity; });
 
         const auto begin = &receiveBuf.data.get()[startOfRead + sizeof(receiveSize)];
         const auto end = begin + receiveSize;
@@ -163,10 +193,26 @@ public:
         std::fill(&receiveBuf.data.get()[startOfRead], &receiveBuf.data.get()[startOfRead + totalSizeRead], 0);
 
         localReadPos.store(lastReadPos + totalSizeRead, std::memory_order_release);
+        if (remoteCreditInterval != 0 && lastReadPos + totalSizeRead - lastCreditReadPos >= remoteCreditInterval) {
+            writeCredits();
+        }
     }
 
 private:
     void waitUntilSendFree(size_t sizeToWrite);
+
+    /// The newest known read position of the remote side, fetched or written by it
+    size_t knownRemoteReadPos() const;
+
+    /// Whether waiting for credits might not be enough to fit sizeToWrite
+    bool needsFetch(size_t sizeToWrite) const;
+
+    /// RDMA write localReadPos to the remote side's creditReadPos
+    void writeCredits();
+
+    /// RDMA read the remote's read position into remoteReadPos. The read takes the send queue slot, that
+    /// signaling leaves free
+    void fetchRemoteReadPos();
 };
 } // namespace datastructure
 } // namespace l5
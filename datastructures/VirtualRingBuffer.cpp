@@ -1,18 +1,25 @@
 #include "VirtualRingBuffer.h"
 #include "util/busywait.h"
+#include "util/copy.h"
+#include "util/futex.h"
 #include "util/socket/domain.h"
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <chrono>
 
 namespace l5 {
 namespace datastructure {
 using namespace util;
 namespace {
 static auto uuidGenerator = boost::uuids::random_generator{};
+/// How long to keep spinning in WaitMode::Futex, before going to sleep
+constexpr auto futexSpinTime = std::chrono::microseconds(5);
 }
 
-VirtualRingBuffer::VirtualRingBuffer(size_t size, const Socket &sock) : size(size), bitmask(size - 1) {
+VirtualRingBuffer::VirtualRingBuffer(size_t size, const Socket &sock, WaitMode waitMode,
+                                     MappingOptions mappingOptions) :
+        size(size), bitmask(size - 1), waitMode(waitMode) {
     const bool powerOfTwo = (size != 0) && !(size & (size - 1));
     if (not powerOfTwo) {
         throw std::runtime_error{"size should be a power of 2"};
@@ -22,34 +29,114 @@ VirtualRingBuffer::VirtualRingBuffer(size_t size, const Socket &sock) : size(siz
     localRw = malloc_shared<RingBufferInfo>(infoName + name, sizeof(RingBufferInfo));
     domain::send_fd(sock, localRw.fd);
 
-    local = mmapSharedRingBuffer(bufferName + name, size, true);
+    local = mmapSharedRingBuffer(bufferName + name, size, true, mappingOptions);
     domain::send_fd(sock, local.fd);
 
     auto remoteRwFd = Socket::fromRaw(domain::receive_fd(sock));
     remoteRw = malloc_shared<RingBufferInfo>(remoteRwFd.get(), sizeof(RingBufferInfo));
 
     auto remoteFd = Socket::fromRaw(domain::receive_fd(sock));
-    remote = mmapRingBuffer(remoteFd.get(), size);
+    remote = mmapRingBuffer(remoteFd.get(), size, false, mappingOptions);
+}
+
+VirtualRingBuffer::~VirtualRingBuffer() {
+    flush();
+}
+
+void VirtualRingBuffer::setBatching(Batching newBatching) {
+    batching = newBatching;
+    if (batchComplete()) {
+        flush();
+    }
+}
+
+void VirtualRingBuffer::flush() {
+    if (stagedWritten == publishedWritten) return;
+    publishWritten(stagedWritten);
+    publishedWritten = stagedWritten;
+    stagedMessages = 0;
+}
+
+bool VirtualRingBuffer::canSend(size_t length) {
+    if (length > size) throw std::runtime_error{"data > buffersize!"};
+    if ((stagedWritten - cachedRemoteRead) <= (size - length)) return true;
+    cachedRemoteRead = remoteRw.data->read;
+    if ((stagedWritten - cachedRemoteRead) <= (size - length)) return true;
+    // the consumer can only make space for data it knows about
+    flush();
+    return false;
+}
+
+bool VirtualRingBuffer::canReceive(size_t length) {
+    if (length > size) throw std::runtime_error{"data > buffersize!"};
+    const auto localRead = localRw.data->read.load();
+    if ((cachedRemoteWritten - localRead) >= length) return true;
+    cachedRemoteWritten = remoteRw.data->written.load(std::memory_order_acquire);
+    if ((cachedRemoteWritten - localRead) >= length) return true;
+    // the remote might wait for our staged sends, before it sends anything new
+    flush();
+    return false;
 }
 
 void VirtualRingBuffer::waitUntilSendFree(size_t localWritten, size_t length) {
     // Don't read the remote memory if we don't have to
-    if ((localWritten - cachedRemoteRead) > (size - length)) return;
+    if ((localWritten - cachedRemoteRead) <= (size - length)) return;
+    // the consumer can only make space for data it knows about
+    flush();
     loop_while([&]() {
         cachedRemoteRead = remoteRw.data->read;
     }, [&]() { return (localWritten - cachedRemoteRead) > (size - length); }); // block until there is some space
 }
 
 void VirtualRingBuffer::send(const uint8_t *data, size_t length) {
-    const auto localWritten = localRw.data->written.load();
+    const auto localWritten = stagedWritten;
     const auto pos = localWritten & bitmask;
 
     waitUntilSendFree(localWritten, length);
 
-    std::copy(data, data + length, &local.data.get()[pos]);
+    copyBytes(data, data + length, &local.data.get()[pos]);
 
-    // basically `localRw->written += length;`, but without the mfence or locked instructions
-    localRw.data->written.store(localWritten + length, std::memory_order_release);
+    stageWritten(localWritten + length);
+}
+
+void VirtualRingBuffer::send(const ConstSegment *segments, size_t count) {
+    const auto length = totalSize(segments, count);
+    if (length > size) throw std::runtime_error{"data > buffersize!"};
+    const auto localWritten = stagedWritten;
+    const auto pos = localWritten & bitmask;
+
+    waitUntilSendFree(localWritten, length);
+
+    gather(segments, count, 0, length, &local.data.get()[pos]);
+
+    stageWritten(localWritten + length);
+}
+
+void VirtualRingBuffer::stageWritten(size_t written, size_t messages) {
+    stagedWritten = written;
+    stagedMessages += messages;
+    if (batchComplete()) {
+        flush();
+    }
+}
+
+bool VirtualRingBuffer::batchComplete() const {
+    return (batching.bytes != 0 && stagedWritten - publishedWritten >= batching.bytes) ||
+           (batching.messages != 0 && stagedMessages >= batching.messages);
+}
+
+void VirtualRingBuffer::publishWritten(size_t written) {
+    if (waitMode == WaitMode::Spin) {
+        // basically `localRw->written += length;`, but without the mfence or locked instructions
+        localRw.data->written.store(written, std::memory_order_release);
+        return;
+    }
+    // sequentially consistent, so the consumer either sees the new value, or we see that it's sleeping
+    localRw.data->written.store(written);
+    if (localRw.data->sleeping.load() != 0) {
+        ++localRw.data->wakeups;
+        futexWakeAll(localRw.data->wakeups);
+    }
 }
 
 size_t VirtualRingBuffer::receive(void *whereTo, size_t maxSize) {
@@ -58,7 +145,7 @@ size_t VirtualRingBuffer::receive(void *whereTo, size_t maxSize) {
 
     waitUntilReceiveAvailable(maxSize, localRead);
 
-    std::copy(&remote.data.get()[pos], &remote.data.get()[pos + maxSize], reinterpret_cast<uint8_t *>(whereTo));
+    copyBytes(&remote.data.get()[pos], &remote.data.get()[pos + maxSize], reinterpret_cast<uint8_t *>(whereTo));
 
     // basically `localRw->read += maxSize;`, but without the mfence or locked instructions
     localRw.data->read.store(localRead + maxSize, std::memory_order_release);
@@ -72,20 +159,153 @@ size_t VirtualRingBuffer::receiveSome(void *whereTo, size_t maxSize) {
     // read at least 1 byte
     waitUntilReceiveAvailable(1, localRead);
 
-    const auto written = remoteRw.data->written.load();
-    const auto size = std::min(written - localRead, maxSize);
-    std::copy(&remote.data.get()[pos], &remote.data.get()[pos + size], reinterpret_cast<uint8_t *>(whereTo));
+    const auto size = std::min(cachedRemoteWritten - localRead, maxSize);
+    copyBytes(&remote.data.get()[pos], &remote.data.get()[pos + size], reinterpret_cast<uint8_t *>(whereTo));
 
     // basically `localRw->read += size;`, but without the mfence or locked instructions
     localRw.data->read.store(localRead + size, std::memory_order_release);
     return size;
 }
 
+size_t VirtualRingBuffer::trySendSome(const uint8_t *data, size_t maxLength) {
+    const auto localWritten = stagedWritten;
+    // Don't read the remote memory if we don't have to
+    if (size - (localWritten - cachedRemoteRead) < maxLength) {
+        cachedRemoteRead = remoteRw.data->read;
+    }
+    const auto length = std::min(size - (localWritten - cachedRemoteRead), maxLength);
+    if (length > 0) {
+        copyBytes(data, data + length, &local.data.get()[localWritten & bitmask]);
+        stageWritten(localWritten + length);
+    }
+    // the consumer can only make space for data it knows about
+    if (length < maxLength) flush();
+    return length;
+}
+
+size_t VirtualRingBuffer::tryReceiveSome(void *whereTo, size_t maxSize) {
+    const auto localRead = localRw.data->read.load();
+    const auto pos = localRead & bitmask;
+    if ((cachedRemoteWritten - localRead) < maxSize) {
+        cachedRemoteWritten = remoteRw.data->written.load(std::memory_order_acquire);
+    }
+
+    const auto size = std::min(cachedRemoteWritten - localRead, maxSize);
+    if (size == 0) {
+        // the remote might wait for our staged sends, before it sends anything new
+        flush();
+        return 0;
+    }
+    copyBytes(&remote.data.get()[pos], &remote.data.get()[pos + size], reinterpret_cast<uint8_t *>(whereTo));
+
+    localRw.data->read.store(localRead + size, std::memory_order_release);
+    return size;
+}
+
+void VirtualRingBuffer::receive(const MutableSegment *segments, size_t count) {
+    const auto length = totalSize(segments, count);
+    if (length > size) throw std::runtime_error{"data > buffersize!"};
+    const auto localRead = localRw.data->read.load();
+    const auto pos = localRead & bitmask;
+
+    waitUntilReceiveAvailable(length, localRead);
+
+    scatter(&remote.data.get()[pos], length, segments, count, 0);
+
+    localRw.data->read.store(localRead + length, std::memory_order_release);
+}
+
+void VirtualRingBuffer::sendMessage(const uint8_t *data, size_t length) {
+    send(length, [&](uint8_t *begin) {
+        copyBytes(data, data + length, begin);
+        return length;
+    });
+}
+
+void VirtualRingBuffer::sendMessage(const ConstSegment *segments, size_t count) {
+    const auto length = totalSize(segments, count);
+    send(length, [&](uint8_t *begin) {
+        gather(segments, count, 0, length, begin);
+        return length;
+    });
+}
+
+void VirtualRingBuffer::sendBatch(const ConstSegment *messages, size_t count) {
+    for (size_t first = 0; first < count;) {
+        // take as many messages as fit into the buffer at once
+        size_t length = 0;
+        size_t last = first;
+        for (; last < count && length + sizeof(size_t) + messages[last].size <= size; ++last) {
+            length += sizeof(size_t) + messages[last].size;
+        }
+        if (last == first) throw std::runtime_error{"data > buffersize!"};
+
+        const auto localWritten = stagedWritten;
+        waitUntilSendFree(localWritten, length);
+
+        // same framing as sendMessage, the wraparound mapping keeps each frame contiguous
+        auto position = localWritten;
+        for (size_t i = first; i < last; ++i) {
+            const auto frame = &local.data.get()[position & bitmask];
+            *reinterpret_cast<size_t *>(frame) = messages[i].size;
+            const auto begin = reinterpret_cast<const uint8_t *>(messages[i].data);
+            copyBytes(begin, begin + messages[i].size, frame + sizeof(size_t));
+            position += sizeof(size_t) + messages[i].size;
+        }
+
+        stageWritten(localWritten + length, last - first);
+        first = last;
+    }
+}
+
+size_t VirtualRingBuffer::receiveMessage(void *whereTo, size_t maxSize) {
+    size_t receiveSize;
+    receive([&](const uint8_t *begin, const uint8_t *end) {
+        receiveSize = static_cast<size_t>(std::distance(begin, end));
+        if (receiveSize > maxSize) {
+            throw std::runtime_error{"received message > maxSize"};
+        }
+        copyBytes(begin, end, reinterpret_cast<uint8_t *>(whereTo));
+    });
+    return receiveSize;
+}
+
 void VirtualRingBuffer::waitUntilReceiveAvailable(size_t maxSize, size_t localRead) {
-    size_t remoteWritten;
+    // Don't read the remote memory if we don't have to
+    if ((cachedRemoteWritten - localRead) >= maxSize) return;
+    // the remote might wait for our staged sends, before it sends anything new
+    flush();
+    if (waitMode == WaitMode::Futex) {
+        return sleepUntilReceiveAvailable(maxSize, localRead);
+    }
     loop_while([&]() {
-        remoteWritten = remoteRw.data->written; // probably buffer this in class, so we don't have as much remote reads
-    }, [&]() { return (remoteWritten - localRead) < maxSize; }); // block until maxSize is available
+        cachedRemoteWritten = remoteRw.data->written.load(std::memory_order_acquire);
+    }, [&]() { return (cachedRemoteWritten - localRead) < maxSize; }); // block until maxSize is available
+}
+
+void VirtualRingBuffer::sleepUntilReceiveAvailable(size_t maxSize, size_t localRead) {
+    auto &info = *remoteRw.data;
+    const auto available = [&]() {
+        cachedRemoteWritten = info.written.load();
+        return (cachedRemoteWritten - localRead) >= maxSize;
+    };
+    if (available()) return;
+
+    // spinning is cheaper than a syscall for the first few microseconds
+    const auto spinUntil = std::chrono::steady_clock::now() + futexSpinTime;
+    while (not available()) {
+        if (std::chrono::steady_clock::now() < spinUntil) {
+            _mm_pause();
+            continue;
+        }
+        const auto wakeups = info.wakeups.load();
+        info.sleeping.store(1);
+        // check again, the producer might have published, before it could see we are sleeping
+        if (not available()) {
+            futexWait(info.wakeups, wakeups);
+        }
+        info.sleeping.store(0);
+    }
 }
 } // namespace datastructure
 } // namespace l5
@@ -3,6 +3,9 @@
 
 #include <atomic>
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "util/segments.h"
 #include "util/virtualMemory.h"
 
 namespace l5 {
@@ -13,6 +16,35 @@ namespace datastructure {
 struct RingBufferInfo {
     std::atomic<size_t> read;
     std::atomic<size_t> written;
+    /// futex word, incremented by the producer whenever it wakes up the consumer
+    std::atomic<uint32_t> wakeups;
+    /// set by the consumer, before it goes to sleep on wakeups
+    std::atomic<uint32_t> sleeping;
+};
+
+/// How to wait for new data
+enum class WaitMode {
+    /// busy poll, gradually backing off to sched_yield / usleep
+    Spin,
+    /// spin for a few microseconds, then sleep on a futex until the producer wakes us
+    Futex
+};
+
+/// How the data written to a ring buffer is delimited
+enum class Framing {
+    /// plain byte stream, the receiver needs to know how much to read
+    Stream,
+    /// every write is prefixed with its size and received as a whole message
+    Message
+};
+
+/// When to make staged sends visible to the consumer. A threshold of 0 is disabled, with both disabled, sends are only
+/// published on flush. The defaults publish every send immediately
+struct Batching {
+    /// publish, once at least this many bytes are staged
+    size_t bytes = 1;
+    /// publish, once at least this many sends are staged
+    size_t messages = 0;
 };
 
 /// http://ourmachinery.com/post/virtual-memory-tricks/
@@ -21,16 +53,36 @@ struct VirtualRingBuffer {
     const std::string infoName = "/sharedRw";
     const size_t size;
     const size_t bitmask;
+    const WaitMode waitMode;
 
     util::ShmMapping<RingBufferInfo> localRw;
     util::WraparoundBuffer local;
+    Batching batching;
+    /// written position including staged, but not yet published sends
+    size_t stagedWritten = 0;
+    size_t publishedWritten = 0;
+    size_t stagedMessages = 0;
 
-    size_t cachedRemoteRead;
+    size_t cachedRemoteRead = 0;
+    size_t cachedRemoteWritten = 0;
     util::ShmMapping<RingBufferInfo> remoteRw;
     util::WraparoundBuffer remote;
 
     /// Establish a shared memory region of size with the remote side of sock
-    VirtualRingBuffer(size_t size, const util::Socket &sock);
+    /// Both sides need to agree on the waitMode
+    VirtualRingBuffer(size_t size, const util::Socket &sock, WaitMode waitMode = WaitMode::Spin,
+                      util::MappingOptions mappingOptions = {});
+
+    /// Publishes all staged sends
+    ~VirtualRingBuffer();
+
+    /// Only publish sends once the thresholds are reached, or on flush. Batching saves a cache line transfer to the
+    /// consumer per send, which dominates the cost of small messages
+    void setBatching(Batching newBatching);
+
+    /// Make all staged sends visible to the consumer. Also happens implicitly, before waiting for free space or
+    /// incoming data, so request / response patterns can't deadlock
+    void flush();
 
     void send(const uint8_t *data, size_t length);
 
@@ -40,10 +92,101 @@ struct VirtualRingBuffer {
     /// Receive at least 1, up to maxSize bytes
     size_t receiveSome(void* whereTo, size_t maxSize);
 
+    /// Send as much of data as fits without waiting for the consumer, returns the bytes sent
+    size_t trySendSome(const uint8_t *data, size_t maxLength);
+
+    /// Like receiveSome, but returns 0 instead of waiting, when nothing is available
+    size_t tryReceiveSome(void *whereTo, size_t maxSize);
+
+    /// Send the concatenation of all segments, copying them directly into the ring
+    void send(const util::ConstSegment *segments, size_t count);
+
+    /// Receive exactly the total size of all segments, copying directly from the ring into them
+    void receive(const util::MutableSegment *segments, size_t count);
+
+    /// Whether length bytes can be sent without waiting for the consumer
+    bool canSend(size_t length);
+
+    /// Whether length bytes can be received without waiting for the producer
+    bool canReceive(size_t length);
+
+
+    /// Send length bytes as a single message, framed with its size
+    void sendMessage(const uint8_t *data, size_t length);
+
+    /// Send the concatenation of all segments as a single message, framed with its size
+    void sendMessage(const util::ConstSegment *segments, size_t count);
+
+    /// Send each segment as its own message, like sendMessage, but publish them all with a single position update.
+    /// Batches, that don't fit into the buffer at once, are split
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
+    /// Receive a whole message sent with sendMessage, with at most maxSize bytes
+    size_t receiveMessage(void *whereTo, size_t maxSize);
+
+    /// send data via a lambda to enable zerocopy operation. The lambda writes directly into the shared wraparound
+    /// mapping, so the maximum size needs to be known beforehand, to not overwrite data the remote didn't read yet.
+    /// Messages sent this way are framed with their size and need to be received with the lambda receive
+    /// expected signature: [](uint8_t* begin) -> size_t
+    template<typename SizeReturner>
+    void send(size_t maxSize, SizeReturner &&doWork) {
+        static_assert(std::is_unsigned_v<std::result_of_t<SizeReturner(uint8_t *)>>);
+        const auto maxSizeToWrite = sizeof(size_t) + maxSize;
+        if (maxSizeToWrite > size) throw std::runtime_error{"data > buffersize!"};
+
+        const auto localWritten = stagedWritten;
+        const auto pos = localWritten & bitmask;
+
+        waitUntilSendFree(localWritten, maxSizeToWrite);
+
+        const auto sizePtr = reinterpret_cast<size_t *>(&local.data.get()[pos]);
+        const auto begin = reinterpret_cast<uint8_t *>(sizePtr + 1);
+
+        // let the caller do the data stuff
+        const size_t dataSize = doWork(begin);
+        if (dataSize > maxSize) throw std::runtime_error{"wrote more than maxSize!"};
+        *sizePtr = dataSize;
+
+        stageWritten(localWritten + sizeof(size_t) + dataSize);
+    }
+
+    /// receive data via a lambda to enable zerocopy operation
+    /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+    template<typename RangeConsumer>
+    void receive(RangeConsumer &&callback) {
+        static_assert(std::is_void_v<std::result_of_t<RangeConsumer(const uint8_t *, const uint8_t *)>>);
+        const auto localRead = localRw.data->read.load();
+        const auto pos = localRead & bitmask;
+
+        // the sender publishes size and data at once, so the whole message is available with the size
+        waitUntilReceiveAvailable(sizeof(size_t), localRead);
+
+        const auto receiveSize = *reinterpret_cast<const size_t *>(&remote.data.get()[pos]);
+        const auto begin = &remote.data.get()[pos + sizeof(size_t)];
+        const auto end = begin + receiveSize;
+
+        // let the caller do the data stuff
+        callback(begin, end);
+
+        localRw.data->read.store(localRead + sizeof(size_t) + receiveSize, std::memory_order_release);
+    }
+
 private:
     void waitUntilSendFree(size_t localWritten, size_t length);
 
     void waitUntilReceiveAvailable(size_t maxSize, size_t localRead);
+
+    void sleepUntilReceiveAvailable(size_t maxSize, size_t localRead);
+
+    /// Advance the written position by the given number of sends, only publishing it, once the batching thresholds
+    /// are reached
+    void stageWritten(size_t written, size_t messages = 1);
+
+    /// Whether the staged sends reach one of the enabled batching thresholds
+    bool batchComplete() const;
+
+    /// Make everything up to written visible to the consumer and wake it up, if necessary
+    void publishWritten(size_t written);
 };
 } // namespace datastructure
 } // namespace l5
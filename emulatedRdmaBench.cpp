@@ -0,0 +1,123 @@
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "rdma/EmulatedVerbs.h"
+
+using namespace rdma::emulated;
+
+static constexpr size_t ROUNDS = 10'000;
+static constexpr size_t BANDWIDTH_BYTES = 1024ull * 1024 * 1024;
+/// Outstanding writes while streaming, every one of them is signaled
+static constexpr size_t WINDOW = 16;
+static constexpr int ACCESS = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+
+static ibv_wc pollBlocking(CompletionQueue &queue) {
+   ibv_wc completion{};
+   // the emulation runs on a thread of its own, which needs the cpu more than we do
+   while (queue.poll(1, &completion) == 0) {
+      std::this_thread::yield();
+   }
+   if (completion.status != IBV_WC_SUCCESS) {
+      throw std::runtime_error{"unexpected completion status: " + std::to_string(completion.status)};
+   }
+   return completion;
+}
+
+struct Side {
+   std::unique_ptr<CompletionQueue> sendQueue;
+   std::unique_ptr<CompletionQueue> receiveQueue;
+   std::unique_ptr<SharedReceiveQueue> receives;
+   std::unique_ptr<QueuePair> qp;
+   std::vector<uint8_t> buffer;
+   std::unique_ptr<MemoryRegion> mr;
+
+   Side(Fabric &fabric, size_t size) :
+         sendQueue(fabric.createCompletionQueue()),
+         receiveQueue(fabric.createCompletionQueue()),
+         receives(fabric.createSrq()),
+         qp(fabric.createQueuePair(*sendQueue, *receiveQueue, *receives)),
+         buffer(size),
+         mr(fabric.registerMr(buffer.data(), buffer.size(), ACCESS)) {}
+
+   void write(const Side &to, size_t size, bool withImm) {
+      ibv_sge sge{reinterpret_cast<uintptr_t>(buffer.data()), static_cast<uint32_t>(size), mr->getLkey()};
+      ibv_send_wr wr{};
+      wr.sg_list = &sge;
+      wr.num_sge = 1;
+      wr.opcode = withImm ? IBV_WR_RDMA_WRITE_WITH_IMM : IBV_WR_RDMA_WRITE;
+      wr.send_flags = withImm ? 0 : IBV_SEND_SIGNALED;
+      wr.wr.rdma.remote_addr = reinterpret_cast<uintptr_t>(to.buffer.data());
+      wr.wr.rdma.rkey = to.mr->getRkey();
+      qp->postSend(wr);
+   }
+
+   void postReceive() {
+      ibv_recv_wr wr{};
+      receives->postRecv(wr);
+   }
+};
+
+/// Round trip of a write with immediate in each direction
+static void pingPong(Fabric &fabric, size_t size) {
+   auto ping = Side(fabric, size);
+   auto pong = Side(fabric, size);
+   ping.qp->connect(pong.qp->getQPN());
+   pong.qp->connect(ping.qp->getQPN());
+
+   const auto start = std::chrono::steady_clock::now();
+   auto ponger = std::async(std::launch::async, [&] {
+      for (size_t i = 0; i < ROUNDS; ++i) {
+         pong.postReceive();
+         pollBlocking(*pong.receiveQueue);
+         pong.write(ping, size, true);
+      }
+   });
+   for (size_t i = 0; i < ROUNDS; ++i) {
+      ping.postReceive();
+      ping.write(pong, size, true);
+      pollBlocking(*ping.receiveQueue);
+   }
+   ponger.get();
+   const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   std::cout << "ping pong, " << size << ", " << seconds / ROUNDS * 1e6 << "us\n";
+}
+
+/// Stream writes with a fixed number of them in flight
+static void stream(Fabric &fabric, size_t size) {
+   auto sender = Side(fabric, size);
+   auto receiver = Side(fabric, size);
+   sender.qp->connect(receiver.qp->getQPN());
+   receiver.qp->connect(sender.qp->getQPN());
+
+   const auto writes = std::max<size_t>(BANDWIDTH_BYTES / size, WINDOW);
+   const auto start = std::chrono::steady_clock::now();
+   size_t completed = 0;
+   for (size_t posted = 0; posted < writes; ++posted) {
+      if (posted - completed == WINDOW) {
+         pollBlocking(*sender.sendQueue);
+         ++completed;
+      }
+      sender.write(receiver, size, false);
+   }
+   for (; completed < writes; ++completed) {
+      pollBlocking(*sender.sendQueue);
+   }
+   const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   std::cout << "bandwidth, " << size << ", " << static_cast<double>(writes * size) / seconds / 1e6 << "MB/s\n";
+}
+
+/// Explore a link with L5RDMA_EMULATED_LATENCY_NS and L5RDMA_EMULATED_BANDWIDTH on machines without RDMA device
+int main() {
+   auto fabric = Fabric();
+   std::cout << "emulated link: latency " << fabric.getModel().latency.count() << "ns, bandwidth "
+             << fabric.getModel().bandwidth / 1e6 << "MB/s (0 = unlimited)\n";
+   std::cout << "benchmark, message size, result\n";
+   for (size_t size : {64, 4096, 64 * 1024}) {
+      pingPong(fabric, size);
+   }
+   for (size_t size : {4096, 64 * 1024, 1024 * 1024}) {
+      stream(fabric, size);
+   }
+   return 0;
+}
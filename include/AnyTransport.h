@@ -0,0 +1,145 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <variant>
+#include "DomainSocketsTransport.h"
+#include "LibRdmacmTransport.h"
+#include "RdmaTransport.h"
+#include "SharedMemoryTransport.h"
+#include "TcpTransport.h"
+#include "Transport.h"
+
+namespace l5 {
+namespace transport {
+/**
+ * A transport, chosen at runtime from a closed set of transports. Calls through the Transport interface dispatch with
+ * a jump on the variant index instead of a virtual call. Hot loops should lock in the concrete transport with visit,
+ * so the loop body is compiled once per alternative and runs without any indirect calls, just like the CRTP version.
+ * @tparam Servers the possible transports
+ */
+template<typename... Servers>
+class BasicAnyTransportServer : public TransportServer<BasicAnyTransportServer<Servers...>> {
+   std::variant<std::unique_ptr<Servers>...> transport;
+
+   public:
+   template<typename Server>
+   explicit BasicAnyTransportServer(std::unique_ptr<Server> server) : transport(std::move(server)) {}
+
+   /// Take over a transport from make_transportServer
+   template<typename Server>
+   explicit BasicAnyTransportServer(std::unique_ptr<TransportServer<Server>> server) :
+         transport(std::unique_ptr<Server>(static_cast<Server *>(server.release()))) {}
+
+   ~BasicAnyTransportServer() override = default;
+
+   /// Construct the given alternative in place
+   template<typename Server, typename... Args>
+   static BasicAnyTransportServer make(Args &&... args) {
+      return BasicAnyTransportServer(std::make_unique<Server>(std::forward<Args>(args)...));
+   }
+
+   template<typename Server>
+   bool holds() const { return std::holds_alternative<std::unique_ptr<Server>>(transport); }
+
+   /// Call visitor with the concrete transport, so everything in it is statically dispatched
+   template<typename Visitor>
+   decltype(auto) visit(Visitor &&visitor) {
+      return std::visit([&](auto &t) -> decltype(auto) { return visitor(*t); }, transport);
+   }
+
+   void accept_impl() { visit([](auto &t) { t.accept(); }); }
+
+   void write_impl(const uint8_t *data, size_t size) { visit([&](auto &t) { t.write(data, size); }); }
+
+   void read_impl(uint8_t *buffer, size_t size) { visit([&](auto &t) { t.read(buffer, size); }); }
+
+   size_t readSome_impl(uint8_t *buffer, size_t maxSize) {
+      return visit([&](auto &t) { return t.readSome(buffer, maxSize); });
+   }
+
+   void writev_impl(const util::ConstSegment *segments, size_t count) {
+      visit([&](auto &t) { t.writev(segments, count); });
+   }
+
+   void readv_impl(const util::MutableSegment *segments, size_t count) {
+      visit([&](auto &t) { t.readv(segments, count); });
+   }
+
+   bool tryRead_impl(uint8_t *buffer, size_t size) { return visit([&](auto &t) { return t.tryRead(buffer, size); }); }
+
+   bool tryWrite_impl(const uint8_t *data, size_t size) {
+      return visit([&](auto &t) { return t.tryWrite(data, size); });
+   }
+
+   bool readable_impl() { return visit([](auto &t) { return t.readable(); }); }
+
+   bool writable_impl() { return visit([](auto &t) { return t.writable(); }); }
+};
+
+template<typename... Clients>
+class BasicAnyTransportClient : public TransportClient<BasicAnyTransportClient<Clients...>> {
+   std::variant<std::unique_ptr<Clients>...> transport;
+
+   public:
+   template<typename Client>
+   explicit BasicAnyTransportClient(std::unique_ptr<Client> client) : transport(std::move(client)) {}
+
+   /// Take over a transport from make_transportClient
+   template<typename Client>
+   explicit BasicAnyTransportClient(std::unique_ptr<TransportClient<Client>> client) :
+         transport(std::unique_ptr<Client>(static_cast<Client *>(client.release()))) {}
+
+   ~BasicAnyTransportClient() override = default;
+
+   template<typename Client, typename... Args>
+   static BasicAnyTransportClient make(Args &&... args) {
+      return BasicAnyTransportClient(std::make_unique<Client>(std::forward<Args>(args)...));
+   }
+
+   template<typename Client>
+   bool holds() const { return std::holds_alternative<std::unique_ptr<Client>>(transport); }
+
+   template<typename Visitor>
+   decltype(auto) visit(Visitor &&visitor) {
+      return std::visit([&](auto &t) -> decltype(auto) { return visitor(*t); }, transport);
+   }
+
+   void connect_impl(const std::string &whereTo) { visit([&](auto &t) { t.connect(whereTo); }); }
+
+   void reset_impl() { visit([](auto &t) { t.reset(); }); }
+
+   void write_impl(const uint8_t *data, size_t size) { visit([&](auto &t) { t.write(data, size); }); }
+
+   void read_impl(uint8_t *buffer, size_t size) { visit([&](auto &t) { t.read(buffer, size); }); }
+
+   size_t readSome_impl(uint8_t *buffer, size_t maxSize) {
+      return visit([&](auto &t) { return t.readSome(buffer, maxSize); });
+   }
+
+   void writev_impl(const util::ConstSegment *segments, size_t count) {
+      visit([&](auto &t) { t.writev(segments, count); });
+   }
+
+   void readv_impl(const util::MutableSegment *segments, size_t count) {
+      visit([&](auto &t) { t.readv(segments, count); });
+   }
+
+   bool tryRead_impl(uint8_t *buffer, size_t size) { return visit([&](auto &t) { return t.tryRead(buffer, size); }); }
+
+   bool tryWrite_impl(const uint8_t *data, size_t size) {
+      return visit([&](auto &t) { return t.tryWrite(data, size); });
+   }
+
+   bool readable_impl() { return visit([](auto &t) { return t.readable(); }); }
+
+   bool writable_impl() { return visit([](auto &t) { return t.writable(); }); }
+};
+
+/// All point to point transports with their default buffer sizes
+using AnyTransportServer = BasicAnyTransportServer<TcpTransportServer, DomainSocketsTransportServer,
+      SharedMemoryTransportServer<>, RdmaTransportServer<>, LibRdmacmTransportServer>;
+using AnyTransportClient = BasicAnyTransportClient<TcpTransportClient, DomainSocketsTransportClient,
+      SharedMemoryTransportClient<>, RdmaTransportClient<>, LibRdmacmTransportClient>;
+} // namespace transport
+} // namespace l5
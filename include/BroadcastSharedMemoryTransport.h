@@ -0,0 +1,85 @@
+#ifndef L5RDMA_BROADCASTSHAREDMEMORYTRANSPORT_H
+#define L5RDMA_BROADCASTSHAREDMEMORYTRANSPORT_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "datastructures/BroadcastRingBuffer.h"
+#include "util/socket/Socket.h"
+
+namespace l5 {
+namespace transport {
+/**
+ * One-to-many channel via shared memory: every message written by the server is received by all attached clients.
+ * The message is only copied once into the shared buffer, regardless of the number of clients.
+ */
+class BroadcastSharedMemoryTransportServer {
+    util::Socket listenSock;
+    std::string file;
+    datastructure::BroadcastRingBufferWriter ring;
+
+public:
+    /**
+     * @param domainSocket filename of the domain socket, clients attach to
+     * @param bufferSize size of the shared ring buffer, needs to be a power of 2
+     * @param lagging whether to wait for, or drop clients, that are a whole buffer behind
+     */
+    explicit BroadcastSharedMemoryTransportServer(std::string_view domainSocket,
+                                                  size_t bufferSize = 16 * 1024 * 1024,
+                                                  datastructure::LaggingReaders lagging =
+                                                  datastructure::LaggingReaders::Block);
+
+    ~BroadcastSharedMemoryTransportServer();
+
+    /// Attach one more client. It receives all messages written after it was accepted
+    void accept();
+
+    /// Stop accepting new clients and remove the domain socket
+    void finishListen();
+
+    void send(const uint8_t *data, size_t size);
+
+    /// send data via a lambda to enable zerocopy operation, writing at most maxSize bytes
+    /// expected signature: [](uint8_t* begin) -> size_t
+    template<typename SizeReturner>
+    void send(size_t maxSize, SizeReturner &&doWork) {
+        ring.send(maxSize, std::forward<SizeReturner>(doWork));
+    }
+
+    template<typename TriviallyCopyable>
+    void write(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        send(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+};
+
+class BroadcastSharedMemoryTransportClient {
+    util::Socket sock;
+    std::unique_ptr<datastructure::BroadcastRingBufferReader> ring;
+
+public:
+    BroadcastSharedMemoryTransportClient();
+
+    /// Connect to the server's domain socket
+    void connect(std::string_view whereTo);
+
+    /// receive the next message, throws if this client lagged behind and was dropped by the server
+    size_t receive(void *whereTo, size_t maxSize);
+
+    /// receive data via a lambda to enable zerocopy operation
+    /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+    template<typename RangeConsumer>
+    void receive(RangeConsumer &&callback) {
+        ring->receive(std::forward<RangeConsumer>(callback));
+    }
+
+    template<typename TriviallyCopyable>
+    void read(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        receive(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+    }
+};
+} // namespace transport
+} // namespace l5
+
+#endif //L5RDMA_BROADCASTSHAREDMEMORYTRANSPORT_H
@@ -1,18 +1,27 @@
 #pragma once
 
+#include <optional>
 #include <string>
 #include <util/socket/Socket.h>
+#include <util/socket/fdPassing.h>
+#include <util/socket/nonBlocking.h>
 #include "Transport.h"
 
 namespace l5 {
 namespace transport {
+/// With fd passing enabled, large writes go through pooled shared memory instead of the socket, c.f.
+/// util::domain::FdPassingStream. Server and client need the same setting
 class DomainSocketsTransportServer : public TransportServer<DomainSocketsTransportServer> {
     const util::Socket initialSocket;
     const std::string file;
     util::Socket communicationSocket;
+    std::optional<util::domain::FdPassingStream> fdPassing;
+    /// How far the last tryRead / tryWrite got, reset for every accepted connection
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
-    explicit DomainSocketsTransportServer(std::string file);
+    explicit DomainSocketsTransportServer(std::string file, util::domain::FdPassing fdPassing = {});
 
     ~DomainSocketsTransportServer() override;
 
@@ -22,14 +31,33 @@ public:
 
     void read_impl(uint8_t *buffer, size_t size);
 
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
+
     size_t readSome_impl(uint8_t *buffer, size_t maxSize);
+
+    /// The connected socket, so util::EventLoop can wait for it with epoll. -1 with fd passing, since a write then
+    /// waits for the remote side to release pooled memory, which epoll can't see
+    int pollFd() const { return fdPassing ? -1 : communicationSocket.get(); }
 };
 
 class DomainSocketsTransportClient : public TransportClient<DomainSocketsTransportClient> {
     const util::Socket socket;
+    std::optional<util::domain::FdPassingStream> fdPassing;
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
-    DomainSocketsTransportClient();
+    explicit DomainSocketsTransportClient(util::domain::FdPassing fdPassing = {});
 
     ~DomainSocketsTransportClient() override;
 
@@ -39,7 +67,95 @@ public:
 
     void read_impl(uint8_t *buffer, size_t size);
 
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
+
     size_t readSome_impl(uint8_t *buffer, size_t maxSize);
+
+    int pollFd() const { return fdPassing ? -1 : socket.get(); }
+};
+
+/**
+ * Message oriented channel over a SOCK_SEQPACKET domain socket. Every receive returns exactly one message, as it was
+ * sent, so callers don't need to frame their messages and each message costs a single system call.
+ * sendBatch and receiveBatch move many messages with a single sendmmsg / recvmmsg. Messages can't be empty, an empty
+ * receive is the peer hanging up, so receive throws then.
+ */
+class DomainSocketsMessageTransportServer {
+    const util::Socket initialSocket;
+    const std::string file;
+    util::Socket communicationSocket;
+
+public:
+    explicit DomainSocketsMessageTransportServer(std::string file);
+
+    void accept();
+
+    void send(const uint8_t *data, size_t size);
+
+    /// The message needs to fit into maxSize bytes. Returns its size
+    size_t receive(void *whereTo, size_t maxSize);
+
+    /// Send each segment as its own message
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
+    /// Receive all available messages, but at least one and at most count, one per buffer. Returns the number of
+    /// messages, sizes receives the size of each of them
+    size_t receiveBatch(const util::MutableSegment *buffers, size_t count, size_t *sizes);
+
+    template<typename TriviallyCopyable>
+    void write(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+        send(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    template<typename TriviallyCopyable>
+    size_t read(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+        return receive(&data, sizeof(data));
+    }
+};
+
+class DomainSocketsMessageTransportClient {
+    const util::Socket socket;
+
+public:
+    DomainSocketsMessageTransportClient();
+
+    void connect(std::string file);
+
+    void send(const uint8_t *data, size_t size);
+
+    /// The message needs to fit into maxSize bytes. Returns its size
+    size_t receive(void *whereTo, size_t maxSize);
+
+    /// Send each segment as its own message
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
+    /// Receive all available messages, but at least one and at most count, one per buffer. Returns the number of
+    /// messages, sizes receives the size of each of them
+    size_t receiveBatch(const util::MutableSegment *buffers, size_t count, size_t *sizes);
+
+    template<typename TriviallyCopyable>
+    void write(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+        send(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    template<typename TriviallyCopyable>
+    size_t read(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+        return receive(&data, sizeof(data));
+    }
 };
 } // namespace transport
 } // namespace l5
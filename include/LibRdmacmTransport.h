@@ -2,6 +2,7 @@
 #define L5RDMA_LIBRDMACMTRANSPORT_H
 
 #include "Transport.h"
+#include "util/socket/nonBlocking.h"
 #include <rdma/rsocket.h>
 
 namespace l5 {
@@ -9,6 +10,9 @@ namespace transport {
 class LibRdmacmTransportServer : public TransportServer<LibRdmacmTransportServer> {
     int rdmaSocket;
     int commSocket = -1;
+    /// How far the last tryRead / tryWrite got, reset for every accepted connection
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
     explicit LibRdmacmTransportServer(std::string_view port);
@@ -20,10 +24,24 @@ public:
     void write_impl(const uint8_t *data, size_t size);
 
     void read_impl(uint8_t *buffer, size_t size);
+
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
 };
 
 class LibRdmacmTransportClient : public TransportClient<LibRdmacmTransportClient> {
     int rdmaSocket = -1;
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
     LibRdmacmTransportClient();
@@ -35,6 +53,18 @@ public:
     void write_impl(const uint8_t *data, size_t size);
 
     void read_impl(uint8_t *buffer, size_t size);
+
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
 };
 } // namespace transport
 } // namespace l5
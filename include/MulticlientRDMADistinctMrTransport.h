@@ -6,6 +6,7 @@
 #include <rdma/Network.hpp>
 #include <rdma/MemoryRegion.h>
 #include <rdma/RcQueuePair.h>
+#include <rdma/SelectiveSignaling.h>
 
 namespace l5::transport {
 class MulticlientRDMADistinctMrTransportServer {
@@ -17,8 +18,9 @@ class MulticlientRDMADistinctMrTransportServer {
         rdma::RcQueuePair qp;
         /// The pre-prepared answer work request. Only the local data source changes for each answer
         ibv::workrequest::Simple<ibv::workrequest::Write> answerWr;
-        /// Send counter to keep track when we need to signal
-        size_t sendCounter = 0;
+        /// Selective signaling needs to happen per queuepair / connection. On the heap, since it's bound to the shared
+        /// completion queue
+        std::unique_ptr<rdma::SelectiveSignaling> signaling;
         /// Constructor
         Connection(util::Socket socket, rdma::RcQueuePair qp, ibv::workrequest::Simple<ibv::workrequest::Write> answerWr)
             : socket(std::move(socket)), qp(std::move(qp)), answerWr(answerWr){}
@@ -27,6 +29,8 @@ class MulticlientRDMADistinctMrTransportServer {
     static constexpr size_t MAX_MESSAGESIZE = 256 * 1024 * 1024;
     static constexpr char validity = '\4'; // ASCII EOT char
     size_t MAX_CLIENTS;
+    /// Signal every signalingWatermark-th answer of a connection, 0 for a quarter of its send queue
+    uint32_t signalingWatermark;
 
     util::Socket listenSock;
     rdma::Network net;
@@ -50,7 +54,8 @@ class MulticlientRDMADistinctMrTransportServer {
     }
 
 public:
-    explicit MulticlientRDMADistinctMrTransportServer(const std::string &port, size_t maxClients = 256);
+    explicit MulticlientRDMADistinctMrTransportServer(const std::string &port, size_t maxClients = 256,
+                                                      uint32_t signalingWatermark = 0);
 
     ~MulticlientRDMADistinctMrTransportServer() = default;
 
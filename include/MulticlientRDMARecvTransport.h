@@ -4,6 +4,7 @@
 #include "rdma/MemoryRegion.h"
 #include "rdma/Network.hpp"
 #include "rdma/RcQueuePair.h"
+#include "rdma/SelectiveSignaling.h"
 #include "util/socket/Socket.h"
 #include <unordered_map>
 #include <emmintrin.h>
@@ -20,8 +21,9 @@ class MulticlientRDMARecvTransportServer {
       ibv::workrequest::Simple<ibv::workrequest::Write> answerWr;
       /// The receive request for incoming messages
       ibv::workrequest::Recv recv;
-      /// Send counter to keep track when we need to signal
-      size_t sendCounter = 0; // TODO: instead of a send counter, maybe use an "unsignaled" count with a threshold
+      /// Selective signaling needs to happen per queuepair / connection. On the heap, since it's bound to the shared
+      /// completion queue
+      std::unique_ptr<rdma::SelectiveSignaling> signaling;
       /// Constructor
       Connection(util::Socket socket, rdma::RcQueuePair qp, ibv::workrequest::Simple<ibv::workrequest::Write> answerWr,
                  ibv::workrequest::Recv recv)
@@ -34,6 +36,8 @@ class MulticlientRDMARecvTransportServer {
    static constexpr char validity = '\4'; // ASCII EOT char
    /// How many clients can concurrently connect
    size_t MAX_CLIENTS;
+   /// Signal every signalingWatermark-th answer of a connection, 0 for a quarter of its send queue
+   uint32_t signalingWatermark;
 
    util::Socket listenSock;
    rdma::Network net;
@@ -54,7 +58,8 @@ class MulticlientRDMARecvTransportServer {
    }
 
    public:
-   explicit MulticlientRDMARecvTransportServer(const std::string& port, size_t maxClients = 256);
+   explicit MulticlientRDMARecvTransportServer(const std::string& port, size_t maxClients = 256,
+                                               uint32_t signalingWatermark = 0);
 
    ~MulticlientRDMARecvTransportServer() = default;
 
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstring>
 #include <emmintrin.h>
 #include <util/socket/Socket.h>
 #include <rdma/CompletionQueuePair.hpp>
 #include <rdma/Network.hpp>
 #include <rdma/MemoryRegion.h>
 #include <rdma/RcQueuePair.h>
+#include <rdma/SelectiveSignaling.h>
+#include "util/segments.h"
 
 namespace l5 {
 namespace transport {
@@ -18,8 +21,9 @@ class MulticlientRDMATransportServer {
         rdma::RcQueuePair qp;
         /// The pre-prepared answer work request. Only the local data source changes for each answer
         ibv::workrequest::Simple<ibv::workrequest::Write> answerWr;
-        /// Send counter to keep track when we need to signal
-        size_t sendCounter = 0;
+        /// Selective signaling needs to happen per queuepair / connection. On the heap, since it's bound to the shared
+        /// completion queue
+        std::unique_ptr<rdma::SelectiveSignaling> signaling;
         /// Constructor
         Connection(util::Socket socket, rdma::RcQueuePair qp, ibv::workrequest::Simple<ibv::workrequest::Write> answerWr)
             : socket(std::move(socket)), qp(std::move(qp)), answerWr(answerWr){}
@@ -28,6 +32,8 @@ class MulticlientRDMATransportServer {
     static constexpr size_t MAX_MESSAGESIZE = 256 * 1024 * 1024;
     static constexpr char validity = '\4'; // ASCII EOT char
     size_t MAX_CLIENTS;
+    /// Signal every signalingWatermark-th answer of a connection, 0 for a quarter of its send queue
+    uint32_t signalingWatermark;
 
     util::Socket listenSock;
     rdma::Network net;
@@ -42,6 +48,11 @@ class MulticlientRDMATransportServer {
 
     std::vector<Connection> connections;
 
+    /// The batch, that is currently handed out message by message
+    size_t batchSender = 0;
+    size_t batchRemaining = 0;
+    size_t batchOffset = 0;
+
     void listen(uint16_t port);
 
     __always_inline
@@ -83,7 +94,8 @@ class MulticlientRDMATransportServer {
     }
 
 public:
-    explicit MulticlientRDMATransportServer(const std::string &port, size_t maxClients = 256);
+    explicit MulticlientRDMATransportServer(const std::string &port, size_t maxClients = 256,
+                                            uint32_t signalingWatermark = 0);
 
     ~MulticlientRDMATransportServer();
 
@@ -125,30 +137,42 @@ public:
         *validityPtr = validity;
 
         con.answerWr.setLocalAddress(sendBuffer.getSlice(0, totalLength));
-        // selective signaling needs to happen per queuepair / connection
-        ++con.sendCounter;
-        if (con.sendCounter % 1024 == 0) { // selective signaling
-            setWrFlags(con.answerWr, true, totalLength < 512);
-            con.qp.postWorkRequest(con.answerWr);
-            sharedCq->pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode::RDMA_WRITE);
-        } else {
-            setWrFlags(con.answerWr, false, totalLength < 512);
-            con.qp.postWorkRequest(con.answerWr);
-        }
+        // reaps the completions without blocking, unless the send queue is full
+        setWrFlags(con.answerWr, con.signaling->prepare(), totalLength < 512);
+        con.qp.postWorkRequest(con.answerWr);
     }
 
     /// receive data via a lambda to enable zerocopy operation
     /// expected signature: [](size_t sender, const uint8_t* begin, const uint8_t* end) -> void
     template<typename RangeConsumer>
     void receive(RangeConsumer &&callback) {
-        const auto sender = pollSSE(doorBells.data(), MAX_CLIENTS);
-
-        const auto sizePtr = reinterpret_cast<uint8_t *>(receives.data()[sender]);
-        const auto size = *reinterpret_cast<size_t *>(sizePtr);
+        if (batchRemaining == 0) {
+            const auto sender = pollSSE(doorBells.data(), MAX_CLIENTS);
+
+            // [size][frames][data], c.f. MultiClientRDMATransportClient
+            const auto slot = reinterpret_cast<uint8_t *>(receives.data()[sender]);
+            const auto size = *reinterpret_cast<size_t *>(slot);
+            const auto frames = *reinterpret_cast<size_t *>(slot + sizeof(size_t));
+
+            if (frames == 0) {
+                const auto begin = slot + 2 * sizeof(size_t);
+                const auto end = begin + size;
+                callback(sender, begin, end);
+                return;
+            }
+            batchSender = sender;
+            batchRemaining = frames;
+            batchOffset = 2 * sizeof(size_t);
+        }
 
-        const auto begin = sizePtr + sizeof(size_t);
-        const auto end = begin + size;
-        callback(sender, begin, end);
+        // a batch from sendBatch, each message prefixed with its size
+        const auto slot = reinterpret_cast<uint8_t *>(receives.data()[batchSender]);
+        size_t size;
+        std::memcpy(&size, slot + batchOffset, sizeof(size));
+        const auto begin = slot + batchOffset + sizeof(size);
+        batchOffset += sizeof(size) + size;
+        --batchRemaining;
+        callback(batchSender, begin, begin + size);
     }
 
     template<typename TriviallyCopyable>
@@ -182,6 +206,9 @@ class MultiClientRDMATransportClient {
 
     void rdmaConnect();
 
+    /// Write the first dataWrSize bytes of the send buffer and ring the door bell, with a single post and completion
+    void postWithDoorBell(size_t dataWrSize);
+
 public:
     MultiClientRDMATransportClient();
 
@@ -191,31 +218,29 @@ public:
 
     void send(const uint8_t *data, size_t size);
 
+    /// Send several messages with a single data write and door bell. The server still receives them one by one
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
     size_t receive(void *whereTo, size_t maxSize);
 
     /// send data via a lambda to enable zerocopy operation
     /// expected signature: [](uint8_t* begin) -> size_t
     template<typename SizeReturner>
     void send(SizeReturner &&doWork) {
+        // [size][frames][data], frames is 0 for a single message
         auto sizePtr = reinterpret_cast<size_t *>(sendBuffer.data());
-        auto begin = sendBuffer.data() + sizeof(size_t);
+        auto begin = sendBuffer.data() + 2 * sizeof(size_t);
 
         const auto size = doWork(begin);
-        const auto dataWrSize = size + sizeof(size_t);
+        const auto dataWrSize = size + 2 * sizeof(size_t);
         if (dataWrSize > MAX_MESSAGESIZE) {
             throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
         }
 
-        *sizePtr = size;
-
-        dataWr.setLocalAddress(sendBuffer.getSlice(0, dataWrSize));
-        qp.postWorkRequest(dataWr);
-
-        doorBell.data()[0] = 'X'; // could be anything, really
-        qp.postWorkRequest(doorBellWr);
+        sizePtr[0] = size;
+        sizePtr[1] = 0;
 
-        cq.pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode::RDMA_WRITE);
-        cq.pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode::RDMA_WRITE);
+        postWithDoorBell(dataWrSize);
     }
 
     /// receive data via a lambda to enable zerocopy operation
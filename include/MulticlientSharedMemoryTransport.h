@@ -0,0 +1,271 @@
+#ifndef L5RDMA_MULTICLIENTSHAREDMEMORYTRANSPORT_H
+#define L5RDMA_MULTICLIENTSHAREDMEMORYTRANSPORT_H
+
+#include <atomic>
+#include <cstring>
+#include <emmintrin.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util/busywait.h"
+#include "util/segments.h"
+#include "util/socket/Socket.h"
+#include "util/virtualMemory.h"
+
+namespace l5 {
+namespace transport {
+namespace multiclientshm {
+static constexpr size_t MAX_MESSAGESIZE = 16 * 1024 * 1024;
+
+/// A single message in shared memory
+struct Message {
+    /// Only used for answers, requests are announced via the door bells
+    alignas(64) std::atomic<bool> full;
+    size_t size;
+    /// 0 for a single message. Otherwise data holds this many messages from sendBatch, each prefixed with its size
+    size_t frames;
+    alignas(64) uint8_t data[MAX_MESSAGESIZE];
+};
+
+/// The shared memory for each client, created by the server and sent to the client via domain::send_fd
+struct Mailbox {
+    Message request;
+    Message answer;
+};
+
+/// Exchanged after the file descriptors of the door bells and the mailbox
+struct ConnectionInfo {
+    size_t clientId;
+    size_t maxClients;
+};
+} // namespace multiclientshm
+
+/**
+ * Many-to-one channel via shared memory, mirroring the MulticlientRDMATransportServer. Each client gets its own
+ * Mailbox and one byte in a door bell array shared by all clients. The server finds ready clients, by scanning the
+ * door bells with SSE.
+ * Each client can have at most one message in flight in each direction.
+ */
+class MulticlientSharedMemoryTransportServer {
+    struct Connection {
+        /// Socket from accept (currently unused after bootstrapping)
+        util::Socket socket;
+        util::ShmMapping<multiclientshm::Mailbox> mailbox;
+
+        Connection(util::Socket socket, util::ShmMapping<multiclientshm::Mailbox> mailbox)
+                : socket(std::move(socket)), mailbox(std::move(mailbox)) {}
+    };
+
+    size_t MAX_CLIENTS;
+
+    util::Socket listenSock;
+    std::string file;
+
+    util::ShmMapping<char> doorBells;
+    /// The client served last, the next scan starts right after it, so low client ids don't starve high ones
+    size_t lastServed = SIZE_MAX;
+
+    /// The batch, that is currently handed out message by message. Its door bell stays set until the last one
+    size_t batchSender = 0;
+    size_t batchRemaining = 0;
+    size_t batchOffset = 0;
+
+    std::vector<Connection> connections;
+
+    /// Find a door bell that is set. Doesn't clear it, since the client may only reuse its mailbox afterwards
+    __always_inline
+    size_t pollSSE(const char *bells, size_t count) noexcept {
+        const auto zero = _mm_set1_epi8('\0');
+        const auto start = (lastServed + 1) % count;
+        const auto startBlock = start - start % 16;
+        // in the first block, the bells up to the last served one only count, after all others were scanned
+        auto mask = static_cast<uint16_t>(0xffff << (start % 16));
+        for (size_t i = startBlock, tries = 0;; i = (i + 16) % count) {
+            if (i == startBlock) {
+                // back off after each unsuccessful scan of all door bells
+                yield(tries++);
+            }
+            auto data = *reinterpret_cast<const volatile __m128i *>(&bells[i]);
+            auto cmp = _mm_cmpeq_epi8(zero, data);
+            uint16_t cmpMask = compl _mm_movemask_epi8(cmp) & mask;
+            mask = 0xffff;
+            if (cmpMask != 0) {
+                lastServed = __builtin_ctz(cmpMask) + i;
+                return lastServed;
+            }
+        }
+    }
+
+    /// hand the request buffer back to the client
+    void releaseRequest(size_t sender) {
+        std::atomic_thread_fence(std::memory_order_release);
+        *reinterpret_cast<volatile char *>(&doorBells.data.get()[sender]) = '\0';
+    }
+
+    /// Hand a message to callback. It's consumed, even if callback throws. After the last one of the request, the
+    /// client may reuse its mailbox
+    template<typename RangeConsumer>
+    void consume(RangeConsumer &callback, size_t sender, const uint8_t *begin, size_t size, bool last) {
+        try {
+            callback(sender, begin, begin + size);
+        } catch (...) {
+            if (last) releaseRequest(sender);
+            throw;
+        }
+        if (last) releaseRequest(sender);
+    }
+
+public:
+    /// Accept clients on the given domain socket
+    explicit MulticlientSharedMemoryTransportServer(std::string_view domainSocket, size_t maxClients = 256);
+
+    ~MulticlientSharedMemoryTransportServer();
+
+    MulticlientSharedMemoryTransportServer(MulticlientSharedMemoryTransportServer &&) = default;
+
+    MulticlientSharedMemoryTransportServer &operator=(MulticlientSharedMemoryTransportServer &&) = default;
+
+    void accept();
+
+    /// Stop accepting new clients and remove the domain socket
+    void finishListen();
+
+    /// polls all possible clients for incoming messages and copys the first one it finds to "whereTo"
+    size_t receive(void *whereTo, size_t maxSize);
+
+    void send(size_t receiverId, const uint8_t *data, size_t size);
+
+    /// send data via a lambda to enable zerocopy operation
+    /// expected signature: [](uint8_t* begin) -> size_t
+    template<typename SizeReturner>
+    void send(size_t receiverId, SizeReturner &&doWork) {
+        if (receiverId >= connections.size()) {
+            throw std::runtime_error("no such connection");
+        }
+
+        auto &answer = connections[receiverId].mailbox.data->answer;
+        // wait until the client consumed the previous answer
+        loop_while([] {}, [&]() { return answer.full.load(std::memory_order_acquire); });
+
+        const size_t size = doWork(answer.data);
+        if (size > multiclientshm::MAX_MESSAGESIZE) {
+            throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
+        }
+        answer.size = size;
+        answer.full.store(true, std::memory_order_release);
+    }
+
+    /// receive data via a lambda to enable zerocopy operation
+    /// expected signature: [](size_t sender, const uint8_t* begin, const uint8_t* end) -> void
+    template<typename RangeConsumer>
+    void receive(RangeConsumer &&callback) {
+        if (batchRemaining == 0) {
+            const auto sender = pollSSE(doorBells.data.get(), MAX_CLIENTS);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            const auto &request = connections[sender].mailbox.data->request;
+            if (request.frames == 0) {
+                consume(callback, sender, request.data, request.size, true);
+                return;
+            }
+            batchSender = sender;
+            batchRemaining = request.frames;
+            batchOffset = 0;
+        }
+
+        const auto &request = connections[batchSender].mailbox.data->request;
+        size_t size;
+        std::memcpy(&size, &request.data[batchOffset], sizeof(size));
+        const auto begin = &request.data[batchOffset + sizeof(size)];
+        // the batch moves on before the callback, which might throw
+        batchOffset += sizeof(size) + size;
+        --batchRemaining;
+        consume(callback, batchSender, begin, size, batchRemaining == 0);
+    }
+
+    template<typename TriviallyCopyable>
+    void write(size_t receiverId, const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        send(receiverId, reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    template<typename TriviallyCopyable>
+    size_t read(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        return receive(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+    }
+};
+
+class MulticlientSharedMemoryTransportClient {
+    util::Socket sock;
+    size_t clientId = 0;
+    util::ShmMapping<char> doorBells;
+    util::ShmMapping<multiclientshm::Mailbox> mailbox;
+
+    volatile char &doorBell() {
+        return *reinterpret_cast<volatile char *>(&doorBells.data.get()[clientId]);
+    }
+
+public:
+    MulticlientSharedMemoryTransportClient();
+
+    /// Connect to the server's domain socket
+    void connect(std::string_view whereTo);
+
+    void send(const uint8_t *data, size_t size);
+
+    /// Send several messages with a single door bell. The server still receives them one by one
+    void sendBatch(const util::ConstSegment *messages, size_t count);
+
+    size_t receive(void *whereTo, size_t maxSize);
+
+    /// send data via a lambda to enable zerocopy operation
+    /// expected signature: [](uint8_t* begin) -> size_t
+    template<typename SizeReturner>
+    void send(SizeReturner &&doWork) {
+        // wait until the server consumed our previous request
+        loop_while([] {}, [&]() { return doorBell() != '\0'; });
+
+        auto &request = mailbox.data->request;
+        const size_t size = doWork(request.data);
+        if (size > multiclientshm::MAX_MESSAGESIZE) {
+            throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
+        }
+        request.size = size;
+        request.frames = 0;
+
+        std::atomic_thread_fence(std::memory_order_release);
+        doorBell() = 'X'; // could be anything, really
+    }
+
+    /// receive data via a lambda to enable zerocopy operation
+    /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+    template<typename RangeConsumer>
+    void receive(RangeConsumer &&callback) {
+        auto &answer = mailbox.data->answer;
+        loop_while([] {}, [&]() { return not answer.full.load(std::memory_order_acquire); });
+
+        const auto begin = answer.data;
+        const auto end = begin + answer.size;
+        callback(begin, end);
+
+        answer.full.store(false, std::memory_order_release);
+    }
+
+    template<typename TriviallyCopyable>
+    void write(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        send(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    template<typename TriviallyCopyable>
+    void read(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        receive(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+    }
+};
+} // namespace transport
+} // namespace l5
+
+#endif //L5RDMA_MULTICLIENTSHAREDMEMORYTRANSPORT_H
@@ -1,29 +1,140 @@
 #ifndef L5RDMA_MULTICLIENTTCPTRANSPORT_H
 #define L5RDMA_MULTICLIENTTCPTRANSPORT_H
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <string_view>
 #include <vector>
-#include <poll.h>
 #include "util/socket/Socket.h"
+#include "util/socket/tcp.h"
 
 namespace l5 {
+namespace util {
+class IoUring;
+class ProvidedBuffers;
+} // namespace util
 namespace transport {
+/// How MulticlientTCPTransportServer waits for and receives incoming data
+enum class MulticlientTcpBackend {
+    /// edge triggered epoll and a recv per ready connection
+    Epoll,
+    /// multishot receives into provided buffers. Sends are batched and submitted with the next wait, so a single
+    /// system call serves many connections (needs Linux 5.19)
+    IoUring
+};
+
+/// How MulticlientTCPTransportServer accepts connections
+enum class MulticlientTcpAccept {
+    /// with a call to accept per client
+    Explicit,
+    /// receive accepts new connections, as they come in. The listen socket has SO_REUSEPORT, so several servers on the
+    /// same port share the incoming connections, c.f. ShardedTCPTransportServer
+    Automatic
+};
+
+/**
+ * Many-to-one channel via TCP. Every message is prefixed with its size, so it is received as a whole.
+ * The server is driven by an edge triggered epoll instance and keeps a read buffer per connection, so receive only
+ * costs O(ready connections). Ready connections are served round robin, so no client can starve the others.
+ * A client announcing a message larger than MAX_MESSAGESIZE is dropped, as soon as its header arrives.
+ */
 class MulticlientTCPTransportServer {
+    struct Connection {
+        util::Socket socket;
+        /// Received, but not yet consumed bytes are in [begin, end)
+        std::vector<uint8_t> buffer;
+        size_t begin = 0;
+        size_t end = 0;
+        /// Whether the connection is in the ready queue
+        bool queued = false;
+        bool closed = false;
+        /// io_uring only: framed messages, that wait for the next submission and the ones currently being sent
+        std::vector<uint8_t> outbox;
+        std::vector<uint8_t> sending;
+        /// how much of sending is sent already
+        size_t sent = 0;
+
+        explicit Connection(util::Socket socket) : socket(std::move(socket)) {}
+    };
+
     const util::Socket serverSocket;
-    std::vector<util::Socket> connections;
-    std::vector<pollfd> pollFds;
+    const MulticlientTcpAccept acceptMode;
+    const util::Socket epoll;
+    std::vector<Connection> connections;
+    /// Connections, that might have a complete message buffered or unread data in the socket
+    std::deque<size_t> ready;
+
+    /// Declared before uring, so the ring is closed first and nothing can be submitted anymore, while the buffers
+    /// cancel the pending receives
+    std::unique_ptr<util::ProvidedBuffers> receiveBuffers;
+    std::unique_ptr<util::IoUring> uring;
+    /// Connections with a non-empty outbox
+    std::vector<size_t> unsent;
+    size_t sendsInFlight = 0;
 
     void listen(uint16_t port);
 
+    void addConnection(util::Socket socket);
+
+    /// Automatic accept only: accept all pending connections without blocking
+    void acceptPending();
+
+    /// Block until at least one connection is ready, but at most timeoutMs, if it is not negative
+    void waitForEvents(int timeoutMs);
+
+    /// Copy out the message of the first ready connection, that has a complete one. Doesn't wait
+    std::optional<size_t> receiveReady(void *whereTo, size_t maxSize);
+
+    /// Read from the socket until a complete message is buffered. Returns false, if the socket ran dry first
+    bool fill(Connection &connection);
+
+    /// Drop the connection, if the next buffered header announces more than MAX_MESSAGESIZE. Returns whether it did
+    bool dropOversized(Connection &connection);
+
+    /// Make room for at least bytes after the end of the connection's buffer
+    static void reserve(Connection &connection, size_t bytes);
+
+    /// io_uring only: (re-)start the multishot receive of a connection
+    void armReceive(size_t id);
+
+    /// io_uring with automatic accept only: (re-)start the multishot accept
+    void armAccept();
+
+    /// io_uring only: prepare a send for every connection with an outbox and without a send in flight
+    void prepareSends();
+
+    /// io_uring only: prepare a send of the rest of the connection's sending
+    void prepareSend(size_t id);
+
+    /// io_uring only: submit everything prepared, wait for at least one completion and handle all available ones
+    void submitAndReap(int timeoutMs = -1);
+
 public:
-    explicit MulticlientTCPTransportServer(std::string_view port);
+    static constexpr size_t MAX_MESSAGESIZE = 256 * 1024 * 1024;
+
+    explicit MulticlientTCPTransportServer(std::string_view port,
+                                           MulticlientTcpBackend backend = MulticlientTcpBackend::Epoll,
+                                           MulticlientTcpAccept acceptMode = MulticlientTcpAccept::Explicit);
 
     ~MulticlientTCPTransportServer();
 
+    /// Explicit accept only
     void accept();
 
+    /// Connection ids are assigned in accept order, starting at 0, and never reused
+    size_t connectionCount() const { return connections.size(); }
+
+    /// Send everything batched by send and wait until it is written. Only does anything with the io_uring backend,
+    /// where the batched sends otherwise go out with the next receive
+    void flush();
+
     size_t receive(void *whereTo, size_t maxSize);
 
+    /// Like receive, but gives up after timeout
+    std::optional<size_t> receive(void *whereTo, size_t maxSize, std::chrono::milliseconds timeout);
+
     void send(size_t receiverId, const uint8_t *data, size_t size);
 
     template<typename TriviallyCopyable>
@@ -41,8 +152,11 @@ public:
 
 class MulticlientTCPTransportClient {
     util::Socket socket;
+    util::tcp::Profile profile;
+
+    void readExactly(void *whereTo, size_t size);
 public:
-    MulticlientTCPTransportClient();
+    explicit MulticlientTCPTransportClient(util::tcp::Profile profile = util::tcp::Profile::Default);
 
     ~MulticlientTCPTransportClient();
 
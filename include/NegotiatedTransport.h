@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <variant>
+#include "RdmaTransport.h"
+#include "SharedMemoryTransport.h"
+#include "TcpTransport.h"
+#include "Transport.h"
+
+namespace l5 {
+namespace transport {
+/// The connection types, a negotiated connection can end up with. In order of the variant alternatives
+enum class TransportKind : uint8_t {
+   Tcp, SharedMemory, Rdma
+};
+
+const char *to_string(TransportKind kind);
+
+/// What a peer can offer, exchanged over the bootstrap connection
+struct PeerCapabilities {
+   /// Identifies the host, shared memory only works between peers with the same boot id
+   std::array<char, 37> bootId;
+   /// Identifies the directory of the shared memory transport's domain socket, which peers in different mount
+   /// namespaces on the same host don't necessarily share
+   uint64_t rendezvousDevice;
+   uint64_t rendezvousInode;
+   /// Whether rdma::Network will find a usable device
+   bool rdma;
+};
+
+/// Probe the local machine
+PeerCapabilities localCapabilities();
+
+/// Shared memory when both peers share a host and can reach the same domain socket, RDMA when both have a device,
+/// TCP otherwise.
+/// Symmetric, so both peers come to the same result independently
+TransportKind chooseTransport(const PeerCapabilities &a, const PeerCapabilities &b);
+
+/// Sent by the server, once it listens for the chosen transport
+struct Rendezvous {
+   std::array<char, 108> domainSocket;
+   /// RDMA is bootstrapped via a port the kernel picks, so it can't be taken already
+   uint16_t port;
+};
+
+/// The domain socket of the shared memory transport of the server with the bootstrap port: /tmp/l5negotiated-<port>
+std::string rendezvousSocket(uint16_t port);
+
+/**
+ * A connection, that negotiates the best transport both peers support over a TCP bootstrap connection.
+ * Calls through the Transport interface dispatch on the chosen transport. Hot loops should use visit instead, to
+ * work on the concrete transport directly.
+ * @tparam BUFFER_SIZE buffer size of the shared memory and RDMA transports
+ */
+template<size_t BUFFER_SIZE = 16 * 1024 * 1024>
+class NegotiatedTransportServer : public TransportServer<NegotiatedTransportServer<BUFFER_SIZE>> {
+   const PeerCapabilities capabilities;
+   /// the bootstrap connection is replaced by the chosen transport, so there is only ever one connection
+   bool accepted = false;
+   std::variant<std::unique_ptr<TcpTransportServer>,
+         std::unique_ptr<SharedMemoryTransportServer<BUFFER_SIZE>>,
+         std::unique_ptr<RdmaTransportServer<BUFFER_SIZE>>> transport;
+
+   public:
+   /**
+    * @param port TCP port for the bootstrap connection, which is also the fallback transport
+    * @param capabilities what to offer the client, defaults to everything this machine supports
+    */
+   explicit NegotiatedTransportServer(const std::string &port, PeerCapabilities capabilities = localCapabilities());
+
+   ~NegotiatedTransportServer() override = default;
+
+   TransportKind kind() const { return static_cast<TransportKind>(transport.index()); }
+
+   /// Call visitor with the concrete transport, so everything in it is statically dispatched
+   template<typename Visitor>
+   decltype(auto) visit(Visitor &&visitor) {
+      return std::visit([&](auto &t) -> decltype(auto) { return visitor(*t); }, transport);
+   }
+
+   void accept_impl();
+
+   void write_impl(const uint8_t *data, size_t size) { visit([&](auto &t) { t.write(data, size); }); }
+
+   void read_impl(uint8_t *buffer, size_t size) { visit([&](auto &t) { t.read(buffer, size); }); }
+
+   size_t readSome_impl(uint8_t *buffer, size_t maxSize) {
+      return visit([&](auto &t) { return t.readSome(buffer, maxSize); });
+   }
+
+   void writev_impl(const util::ConstSegment *segments, size_t count) {
+      visit([&](auto &t) { t.writev(segments, count); });
+   }
+
+   void readv_impl(const util::MutableSegment *segments, size_t count) {
+      visit([&](auto &t) { t.readv(segments, count); });
+   }
+
+   bool tryRead_impl(uint8_t *buffer, size_t size) { return visit([&](auto &t) { return t.tryRead(buffer, size); }); }
+
+   bool tryWrite_impl(const uint8_t *data, size_t size) {
+      return visit([&](auto &t) { return t.tryWrite(data, size); });
+   }
+
+   bool readable_impl() { return visit([](auto &t) { return t.readable(); }); }
+
+   bool writable_impl() { return visit([](auto &t) { return t.writable(); }); }
+};
+
+template<size_t BUFFER_SIZE = 16 * 1024 * 1024>
+class NegotiatedTransportClient : public TransportClient<NegotiatedTransportClient<BUFFER_SIZE>> {
+   const PeerCapabilities capabilities;
+   bool connected = false;
+   std::variant<std::unique_ptr<TcpTransportClient>,
+         std::unique_ptr<SharedMemoryTransportClient<BUFFER_SIZE>>,
+         std::unique_ptr<RdmaTransportClient<BUFFER_SIZE>>> transport;
+
+   public:
+   explicit NegotiatedTransportClient(PeerCapabilities capabilities = localCapabilities());
+
+   ~NegotiatedTransportClient() override = default;
+
+   TransportKind kind() const { return static_cast<TransportKind>(transport.index()); }
+
+   template<typename Visitor>
+   decltype(auto) visit(Visitor &&visitor) {
+      return std::visit([&](auto &t) -> decltype(auto) { return visitor(*t); }, transport);
+   }
+
+   /// Connect to a NegotiatedTransportServer at <ip>:<port>
+   void connect_impl(const std::string &connection);
+
+   void write_impl(const uint8_t *data, size_t size) { visit([&](auto &t) { t.write(data, size); }); }
+
+   void read_impl(uint8_t *buffer, size_t size) { visit([&](auto &t) { t.read(buffer, size); }); }
+
+   size_t readSome_impl(uint8_t *buffer, size_t maxSize) {
+      return visit([&](auto &t) { return t.readSome(buffer, maxSize); });
+   }
+
+   void writev_impl(const util::ConstSegment *segments, size_t count) {
+      visit([&](auto &t) { t.writev(segments, count); });
+   }
+
+   void readv_impl(const util::MutableSegment *segments, size_t count) {
+      visit([&](auto &t) { t.readv(segments, count); });
+   }
+
+   bool tryRead_impl(uint8_t *buffer, size_t size) { return visit([&](auto &t) { return t.tryRead(buffer, size); }); }
+
+   bool tryWrite_impl(const uint8_t *data, size_t size) {
+      return visit([&](auto &t) { return t.tryWrite(data, size); });
+   }
+
+   bool readable_impl() { return visit([](auto &t) { return t.readable(); }); }
+
+   bool writable_impl() { return visit([](auto &t) { return t.writable(); }); }
+};
+
+template<size_t BUFFER_SIZE>
+NegotiatedTransportServer<BUFFER_SIZE>::NegotiatedTransportServer(const std::string &port, PeerCapabilities capabilities) :
+      capabilities(capabilities),
+      transport(std::make_unique<TcpTransportServer>(port)) {}
+
+template<size_t BUFFER_SIZE>
+void NegotiatedTransportServer<BUFFER_SIZE>::accept_impl() {
+   if (accepted) {
+      throw std::runtime_error{"a NegotiatedTransportServer only accepts a single connection"};
+   }
+   auto &bootstrap = *std::get<std::unique_ptr<TcpTransportServer>>(transport);
+   bootstrap.accept();
+   accepted = true;
+   PeerCapabilities remote{};
+   bootstrap.read(remote);
+   bootstrap.write(capabilities);
+
+   const auto chosen = chooseTransport(capabilities, remote);
+   if (chosen == TransportKind::Tcp) return; // just keep using the bootstrap connection
+
+   auto rendezvous = Rendezvous{};
+   if (chosen == TransportKind::SharedMemory) {
+      // the bound port, so servers on port "0" get their own. We own the port, so a file there is left behind by a
+      // crashed server
+      const auto file = rendezvousSocket(bootstrap.port());
+      ::unlink(file.c_str());
+      std::copy_n(file.begin(), std::min(file.size(), rendezvous.domainSocket.size() - 1),
+                  rendezvous.domainSocket.begin());
+      auto shm = std::make_unique<SharedMemoryTransportServer<BUFFER_SIZE>>(rendezvous.domainSocket.data());
+      bootstrap.write(rendezvous);
+      shm->accept();
+      transport = std::move(shm);
+   } else {
+      auto rdma = std::make_unique<RdmaTransportServer<BUFFER_SIZE>>("0");
+      rendezvous.port = rdma->port();
+      bootstrap.write(rendezvous);
+      rdma->accept();
+      transport = std::move(rdma);
+   }
+}
+
+template<size_t BUFFER_SIZE>
+NegotiatedTransportClient<BUFFER_SIZE>::NegotiatedTransportClient(PeerCapabilities capabilities) :
+      capabilities(capabilities),
+      transport(std::make_unique<TcpTransportClient>()) {}
+
+template<size_t BUFFER_SIZE>
+void NegotiatedTransportClient<BUFFER_SIZE>::connect_impl(const std::string &connection) {
+   if (connected) {
+      throw std::runtime_error{"a NegotiatedTransportClient only connects once"};
+   }
+   auto &bootstrap = *std::get<std::unique_ptr<TcpTransportClient>>(transport);
+   bootstrap.connect(connection);
+   connected = true;
+   bootstrap.write(capabilities);
+   PeerCapabilities remote{};
+   bootstrap.read(remote);
+
+   const auto chosen = chooseTransport(capabilities, remote);
+   if (chosen == TransportKind::Tcp) return;
+
+   // wait until the server listens
+   Rendezvous rendezvous{};
+   bootstrap.read(rendezvous);
+   if (chosen == TransportKind::SharedMemory) {
+      auto shm = std::make_unique<SharedMemoryTransportClient<BUFFER_SIZE>>();
+      shm->connect("shm:" + std::string(rendezvous.domainSocket.data()));
+      transport = std::move(shm);
+   } else {
+      const auto ip = connection.substr(0, connection.find(':'));
+      auto rdma = std::make_unique<RdmaTransportClient<BUFFER_SIZE>>();
+      rdma->connect(ip + ":" + std::to_string(rendezvous.port));
+      transport = std::move(rdma);
+   }
+}
+} // namespace transport
+} // namespace l5
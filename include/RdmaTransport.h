@@ -3,6 +3,7 @@
 #include <memory>
 #include "util/socket/Socket.h"
 #include "datastructures/VirtualRDMARingBuffer.h"
+#include "util/socket/nonBlocking.h"
 #include "util/socket/tcp.h"
 #include "Transport.h"
 
@@ -11,23 +12,45 @@ namespace transport {
 template<size_t BUFFER_SIZE = 16 * 1024 * 1024>
 class RdmaTransportServer : public TransportServer<RdmaTransportServer<BUFFER_SIZE>> {
    const util::Socket sock;
+   /// Credit based flow control of the ring buffers, 0 reads the remote read position instead
+   const size_t creditInterval;
    std::unique_ptr<datastructure::VirtualRDMARingBuffer> rdma = nullptr;
+   /// How far the last tryRead / tryWrite got, reset for every accepted connection
+   util::PartialTransfer pendingRead;
+   util::PartialTransfer pendingWrite;
 
    void listen(uint16_t port);
 
    public:
    static constexpr auto buffer_size = BUFFER_SIZE;
 
-   explicit RdmaTransportServer(const std::string &port);
+   /// With a creditInterval, the client RDMA writes its read position to us, whenever it consumed that many bytes,
+   /// so a full ring doesn't need a round trip to find free space, see VirtualRDMARingBuffer
+   explicit RdmaTransportServer(const std::string &port, size_t creditInterval = 0);
 
    ~RdmaTransportServer() override = default;
 
+   /// The port we listen on, e.g. the one the kernel picked for port "0"
+   uint16_t port() const { return util::tcp::localPort(sock); }
+
    void accept_impl();
 
    void write_impl(const uint8_t* data, size_t size);
 
    void read_impl(uint8_t* buffer, size_t size);
 
+   void writev_impl(const util::ConstSegment *segments, size_t count);
+
+   void readv_impl(const util::MutableSegment *segments, size_t count);
+
+   bool tryRead_impl(uint8_t *buffer, size_t size);
+
+   bool tryWrite_impl(const uint8_t *data, size_t size);
+
+   bool readable_impl();
+
+   bool writable_impl();
+
    template<typename RangeConsumer>
    void readZC(RangeConsumer &&callback) {
       rdma->receive(std::forward<RangeConsumer>(callback));
@@ -44,12 +67,18 @@ class RdmaTransportServer : public TransportServer<RdmaTransportServer<BUFFER_SI
 template<size_t BUFFER_SIZE = 16 * 1024 * 1024>
 class RdmaTransportClient : public TransportClient<RdmaTransportClient<BUFFER_SIZE>> {
    util::Socket sock;
+   /// Credit based flow control of the ring buffers, 0 reads the remote read position instead
+   size_t creditInterval;
    std::unique_ptr<datastructure::VirtualRDMARingBuffer> rdma = nullptr;
+   util::PartialTransfer pendingRead;
+   util::PartialTransfer pendingWrite;
 
    public:
    static constexpr auto buffer_size = BUFFER_SIZE;
 
-   RdmaTransportClient() : sock(util::Socket::create()) {};
+   /// Like the server's creditInterval, for the direction to the server
+   explicit RdmaTransportClient(size_t creditInterval = 0) :
+         sock(util::Socket::create()), creditInterval(creditInterval) {};
 
    ~RdmaTransportClient() override = default;
 
@@ -65,6 +94,18 @@ class RdmaTransportClient : public TransportClient<RdmaTransportClient<BUFFER_SI
 
    void read_impl(uint8_t* buffer, size_t size);
 
+   void writev_impl(const util::ConstSegment *segments, size_t count);
+
+   void readv_impl(const util::MutableSegment *segments, size_t count);
+
+   bool tryRead_impl(uint8_t *buffer, size_t size);
+
+   bool tryWrite_impl(const uint8_t *data, size_t size);
+
+   bool readable_impl();
+
+   bool writable_impl();
+
    template<typename RangeConsumer>
    void readZC(RangeConsumer &&callback) {
       rdma->receive(std::forward<RangeConsumer>(callback));
@@ -79,8 +120,8 @@ class RdmaTransportClient : public TransportClient<RdmaTransportClient<BUFFER_SI
 };
 
 template<size_t BUFFER_SIZE>
-RdmaTransportServer<BUFFER_SIZE>::RdmaTransportServer(const std::string &port) :
-      sock(util::Socket::create()) {
+RdmaTransportServer<BUFFER_SIZE>::RdmaTransportServer(const std::string &port, size_t creditInterval) :
+      sock(util::Socket::create()), creditInterval(creditInterval) {
    auto p = std::stoi(port);
    listen(p);
 }
@@ -88,7 +129,9 @@ RdmaTransportServer<BUFFER_SIZE>::RdmaTransportServer(const std::string &port) :
 template<size_t BUFFER_SIZE>
 void RdmaTransportServer<BUFFER_SIZE>::accept_impl() {
    auto acced = util::tcp::accept(sock);
-   rdma = std::make_unique<datastructure::VirtualRDMARingBuffer>(BUFFER_SIZE, acced);
+   rdma = std::make_unique<datastructure::VirtualRDMARingBuffer>(BUFFER_SIZE, acced, 0, creditInterval);
+   pendingRead = {};
+   pendingWrite = {};
 }
 
 template<size_t BUFFER_SIZE>
@@ -121,6 +164,59 @@ size_t RdmaTransportServer<BUFFER_SIZE>::readSome_impl(uint8_t* buffer, size_t s
     return rdma->receive(buffer, chunk);
 }
 
+template<size_t BUFFER_SIZE>
+void RdmaTransportServer<BUFFER_SIZE>::writev_impl(const util::ConstSegment *segments, size_t count) {
+   // gather directly into the registered send buffer, so each chunk is still a single write with a single slice
+   const auto size = util::totalSize(segments, count);
+   for (size_t i = 0; i < size;) {
+      const auto chunk = std::min(size - i, BUFFER_SIZE - 2 * sizeof(size_t));
+      rdma->send([&](volatile uint8_t *begin) {
+         util::gather(segments, count, i, chunk, const_cast<uint8_t *>(begin));
+         return chunk;
+      });
+      i += chunk;
+   }
+}
+
+template<size_t BUFFER_SIZE>
+void RdmaTransportServer<BUFFER_SIZE>::readv_impl(const util::MutableSegment *segments, size_t count) {
+   const auto size = util::totalSize(segments, count);
+   for (size_t i = 0; i < size;) {
+      rdma->receive([&](const uint8_t *begin, const uint8_t *end) {
+         const auto receiveSize = static_cast<size_t>(std::distance(begin, end));
+         if (receiveSize > size - i) {
+            throw std::runtime_error{"plz only read whole messages for now!"};
+         }
+         util::scatter(begin, receiveSize, segments, count, i);
+         i += receiveSize;
+      });
+   }
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportServer<BUFFER_SIZE>::tryRead_impl(uint8_t* buffer, size_t size) {
+   return pendingRead.advance(size, [&](size_t offset) {
+      return rdma->receiveAvailable(&buffer[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportServer<BUFFER_SIZE>::tryWrite_impl(const uint8_t* data, size_t size) {
+   return pendingWrite.advance(size, [&](size_t offset) {
+      return rdma->sendSome(&data[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportServer<BUFFER_SIZE>::readable_impl() {
+   return rdma->hasData();
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportServer<BUFFER_SIZE>::writable_impl() {
+   return rdma->canSend(1);
+}
+
 template<size_t BUFFER_SIZE>
 void RdmaTransportClient<BUFFER_SIZE>::connect_impl(const std::string &connection) {
    const auto pos = connection.find(':');
@@ -131,7 +227,9 @@ void RdmaTransportClient<BUFFER_SIZE>::connect_impl(const std::string &connectio
    const auto port = std::stoi(std::string(connection.begin() + pos + 1, connection.end()));
 
    util::tcp::connect(sock, ip, port);
-   rdma = std::make_unique<datastructure::VirtualRDMARingBuffer>(BUFFER_SIZE, sock);
+   rdma = std::make_unique<datastructure::VirtualRDMARingBuffer>(BUFFER_SIZE, sock, 0, creditInterval);
+   pendingRead = {};
+   pendingWrite = {};
 }
 
 template<size_t BUFFER_SIZE>
@@ -158,10 +256,65 @@ size_t RdmaTransportClient<BUFFER_SIZE>::readSome_impl(uint8_t* buffer, size_t s
     return rdma->receive(buffer, chunk);
 }
 
+template<size_t BUFFER_SIZE>
+void RdmaTransportClient<BUFFER_SIZE>::writev_impl(const util::ConstSegment *segments, size_t count) {
+   // gather directly into the registered send buffer, so each chunk is still a single write with a single slice
+   const auto size = util::totalSize(segments, count);
+   for (size_t i = 0; i < size;) {
+      const auto chunk = std::min(size - i, BUFFER_SIZE - 2 * sizeof(size_t));
+      rdma->send([&](volatile uint8_t *begin) {
+         util::gather(segments, count, i, chunk, const_cast<uint8_t *>(begin));
+         return chunk;
+      });
+      i += chunk;
+   }
+}
+
+template<size_t BUFFER_SIZE>
+void RdmaTransportClient<BUFFER_SIZE>::readv_impl(const util::MutableSegment *segments, size_t count) {
+   const auto size = util::totalSize(segments, count);
+   for (size_t i = 0; i < size;) {
+      rdma->receive([&](const uint8_t *begin, const uint8_t *end) {
+         const auto receiveSize = static_cast<size_t>(std::distance(begin, end));
+         if (receiveSize > size - i) {
+            throw std::runtime_error{"plz only read whole messages for now!"};
+         }
+         util::scatter(begin, receiveSize, segments, count, i);
+         i += receiveSize;
+      });
+   }
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportClient<BUFFER_SIZE>::tryRead_impl(uint8_t* buffer, size_t size) {
+   return pendingRead.advance(size, [&](size_t offset) {
+      return rdma->receiveAvailable(&buffer[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportClient<BUFFER_SIZE>::tryWrite_impl(const uint8_t* data, size_t size) {
+   return pendingWrite.advance(size, [&](size_t offset) {
+      return rdma->sendSome(&data[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportClient<BUFFER_SIZE>::readable_impl() {
+   return rdma->hasData();
+}
+
+template<size_t BUFFER_SIZE>
+bool RdmaTransportClient<BUFFER_SIZE>::writable_impl() {
+   return rdma->canSend(1);
+}
+
 template<size_t BUFFER_SIZE>
 void RdmaTransportClient<BUFFER_SIZE>::reset_impl() {
    sock = util::Socket::create();
    rdma.reset();
+   pendingRead = {};
+   pendingWrite = {};
 }
 } // namespace transport
 } // namespace l5
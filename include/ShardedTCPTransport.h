@@ -0,0 +1,103 @@
+#ifndef L5RDMA_SHARDEDTCPTRANSPORT_H
+#define L5RDMA_SHARDEDTCPTRANSPORT_H
+
+#include <cassert>
+#include <future>
+#include <memory>
+#include <vector>
+#include "MulticlientTCPTransport.h"
+
+namespace l5 {
+namespace transport {
+/**
+ * Several MulticlientTCPTransportServers on the same port, each with its own listen socket, epoll set (or io_uring)
+ * and thread. The kernel spreads the incoming connections across the listen sockets (SO_REUSEPORT), so the shards
+ * don't share any state and don't need to synchronize.
+ * Connection ids are unique across all shards and stay the same for the lifetime of a connection.
+ */
+class ShardedTCPTransportServer {
+public:
+    /// The part of the server, that is driven by a single thread. Only answers its own connections
+    class Shard {
+        MulticlientTCPTransportServer server;
+        const size_t shardIndex;
+        const size_t shardCount;
+
+        size_t globalId(size_t localId) const { return localId * shardCount + shardIndex; }
+
+        size_t localId(size_t globalId) const {
+            assert(globalId % shardCount == shardIndex);
+            return globalId / shardCount;
+        }
+
+    public:
+        Shard(std::string_view port, MulticlientTcpBackend backend, size_t shardIndex, size_t shardCount) :
+                server(port, backend, MulticlientTcpAccept::Automatic),
+                shardIndex(shardIndex),
+                shardCount(shardCount) {}
+
+        size_t index() const { return shardIndex; }
+
+        size_t receive(void *whereTo, size_t maxSize) { return globalId(server.receive(whereTo, maxSize)); }
+
+        std::optional<size_t> receive(void *whereTo, size_t maxSize, std::chrono::milliseconds timeout) {
+            if (const auto id = server.receive(whereTo, maxSize, timeout)) {
+                return globalId(*id);
+            }
+            return std::nullopt;
+        }
+
+        void send(size_t receiverId, const uint8_t *data, size_t size) {
+            server.send(localId(receiverId), data, size);
+        }
+
+        void flush() { server.flush(); }
+
+        template<typename TriviallyCopyable>
+        void write(size_t receiverId, const TriviallyCopyable &data) {
+            static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+            send(receiverId, reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+        }
+
+        template<typename TriviallyCopyable>
+        size_t read(TriviallyCopyable &data) {
+            static_assert(std::is_trivially_copyable_v<TriviallyCopyable>);
+            return receive(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+        }
+    };
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards;
+
+public:
+    ShardedTCPTransportServer(std::string_view port, size_t shardCount,
+                              MulticlientTcpBackend backend = MulticlientTcpBackend::Epoll) {
+        for (size_t i = 0; i < shardCount; ++i) {
+            shards.push_back(std::make_unique<Shard>(port, backend, i, shardCount));
+        }
+    }
+
+    size_t shardCount() const { return shards.size(); }
+
+    Shard &shard(size_t index) { return *shards[index]; }
+
+    /// The shard, that serves the connection
+    size_t shardOf(size_t connectionId) const { return connectionId % shards.size(); }
+
+    /// Call handler(shard) for every shard on its own thread and wait until all of them returned.
+    /// Rethrows the first exception of a handler
+    template<typename Handler>
+    void serve(Handler &&handler) {
+        std::vector<std::future<void>> workers;
+        for (auto &shard : shards) {
+            workers.push_back(std::async(std::launch::async, [&handler, &shard]() { handler(*shard); }));
+        }
+        for (auto &worker : workers) {
+            worker.get();
+        }
+    }
+};
+} // namespace transport
+} // namespace l5
+
+#endif //L5RDMA_SHARDEDTCPTRANSPORT_H
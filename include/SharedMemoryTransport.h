@@ -2,6 +2,7 @@
 
 #include "datastructures/VirtualRingBuffer.h"
 #include "util/socket/domain.h"
+#include "util/socket/nonBlocking.h"
 #include "Transport.h"
 
 namespace l5 {
@@ -17,15 +18,29 @@ class SharedMemoryTransportServer : public TransportServer<SharedMemoryTransport
    util::Socket initialSocket;
    std::string file;
    util::Socket communicationSocket;
+   datastructure::WaitMode waitMode;
+   util::MappingOptions mappingOptions;
+   datastructure::Framing framing;
+   datastructure::Batching batching;
    std::unique_ptr<datastructure::VirtualRingBuffer> messageBuffer;
+   /// How far the last tryRead / tryWrite got, reset for every accepted connection
+   util::PartialTransfer pendingRead;
+   util::PartialTransfer pendingWrite;
 
    public:
    static constexpr auto buffer_size = BUFFER_SIZE;
    /**
     * Exchange information about the shared memory via the given domain socket
     * @param domainSocket filename of the domain socket
+    * @param waitMode how to wait for incoming data, needs to match the client's
+    * @param mappingOptions page size, prefaulting and locking of the shared memory
+    * @param framing with Framing::Message, every write is received as a whole by a single readSome, needs to match
+    *        the client's
     */
-   explicit SharedMemoryTransportServer(std::string domainSocket);
+   explicit SharedMemoryTransportServer(std::string domainSocket,
+                                        datastructure::WaitMode waitMode = datastructure::WaitMode::Spin,
+                                        util::MappingOptions mappingOptions = {},
+                                        datastructure::Framing framing = datastructure::Framing::Stream);
 
    ~SharedMemoryTransportServer() override = default;
 
@@ -36,16 +51,60 @@ class SharedMemoryTransportServer : public TransportServer<SharedMemoryTransport
    void read_impl(uint8_t* buffer, size_t size);
 
    size_t readSome_impl(uint8_t *buffer, size_t maxSize);
+
+   void writev_impl(const util::ConstSegment *segments, size_t count);
+
+   void readv_impl(const util::MutableSegment *segments, size_t count);
+
+   bool tryRead_impl(uint8_t *buffer, size_t size);
+
+   bool tryWrite_impl(const uint8_t *data, size_t size);
+
+   bool readable_impl();
+
+   bool writable_impl();
+
+   /// receive a message sent with writeZC or, with Framing::Message, write, directly from the shared memory
+   /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+   template<typename RangeConsumer>
+   void readZC(RangeConsumer &&callback) {
+      messageBuffer->receive(std::forward<RangeConsumer>(callback));
+   }
+
+   /// serialize directly into the shared memory, writing at most maxSize bytes
+   /// expected signature: [](uint8_t* begin) -> size_t
+   template<typename SizeReturner>
+   void writeZC(size_t maxSize, SizeReturner &&doWork) {
+      messageBuffer->send(maxSize, std::forward<SizeReturner>(doWork));
+   }
+
+   /// Only publish writes to the remote side, once the thresholds are reached, or on flush. Reads flush implicitly
+   void setBatching(datastructure::Batching newBatching) {
+      batching = newBatching;
+      if (messageBuffer) messageBuffer->setBatching(batching);
+   }
+
+   /// Make all batched writes visible to the remote side
+   void flush() { messageBuffer->flush(); }
 };
 
 template<size_t BUFFER_SIZE = 16 * 1024 * 1024>
 class SharedMemoryTransportClient : public TransportClient<SharedMemoryTransportClient<BUFFER_SIZE>> {
    util::Socket socket;
+   datastructure::WaitMode waitMode;
+   util::MappingOptions mappingOptions;
+   datastructure::Framing framing;
+   datastructure::Batching batching;
    std::unique_ptr<datastructure::VirtualRingBuffer> messageBuffer;
+   util::PartialTransfer pendingRead;
+   util::PartialTransfer pendingWrite;
 
    public:
    static constexpr auto buffer_size = BUFFER_SIZE;
-   SharedMemoryTransportClient() : socket(util::domain::socket()) {};
+   explicit SharedMemoryTransportClient(datastructure::WaitMode waitMode = datastructure::WaitMode::Spin,
+                                        util::MappingOptions mappingOptions = {},
+                                        datastructure::Framing framing = datastructure::Framing::Stream) :
+         socket(util::domain::socket()), waitMode(waitMode), mappingOptions(mappingOptions), framing(framing) {};
 
    ~SharedMemoryTransportClient() override = default;
 
@@ -58,12 +117,53 @@ class SharedMemoryTransportClient : public TransportClient<SharedMemoryTransport
    void read_impl(uint8_t* buffer, size_t size);
 
    size_t readSome_impl(uint8_t *buffer, size_t maxSize);
+
+   void writev_impl(const util::ConstSegment *segments, size_t count);
+
+   void readv_impl(const util::MutableSegment *segments, size_t count);
+
+   bool tryRead_impl(uint8_t *buffer, size_t size);
+
+   bool tryWrite_impl(const uint8_t *data, size_t size);
+
+   bool readable_impl();
+
+   bool writable_impl();
+
+   /// receive a message sent with writeZC or, with Framing::Message, write, directly from the shared memory
+   /// expected signature: [](const uint8_t* begin, const uint8_t* end) -> void
+   template<typename RangeConsumer>
+   void readZC(RangeConsumer &&callback) {
+      messageBuffer->receive(std::forward<RangeConsumer>(callback));
+   }
+
+   /// serialize directly into the shared memory, writing at most maxSize bytes
+   /// expected signature: [](uint8_t* begin) -> size_t
+   template<typename SizeReturner>
+   void writeZC(size_t maxSize, SizeReturner &&doWork) {
+      messageBuffer->send(maxSize, std::forward<SizeReturner>(doWork));
+   }
+
+   /// Only publish writes to the remote side, once the thresholds are reached, or on flush. Reads flush implicitly
+   void setBatching(datastructure::Batching newBatching) {
+      batching = newBatching;
+      if (messageBuffer) messageBuffer->setBatching(batching);
+   }
+
+   /// Make all batched writes visible to the remote side
+   void flush() { messageBuffer->flush(); }
 };
 
 template<size_t BUFFER_SIZE>
-SharedMemoryTransportServer<BUFFER_SIZE>::SharedMemoryTransportServer(std::string domainSocket) :
+SharedMemoryTransportServer<BUFFER_SIZE>::SharedMemoryTransportServer(std::string domainSocket,
+                                                                      datastructure::WaitMode waitMode,
+                                                                      util::MappingOptions mappingOptions,
+                                                                      datastructure::Framing framing) :
       initialSocket(util::domain::socket()),
-      file(std::move(domainSocket)) {
+      file(std::move(domainSocket)),
+      waitMode(waitMode),
+      mappingOptions(mappingOptions),
+      framing(framing) {
    util::domain::bind(initialSocket, file);
    util::domain::listen(initialSocket);
 }
@@ -72,11 +172,19 @@ template<size_t BUFFER_SIZE>
 void SharedMemoryTransportServer<BUFFER_SIZE>::accept_impl() {
    communicationSocket = util::domain::accept(initialSocket);
 
-   messageBuffer = std::make_unique<datastructure::VirtualRingBuffer>(BUFFER_SIZE, communicationSocket);
+   messageBuffer = std::make_unique<datastructure::VirtualRingBuffer>(BUFFER_SIZE, communicationSocket, waitMode,
+                                                                   mappingOptions);
+   messageBuffer->setBatching(batching);
+   pendingRead = {};
+   pendingWrite = {};
 }
 
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportServer<BUFFER_SIZE>::write_impl(const uint8_t* data, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      messageBuffer->sendMessage(data, size);
+      return;
+   }
    for (size_t i = 0; i < size;) {
       auto chunk = std::min(size - i, BUFFER_SIZE);
       messageBuffer->send(&data[i], chunk);
@@ -86,6 +194,13 @@ void SharedMemoryTransportServer<BUFFER_SIZE>::write_impl(const uint8_t* data, s
 
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportServer<BUFFER_SIZE>::read_impl(uint8_t* buffer, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      // reassemble from as many messages as necessary, but never split one
+      for (size_t i = 0; i < size;) {
+         i += messageBuffer->receiveMessage(&buffer[i], size - i);
+      }
+      return;
+   }
    for (size_t i = 0; i < size;) {
       auto chunk = std::min(size - i, BUFFER_SIZE);
       messageBuffer->receive(&buffer[i], chunk);
@@ -95,10 +210,94 @@ void SharedMemoryTransportServer<BUFFER_SIZE>::read_impl(uint8_t* buffer, size_t
 
 template<size_t BUFFER_SIZE>
 size_t SharedMemoryTransportServer<BUFFER_SIZE>::readSome_impl(uint8_t* buffer, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      return messageBuffer->receiveMessage(buffer, size);
+   }
    auto chunk = std::min(size, BUFFER_SIZE);
    return messageBuffer->receiveSome(buffer, chunk);
 }
 
+template<size_t BUFFER_SIZE>
+void SharedMemoryTransportServer<BUFFER_SIZE>::writev_impl(const util::ConstSegment *segments, size_t count) {
+   if (framing == datastructure::Framing::Message) {
+      messageBuffer->sendMessage(segments, count);
+      return;
+   }
+   if (util::totalSize(segments, count) <= BUFFER_SIZE) {
+      messageBuffer->send(segments, count);
+      return;
+   }
+   // doesn't fit into the ring at once, so we need to chunk anyways
+   for (size_t i = 0; i < count; ++i) {
+      write_impl(reinterpret_cast<const uint8_t *>(segments[i].data), segments[i].size);
+   }
+}
+
+template<size_t BUFFER_SIZE>
+void SharedMemoryTransportServer<BUFFER_SIZE>::readv_impl(const util::MutableSegment *segments, size_t count) {
+   const auto size = util::totalSize(segments, count);
+   if (framing == datastructure::Framing::Message) {
+      // reassemble from as many messages as necessary, but never split one
+      for (size_t i = 0; i < size;) {
+         messageBuffer->receive([&](const uint8_t *begin, const uint8_t *end) {
+            const auto receiveSize = static_cast<size_t>(std::distance(begin, end));
+            if (receiveSize > size - i) {
+               throw std::runtime_error{"received message > maxSize"};
+            }
+            util::scatter(begin, receiveSize, segments, count, i);
+            i += receiveSize;
+         });
+      }
+      return;
+   }
+   if (size <= BUFFER_SIZE) {
+      messageBuffer->receive(segments, count);
+      return;
+   }
+   for (size_t i = 0; i < count; ++i) {
+      read_impl(reinterpret_cast<uint8_t *>(segments[i].data), segments[i].size);
+   }
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportServer<BUFFER_SIZE>::tryRead_impl(uint8_t* buffer, size_t size) {
+   return pendingRead.advance(size, [&](size_t offset) {
+      if (framing == datastructure::Framing::Stream) {
+         return messageBuffer->tryReceiveSome(&buffer[offset], size - offset);
+      }
+      // reassemble from the complete messages, but never split one
+      size_t received = 0;
+      while (offset + received < size && messageBuffer->canReceive(sizeof(size_t))) {
+         received += messageBuffer->receiveMessage(&buffer[offset + received], size - offset - received);
+      }
+      return received;
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportServer<BUFFER_SIZE>::tryWrite_impl(const uint8_t* data, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      // a message is only ever sent as a whole, like with write
+      if (not messageBuffer->canSend(sizeof(size_t) + size)) return false;
+      messageBuffer->sendMessage(data, size);
+      return true;
+   }
+   return pendingWrite.advance(size, [&](size_t offset) {
+      return messageBuffer->trySendSome(&data[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportServer<BUFFER_SIZE>::readable_impl() {
+   // with framing, there's only something to read, once the first message is complete
+   return messageBuffer->canReceive(framing == datastructure::Framing::Message ? sizeof(size_t) : 1);
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportServer<BUFFER_SIZE>::writable_impl() {
+   return messageBuffer->canSend(framing == datastructure::Framing::Message ? sizeof(size_t) + 1 : 1);
+}
+
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportClient<BUFFER_SIZE>::connect_impl(const std::string &file) {
    const auto pos = file.find(':');
@@ -106,11 +305,18 @@ void SharedMemoryTransportClient<BUFFER_SIZE>::connect_impl(const std::string &f
    util::domain::connect(socket, whereTo);
    util::domain::unlink(whereTo);
 
-   messageBuffer = std::make_unique<datastructure::VirtualRingBuffer>(BUFFER_SIZE, socket);
+   messageBuffer = std::make_unique<datastructure::VirtualRingBuffer>(BUFFER_SIZE, socket, waitMode, mappingOptions);
+   messageBuffer->setBatching(batching);
+   pendingRead = {};
+   pendingWrite = {};
 }
 
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportClient<BUFFER_SIZE>::write_impl(const uint8_t* data, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      messageBuffer->sendMessage(data, size);
+      return;
+   }
    for (size_t i = 0; i < size;) {
       auto chunk = std::min(size - i, BUFFER_SIZE);
       messageBuffer->send(&data[i], chunk);
@@ -120,6 +326,13 @@ void SharedMemoryTransportClient<BUFFER_SIZE>::write_impl(const uint8_t* data, s
 
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportClient<BUFFER_SIZE>::read_impl(uint8_t* buffer, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      // reassemble from as many messages as necessary, but never split one
+      for (size_t i = 0; i < size;) {
+         i += messageBuffer->receiveMessage(&buffer[i], size - i);
+      }
+      return;
+   }
    for (size_t i = 0; i < size;) {
       auto chunk = std::min(size - i, BUFFER_SIZE);
       messageBuffer->receive(&buffer[i], chunk);
@@ -129,14 +342,100 @@ void SharedMemoryTransportClient<BUFFER_SIZE>::read_impl(uint8_t* buffer, size_t
 
 template<size_t BUFFER_SIZE>
 size_t SharedMemoryTransportClient<BUFFER_SIZE>::readSome_impl(uint8_t* buffer, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      return messageBuffer->receiveMessage(buffer, size);
+   }
    auto chunk = std::min(size, BUFFER_SIZE);
    return messageBuffer->receiveSome(buffer, chunk);
 }
 
+template<size_t BUFFER_SIZE>
+void SharedMemoryTransportClient<BUFFER_SIZE>::writev_impl(const util::ConstSegment *segments, size_t count) {
+   if (framing == datastructure::Framing::Message) {
+      messageBuffer->sendMessage(segments, count);
+      return;
+   }
+   if (util::totalSize(segments, count) <= BUFFER_SIZE) {
+      messageBuffer->send(segments, count);
+      return;
+   }
+   // doesn't fit into the ring at once, so we need to chunk anyways
+   for (size_t i = 0; i < count; ++i) {
+      write_impl(reinterpret_cast<const uint8_t *>(segments[i].data), segments[i].size);
+   }
+}
+
+template<size_t BUFFER_SIZE>
+void SharedMemoryTransportClient<BUFFER_SIZE>::readv_impl(const util::MutableSegment *segments, size_t count) {
+   const auto size = util::totalSize(segments, count);
+   if (framing == datastructure::Framing::Message) {
+      // reassemble from as many messages as necessary, but never split one
+      for (size_t i = 0; i < size;) {
+         messageBuffer->receive([&](const uint8_t *begin, const uint8_t *end) {
+            const auto receiveSize = static_cast<size_t>(std::distance(begin, end));
+            if (receiveSize > size - i) {
+               throw std::runtime_error{"received message > maxSize"};
+            }
+            util::scatter(begin, receiveSize, segments, count, i);
+            i += receiveSize;
+         });
+      }
+      return;
+   }
+   if (size <= BUFFER_SIZE) {
+      messageBuffer->receive(segments, count);
+      return;
+   }
+   for (size_t i = 0; i < count; ++i) {
+      read_impl(reinterpret_cast<uint8_t *>(segments[i].data), segments[i].size);
+   }
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportClient<BUFFER_SIZE>::tryRead_impl(uint8_t* buffer, size_t size) {
+   return pendingRead.advance(size, [&](size_t offset) {
+      if (framing == datastructure::Framing::Stream) {
+         return messageBuffer->tryReceiveSome(&buffer[offset], size - offset);
+      }
+      // reassemble from the complete messages, but never split one
+      size_t received = 0;
+      while (offset + received < size && messageBuffer->canReceive(sizeof(size_t))) {
+         received += messageBuffer->receiveMessage(&buffer[offset + received], size - offset - received);
+      }
+      return received;
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportClient<BUFFER_SIZE>::tryWrite_impl(const uint8_t* data, size_t size) {
+   if (framing == datastructure::Framing::Message) {
+      // a message is only ever sent as a whole, like with write
+      if (not messageBuffer->canSend(sizeof(size_t) + size)) return false;
+      messageBuffer->sendMessage(data, size);
+      return true;
+   }
+   return pendingWrite.advance(size, [&](size_t offset) {
+      return messageBuffer->trySendSome(&data[offset], size - offset);
+   });
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportClient<BUFFER_SIZE>::readable_impl() {
+   // with framing, there's only something to read, once the first message is complete
+   return messageBuffer->canReceive(framing == datastructure::Framing::Message ? sizeof(size_t) : 1);
+}
+
+template<size_t BUFFER_SIZE>
+bool SharedMemoryTransportClient<BUFFER_SIZE>::writable_impl() {
+   return messageBuffer->canSend(framing == datastructure::Framing::Message ? sizeof(size_t) + 1 : 1);
+}
+
 template<size_t BUFFER_SIZE>
 void SharedMemoryTransportClient<BUFFER_SIZE>::reset_impl() {
    socket = util::domain::socket();
    messageBuffer.reset();
+   pendingRead = {};
+   pendingWrite = {};
 }
 
 } // namespace transport
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <optional>
 #include "util/socket/Socket.h"
+#include "util/socket/tcp.h"
 #include "Transport.h"
 
 namespace l5 {
@@ -8,29 +10,69 @@ namespace transport {
 class TcpTransportServer : public TransportServer<TcpTransportServer> {
     const util::Socket initialSocket;
     util::Socket communicationSocket;
+    const util::tcp::Profile profile;
+    /// Set by enableZeroCopy, and reset for every accepted connection
+    std::optional<util::tcp::ZeroCopy> zeroCopy;
+    /// How far the last tryRead / tryWrite got, reset for every accepted connection
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
-    explicit TcpTransportServer(const std::string &port);
+    explicit TcpTransportServer(const std::string &port, util::tcp::Profile profile = util::tcp::Profile::Default);
 
     ~TcpTransportServer() override;
 
+    /// The port we listen on, e.g. the one the kernel picked for port "0"
+    uint16_t port() const { return util::tcp::localPort(initialSocket); }
+
     void accept_impl();
 
     void write_impl(const uint8_t *data, size_t size);
 
     void read_impl(uint8_t *buffer, size_t size);
 
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
+
     size_t readSome_impl(uint8_t *buffer, size_t maxSize);
 
+    /// The connected socket, so util::EventLoop can wait for it with epoll
+    int pollFd() const { return communicationSocket.get(); }
+
+    /// Opt in to MSG_ZEROCOPY for writes of at least threshold bytes. Only pays off for large writes to remote hosts
+    void enableZeroCopy(size_t threshold = 16 * 1024);
+
+    /// Like write, but large writes aren't copied into the socket buffer: The kernel sends straight from data, which
+    /// therefore belongs to the kernel until reusable(ticket). Without enableZeroCopy, it's a plain write
+    uint64_t writeZeroCopy(const uint8_t *data, size_t size);
+
+    /// Whether the data of writeZeroCopy may be modified or freed again. Doesn't block
+    bool reusable(uint64_t ticket);
+
+    void waitUntilReusable(uint64_t ticket);
+
 private:
     void listen(uint16_t port);
 };
 
 class TcpTransportClient : public TransportClient<TcpTransportClient> {
     const util::Socket socket;
+    const util::tcp::Profile profile;
+    std::optional<util::tcp::ZeroCopy> zeroCopy;
+    util::PartialTransfer pendingRead;
+    util::PartialTransfer pendingWrite;
 
 public:
-    TcpTransportClient();
+    explicit TcpTransportClient(util::tcp::Profile profile = util::tcp::Profile::Default);
 
     ~ TcpTransportClient() override;
 
@@ -40,7 +82,30 @@ public:
 
     void read_impl(uint8_t *buffer, size_t size);
 
+    void writev_impl(const util::ConstSegment *segments, size_t count);
+
+    void readv_impl(const util::MutableSegment *segments, size_t count);
+
+    bool tryRead_impl(uint8_t *buffer, size_t size);
+
+    bool tryWrite_impl(const uint8_t *data, size_t size);
+
+    bool readable_impl();
+
+    bool writable_impl();
+
     size_t readSome_impl(uint8_t *buffer, size_t maxSize);
+
+    int pollFd() const { return socket.get(); }
+
+    /// Zero copy writes, c.f. TcpTransportServer
+    void enableZeroCopy(size_t threshold = 16 * 1024);
+
+    uint64_t writeZeroCopy(const uint8_t *data, size_t size);
+
+    bool reusable(uint64_t ticket);
+
+    void waitUntilReusable(uint64_t ticket);
 };
 } // namespace transport
 } // namespace l5
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <stdexcept>
+#include "util/segments.h"
 
 namespace l5 {
 namespace transport {
@@ -32,6 +34,15 @@ public:
         write(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
     }
 
+    /**
+     * Send data gathered from several memory locations, as if it was written with a single write
+     */
+    void writev(const util::ConstSegment *segments, size_t count) {
+        static_cast<T *>(this)->writev_impl(segments, count);
+    }
+
+    void writev(std::initializer_list<util::ConstSegment> segments) { writev(segments.begin(), segments.size()); }
+
     /**
      * Read *some* bytes to an arbitrary memory location
      * The number of bytes is [1, maxSize]
@@ -49,6 +60,50 @@ public:
         read(reinterpret_cast<uint8_t *>(&data), sizeof(data));
     }
 
+    /**
+     * Receive data scattered to several memory locations, as if it was read with a single read
+     */
+    void readv(const util::MutableSegment *segments, size_t count) {
+        static_cast<T *>(this)->readv_impl(segments, count);
+    }
+
+    void readv(std::initializer_list<util::MutableSegment> segments) { readv(segments.begin(), segments.size()); }
+
+    /**
+     * Receive exactly size bytes, without blocking. Returns true, once all of them arrived. A false return might already
+     * have read a part of them, so call again with the same buffer and size, and nothing else reading in between
+     */
+    bool tryRead(uint8_t *whereTo, size_t size) { return static_cast<T *>(this)->tryRead_impl(whereTo, size); }
+
+    template<typename TriviallyCopyable>
+    bool tryRead(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        return tryRead(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+    }
+
+    /**
+     * Send size bytes, without waiting for the remote side. Returns true, once all of them are sent. Like tryRead, a
+     * false return might already have sent a part of them, so call again with the same data and size, and nothing
+     * else writing in between, to send the rest
+     */
+    bool tryWrite(const uint8_t *data, size_t size) { return static_cast<T *>(this)->tryWrite_impl(data, size); }
+
+    template<typename TriviallyCopyable>
+    bool tryWrite(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        return tryWrite(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    /**
+     * Whether a read would find data without blocking
+     */
+    bool readable() { return static_cast<T *>(this)->readable_impl(); }
+
+    /**
+     * Whether a write would find space without blocking
+     */
+    bool writable() { return static_cast<T *>(this)->writable_impl(); }
+
     template<typename TriviallyCopyable>
     TriviallyCopyable read() {
         static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
@@ -85,6 +140,15 @@ public:
         write(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
     }
 
+    /**
+     * Send data gathered from several memory locations, as if it was written with a single write
+     */
+    void writev(const util::ConstSegment *segments, size_t count) {
+        static_cast<T *>(this)->writev_impl(segments, count);
+    }
+
+    void writev(std::initializer_list<util::ConstSegment> segments) { writev(segments.begin(), segments.size()); }
+
     void read(uint8_t *whereTo, size_t size) { static_cast<T *>(this)->read_impl(whereTo, size); }
 
     /**
@@ -100,6 +164,50 @@ public:
         read(reinterpret_cast<uint8_t *>(&data), sizeof(data));
     }
 
+    /**
+     * Receive data scattered to several memory locations, as if it was read with a single read
+     */
+    void readv(const util::MutableSegment *segments, size_t count) {
+        static_cast<T *>(this)->readv_impl(segments, count);
+    }
+
+    void readv(std::initializer_list<util::MutableSegment> segments) { readv(segments.begin(), segments.size()); }
+
+    /**
+     * Receive exactly size bytes, without blocking. Returns true, once all of them arrived. A false return might already
+     * have read a part of them, so call again with the same buffer and size, and nothing else reading in between
+     */
+    bool tryRead(uint8_t *whereTo, size_t size) { return static_cast<T *>(this)->tryRead_impl(whereTo, size); }
+
+    template<typename TriviallyCopyable>
+    bool tryRead(TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        return tryRead(reinterpret_cast<uint8_t *>(&data), sizeof(data));
+    }
+
+    /**
+     * Send size bytes, without waiting for the remote side. Returns true, once all of them are sent. Like tryRead, a
+     * false return might already have sent a part of them, so call again with the same data and size, and nothing
+     * else writing in between, to send the rest
+     */
+    bool tryWrite(const uint8_t *data, size_t size) { return static_cast<T *>(this)->tryWrite_impl(data, size); }
+
+    template<typename TriviallyCopyable>
+    bool tryWrite(const TriviallyCopyable &data) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        return tryWrite(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+    }
+
+    /**
+     * Whether a read would find data without blocking
+     */
+    bool readable() { return static_cast<T *>(this)->readable_impl(); }
+
+    /**
+     * Whether a write would find space without blocking
+     */
+    bool writable() { return static_cast<T *>(this)->writable_impl(); }
+
     virtual ~TransportClient() = default;
 };
 
@@ -1,9 +1,12 @@
+#include <cstring>
 #include <iostream>
 #include <thread>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <include/MulticlientRDMATransport.h>
 #include <include/MulticlientTCPTransport.h>
+#include <include/MulticlientSharedMemoryTransport.h>
+#include <include/ShardedTCPTransport.h>
 #include <util/ycsb.h>
 #include "rdma/Network.hpp"
 #include "rdma/QueuePair.hpp"
@@ -20,8 +23,14 @@ static constexpr uint16_t port = 1234;
 static const char *ip = "127.0.0.1";
 static constexpr auto MESSAGES = 1024 * 1024;
 
+/// The same server, but receiving with io_uring
+struct UringMulticlientTCPTransportServer : MulticlientTCPTransportServer {
+    explicit UringMulticlientTCPTransportServer(std::string_view port) :
+            MulticlientTCPTransportServer(port, MulticlientTcpBackend::IoUring) {}
+};
+
 template<class Client, class Server>
-void doRun(size_t clients, bool isClient) {
+void doRun(size_t clients, bool isClient, const std::string &connection, const std::string &listenOn) {
     if (isClient) {
         RandomString rand;
         char testdata[64];
@@ -34,7 +43,7 @@ void doRun(size_t clients, bool isClient) {
                 auto client = Client();
                 for (int i = 0;; ++i) {
                     try {
-                        client.connect(ip, port);
+                        client.connect(connection);
                         break;
                     } catch (...) {
                         std::this_thread::sleep_for(20ms);
@@ -58,7 +67,7 @@ void doRun(size_t clients, bool isClient) {
             t.join();
         }
     } else {
-        auto server = Server(to_string(port));
+        auto server = Server(listenOn);
         for (size_t i = 0; i < clients; ++i) {
             server.accept();
         }
@@ -73,6 +82,28 @@ void doRun(size_t clients, bool isClient) {
     }
 }
 
+/// Like doRun, but the server answers with a shard per core. The shards accept their connections while benchmarking
+void doShardedRun(size_t clients, bool isClient, const std::string &connection, const std::string &listenOn) {
+    if (isClient) {
+        doRun<MulticlientTCPTransportClient, MulticlientTCPTransportServer>(clients, isClient, connection, listenOn);
+        return;
+    }
+    const auto shards = std::min<size_t>(clients, std::thread::hardware_concurrency());
+    auto server = ShardedTCPTransportServer(listenOn, shards);
+    std::atomic<size_t> answered = 0;
+    bench(MESSAGES * clients, [&] {
+        server.serve([&](ShardedTCPTransportServer::Shard &shard) {
+            std::vector<uint8_t> buf(64);
+            while (answered < MESSAGES * clients) {
+                const auto client = shard.receive(buf.data(), 64, 10ms);
+                if (not client) continue;
+                shard.send(*client, buf.data(), 64);
+                ++answered;
+            }
+        });
+    });
+}
+
 int main(int argc, char **argv) {
     if (argc < 3) {
         cout << "Usage: " << argv[0] << " <client / server> <#clients> <(optional) 127.0.0.1>" << endl;
@@ -84,9 +115,31 @@ int main(int argc, char **argv) {
         ip = argv[3];
     }
 
-    cout << "clients, messages, seconds, msgps, user, kernel, total\n";
+    const auto isLocal = strcmp("127.0.0.1", ip) == 0;
+
+    cout << "connection, clients, messages, seconds, msgps, user, kernel, total\n";
+    if (!isClient) {
+        cout << "tcp, " << clients << ", ";
+    }
+    doRun<MulticlientTCPTransportClient, MulticlientTCPTransportServer>(clients, isClient,
+                                                                       ip + string(":") + to_string(port),
+                                                                       to_string(port));
     if (!isClient) {
-        cout << clients << ", ";
+        cout << "tcp io_uring, " << clients << ", ";
+    }
+    doRun<MulticlientTCPTransportClient, UringMulticlientTCPTransportServer>(clients, isClient,
+                                                                            ip + string(":") + to_string(port),
+                                                                            to_string(port));
+    if (!isClient) {
+        cout << "tcp sharded, " << clients << ", ";
+    }
+    doShardedRun(clients, isClient, ip + string(":") + to_string(port), to_string(port));
+    if (isLocal) {
+        if (!isClient) {
+            cout << "shared memory, " << clients << ", ";
+        }
+        doRun<MulticlientSharedMemoryTransportClient, MulticlientSharedMemoryTransportServer>(clients, isClient,
+                                                                                             "/tmp/many2One",
+                                                                                             "/tmp/many2One");
     }
-    doRun<MulticlientTCPTransportClient, MulticlientTCPTransportServer>(clients, isClient);
 }
@@ -10,6 +10,8 @@
 
 using namespace std;
 using namespace l5::transport;
+using l5::datastructure::WaitMode;
+using l5::util::tcp::Profile;
 
 static const size_t MESSAGES = 256 * 1024;  //~ 1s
 static const size_t SHAREDMEM_MESSAGES = 1024 * 1024;
@@ -50,6 +52,17 @@ int main(int argc, char **argv) {
                });
             }
             sleep(1);
+            {
+               cout << size << ", " << "shared memory futex, ";
+               auto client = Ping(make_transportClient<SharedMemoryTransportClient<>>(WaitMode::Futex),
+                                  "/dev/shm/pingPong", size);
+               bench(SHAREDMEM_MESSAGES, [&]() {
+                   for (size_t i = 0; i < SHAREDMEM_MESSAGES; ++i) {
+                       client.ping();
+                   }
+               });
+            }
+            sleep(1);
             {
                 cout << size << ", " << "tcp, ";
                 auto client = Ping(make_transportClient<TcpTransportClient>(), ip + string(":") + to_string(port),
@@ -60,6 +73,17 @@ int main(int argc, char **argv) {
                     }
                 });
             }
+            sleep(1);
+            {
+                cout << size << ", " << "tcp low latency, ";
+                auto client = Ping(make_transportClient<TcpTransportClient>(Profile::LowLatency),
+                                   ip + string(":") + to_string(port), size);
+                bench(MESSAGES, [&]() {
+                    for (size_t i = 0; i < MESSAGES; ++i) {
+                        client.ping();
+                    }
+                });
+            }
             // sleep(1);
             // {
             //     cout << size << ", " << "rdma, ";
@@ -101,6 +125,17 @@ int main(int argc, char **argv) {
                    }
                });
             }
+            {
+               cout << size << ", " << "shared memory futex, ";
+               auto server = Pong(make_transportServer<SharedMemoryTransportServer<>>("/dev/shm/pingPong",
+                                                                                      WaitMode::Futex), size);
+               server.start();
+               bench(SHAREDMEM_MESSAGES, [&]() {
+                   for (size_t i = 0; i < SHAREDMEM_MESSAGES; ++i) {
+                       server.pong();
+                   }
+               });
+            }
             {
                 cout << size << ", " << "tcp, ";
                 auto server = Pong(make_transportServer<TcpTransportServer>(to_string(port)), size);
@@ -111,6 +146,17 @@ int main(int argc, char **argv) {
                     }
                 });
             }
+            {
+                cout << size << ", " << "tcp low latency, ";
+                auto server = Pong(make_transportServer<TcpTransportServer>(to_string(port), Profile::LowLatency),
+                                   size);
+                server.start();
+                bench(MESSAGES, [&]() {
+                    for (size_t i = 0; i < MESSAGES; ++i) {
+                        server.pong();
+                    }
+                });
+            }
             // {
             //     cout << size << ", " << "rdma, ";
             //     auto server = Pong(make_transportServer<RdmaTransportServer<>>(to_string(port)), size);
@@ -1,5 +1,7 @@
 #include "CompletionQueuePair.hpp"
 #include "NetworkException.h"
+#include <algorithm>
+#include <array>
 
 using namespace std;
 namespace rdma {
@@ -9,111 +11,297 @@ namespace rdma {
             sendQueue(ctx.createCompletionQueue(CQ_SIZE, contextPtr, *channel, completionVector)),
             receiveQueue(ctx.createCompletionQueue(CQ_SIZE, contextPtr, *channel, completionVector)) {
 
+        sendCompletions.queue = sendQueue.get();
+        recvCompletions.queue = receiveQueue.get();
+
         // Request notifications
         sendQueue->requestNotify(false);
         receiveQueue->requestNotify(false);
     }
 
+    CompletionQueuePair::CompletionQueuePair(emulated::Fabric &fabric) :
+            emulatedSendQueue(fabric.createCompletionQueue()),
+            emulatedReceiveQueue(fabric.createCompletionQueue()) {
+        sendCompletions.emulatedQueue = emulatedSendQueue.get();
+        recvCompletions.emulatedQueue = emulatedReceiveQueue.get();
+    }
+
     CompletionQueuePair::~CompletionQueuePair() {
         for (auto event : eventsToAck) {
             event->ackEvents(1);
         }
     }
 
-    /// Poll a completion queue
-    uint64_t CompletionQueuePair::pollCompletionQueue(ibv::completions::CompletionQueue &completionQueue,
-                                                      ibv::workcompletion::Opcode type) {
-        // Poll for a work completion
-        ibv::workcompletion::WorkCompletion completion;
-        if (completionQueue.poll(1, &completion) == 0) {
-            return numeric_limits<uint64_t>::max();
+    CompletionQueuePair::Completions &
+    CompletionQueuePair::completionsOf(ibv::completions::CompletionQueue &completionQueue) {
+        return &completionQueue == sendQueue.get() ? sendCompletions : recvCompletions;
+    }
+
+    size_t CompletionQueuePair::pollBatch(Completions &completions) {
+        array<ibv::workcompletion::WorkCompletion, POLL_BATCH> polled;
+        // WorkCompletion only adds methods to ibv_wc
+        static_assert(sizeof(ibv::workcompletion::WorkCompletion) == sizeof(ibv_wc));
+        const auto count = completions.queue != nullptr
+                           ? completions.queue->poll(POLL_BATCH, polled.data())
+                           : completions.emulatedQueue->poll(POLL_BATCH, polled.data());
+        for (int i = 0; i < count; ++i) {
+            const auto &completion = polled[i];
+            const auto discarded = completions.discarded.find(completion.getId());
+            if (discarded != completions.discarded.end()) {
+                if (--discarded->second == 0) {
+                    completions.discarded.erase(discarded);
+                }
+                if (&completions == &sendCompletions) {
+                    releaseSendCompletion();
+                }
+                continue;
+            }
+            const auto awaited = completions.awaited.find(completion.getId());
+            if (awaited != completions.awaited.end()) {
+                awaited->second = completion;
+                continue;
+            }
+            const auto handler = completions.handlers.find(completion.getId());
+            // failed completions are cached, so the next poll reports them
+            if (handler != completions.handlers.end() && completion) {
+                handler->second(completion);
+            } else {
+                completions.cached.push_back(completion);
+            }
+        }
+        return static_cast<size_t>(count);
+    }
+
+    optional<ibv::workcompletion::WorkCompletion> CompletionQueuePair::nextCompletion(Completions &completions) {
+        const auto lock = lock_guard(guard);
+        if (completions.cached.empty()) {
+            pollBatch(completions);
+            if (completions.cached.empty()) {
+                return nullopt;
+            }
         }
+        const auto completion = completions.cached.front();
+        completions.cached.pop_front();
 
-        // Check status and opcode
+        // Check status
         if (not completion) {
             throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
         }
-        if (completion.getOpcode() != type) {
-            throw NetworkException("unexpected completion opcode: " + to_string(completion.getOpcode()));
-        }
-        return completion.getId();
+        return completion;
     }
 
-    /// Poll the send completion queue
-    uint64_t CompletionQueuePair::pollSendCompletionQueue() {
+    /// Poll a completion queue
+    uint64_t CompletionQueuePair::pollCompletionQueue(Completions &completions, ibv::workcompletion::Opcode type) {
         // Poll for a work completion
-        ibv::workcompletion::WorkCompletion completion;
-        if (sendQueue->poll(1, &completion) == 0) {
+        const auto completion = nextCompletion(completions);
+        if (not completion) {
             return numeric_limits<uint64_t>::max();
         }
 
-        // Check status and opcode
+        // Check opcode
+        if (completion->getOpcode() != type) {
+            throw NetworkException("unexpected completion opcode: " + to_string(completion->getOpcode()));
+        }
+        return completion->getId();
+    }
+
+    /// Poll the send completion queue
+    uint64_t CompletionQueuePair::pollSendCompletionQueue() {
+        // Poll for a work completion
+        const auto completion = nextCompletion(sendCompletions);
         if (not completion) {
-            throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
+            return numeric_limits<uint64_t>::max();
         }
-        return completion.getId();
+        return completion->getId();
     }
 
     uint64_t CompletionQueuePair::pollSendCompletionQueue(ibv::workcompletion::Opcode type) {
-        return pollCompletionQueue(*sendQueue, type);
+        return pollCompletionQueue(sendCompletions, type);
     }
 
     /// Poll the receive completion queue
     uint64_t CompletionQueuePair::pollRecvCompletionQueue() {
-        return pollCompletionQueue(*receiveQueue, ibv::workcompletion::Opcode::RECV);
+        return pollCompletionQueue(recvCompletions, ibv::workcompletion::Opcode::RECV);
     }
 
     /// Poll a completion queue blocking
     uint64_t
     CompletionQueuePair::pollCompletionQueueBlocking(ibv::completions::CompletionQueue &completionQueue,
                                                      ibv::workcompletion::Opcode type) {
-        // Poll for a work completion
-        ibv::workcompletion::WorkCompletion completion;
-        while (completionQueue.poll(1, &completion) == 0); // busy poll
+        return pollCompletionQueueBlocking(completionsOf(completionQueue), type);
+    }
 
-        // Check status and opcode
-        if (not completion) {
-            throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
+    uint64_t CompletionQueuePair::pollCompletionQueueBlocking(Completions &completions,
+                                                              ibv::workcompletion::Opcode type) {
+        // Poll for a work completion
+        auto completion = nextCompletion(completions);
+        while (not completion) { // busy poll
+            completion = nextCompletion(completions);
         }
-        if (completion.getOpcode() != type) {
-            throw NetworkException("unexpected completion opcode: " + to_string(completion.getOpcode()));
+
+        // Check opcode
+        if (completion->getOpcode() != type) {
+            throw NetworkException("unexpected completion opcode: " + to_string(completion->getOpcode()));
         }
-        return completion.getId();
+        return completion->getId();
     }
 
     /// Poll the send completion queue blocking
     uint64_t CompletionQueuePair::pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode opcode) {
-        return pollCompletionQueueBlocking(*sendQueue, opcode);
+        return pollCompletionQueueBlocking(sendCompletions, opcode);
     }
 
     /// Poll the receive completion queue blocking
     uint64_t CompletionQueuePair::pollRecvCompletionQueueBlocking(ibv::workcompletion::Opcode opcode) {
-        return pollCompletionQueueBlocking(*receiveQueue, opcode);
+        return pollCompletionQueueBlocking(recvCompletions, opcode);
     }
 
     /// Wait for a work completion
-    void CompletionQueuePair::waitForCompletion() {
-        // Wait for completion queue event
-        auto[event, ctx] = channel->getEvent();
-        std::ignore = ctx;
+    ibv::workcompletion::WorkCompletion CompletionQueuePair::waitForCompletion() {
+        for (;;) {
+            {
+                const auto lock = lock_guard(guard);
+                // completions, that were polled by an earlier call, didn't raise an event of their own
+                for (auto completions : {&sendCompletions, &recvCompletions}) {
+                    if (completions->cached.empty()) {
+                        continue;
+                    }
+                    const auto completion = completions->cached.front();
+                    completions->cached.pop_front();
+                    if (not completion) {
+                        throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
+                    }
+                    return completion;
+                }
+            }
 
-        eventsToAck.push_back(event);
+            if (channel == nullptr) {
+                // the emulation has no completion events, poll both queues until there is a completion
+                const auto lock = lock_guard(guard);
+                pollBatch(sendCompletions);
+                pollBatch(recvCompletions);
+                continue;
+            }
 
-        // Request a completion queue event
-        event->requestNotify(false);
+            // Wait for completion queue event
+            auto[event, ctx] = channel->getEvent();
+            std::ignore = ctx;
 
-        // Poll all work completions
-        ibv::workcompletion::WorkCompletion completion;
-        for (;;) {
-            auto numPolled = event->poll(1, &completion);
+            const auto lock = lock_guard(guard);
+            eventsToAck.push_back(event);
+
+            // Request a completion queue event
+            event->requestNotify(false);
 
-            if (numPolled == 0) {
-                break;
+            // Poll all work completions, the ones with a handler are dispatched, all others stay cached
+            auto &completions = completionsOf(*event);
+            while (pollBatch(completions) > 0);
+        }
+    }
+
+    ibv::workcompletion::WorkCompletion CompletionQueuePair::waitForSendCompletion(uint64_t wrId) {
+        auto lock = unique_lock(guard);
+        auto &cached = sendCompletions.cached;
+        optional<ibv::workcompletion::WorkCompletion> completion;
+        const auto found = find_if(cached.begin(), cached.end(), [&](const auto &c) { return c.getId() == wrId; });
+        if (found != cached.end()) {
+            completion = *found;
+            cached.erase(found);
+        } else {
+            // whoever polls it from now on, puts it aside for us. Elements of an unordered_map don't move
+            auto &awaited = sendCompletions.awaited[wrId];
+            while (not awaited) {
+                // let the other pollers in between the batches
+                lock.unlock();
+                lock.lock();
+                pollBatch(sendCompletions);
             }
-            if (not completion.isSuccessful()) {
-                throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
+            completion = awaited;
+            sendCompletions.awaited.erase(wrId);
+        }
+        if (not completion->isSuccessful()) {
+            throw NetworkException("unexpected completion status: " + to_string(completion->getStatus()));
+        }
+        return *completion;
+    }
+
+    void CompletionQueuePair::setSendHandler(uint64_t wrId, Handler handler) {
+        const auto lock = lock_guard(guard);
+        sendCompletions.handlers[wrId] = move(handler);
+    }
+
+    void CompletionQueuePair::removeSendHandler(uint64_t wrId) {
+        const auto lock = lock_guard(guard);
+        sendCompletions.handlers.erase(wrId);
+    }
+
+    void CompletionQueuePair::discardSendCompletions(uint64_t wrId, size_t count) {
+        const auto lock = lock_guard(guard);
+        sendCompletions.handlers.erase(wrId);
+        auto &cached = sendCompletions.cached;
+        // some might already be polled, e.g. failed ones
+        for (auto it = cached.begin(); count > 0 && it != cached.end();) {
+            if (it->getId() != wrId) {
+                ++it;
+                continue;
             }
-        };
+            it = cached.erase(it);
+            releaseSendCompletion();
+            --count;
+        }
+        if (count > 0) {
+            sendCompletions.discarded[wrId] += count;
+        }
+    }
+
+    void CompletionQueuePair::setRecvHandler(uint64_t wrId, Handler handler) {
+        const auto lock = lock_guard(guard);
+        recvCompletions.handlers[wrId] = move(handler);
+    }
+
+    void CompletionQueuePair::removeRecvHandler(uint64_t wrId) {
+        const auto lock = lock_guard(guard);
+        recvCompletions.handlers.erase(wrId);
+    }
+
+    size_t CompletionQueuePair::dispatchBatch(Completions &completions) {
+        const auto lock = lock_guard(guard);
+        const auto alreadyCached = completions.cached.size();
+        const auto count = pollBatch(completions);
+        // a failed completion is cached, but nobody might poll for it
+        for (auto it = completions.cached.begin() + static_cast<ptrdiff_t>(alreadyCached);
+             it != completions.cached.end(); ++it) {
+            if (not it->isSuccessful()) {
+                throw NetworkException("unexpected completion status: " + to_string(it->getStatus()));
+            }
+        }
+        return count;
+    }
+
+    size_t CompletionQueuePair::dispatchSendCompletions() {
+        return dispatchBatch(sendCompletions);
+    }
+
+    size_t CompletionQueuePair::dispatchRecvCompletions() {
+        return dispatchBatch(recvCompletions);
+    }
+
+    bool CompletionQueuePair::reserveSendCompletion() {
+        auto reserved = reservedSendCompletions.load();
+        do {
+            if (reserved >= MAX_RESERVED_SEND_COMPLETIONS) {
+                return false;
+            }
+        } while (not reservedSendCompletions.compare_exchange_weak(reserved, reserved + 1));
+        return true;
+    }
+
+    void CompletionQueuePair::releaseSendCompletion(size_t count) {
+        reservedSendCompletions -= count;
+    }
+
+    bool CompletionQueuePair::hasReservedSendCompletions() const {
+        return reservedSendCompletions.load() != 0;
     }
 
     ibv::completions::CompletionQueue &CompletionQueuePair::getSendQueue() {
@@ -124,20 +312,27 @@ namespace rdma {
         return *receiveQueue;
     }
 
-    static ibv::workcompletion::WorkCompletion pollQueueBlocking(ibv::completions::CompletionQueue &queue) {
-        ibv::workcompletion::WorkCompletion completion;
-        while (queue.poll(1, &completion) == 0); // busy poll
-        if (not completion) {
-            throw NetworkException("unexpected completion status: " + to_string(completion.getStatus()));
+    emulated::CompletionQueue &CompletionQueuePair::getEmulatedSendQueue() {
+        return *emulatedSendQueue;
+    }
+
+    emulated::CompletionQueue &CompletionQueuePair::getEmulatedReceiveQueue() {
+        return *emulatedReceiveQueue;
+    }
+
+    ibv::workcompletion::WorkCompletion CompletionQueuePair::pollWorkCompletionBlocking(Completions &completions) {
+        auto completion = nextCompletion(completions);
+        while (not completion) { // busy poll
+            completion = nextCompletion(completions);
         }
-        return completion;
+        return *completion;
     }
 
     ibv::workcompletion::WorkCompletion CompletionQueuePair::pollSendWorkCompletionBlocking() {
-        return pollQueueBlocking(*sendQueue);
+        return pollWorkCompletionBlocking(sendCompletions);
     }
 
     ibv::workcompletion::WorkCompletion CompletionQueuePair::pollRecvWorkCompletionBlocking() {
-        return pollQueueBlocking(*receiveQueue);
+        return pollWorkCompletionBlocking(recvCompletions);
     }
 } // End of namespace rdma
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <optional>
+#include <functional>
 #include <vector>
 #include <mutex>
+#include <unordered_map>
 #include <libibverbscpp.h>
+#include "EmulatedVerbs.h"
 
 namespace rdma {
     class CompletionQueuePair {
@@ -10,6 +16,28 @@ namespace rdma {
         static constexpr int completionVector = 0;
         /// The minimal number of entries for the completion queue
         static constexpr int CQ_SIZE = 100;
+        /// The maximal number of work completions taken from the device with a single poll
+        static constexpr int POLL_BATCH = 16;
+        /// Send completions, that may be reserved at once. The rest of the queue is left to signaled work requests,
+        /// that don't reserve
+        static constexpr size_t MAX_RESERVED_SEND_COMPLETIONS = CQ_SIZE / 2;
+
+        using Handler = std::function<void(const ibv::workcompletion::WorkCompletion &)>;
+
+        /// The work completions of one completion queue, that were polled, but not yet consumed
+        struct Completions {
+            /// The queue, either of the device or of the emulation
+            ibv::completions::CompletionQueue *queue = nullptr;
+            emulated::CompletionQueue *emulatedQueue = nullptr;
+            std::deque<ibv::workcompletion::WorkCompletion> cached;
+            /// Completions with these wr_ids go to their handler instead of the cache
+            std::unordered_map<uint64_t, Handler> handlers;
+            /// Completions with these wr_ids are put aside for waitForSendCompletion, which waits for them without
+            /// holding the guard, so no other poller can take them from the cache meanwhile
+            std::unordered_map<uint64_t, std::optional<ibv::workcompletion::WorkCompletion>> awaited;
+            /// How many more completions with these wr_ids are dropped
+            std::unordered_map<uint64_t, size_t> discarded;
+        };
 
         /// The completion channel
         std::unique_ptr<ibv::completions::CompletionEventChannel> channel;
@@ -17,26 +45,53 @@ namespace rdma {
         std::unique_ptr<ibv::completions::CompletionQueue> sendQueue;
         /// The receive completion queue
         std::unique_ptr<ibv::completions::CompletionQueue> receiveQueue;
-
-        /// The cached work completions
-        std::vector<std::pair<bool, uint64_t>> cachedCompletions;
-        /// Protect wait for events method from concurrent access
+        /// Replace the queues above for the emulation, which has no completion events
+        std::unique_ptr<emulated::CompletionQueue> emulatedSendQueue;
+        std::unique_ptr<emulated::CompletionQueue> emulatedReceiveQueue;
+
+        /// Work completions of the send and of the receive queue, that were polled in a batch, but not yet consumed
+        Completions sendCompletions;
+        Completions recvCompletions;
+        /// Protect wait for events method and the cached completions from concurrent access
         std::mutex guard;
+        /// Send completions reserved, that weren't released yet. Atomic, so handlers can release while polling
+        std::atomic<size_t> reservedSendCompletions = 0;
 
-        uint64_t
-        pollCompletionQueue(ibv::completions::CompletionQueue &completionQueue, ibv::workcompletion::Opcode type);
+        Completions &completionsOf(ibv::completions::CompletionQueue &completionQueue);
+
+        /// Poll up to POLL_BATCH work completions with a single poll and dispatch or cache them. Needs the guard
+        size_t pollBatch(Completions &completions);
+
+        /// pollBatch with the guard, throws on failed completions
+        size_t dispatchBatch(Completions &completions);
+
+        /// The oldest cached work completion, after polling a batch, if there is none. Throws on errors
+        std::optional<ibv::workcompletion::WorkCompletion> nextCompletion(Completions &completions);
+
+        uint64_t pollCompletionQueue(Completions &completions, ibv::workcompletion::Opcode type);
+
+        uint64_t pollCompletionQueueBlocking(Completions &completions, ibv::workcompletion::Opcode type);
+
+        ibv::workcompletion::WorkCompletion pollWorkCompletionBlocking(Completions &completions);
 
         std::vector<ibv::completions::CompletionQueue *> eventsToAck;
 
     public:
         explicit CompletionQueuePair(ibv::context::Context &ctx);
 
+        explicit CompletionQueuePair(emulated::Fabric &fabric);
+
         ~CompletionQueuePair();
 
+        /// Only for a device, for the emulation use the getEmulated ones
         ibv::completions::CompletionQueue &getSendQueue();
 
         ibv::completions::CompletionQueue &getReceiveQueue();
 
+        emulated::CompletionQueue &getEmulatedSendQueue();
+
+        emulated::CompletionQueue &getEmulatedReceiveQueue();
+
         /// Poll the send completion queue
         uint64_t pollSendCompletionQueue();
 
@@ -61,7 +116,48 @@ namespace rdma {
 
         ibv::workcompletion::WorkCompletion pollRecvWorkCompletionBlocking();
 
-        /// Wait for a work request completion
-        void waitForCompletion();
+        /// Wait for a work request completion event and return the oldest completion, that wasn't consumed yet.
+        /// Only this one is taken, the other completions polled meanwhile stay available for the poll methods
+        ibv::workcompletion::WorkCompletion waitForCompletion();
+
+        /// Busy poll until the send work request with wrId completed. Other completions, that are polled meanwhile,
+        /// aren't lost, but stay available for the other poll methods or go to their handler. The guard is only held
+        /// for each poll, so other threads can poll and set handlers meanwhile. Only one thread may wait for a wrId
+        ibv::workcompletion::WorkCompletion waitForSendCompletion(uint64_t wrId);
+
+        /// Dispatch send completions with wrId to handler, instead of returning them from the poll methods. Handlers
+        /// run while polling and must not poll this CompletionQueuePair themselves
+        void setSendHandler(uint64_t wrId, Handler handler);
+
+        void removeSendHandler(uint64_t wrId);
+
+        /// Drop the next count send completions with wrId, e.g. the ones still in flight, when a queue pair is closed,
+        /// instead of caching them, where nobody would ever poll them. Removes the handler of wrId. Each dropped
+        /// completion releases a reserved send completion
+        void discardSendCompletions(uint64_t wrId, size_t count);
+
+        /// Like setSendHandler, for the receive queue
+        void setRecvHandler(uint64_t wrId, Handler handler);
+
+        void removeRecvHandler(uint64_t wrId);
+
+        /// Poll a batch of send completions without blocking and dispatch them to their handlers. Completions without
+        /// handler are kept for the other poll methods. Throws on failed completions. Returns the number of polled
+        /// completions
+        size_t dispatchSendCompletions();
+
+        /// Like dispatchSendCompletions, for the receive queue
+        size_t dispatchRecvCompletions();
+
+        /// Reserve room in the send completion queue for a signaled work request, so the queue can't overrun, even
+        /// when many queue pairs share it. Returns false, when it is full, then completions need to be dispatched
+        /// until some are released again
+        bool reserveSendCompletion();
+
+        /// Release a reservation, when its completion was polled
+        void releaseSendCompletion(size_t count = 1);
+
+        /// Whether any reserved send completion is outstanding, so polling might be worth it
+        bool hasReservedSendCompletions() const;
     };
 } // End of namespace rdma
@@ -0,0 +1,1055 @@
+#include "EmulatedVerbs.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <optional>
+#include <pthread.h>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <tuple>
+#include <unistd.h>
+#include "NetworkException.h"
+#include "util/futex.h"
+
+using namespace std;
+namespace rdma {
+namespace emulated {
+    /// Below this, waiting for the next operation spins instead of sleeping, which is way too coarse for microseconds
+    static constexpr auto spinThreshold = chrono::microseconds(50);
+    /// Operations waiting for a receive are retried this often, like after an RNR NAK. The receive might be posted to
+    /// another fabric, which doesn't wake up our worker. The same goes for a full inbox of another process
+    static constexpr auto rnrRetryInterval = chrono::microseconds(100);
+    /// How often to check, whether processes with unanswered operations are still there
+    static constexpr auto livenessInterval = chrono::milliseconds(10);
+
+    /// Capacities of the shared memory. Keys contain the slot of their region, so MAX_REGIONS is a power of 2
+    static constexpr uint32_t MAX_REGIONS = 4096;
+    static constexpr uint32_t MAX_QUEUE_PAIRS = 1024;
+    static constexpr uint32_t MAX_COMPLETION_QUEUES = 16;
+    static constexpr uint32_t MAX_RECEIVE_QUEUES = 4;
+    static constexpr uint32_t COMPLETION_QUEUE_SIZE = 16384;
+    static constexpr uint32_t RECEIVE_QUEUE_SIZE = 16384;
+    static constexpr uint32_t MAX_RECEIVE_SGES = 4;
+    /// Bytes of the inbox, and the most data of an operation in a single message, so others still fit meanwhile
+    static constexpr uint64_t INBOX_SIZE = 4 * 1024 * 1024;
+    static constexpr uint64_t MAX_CHUNK = 256 * 1024;
+
+    namespace {
+        /// key 0 marks a free slot
+        struct Region {
+            uint32_t key;
+            int32_t access;
+            uint64_t address;
+            uint64_t length;
+        };
+
+        /// qpn 0 marks a free slot, otherwise it is the slot + 1
+        struct QueuePairEntry {
+            uint32_t qpn;
+            uint32_t receiveQueue;
+            uint32_t completionQueue;
+        };
+
+        struct Receive {
+            uint64_t id;
+            uint32_t count;
+            ibv_sge sges[MAX_RECEIVE_SGES];
+        };
+
+        template<typename T, uint32_t SIZE>
+        struct Ring {
+            bool used;
+            /// a completion didn't fit anymore, which breaks the queue like IBV_EVENT_CQ_ERR
+            bool overrun;
+            uint64_t head;
+            uint64_t tail;
+            T entries[SIZE];
+
+            bool empty() const { return head == tail; }
+
+            bool full() const { return tail - head == SIZE; }
+
+            T &front() { return entries[head % SIZE]; }
+
+            void pop() { ++head; }
+
+            void push(const T &entry) { entries[tail++ % SIZE] = entry; }
+        };
+
+        enum class MessageKind : uint32_t {
+            /// (Part of) an operation posted by another process
+            Request,
+            /// (Part of) the answer to a request, the data of a read and the status in the last part
+            Response
+        };
+
+        /// Precedes length bytes of data in an inbox. An operation is split into several messages, when its data
+        /// is larger than MAX_CHUNK
+        struct Message {
+            MessageKind kind;
+            uint32_t opcode;
+            /// the fabric sending the message
+            uint32_t pid;
+            uint32_t index;
+            uint64_t connection;
+            /// the queue pair, that sent the message, and the one it's for
+            uint32_t sourceQpn;
+            uint32_t targetQpn;
+            uint64_t remoteAddress;
+            uint32_t rkey;
+            uint32_t immData;
+            /// data of the whole operation
+            uint64_t size;
+            /// data following this message
+            uint64_t length;
+            /// ibv_wc_status of a response
+            uint32_t status;
+            /// the last message of the operation
+            uint32_t last;
+        };
+
+        /// Messages of other processes for the owner of the inbox. Wraps around at the end
+        struct Inbox {
+            uint64_t head;
+            uint64_t tail;
+            uint8_t data[INBOX_SIZE];
+
+            /// Copy size bytes to / from position
+            void copyIn(uint64_t position, const void *from, size_t size) {
+                const auto offset = position % INBOX_SIZE;
+                const auto first = min<uint64_t>(size, INBOX_SIZE - offset);
+                std::memcpy(&data[offset], from, first);
+                std::memcpy(data, reinterpret_cast<const uint8_t *>(from) + first, size - first);
+            }
+
+            void copyOut(uint64_t position, void *to, size_t size) const {
+                const auto offset = position % INBOX_SIZE;
+                const auto first = min<uint64_t>(size, INBOX_SIZE - offset);
+                std::memcpy(to, &data[offset], first);
+                std::memcpy(reinterpret_cast<uint8_t *>(to) + first, data, size - first);
+            }
+        };
+
+        /// Space of a message in the inbox, messages stay 8 byte aligned
+        uint64_t spaceOf(uint64_t length) {
+            return (sizeof(Message) + length + 7) & ~uint64_t(7);
+        }
+
+        /// Lives in shared memory, everything is protected by guard, a robust mutex shared between processes
+        struct SharedState {
+            pthread_mutex_t guard;
+            /// futex word, incremented whenever there is something new for the worker of the owner
+            atomic<uint32_t> doorbell;
+            uint32_t keyGeneration;
+            Region regions[MAX_REGIONS];
+            QueuePairEntry queuePairs[MAX_QUEUE_PAIRS];
+            Ring<Receive, RECEIVE_QUEUE_SIZE> receiveQueues[MAX_RECEIVE_QUEUES];
+            Ring<ibv_wc, COMPLETION_QUEUE_SIZE> completionQueues[MAX_COMPLETION_QUEUES];
+            Inbox inbox;
+        };
+
+        class SharedLock {
+            pthread_mutex_t &mutex;
+
+        public:
+            explicit SharedLock(pthread_mutex_t &mutex) : mutex(mutex) {
+                if (pthread_mutex_lock(&mutex) == EOWNERDEAD) {
+                    // every update of the state is finished before it's visible, so a dead owner didn't break it
+                    pthread_mutex_consistent(&mutex);
+                }
+            }
+
+            ~SharedLock() { pthread_mutex_unlock(&mutex); }
+
+            SharedLock(const SharedLock &) = delete;
+
+            SharedLock &operator=(const SharedLock &) = delete;
+        };
+
+        string nameOf(NodeAddress address) {
+            return "/l5rdma-emulated-" + to_string(address.pid) + "-" + to_string(address.index);
+        }
+
+        /// The memory of a registered range, if the region with key allows access to it
+        optional<iovec> translate(SharedState &state, uint32_t key, uint64_t address, size_t size, int access) {
+            const auto &region = state.regions[key % MAX_REGIONS];
+            if (key == 0 || region.key != key || address < region.address ||
+                address + size > region.address + region.length || (region.access & access) != access) {
+                return nullopt;
+            }
+            return iovec{reinterpret_cast<void *>(address), size};
+        }
+
+        /// The memory of the scatter / gather elements, if all of them are registered with access
+        optional<vector<iovec>> translate(SharedState &state, const vector<ibv_sge> &sges, int access) {
+            vector<iovec> segments;
+            for (const auto &sge : sges) {
+                const auto segment = translate(state, sge.lkey, sge.addr, sge.length, access);
+                if (not segment) {
+                    return nullopt;
+                }
+                segments.push_back(*segment);
+            }
+            return segments;
+        }
+
+        size_t sizeOf(const vector<iovec> &segments) {
+            size_t size = 0;
+            for (const auto &segment : segments) {
+                size += segment.iov_len;
+            }
+            return size;
+        }
+
+        /// The bytes [begin, end) of segments
+        vector<iovec> slice(const vector<iovec> &segments, size_t begin, size_t end) {
+            vector<iovec> result;
+            size_t offset = 0;
+            for (const auto &segment : segments) {
+                const auto from = max(begin, offset);
+                const auto to = min(end, offset + segment.iov_len);
+                if (from < to) {
+                    result.push_back({reinterpret_cast<uint8_t *>(segment.iov_base) + (from - offset), to - from});
+                }
+                offset += segment.iov_len;
+            }
+            return result;
+        }
+
+        /// Copy from ours to theirs, or the other way round for reads
+        void copyRange(const vector<iovec> &ours, const vector<iovec> &theirs, bool write) {
+            auto their = theirs.begin();
+            size_t theirOffset = 0;
+            for (const auto &segment : ours) {
+                const auto our = reinterpret_cast<uint8_t *>(segment.iov_base);
+                for (size_t done = 0; done < segment.iov_len;) {
+                    const auto todo = min(segment.iov_len - done, their->iov_len - theirOffset);
+                    const auto theirBytes = reinterpret_cast<uint8_t *>(their->iov_base) + theirOffset;
+                    if (write) {
+                        std::copy(our + done, our + done + todo, theirBytes);
+                    } else {
+                        std::copy(theirBytes, theirBytes + todo, our + done);
+                    }
+                    done += todo;
+                    theirOffset += todo;
+                    if (theirOffset == their->iov_len) {
+                        ++their;
+                        theirOffset = 0;
+                    }
+                }
+            }
+        }
+
+        /// Copy between the segments, both in this process. Writes store the last 8 bytes last, so a reader polling
+        /// the end of a message, e.g. for a validity flag, sees all of it then, as with the in order delivery of a
+        /// device
+        void copySegments(const vector<iovec> &ours, const vector<iovec> &theirs, bool write) {
+            const auto size = sizeOf(ours);
+            if (not write || size <= sizeof(uint64_t)) {
+                copyRange(ours, theirs, write);
+                return;
+            }
+            const auto split = size - sizeof(uint64_t);
+            copyRange(slice(ours, 0, split), slice(theirs, 0, split), write);
+            atomic_thread_fence(memory_order_release);
+            copyRange(slice(ours, split, size), slice(theirs, split, size), write);
+        }
+
+        /// Whether the process might still be there
+        bool alive(uint32_t pid) {
+            return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+        }
+
+        /// Carry out request on the fabric of state, which is locked. local is the memory on the side of the initiator,
+        /// the source of writes and sends and the destination of reads. Returns nullopt, if the receiver has no
+        /// receive or no room for its completion yet
+        optional<ibv_wc_status> perform(SharedState &state, const Message &request, const vector<iovec> &local) {
+            const auto opcode = static_cast<ibv_wr_opcode>(request.opcode);
+            const auto &target = state.queuePairs[(request.targetQpn - 1) % MAX_QUEUE_PAIRS];
+            if (target.qpn != request.targetQpn) {
+                // the remote queue pair is gone, nobody acknowledges anymore
+                return IBV_WC_RETRY_EXC_ERR;
+            }
+            auto &receives = state.receiveQueues[target.receiveQueue];
+            auto &receiveCompletions = state.completionQueues[target.completionQueue];
+            const auto consumesReceive = opcode != IBV_WR_RDMA_WRITE && opcode != IBV_WR_RDMA_READ;
+            if (consumesReceive && (receives.empty() || receiveCompletions.full())) {
+                return nullopt;
+            }
+
+            ibv_wc_status status = IBV_WC_SUCCESS;
+            switch (opcode) {
+                case IBV_WR_RDMA_WRITE:
+                case IBV_WR_RDMA_WRITE_WITH_IMM:
+                case IBV_WR_RDMA_READ: {
+                    const auto write = opcode != IBV_WR_RDMA_READ;
+                    const auto range = translate(state, request.rkey, request.remoteAddress, request.size,
+                                                 write ? IBV_ACCESS_REMOTE_WRITE : IBV_ACCESS_REMOTE_READ);
+                    if (range) {
+                        copySegments(local, {*range}, write);
+                    } else {
+                        status = IBV_WC_REM_ACCESS_ERR;
+                    }
+                    break;
+                }
+                default: {
+                    // sends scatter into the receive buffers
+                    const auto &receive = receives.front();
+                    const auto targets = translate(state, vector<ibv_sge>(receive.sges, receive.sges + receive.count),
+                                                   IBV_ACCESS_LOCAL_WRITE);
+                    if (not targets) {
+                        status = IBV_WC_REM_OP_ERR;
+                    } else if (sizeOf(*targets) < request.size) {
+                        status = IBV_WC_REM_INV_REQ_ERR;
+                    } else {
+                        copySegments(local, *targets, true);
+                    }
+                }
+            }
+
+            if (consumesReceive && status == IBV_WC_SUCCESS) {
+                ibv_wc completion{};
+                completion.wr_id = receives.front().id;
+                completion.status = IBV_WC_SUCCESS;
+                completion.opcode = opcode == IBV_WR_RDMA_WRITE_WITH_IMM ? IBV_WC_RECV_RDMA_WITH_IMM : IBV_WC_RECV;
+                completion.byte_len = static_cast<uint32_t>(request.size);
+                if (opcode != IBV_WR_SEND) {
+                    completion.imm_data = request.immData;
+                    completion.wc_flags = IBV_WC_WITH_IMM;
+                }
+                completion.qp_num = request.targetQpn;
+                completion.src_qp = request.sourceQpn;
+                receives.pop();
+                receiveCompletions.push(completion);
+            }
+            return status;
+        }
+    } // namespace
+
+    struct Node {
+        const NodeAddress address;
+        /// in this process, so its registered memory can be accessed directly
+        const bool local;
+        /// the fabric itself removes the shared memory, all others only map it
+        const bool owner;
+        SharedState *state = nullptr;
+
+        Node(NodeAddress address, bool owner) :
+                address(address), local(address.pid == static_cast<uint32_t>(getpid())), owner(owner) {
+            const auto name = nameOf(address);
+            if (owner) {
+                // a process with the same pid might have crashed before removing it
+                shm_unlink(name.c_str());
+            }
+            const auto fd = owner ? shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)
+                                  : shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0) {
+                throw NetworkException("can't open the emulated fabric " + name + ": " + strerror(errno));
+            }
+            struct stat info{};
+            if ((owner && ftruncate(fd, sizeof(SharedState)) != 0) || fstat(fd, &info) != 0 ||
+                static_cast<size_t>(info.st_size) < sizeof(SharedState)) {
+                close(fd);
+                throw NetworkException("invalid emulated fabric " + name);
+            }
+            const auto mapping = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                throw NetworkException("can't map the emulated fabric " + name + ": " + strerror(errno));
+            }
+            state = reinterpret_cast<SharedState *>(mapping);
+            if (owner) {
+                // the rest starts zeroed, which is empty everywhere
+                pthread_mutexattr_t attributes;
+                pthread_mutexattr_init(&attributes);
+                pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+                pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+                pthread_mutex_init(&state->guard, &attributes);
+                pthread_mutexattr_destroy(&attributes);
+            }
+        }
+
+        ~Node() {
+            munmap(state, sizeof(SharedState));
+            if (owner) {
+                shm_unlink(nameOf(address).c_str());
+            }
+        }
+
+        Node(const Node &) = delete;
+
+        Node &operator=(const Node &) = delete;
+
+        /// Wake up the worker of the owner
+        void ring() const {
+            ++state->doorbell;
+            l5::util::futexWakeAll(state->doorbell);
+        }
+
+        /// Append message and the data of segments to the inbox, unless it doesn't fit
+        bool post(const Message &message, const vector<iovec> &segments) const {
+            {
+                const auto lock = SharedLock(state->guard);
+                auto &inbox = state->inbox;
+                const auto space = spaceOf(message.length);
+                if (inbox.tail - inbox.head + space > INBOX_SIZE) {
+                    return false;
+                }
+                inbox.copyIn(inbox.tail, &message, sizeof(message));
+                auto position = inbox.tail + sizeof(message);
+                for (const auto &segment : segments) {
+                    inbox.copyIn(position, segment.iov_base, segment.iov_len);
+                    position += segment.iov_len;
+                }
+                inbox.tail += space;
+            }
+            ring();
+            return true;
+        }
+    };
+
+    /// An operation another process posted, complete once all of its data arrived
+    struct InboundOperation {
+        Message request;
+        vector<uint8_t> data;
+        bool complete = false;
+    };
+
+    /// The operations of a connected queue pair of another process, carried out in order
+    struct InboundConnection {
+        deque<InboundOperation> operations;
+        /// an operation failed, all following ones are flushed
+        bool failed = false;
+    };
+
+    struct Response {
+        NodeAddress to;
+        Message message;
+        vector<uint8_t> data;
+        /// how much of data is already in the inbox
+        size_t posted = 0;
+    };
+
+    struct Inbound {
+        /// by process, fabric index and connection of the queue pair
+        map<tuple<uint32_t, uint32_t, uint64_t>, InboundConnection> connections;
+        deque<Response> responses;
+    };
+
+    LinkModel LinkModel::fromEnvironment() {
+        LinkModel model;
+        if (const auto latency = getenv("L5RDMA_EMULATED_LATENCY_NS")) {
+            model.latency = chrono::nanoseconds(stoll(latency));
+        }
+        if (const auto bandwidth = getenv("L5RDMA_EMULATED_BANDWIDTH")) {
+            model.bandwidth = stod(bandwidth);
+        }
+        return model;
+    }
+
+    bool enabledByEnvironment() {
+        const auto enabled = getenv("L5RDMA_EMULATED");
+        return enabled != nullptr && string(enabled) != "0";
+    }
+
+    MemoryRegion::MemoryRegion(Fabric &fabric, void *addr, size_t length, uint32_t key) : fabric(fabric) {
+        mr.addr = addr;
+        mr.length = length;
+        mr.lkey = key;
+        mr.rkey = key;
+    }
+
+    MemoryRegion::~MemoryRegion() {
+        auto &state = *fabric.self->state;
+        const auto lock = SharedLock(state.guard);
+        auto &region = state.regions[mr.lkey % MAX_REGIONS];
+        if (region.key == mr.lkey) {
+            region = {};
+        }
+    }
+
+    CompletionQueue::~CompletionQueue() {
+        auto &state = *fabric.self->state;
+        const auto lock = SharedLock(state.guard);
+        state.completionQueues[index].used = false;
+    }
+
+    int CompletionQueue::poll(int count, ibv_wc *out) {
+        int polled = 0;
+        {
+            auto &state = *fabric.self->state;
+            const auto lock = SharedLock(state.guard);
+            auto &completions = state.completionQueues[index];
+            if (completions.overrun) {
+                throw NetworkException("emulated completion queue overran");
+            }
+            for (; polled < count && not completions.empty(); ++polled) {
+                out[polled] = completions.front();
+                completions.pop();
+            }
+        }
+        if (polled == 0) {
+            this_thread::yield();
+        }
+        return polled;
+    }
+
+    SharedReceiveQueue::~SharedReceiveQueue() {
+        auto &state = *fabric.self->state;
+        const auto lock = SharedLock(state.guard);
+        state.receiveQueues[index].used = false;
+    }
+
+    void SharedReceiveQueue::postRecv(const ibv_recv_wr &wr) {
+        {
+            auto &state = *fabric.self->state;
+            const auto lock = SharedLock(state.guard);
+            auto &receives = state.receiveQueues[index];
+            for (auto current = &wr; current != nullptr; current = current->next) {
+                if (receives.full()) {
+                    throw NetworkException("emulated shared receive queue is full");
+                }
+                if (current->num_sge < 0 || static_cast<uint32_t>(current->num_sge) > MAX_RECEIVE_SGES) {
+                    throw NetworkException("too many scatter / gather elements for the emulation: " +
+                                           to_string(current->num_sge));
+                }
+                Receive receive{};
+                receive.id = current->wr_id;
+                receive.count = static_cast<uint32_t>(current->num_sge);
+                copy(current->sg_list, current->sg_list + current->num_sge, receive.sges);
+                receives.push(receive);
+            }
+        }
+        // sends might wait for a receive
+        fabric.self->ring();
+    }
+
+    QueuePair::QueuePair(Fabric &fabric, uint32_t qpn, CompletionQueue &sendQueue)
+            : fabric(fabric), qpn(qpn), sendQueue(sendQueue) {}
+
+    QueuePair::~QueuePair() {
+        const auto lock = lock_guard(fabric.guard);
+        fabric.queuePairs.erase(qpn);
+        // queue pairs connected to this one find it gone on their next operation
+        auto &state = *fabric.self->state;
+        const auto sharedLock = SharedLock(state.guard);
+        state.queuePairs[qpn - 1] = {};
+    }
+
+    void QueuePair::connect(uint32_t remoteQpn) {
+        connect(fabric.getAddress(), remoteQpn);
+    }
+
+    void QueuePair::connect(NodeAddress node, uint32_t remoteQpn) {
+        const auto lock = lock_guard(fabric.guard);
+        auto &target = fabric.peer(node);
+        {
+            const auto sharedLock = SharedLock(target.state->guard);
+            if (remoteQpn == 0 || target.state->queuePairs[(remoteQpn - 1) % MAX_QUEUE_PAIRS].qpn != remoteQpn) {
+                throw NetworkException("no emulated queue pair with qpn " + to_string(remoteQpn));
+            }
+        }
+        remote = &target;
+        this->remoteQpn = remoteQpn;
+        connection = ++fabric.connections;
+    }
+
+    void QueuePair::postSend(const ibv_send_wr &wr) {
+        bool queued = false;
+        {
+            const auto lock = lock_guard(fabric.guard);
+            for (auto current = &wr; current != nullptr; current = current->next) {
+                switch (current->opcode) {
+                    case IBV_WR_RDMA_WRITE:
+                    case IBV_WR_RDMA_WRITE_WITH_IMM:
+                    case IBV_WR_SEND:
+                    case IBV_WR_SEND_WITH_IMM:
+                    case IBV_WR_RDMA_READ:
+                        break;
+                    default:
+                        throw NetworkException("opcode is not supported by the emulation: " +
+                                               to_string(current->opcode));
+                }
+
+                Operation operation{};
+                operation.opcode = current->opcode;
+                operation.id = current->wr_id;
+                operation.signaled = (current->send_flags & IBV_SEND_SIGNALED) != 0;
+                operation.sges.assign(current->sg_list, current->sg_list + current->num_sge);
+                operation.remoteAddress = current->wr.rdma.remote_addr;
+                operation.rkey = current->wr.rdma.rkey;
+                operation.immData = current->imm_data;
+                for (const auto &sge : operation.sges) {
+                    operation.size += sge.length;
+                }
+                if ((current->send_flags & IBV_SEND_INLINE) != 0) {
+                    // inline data is copied right away, so the buffer can be reused immediately
+                    for (const auto &sge : operation.sges) {
+                        const auto begin = reinterpret_cast<const uint8_t *>(sge.addr);
+                        operation.inlineData.insert(operation.inlineData.end(), begin, begin + sge.length);
+                    }
+                }
+
+                // the link transfers one operation at a time, the latency adds up on top
+                const auto now = chrono::steady_clock::now();
+                const auto start = max(now, fabric.linkFreeAt);
+                const auto transfer = fabric.model.bandwidth > 0
+                                      ? chrono::nanoseconds(static_cast<int64_t>(
+                                                static_cast<double>(operation.size) * 1e9 / fabric.model.bandwidth))
+                                      : chrono::nanoseconds(0);
+                fabric.linkFreeAt = start + transfer;
+                operation.due = fabric.linkFreeAt + fabric.model.latency;
+
+                // due already, e.g. without a link model: no need to wait for the worker, unless earlier ones do
+                if (operations.empty() && operation.due <= now && fabric.execute(*this, operation)) {
+                    continue;
+                }
+                operations.push_back(move(operation));
+                queued = true;
+            }
+        }
+        if (queued) {
+            fabric.self->ring();
+        }
+    }
+
+    Fabric::Fabric(LinkModel model) :
+            model(model),
+            self(make_unique<Node>(NodeAddress{static_cast<uint32_t>(getpid()), [] {
+                static atomic<uint32_t> nextIndex{0};
+                return nextIndex++;
+            }()}, true)),
+            inbound(make_unique<Inbound>()) {
+        worker = thread([this] { run(); });
+    }
+
+    Fabric::~Fabric() {
+        {
+            const auto lock = lock_guard(guard);
+            stopping = true;
+        }
+        self->ring();
+        worker.join();
+    }
+
+    NodeAddress Fabric::getAddress() const {
+        return self->address;
+    }
+
+    Node &Fabric::peer(NodeAddress address) {
+        if (address.pid == self->address.pid && address.index == self->address.index) {
+            return *self;
+        }
+        auto &node = peers[{address.pid, address.index}];
+        if (node == nullptr) {
+            node = make_unique<Node>(address, false);
+        }
+        return *node;
+    }
+
+    unique_ptr<MemoryRegion> Fabric::registerMr(void *addr, size_t length, int access) {
+        auto &state = *self->state;
+        const auto lock = SharedLock(state.guard);
+        const auto free = find_if(begin(state.regions), end(state.regions),
+                                  [](const Region &region) { return region.key == 0; });
+        if (free == end(state.regions)) {
+            throw NetworkException("too many emulated memory regions");
+        }
+        // the generation makes keys of deregistered regions invalid, even when the slot is reused
+        uint32_t generation;
+        do {
+            generation = ++state.keyGeneration % (numeric_limits<uint32_t>::max() / MAX_REGIONS);
+        } while (generation == 0);
+        const auto key = generation * MAX_REGIONS + static_cast<uint32_t>(distance(begin(state.regions), free));
+        *free = Region{key, access, reinterpret_cast<uintptr_t>(addr), length};
+        return unique_ptr<MemoryRegion>(new MemoryRegion(*this, addr, length, key));
+    }
+
+    unique_ptr<CompletionQueue> Fabric::createCompletionQueue() {
+        auto &state = *self->state;
+        const auto lock = SharedLock(state.guard);
+        for (uint32_t index = 0; index < MAX_COMPLETION_QUEUES; ++index) {
+            auto &queue = state.completionQueues[index];
+            if (not queue.used) {
+                queue.used = true;
+                queue.overrun = false;
+                queue.head = queue.tail = 0;
+                return unique_ptr<CompletionQueue>(new CompletionQueue(*this, index));
+            }
+        }
+        throw NetworkException("too many emulated completion queues");
+    }
+
+    unique_ptr<SharedReceiveQueue> Fabric::createSrq() {
+        auto &state = *self->state;
+        const auto lock = SharedLock(state.guard);
+        for (uint32_t index = 0; index < MAX_RECEIVE_QUEUES; ++index) {
+            auto &queue = state.receiveQueues[index];
+            if (not queue.used) {
+                queue.used = true;
+                queue.head = queue.tail = 0;
+                return unique_ptr<SharedReceiveQueue>(new SharedReceiveQueue(*this, index));
+            }
+        }
+        throw NetworkException("too many emulated shared receive queues");
+    }
+
+    unique_ptr<QueuePair> Fabric::createQueuePair(CompletionQueue &sendQueue, CompletionQueue &receiveQueue,
+                                                  SharedReceiveQueue &sharedReceiveQueue) {
+        const auto lock = lock_guard(guard);
+        auto &state = *self->state;
+        const auto sharedLock = SharedLock(state.guard);
+        const auto free = find_if(begin(state.queuePairs), end(state.queuePairs),
+                                  [](const QueuePairEntry &entry) { return entry.qpn == 0; });
+        if (free == end(state.queuePairs)) {
+            throw NetworkException("too many emulated queue pairs");
+        }
+        const auto qpn = static_cast<uint32_t>(distance(begin(state.queuePairs), free)) + 1;
+        *free = QueuePairEntry{qpn, sharedReceiveQueue.index, receiveQueue.index};
+        auto qp = unique_ptr<QueuePair>(new QueuePair(*this, qpn, sendQueue));
+        queuePairs[qpn] = qp.get();
+        return qp;
+    }
+
+    void Fabric::complete(QueuePair &qp, const QueuePair::Operation &operation, ibv_wc_status status) {
+        if (status == IBV_WC_SUCCESS && not operation.signaled) {
+            return;
+        }
+        ibv_wc completion{};
+        completion.wr_id = operation.id;
+        completion.status = status;
+        switch (operation.opcode) {
+            case IBV_WR_RDMA_WRITE:
+            case IBV_WR_RDMA_WRITE_WITH_IMM:
+                completion.opcode = IBV_WC_RDMA_WRITE;
+                break;
+            case IBV_WR_RDMA_READ:
+                completion.opcode = IBV_WC_RDMA_READ;
+                completion.byte_len = static_cast<uint32_t>(operation.size);
+                break;
+            default:
+                completion.opcode = IBV_WC_SEND;
+        }
+        completion.qp_num = qp.qpn;
+
+        auto &state = *self->state;
+        const auto lock = SharedLock(state.guard);
+        auto &completions = state.completionQueues[qp.sendQueue.index];
+        if (completions.full()) {
+            completions.overrun = true;
+        } else {
+            completions.push(completion);
+        }
+    }
+
+    bool Fabric::execute(QueuePair &qp, QueuePair::Operation &operation) {
+        const auto finish = [&](ibv_wc_status status) {
+            if (status != IBV_WC_SUCCESS) {
+                qp.failed = true;
+            }
+            complete(qp, operation, status);
+            return true;
+        };
+        if (qp.failed) {
+            // the completions of the in flight operations come first
+            return qp.inFlight.empty() && finish(IBV_WC_WR_FLUSH_ERR);
+        }
+        if (qp.remote == nullptr) {
+            return finish(IBV_WC_RETRY_EXC_ERR);
+        }
+
+        // the local side of the operation
+        optional<vector<iovec>> local;
+        if (operation.inlineData.empty()) {
+            const auto localAccess = operation.opcode == IBV_WR_RDMA_READ ? IBV_ACCESS_LOCAL_WRITE : 0;
+            auto &state = *self->state;
+            const auto lock = SharedLock(state.guard);
+            local = translate(state, operation.sges, localAccess);
+        } else {
+            local = vector<iovec>{{operation.inlineData.data(), operation.inlineData.size()}};
+        }
+        if (not local) {
+            return finish(IBV_WC_LOC_PROT_ERR);
+        }
+
+        Message request{};
+        request.kind = MessageKind::Request;
+        request.opcode = operation.opcode;
+        request.pid = self->address.pid;
+        request.index = self->address.index;
+        request.connection = qp.connection;
+        request.sourceQpn = qp.qpn;
+        request.targetQpn = qp.remoteQpn;
+        request.remoteAddress = operation.remoteAddress;
+        request.rkey = operation.rkey;
+        request.immData = operation.immData;
+        request.size = operation.size;
+
+        auto &remote = *qp.remote;
+        if (remote.local) {
+            optional<ibv_wc_status> status;
+            {
+                const auto lock = SharedLock(remote.state->guard);
+                status = perform(*remote.state, request, *local);
+            }
+            if (not status) {
+                // receiver not ready, retry later, like an infinite RNR retry count
+                return false;
+            }
+            return finish(*status);
+        }
+
+        // another process carries it out, the data of writes and sends goes along in as many messages as needed
+        const auto data = operation.opcode == IBV_WR_RDMA_READ ? vector<iovec>{} : *local;
+        const auto size = sizeOf(data);
+        do {
+            const auto chunk = min<uint64_t>(size - operation.posted, MAX_CHUNK);
+            request.length = chunk;
+            request.last = operation.posted + chunk == size;
+            if (not remote.post(request, slice(data, operation.posted, operation.posted + chunk))) {
+                if (qp.inFlight.empty() && not alive(remote.address.pid)) {
+                    return finish(IBV_WC_RETRY_EXC_ERR);
+                }
+                return false;
+            }
+            operation.posted += chunk;
+        } while (operation.posted < size);
+        qp.inFlight.push_back(move(operation));
+        return true;
+    }
+
+    void Fabric::receiveMessages() {
+        vector<pair<Message, vector<uint8_t>>> messages;
+        {
+            auto &state = *self->state;
+            const auto lock = SharedLock(state.guard);
+            auto &inbox = state.inbox;
+            while (inbox.head != inbox.tail) {
+                Message message{};
+                inbox.copyOut(inbox.head, &message, sizeof(message));
+                vector<uint8_t> data(message.length);
+                inbox.copyOut(inbox.head + sizeof(message), data.data(), data.size());
+                inbox.head += spaceOf(message.length);
+                messages.emplace_back(message, move(data));
+            }
+        }
+
+        for (auto &[message, data] : messages) {
+            if (message.kind == MessageKind::Request) {
+                auto &operations = inbound->connections[{message.pid, message.index, message.connection}].operations;
+                if (operations.empty() || operations.back().complete) {
+                    operations.push_back({message, {}});
+                }
+                auto &operation = operations.back();
+                operation.data.insert(operation.data.end(), data.begin(), data.end());
+                operation.complete = message.last != 0;
+                continue;
+            }
+
+            // the answer to the first in flight operation, unless the queue pair is gone or was connected again
+            const auto found = queuePairs.find(message.targetQpn);
+            if (found == queuePairs.end() || found->second->connection != message.connection ||
+                found->second->inFlight.empty()) {
+                continue;
+            }
+            auto &qp = *found->second;
+            qp.readData.insert(qp.readData.end(), data.begin(), data.end());
+            if (message.last == 0) {
+                continue;
+            }
+            const auto operation = move(qp.inFlight.front());
+            qp.inFlight.pop_front();
+            auto status = static_cast<ibv_wc_status>(message.status);
+            if (status == IBV_WC_SUCCESS && operation.opcode == IBV_WR_RDMA_READ) {
+                optional<vector<iovec>> local;
+                {
+                    auto &state = *self->state;
+                    const auto lock = SharedLock(state.guard);
+                    local = translate(state, operation.sges, IBV_ACCESS_LOCAL_WRITE);
+                }
+                if (local) {
+                    copySegments({{qp.readData.data(), qp.readData.size()}}, *local, true);
+                } else {
+                    status = IBV_WC_LOC_PROT_ERR;
+                }
+            }
+            qp.readData.clear();
+            if (status != IBV_WC_SUCCESS) {
+                qp.failed = true;
+            }
+            complete(qp, operation, status);
+        }
+    }
+
+    bool Fabric::executeInbound() {
+        bool waiting = false;
+        auto &connections = inbound->connections;
+        for (auto current = connections.begin(); current != connections.end();) {
+            auto &[key, connection] = *current;
+            auto &operations = connection.operations;
+            while (not operations.empty() && operations.front().complete) {
+                auto &operation = operations.front();
+                Response response{NodeAddress{get<0>(key), get<1>(key)}, {}, {}};
+                optional<ibv_wc_status> status = IBV_WC_WR_FLUSH_ERR;
+                if (not connection.failed) {
+                    auto &source = operation.request.opcode == IBV_WR_RDMA_READ ? response.data : operation.data;
+                    source.resize(operation.request.size);
+                    auto &state = *self->state;
+                    const auto lock = SharedLock(state.guard);
+                    status = perform(state, operation.request, {{source.data(), source.size()}});
+                }
+                if (not status) {
+                    // receiver not ready, retry later
+                    waiting = true;
+                    break;
+                }
+                if (*status != IBV_WC_SUCCESS) {
+                    connection.failed = true;
+                    response.data.clear();
+                }
+
+                auto &message = response.message;
+                message = operation.request;
+                message.kind = MessageKind::Response;
+                message.pid = self->address.pid;
+                message.index = self->address.index;
+                message.sourceQpn = operation.request.targetQpn;
+                message.targetQpn = operation.request.sourceQpn;
+                message.size = response.data.size();
+                message.status = *status;
+                inbound->responses.push_back(move(response));
+                operations.pop_front();
+            }
+            // a failed connection flushes the rest of its operations, which might still arrive
+            if (operations.empty() && not connection.failed) {
+                current = connections.erase(current);
+            } else {
+                ++current;
+            }
+        }
+        return waiting;
+    }
+
+    bool Fabric::sendResponses() {
+        auto &responses = inbound->responses;
+        while (not responses.empty()) {
+            auto &response = responses.front();
+            Node *target = nullptr;
+            try {
+                target = &peer(response.to);
+            } catch (const NetworkException &) {
+                // the fabric is gone, nobody waits for the answer anymore
+                responses.pop_front();
+                continue;
+            }
+            auto &message = response.message;
+            const vector<iovec> data{{response.data.data(), response.data.size()}};
+            do {
+                const auto chunk = min<uint64_t>(response.data.size() - response.posted, MAX_CHUNK);
+                message.length = chunk;
+                message.last = response.posted + chunk == response.data.size();
+                if (not target->post(message, slice(data, response.posted, response.posted + chunk))) {
+                    if (alive(response.to.pid)) {
+                        return false;
+                    }
+                    break;
+                }
+                response.posted += chunk;
+            } while (response.posted < response.data.size());
+            responses.pop_front();
+        }
+        return true;
+    }
+
+    void Fabric::failUnanswered() {
+        for (auto &[qpn, qp] : queuePairs) {
+            if (qp->inFlight.empty()) {
+                continue;
+            }
+            auto &remote = *qp->remote;
+            bool answered = alive(remote.address.pid);
+            if (answered) {
+                const auto lock = SharedLock(remote.state->guard);
+                answered = remote.state->queuePairs[(qp->remoteQpn - 1) % MAX_QUEUE_PAIRS].qpn == qp->remoteQpn;
+            }
+            if (answered) {
+                continue;
+            }
+            // nobody acknowledges anymore
+            qp->failed = true;
+            auto status = IBV_WC_RETRY_EXC_ERR;
+            for (const auto &operation : qp->inFlight) {
+                complete(*qp, operation, status);
+                status = IBV_WC_WR_FLUSH_ERR;
+            }
+            qp->inFlight.clear();
+            qp->readData.clear();
+        }
+    }
+
+    void Fabric::run() {
+        auto lock = unique_lock(guard);
+        auto nextLivenessCheck = chrono::steady_clock::now();
+        while (not stopping) {
+            // everything after this rings again, so we don't sleep through it
+            const auto rung = self->state->doorbell.load();
+            receiveMessages();
+
+            const auto now = chrono::steady_clock::now();
+            auto next = chrono::steady_clock::time_point::max();
+            bool progress = false;
+            for (auto &[qpn, qp] : queuePairs) {
+                auto &operations = qp->operations;
+                while (not operations.empty() && operations.front().due <= now &&
+                       execute(*qp, operations.front())) {
+                    operations.pop_front();
+                    progress = true;
+                }
+                if (not qp->inFlight.empty()) {
+                    // the answer rings, unless the other process is gone
+                    next = min(next, now + livenessInterval);
+                }
+                if (operations.empty()) {
+                    continue;
+                }
+                if (operations.front().due > now) {
+                    next = min(next, operations.front().due);
+                } else {
+                    // waits for a receive or room in an inbox. postRecv rings, but not the one of another process
+                    next = min(next, now + rnrRetryInterval);
+                }
+            }
+            if (executeInbound()) {
+                next = min(next, now + rnrRetryInterval);
+            }
+            if (not sendResponses()) {
+                next = min(next, now + rnrRetryInterval);
+            }
+            if (now >= nextLivenessCheck) {
+                failUnanswered();
+                nextLivenessCheck = now + livenessInterval;
+            }
+            if (progress) {
+                continue;
+            }
+
+            lock.unlock();
+            if (next == chrono::steady_clock::time_point::max()) {
+                l5::util::futexWait(self->state->doorbell, rung);
+            } else if (next - now < spinThreshold) {
+                this_thread::yield();
+            } else {
+                l5::util::futexWait(self->state->doorbell, rung, next - now);
+            }
+            lock.lock();
+        }
+    }
+} // End of namespace emulated
+} // End of namespace rdma
@@ -0,0 +1,260 @@
+#ifndef L5RDMA_EMULATEDVERBS_H
+#define L5RDMA_EMULATEDVERBS_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <infiniband/verbs.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rdma {
+namespace emulated {
+    /// Timing of the emulated link. A work request occupies the link for size / bandwidth, and its effects become visible
+    /// latency after that
+    struct LinkModel {
+        std::chrono::nanoseconds latency{0};
+        /// in bytes per second, 0 for unlimited
+        double bandwidth = 0;
+
+        /// The defaults, overridden by L5RDMA_EMULATED_LATENCY_NS and L5RDMA_EMULATED_BANDWIDTH (bytes per second)
+        static LinkModel fromEnvironment();
+    };
+
+    /// Whether L5RDMA_EMULATED is set (to anything but 0), which makes rdma::Network use the emulation
+    bool enabledByEnvironment();
+
+    /// Finds a Fabric from other processes on the same host, like the GID of a port
+    struct NodeAddress {
+        uint32_t pid = 0;
+        /// Fabrics of the same process are numbered
+        uint32_t index = 0;
+    };
+
+    class Fabric;
+
+    /// The shared memory of a Fabric: its memory regions, receive queues, completion queues, queue pairs and inbox
+    struct Node;
+
+    /// What another process posted to queue pairs of a Fabric, and the answers to it
+    struct Inbound;
+
+    class MemoryRegion {
+        friend class Fabric;
+
+        Fabric &fabric;
+        ibv_mr mr{};
+
+        MemoryRegion(Fabric &fabric, void *addr, size_t length, uint32_t key);
+
+    public:
+        ~MemoryRegion();
+
+        MemoryRegion(const MemoryRegion &) = delete;
+
+        MemoryRegion &operator=(const MemoryRegion &) = delete;
+
+        void *getAddr() const { return mr.addr; }
+
+        size_t getLength() const { return mr.length; }
+
+        uint32_t getLkey() const { return mr.lkey; }
+
+        uint32_t getRkey() const { return mr.rkey; }
+
+        /// The region as ibv_mr, e.g. to hand it out as ibv::memoryregion::MemoryRegion, which only adds methods
+        ibv_mr &get() { return mr; }
+    };
+
+    class CompletionQueue {
+        friend class Fabric;
+
+        Fabric &fabric;
+        /// The slot in the shared memory, where other processes push receive completions, too
+        const uint32_t index;
+
+        CompletionQueue(Fabric &fabric, uint32_t index) : fabric(fabric), index(index) {}
+
+    public:
+        ~CompletionQueue();
+
+        CompletionQueue(const CompletionQueue &) = delete;
+
+        CompletionQueue &operator=(const CompletionQueue &) = delete;
+
+        /// Like ibv_poll_cq: take up to count completions, returns how many. An empty poll yields the processor, the
+        /// completions come from other threads and processes, which might need it. Throws, when the queue overran
+        int poll(int count, ibv_wc *completions);
+    };
+
+    class SharedReceiveQueue {
+        friend class Fabric;
+
+        Fabric &fabric;
+        /// The slot in the shared memory, other processes take the receives from there
+        const uint32_t index;
+
+        SharedReceiveQueue(Fabric &fabric, uint32_t index) : fabric(fabric), index(index) {}
+
+    public:
+        ~SharedReceiveQueue();
+
+        SharedReceiveQueue(const SharedReceiveQueue &) = delete;
+
+        SharedReceiveQueue &operator=(const SharedReceiveQueue &) = delete;
+
+        /// Like ibv_post_srq_recv, follows the wr.next chain. Throws, when the queue is full
+        void postRecv(const ibv_recv_wr &wr);
+    };
+
+    class QueuePair {
+        friend class Fabric;
+
+        struct Operation {
+            ibv_wr_opcode opcode;
+            uint64_t id;
+            bool signaled;
+            std::vector<ibv_sge> sges;
+            /// IBV_SEND_INLINE only: the data, captured when posting
+            std::vector<uint8_t> inlineData;
+            uint64_t remoteAddress;
+            uint32_t rkey;
+            uint32_t immData;
+            size_t size;
+            /// when the operation takes effect on the remote side
+            std::chrono::steady_clock::time_point due;
+            /// For another process: how much of the data is already in its inbox
+            size_t posted = 0;
+        };
+
+        Fabric &fabric;
+        const uint32_t qpn;
+        CompletionQueue &sendQueue;
+        /// The fabric of the connected queue pair, nullptr until connected
+        Node *remote = nullptr;
+        uint32_t remoteQpn = 0;
+        /// Tells the remote fabric apart operations of an earlier connection of the same qpn
+        uint64_t connection = 0;
+        /// Operations are executed in order, like on a reliable connection
+        std::deque<Operation> operations;
+        /// Operations in the inbox of another process, which answers them in order
+        std::deque<Operation> inFlight;
+        /// The data of the first in flight read received so far
+        std::vector<uint8_t> readData;
+        /// an operation failed, all following ones are flushed
+        bool failed = false;
+
+        QueuePair(Fabric &fabric, uint32_t qpn, CompletionQueue &sendQueue);
+
+    public:
+        ~QueuePair();
+
+        QueuePair(const QueuePair &) = delete;
+
+        QueuePair &operator=(const QueuePair &) = delete;
+
+        uint32_t getQPN() const { return qpn; }
+
+        /// Connect to a queue pair of the same fabric, like a reliable connection
+        void connect(uint32_t remoteQpn);
+
+        /// Connect to a queue pair of any fabric on this host, e.g. of another process
+        void connect(NodeAddress node, uint32_t remoteQpn);
+
+        /// Like ibv_post_send, follows the wr.next chain. Supports RDMA_WRITE(_WITH_IMM), RDMA_READ and SEND(_WITH_IMM)
+        void postSend(const ibv_send_wr &wr);
+    };
+
+    /**
+     * A software RDMA device for queue pairs on the same host, in the same or in other processes. Memory regions,
+     * receive queues, completion queues and queue pairs are kept in shared memory, so other processes find them there.
+     * Within a process, the data is copied directly between the registered memory. Another process can't access that
+     * memory, so operations for it go through the inbox in its shared memory instead: the data of writes and sends is
+     * copied into it, and the background thread of that process carries them out and answers with their status and
+     * the data of reads. This needs no permissions besides the shared memory, so queue pairs can be connected to any
+     * number of processes.
+     * Work requests, that are due, are executed right when they are posted. Others, which wait for the time the
+     * LinkModel assigns to them or for a receive, are executed by a background thread, so the emulation also roughly
+     * behaves like a slower or farther away link.
+     * Work requests and completions are the plain ibv_send_wr / ibv_recv_wr / ibv_wc structs, which the libibverbscpp
+     * wrappers derive from, so code building those for a real device can post them here unchanged.
+     */
+    class Fabric {
+        friend class MemoryRegion;
+        friend class CompletionQueue;
+        friend class SharedReceiveQueue;
+        friend class QueuePair;
+
+        const LinkModel model;
+        const std::unique_ptr<Node> self;
+        /// Fabrics, that queue pairs connected to or received operations from, mapped once
+        std::map<std::pair<uint32_t, uint32_t>, std::unique_ptr<Node>> peers;
+
+        std::mutex guard;
+        bool stopping = false;
+
+        std::map<uint32_t, QueuePair *> queuePairs;
+        uint64_t connections = 0;
+        /// the link is busy transferring until then
+        std::chrono::steady_clock::time_point linkFreeAt{};
+
+        const std::unique_ptr<Inbound> inbound;
+
+        std::thread worker;
+
+        /// The fabric at address, mapped on first use. Needs the guard
+        Node &peer(NodeAddress address);
+
+        /// Execute operation, unless the receiver has no receive or no room for its completion yet, or the inbox of
+        /// its process is full. Returns false, if it needs to wait. Operations for another process are moved to the
+        /// in flight ones. Needs the guard
+        bool execute(QueuePair &qp, QueuePair::Operation &operation);
+
+        void complete(QueuePair &qp, const QueuePair::Operation &operation, ibv_wc_status status);
+
+        /// Take everything out of our inbox. Needs the guard
+        void receiveMessages();
+
+        /// Carry out the operations other processes posted, as far as possible. Returns whether some wait for a
+        /// receive. Needs the guard
+        bool executeInbound();
+
+        /// Put the answers into the inboxes of their processes. Returns false, if some don't fit yet. Needs the guard
+        bool sendResponses();
+
+        /// Fail the in flight operations of queue pairs connected to processes, which are gone. Needs the guard
+        void failUnanswered();
+
+        void run();
+
+    public:
+        explicit Fabric(LinkModel model = LinkModel::fromEnvironment());
+
+        ~Fabric();
+
+        Fabric(const Fabric &) = delete;
+
+        Fabric &operator=(const Fabric &) = delete;
+
+        const LinkModel &getModel() const { return model; }
+
+        NodeAddress getAddress() const;
+
+        /// access is a combination of ibv_access_flags
+        std::unique_ptr<MemoryRegion> registerMr(void *addr, size_t length, int access);
+
+        std::unique_ptr<CompletionQueue> createCompletionQueue();
+
+        std::unique_ptr<SharedReceiveQueue> createSrq();
+
+        std::unique_ptr<QueuePair> createQueuePair(CompletionQueue &sendQueue, CompletionQueue &receiveQueue,
+                                                   SharedReceiveQueue &sharedReceiveQueue);
+    };
+} // End of namespace emulated
+} // End of namespace rdma
+
+#endif //L5RDMA_EMULATEDVERBS_H
@@ -9,7 +9,7 @@ namespace rdma {
     template<typename T>
     struct RegisteredMemoryRegion {
         std::vector<T> underlying;
-        std::unique_ptr<ibv::memoryregion::MemoryRegion> mr;
+        MemoryRegion mr;
 
         RegisteredMemoryRegion(size_t size, rdma::Network &net, std::initializer_list<ibv::AccessFlag> flags) :
                 underlying(size),
@@ -5,6 +5,9 @@
 
 using namespace std;
 
+/// Marks the GIDs of emulated fabrics ("l5emul"), so they aren't mistaken for the ones of a device
+static constexpr uint64_t emulatedSubnetPrefix = 0x6c35656d756c0000;
+
 static std::unique_ptr<ibv::context::Context> openUnambigousDevice(ibv::device::DeviceList &devices) {
     if (devices.size() == 0) {
         throw rdma::NetworkException("no Infiniband devices available");
@@ -24,7 +27,29 @@ namespace rdma {
         return os << "lid=" << address.lid << ", qpn=" << address.qpn;
     }
 
-    Network::Network() : devices(), context(openUnambigousDevice(devices)), sharedCompletionQueuePair(*context) {
+    void MemoryRegionDeleter::operator()(ibv::memoryregion::MemoryRegion *memoryRegion) const {
+        if (emulated != nullptr) {
+            delete emulated;
+        } else {
+            delete memoryRegion;
+        }
+    }
+
+    static bool emulate(Backend backend) {
+        return backend == Backend::Emulated ||
+               (backend == Backend::FromEnvironment && emulated::enabledByEnvironment());
+    }
+
+    Network::Network(Backend backend) :
+            devices(emulate(backend) ? nullptr : make_unique<ibv::device::DeviceList>()),
+            context(devices ? openUnambigousDevice(*devices) : nullptr),
+            fabric(devices ? nullptr : make_unique<emulated::Fabric>()),
+            sharedCompletionQueuePair(newCompletionQueuePair()) {
+        if (fabric) {
+            emulatedReceiveQueue = fabric->createSrq();
+            return;
+        }
+
         // Create the protection domain
         protectionDomain = context->allocProtectionDomain();
 
@@ -33,21 +58,72 @@ namespace rdma {
         sharedReceiveQueue = protectionDomain->createSrq(initAttributes);
     }
 
+    bool Network::hasDevice() {
+        int count = 0;
+        auto devices = ibv_get_device_list(&count);
+        if (devices == nullptr) return false;
+        bool usable = false;
+        if (count == 1) {
+            if (auto context = ibv_open_device(devices[0])) {
+                usable = true;
+                ibv_close_device(context);
+            }
+        }
+        ibv_free_device_list(devices);
+        return usable;
+    }
+
+    bool Network::isEmulated() const {
+        return fabric != nullptr;
+    }
+
+    ibv::Gid Network::gidOf(emulated::NodeAddress node) {
+        // like Context::queryGid, which lets ibv_query_gid fill the Gid as ibv_gid
+        ibv::Gid gid{};
+        auto &raw = *reinterpret_cast<ibv_gid *>(&gid);
+        raw.global.subnet_prefix = emulatedSubnetPrefix;
+        raw.global.interface_id = (static_cast<uint64_t>(node.pid) << 32) | node.index;
+        return gid;
+    }
+
+    emulated::NodeAddress Network::nodeOf(const ibv::Gid &gid) {
+        if (gid.getSubnetPrefix() != emulatedSubnetPrefix) {
+            throw NetworkException("the remote side doesn't use the emulation");
+        }
+        const auto id = gid.getInterfaceId();
+        return emulated::NodeAddress{static_cast<uint32_t>(id >> 32), static_cast<uint32_t>(id)};
+    }
+
     /// Get the LID
     uint16_t Network::getLID() {
+        if (fabric) {
+            return 0;
+        }
         return context->queryPort(ibport).getLid();
     }
 
     /// Get the GID
     ibv::Gid Network::getGID() {
+        if (fabric) {
+            return gidOf(fabric->getAddress());
+        }
         return context->queryGid(ibport, 0);
     }
 
     /// Print the capabilities of the RDMA host channel adapter
     void Network::printCapabilities() {
         using Cap = ibv::device::CapabilityFlag;
+        if (fabric) {
+            const auto address = fabric->getAddress();
+            cout << "[Emulated Device]" << '\n';
+            cout << left << setw(44) << "  Process: " << address.pid << '\n';
+            cout << left << setw(44) << "  Fabric: " << address.index << '\n';
+            cout << left << setw(44) << "  Latency (ns): " << fabric->getModel().latency.count() << '\n';
+            cout << left << setw(44) << "  Bandwidth (B/s, 0 = unlimited): " << fabric->getModel().bandwidth << endl;
+            return;
+        }
         // Get a list of all devices
-        for (auto device : devices) {
+        for (auto device : *devices) {
             // Open the device
             auto context = device->open();
 
@@ -180,16 +256,31 @@ namespace rdma {
         }
     }
 
-    unique_ptr<ibv::memoryregion::MemoryRegion>
-    Network::registerMr(void *addr, size_t length, initializer_list<ibv::AccessFlag> flags) {
-        return protectionDomain->registerMemoryRegion(addr, length, flags);
+    MemoryRegion Network::registerMr(void *addr, size_t length, initializer_list<ibv::AccessFlag> flags) {
+        if (fabric) {
+            int access = 0;
+            for (const auto flag : flags) {
+                access |= static_cast<int>(flag);
+            }
+            const auto region = fabric->registerMr(addr, length, access).release();
+            // libibverbscpp's MemoryRegion only adds methods to ibv_mr
+            return MemoryRegion(reinterpret_cast<ibv::memoryregion::MemoryRegion *>(&region->get()),
+                                MemoryRegionDeleter{region});
+        }
+        return MemoryRegion(protectionDomain->registerMemoryRegion(addr, length, flags).release());
     }
 
     CompletionQueuePair Network::newCompletionQueuePair() {
+        if (fabric) {
+            return CompletionQueuePair(*fabric);
+        }
         return CompletionQueuePair(*context);
     }
 
     ibv::protectiondomain::ProtectionDomain &Network::getProtectionDomain() {
+        if (not protectionDomain) {
+            throw NetworkException("the emulation has no protection domain");
+        }
         return *protectionDomain;
     }
 
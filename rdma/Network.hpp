@@ -2,9 +2,18 @@
 
 #include <memory>
 #include "CompletionQueuePair.hpp"
+#include "EmulatedVerbs.h"
 
 namespace rdma {
-    using MemoryRegion = std::unique_ptr<ibv::memoryregion::MemoryRegion>;
+    /// Deregisters a memory region of the device, or of the emulation
+    struct MemoryRegionDeleter {
+        /// Only set for the emulation, which hands out its ibv_mr as ibv::memoryregion::MemoryRegion
+        emulated::MemoryRegion *emulated = nullptr;
+
+        void operator()(ibv::memoryregion::MemoryRegion *memoryRegion) const;
+    };
+
+    using MemoryRegion = std::unique_ptr<ibv::memoryregion::MemoryRegion, MemoryRegionDeleter>;
 
     std::ostream &operator<<(std::ostream &os, const ibv::memoryregion::RemoteAddress &remoteMemoryRegion);
 
@@ -17,6 +26,16 @@ namespace rdma {
 
     std::ostream &operator<<(std::ostream &os, const Address &address);
 
+    /// Which verbs a Network uses
+    enum class Backend {
+        /// Emulated, if L5RDMA_EMULATED is set, otherwise Verbs
+        FromEnvironment,
+        /// The Infiniband device
+        Verbs,
+        /// A software device, see emulated::Fabric. Connects processes on the same host only
+        Emulated,
+    };
+
     /// Abstracts a global rdma context
     class Network {
         friend class QueuePair;
@@ -27,25 +46,38 @@ namespace rdma {
         /// The port of the Infiniband device
         static constexpr uint8_t ibport = 1;
 
-        /// The Infiniband devices
-        ibv::device::DeviceList devices;
+        /// The Infiniband devices, only for the Verbs backend
+        std::unique_ptr<ibv::device::DeviceList> devices;
         /// The verbs context
         std::unique_ptr<ibv::context::Context> context;
         /// The global protection domain
         std::unique_ptr<ibv::protectiondomain::ProtectionDomain> protectionDomain;
+        /// Replaces all of the above for the Emulated backend
+        std::unique_ptr<emulated::Fabric> fabric;
 
         /// Shared Queues
         CompletionQueuePair sharedCompletionQueuePair;
 
         std::unique_ptr<ibv::srq::SharedReceiveQueue> sharedReceiveQueue;
+        std::unique_ptr<emulated::SharedReceiveQueue> emulatedReceiveQueue;
+
+        /// The emulation has no GIDs, so the GID of its port is the NodeAddress of the fabric
+        static ibv::Gid gidOf(emulated::NodeAddress node);
+
+        static emulated::NodeAddress nodeOf(const ibv::Gid &gid);
 
     public:
-        Network();
+        explicit Network(Backend backend = Backend::FromEnvironment);
+
+        /// Whether there is exactly one Infiniband device, which we can open, as the Verbs backend needs it
+        static bool hasDevice();
+
+        bool isEmulated() const;
 
         /// Get the LID
         uint16_t getLID();
 
-        /// Get the GID
+        /// Get the GID, which also addresses the emulated fabric
         ibv::Gid getGID();
 
         /// Print the capabilities of the RDMA host channel adapter
@@ -56,9 +88,9 @@ namespace rdma {
         CompletionQueuePair &getSharedCompletionQueue();
 
         /// Register a new MemoryRegion
-        std::unique_ptr<ibv::memoryregion::MemoryRegion>
-        registerMr(void *addr, size_t length, std::initializer_list<ibv::AccessFlag> flags);
+        MemoryRegion registerMr(void *addr, size_t length, std::initializer_list<ibv::AccessFlag> flags);
 
+        /// Throws for the Emulated backend, which has none
         ibv::protectiondomain::ProtectionDomain& getProtectionDomain();
     };
 }
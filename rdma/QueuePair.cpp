@@ -1,21 +1,38 @@
 #include "QueuePair.hpp"
 #include "Network.hpp"
+#include "NetworkException.h"
 #include <iomanip>
 
 using namespace std;
 namespace rdma {
     QueuePair::QueuePair(Network &network, ibv::queuepair::Type type)
-            : QueuePair(network, type, network.sharedCompletionQueuePair, *network.sharedReceiveQueue) {}
+            : QueuePair(network, type, network.sharedCompletionQueuePair, network.sharedReceiveQueue.get()) {}
 
     QueuePair::QueuePair(Network &network, ibv::queuepair::Type type, ibv::srq::SharedReceiveQueue &receiveQueue)
-            : QueuePair(network, type, network.sharedCompletionQueuePair, receiveQueue) {}
+            : QueuePair(network, type, network.sharedCompletionQueuePair, &receiveQueue) {}
 
     QueuePair::QueuePair(Network &network, ibv::queuepair::Type type, CompletionQueuePair &completionQueuePair)
-            : QueuePair(network, type, completionQueuePair, *network.sharedReceiveQueue) {}
+            : QueuePair(network, type, completionQueuePair, network.sharedReceiveQueue.get()) {}
 
     QueuePair::QueuePair(Network &network, ibv::queuepair::Type type, CompletionQueuePair &completionQueuePair,
                          ibv::srq::SharedReceiveQueue &receiveQueue)
+            : QueuePair(network, type, completionQueuePair, &receiveQueue) {}
+
+    QueuePair::QueuePair(Network &network, ibv::queuepair::Type type, CompletionQueuePair &completionQueuePair,
+                         ibv::srq::SharedReceiveQueue *receiveQueue)
             : defaultPort(network.ibport), receiveQueue(receiveQueue) {
+        if (network.fabric) {
+            if (type == ibv::queuepair::Type::UD) {
+                throw NetworkException("the emulation only supports connected queue pairs");
+            }
+            // the emulation only has the network's receive queue
+            emulatedReceiveQueue = network.emulatedReceiveQueue.get();
+            emulatedQp = network.fabric->createQueuePair(completionQueuePair.getEmulatedSendQueue(),
+                                                         completionQueuePair.getEmulatedReceiveQueue(),
+                                                         *emulatedReceiveQueue);
+            return;
+        }
+
         ibv::queuepair::InitAttributes queuePairAttributes{};
         queuePairAttributes.setContext(context);
         // CQ to be associated with the Send Queue (SQ)
@@ -23,7 +40,7 @@ namespace rdma {
         // CQ to be associated with the Receive Queue (RQ)
         queuePairAttributes.setRecvCompletionQueue(completionQueuePair.getReceiveQueue());
         // SRQ handle if QP is to be associated with an SRQ, otherwise NULL
-        queuePairAttributes.setSharedReceiveQueue(receiveQueue);
+        queuePairAttributes.setSharedReceiveQueue(*receiveQueue);
         ibv::queuepair::Capabilities capabilities{};
         capabilities.setMaxSendWr(maxOutstandingSendWrs);
         capabilities.setMaxRecvWr(maxOutstandingRecvWrs);
@@ -38,18 +55,37 @@ namespace rdma {
         qp = network.protectionDomain->createQueuePair(queuePairAttributes);
     }
 
+    bool QueuePair::connectEmulated(const Address &address) {
+        if (not emulatedQp) {
+            return false;
+        }
+        emulatedQp->connect(Network::nodeOf(address.gid), address.qpn);
+        return true;
+    }
+
     uint32_t QueuePair::getQPN() {
+        if (emulatedQp) {
+            return emulatedQp->getQPN();
+        }
         return qp->getNum();
     }
 
     void QueuePair::postWorkRequest(ibv::workrequest::SendWr &workRequest) {
+        if (emulatedQp) {
+            emulatedQp->postSend(workRequest);
+            return;
+        }
         ibv::workrequest::SendWr *badWorkRequest = nullptr;
         qp->postSend(workRequest, badWorkRequest);
     }
 
     void QueuePair::postRecvRequest(ibv::workrequest::Recv &recvRequest) {
+        if (emulatedReceiveQueue != nullptr) {
+            emulatedReceiveQueue->postRecv(recvRequest);
+            return;
+        }
         ibv::workrequest::Recv *badWorkRequest = nullptr;
-        receiveQueue.postRecv(recvRequest, badWorkRequest);
+        receiveQueue->postRecv(recvRequest, badWorkRequest);
     }
 
     namespace { // Anonymous helper namespace
@@ -68,6 +104,11 @@ namespace rdma {
     void QueuePair::printQueuePairDetails() const {
         using Mask = ibv::queuepair::AttrMask;
 
+        if (emulatedQp) {
+            cout << "[State of emulated QP " << emulatedQp->getQPN() << "]" << endl;
+            return;
+        }
+
         auto attr = qp->query({Mask::STATE, Mask::CUR_STATE, Mask::EN_SQD_ASYNC_NOTIFY, Mask::ACCESS_FLAGS,
                                Mask::PKEY_INDEX, Mask::PORT, Mask::QKEY, Mask::AV, Mask::PATH_MTU, Mask::TIMEOUT,
                                Mask::RETRY_CNT, Mask::RNR_RETRY, Mask::RQ_PSN, Mask::MAX_QP_RD_ATOMIC, Mask::ALT_PATH,
@@ -107,5 +148,14 @@ namespace rdma {
         return maxInlineSize;
     }
 
+    uint32_t QueuePair::getMaxSendWrs() const {
+        if (emulatedQp) {
+            // the emulation queues any number of work requests
+            return maxOutstandingSendWrs;
+        }
+        const auto attr = qp->query({ibv::queuepair::AttrMask::CAP});
+        return attr.getCap().getMaxSendWr();
+    }
+
     QueuePair::~QueuePair() = default;
 } // End of namespace rdma
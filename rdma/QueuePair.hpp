@@ -24,7 +24,12 @@ namespace rdma {
 
         std::unique_ptr<ibv::queuepair::QueuePair> qp;
 
-        ibv::srq::SharedReceiveQueue &receiveQueue;
+        ibv::srq::SharedReceiveQueue *receiveQueue;
+
+        /// Replace the above, when the Network is emulated
+        std::unique_ptr<emulated::QueuePair> emulatedQp;
+
+        emulated::SharedReceiveQueue *emulatedReceiveQueue = nullptr;
 
         // Uses shared completion and receive Queue
         QueuePair(Network &network, ibv::queuepair::Type type);
@@ -38,6 +43,13 @@ namespace rdma {
         QueuePair(Network &network, ibv::queuepair::Type type, CompletionQueuePair &completionQueuePair,
                   ibv::srq::SharedReceiveQueue &receiveQueue);
 
+        /// Connect the emulated queue pair, like a reliable connection. Returns false, if this one is a device's
+        bool connectEmulated(const Address &address);
+
+    private:
+        QueuePair(Network &network, ibv::queuepair::Type type, CompletionQueuePair &completionQueuePair,
+                  ibv::srq::SharedReceiveQueue *receiveQueue);
+
     public:
         virtual ~QueuePair();
 
@@ -53,6 +65,9 @@ namespace rdma {
 
         uint32_t getMaxInlineSize() const;
 
+        /// The capacity of the send queue, as created by the device, which might round up the requested one
+        uint32_t getMaxSendWrs() const;
+
         /// Print detailed information about this queue pair
         void printQueuePairDetails() const;
     };
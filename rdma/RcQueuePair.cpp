@@ -5,6 +5,10 @@ void rdma::RcQueuePair::connect(const Address &address) {
 }
 
 void rdma::RcQueuePair::connect(const Address &address, uint8_t port, uint8_t retryCount) {
+    if (connectEmulated(address)) {
+        return;
+    }
+
     using Access = ibv::AccessFlag;
     using Mod = ibv::queuepair::AttrMask;
 
@@ -0,0 +1,57 @@
+#include "SelectiveSignaling.h"
+#include "NetworkException.h"
+#include <algorithm>
+
+using namespace std;
+namespace rdma {
+    SelectiveSignaling::SelectiveSignaling(CompletionQueuePair &completionQueue, uint64_t wrId, uint32_t depth,
+                                           uint32_t watermark) :
+            completionQueue(completionQueue),
+            wrId(wrId),
+            depth(depth),
+            watermark(clamp<uint64_t>(watermark == 0 ? depth / 4 : watermark, 1, max<uint64_t>(depth / 2, 1))) {
+        if (depth < 2) {
+            throw NetworkException("send queue too small for selective signaling");
+        }
+        // on a reliable connection, completions arrive in the order the work requests were posted
+        completionQueue.setSendHandler(wrId, [this](const ibv::workcompletion::WorkCompletion &) {
+            confirmed = signaled.front();
+            signaled.pop_front();
+            this->completionQueue.releaseSendCompletion();
+        });
+    }
+
+    SelectiveSignaling::~SelectiveSignaling() {
+        // nobody would ever poll the completions still in flight, they release their reservation, when they arrive
+        completionQueue.discardSendCompletions(wrId, signaled.size());
+    }
+
+    void SelectiveSignaling::reap() {
+        // the queue might be full of other queue pairs' completions, even if none of ours is in flight
+        if (completionQueue.hasReservedSendCompletions()) {
+            completionQueue.dispatchSendCompletions();
+        }
+    }
+
+    bool SelectiveSignaling::prepare(uint32_t count) {
+        if (count > depth / 2) {
+            throw NetworkException("too many work requests at once for the send queue");
+        }
+        reap();
+        const auto signal = sinceSignaled + count >= watermark;
+        // only signaled work requests free the queue. There always is one in flight, when the queue is this full
+        while (posted + count - confirmed > depth ||
+               (signal && (signaled.size() >= MAX_SIGNALED || not completionQueue.reserveSendCompletion()))) {
+            reap();
+        }
+
+        posted += count;
+        if (not signal) {
+            sinceSignaled += count;
+            return false;
+        }
+        sinceSignaled = 0;
+        signaled.push_back(posted);
+        return true;
+    }
+} // End of namespace rdma
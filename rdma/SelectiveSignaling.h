@@ -0,0 +1,63 @@
+#ifndef L5RDMA_SELECTIVESIGNALING_H
+#define L5RDMA_SELECTIVESIGNALING_H
+
+#include <cstdint>
+#include <deque>
+#include "CompletionQueuePair.hpp"
+
+namespace rdma {
+    /**
+     * Decides, which send work requests of a queue pair are signaled. The completion of a signaled work request also
+     * confirms all unsignaled ones posted before it, so it's enough to signal every watermark-th one, as long as there
+     * are never more unconfirmed work requests than the send queue holds.
+     * Completions are reaped with non-blocking polls, while posting. Only when the send queue is full, the sender
+     * busy polls until a completion arrives, it never waits for a completion event, which is a syscall.
+     * Each signaled work request reserves room in the completion queue first, so many queue pairs can share one
+     * completion queue without overrunning it. Reaping polls the whole queue, so it also frees the room of the others.
+     */
+    class SelectiveSignaling {
+        /// Signaled work requests in flight at most, independent of the watermark and the completion queue
+        static constexpr size_t MAX_SIGNALED = 16;
+
+        CompletionQueuePair &completionQueue;
+        /// The wr_id of signaled work requests, their completions are dispatched to this
+        const uint64_t wrId;
+        /// Work requests, that fit into the send queue
+        const uint64_t depth;
+        /// Signal after this many work requests
+        const uint64_t watermark;
+
+        /// All work requests posted, and confirmed by a completion so far
+        uint64_t posted = 0;
+        uint64_t confirmed = 0;
+        uint64_t sinceSignaled = 0;
+        /// For each signaled work request without completion yet: posted, including itself
+        std::deque<uint64_t> signaled;
+
+        void reap();
+
+    public:
+        /// depth is the capacity of the send queue, e.g. QueuePair::getMaxSendWrs(). watermark defaults to a
+        /// quarter of it, and is at most half of it, so the queue never runs full while the signaled work request
+        /// is in flight
+        SelectiveSignaling(CompletionQueuePair &completionQueue, uint64_t wrId, uint32_t depth,
+                           uint32_t watermark = 0);
+
+        ~SelectiveSignaling();
+
+        SelectiveSignaling(const SelectiveSignaling &) = delete;
+
+        SelectiveSignaling &operator=(const SelectiveSignaling &) = delete;
+
+        /// Make room for count work requests, which are posted next. Returns, whether the last of them needs to be
+        /// signaled, with getWrId()
+        bool prepare(uint32_t count = 1);
+
+        uint64_t getWrId() const { return wrId; }
+
+        /// Work requests posted, but not confirmed by a completion yet
+        uint64_t outstanding() const { return posted - confirmed; }
+    };
+} // End of namespace rdma
+
+#endif //L5RDMA_SELECTIVESIGNALING_H
@@ -5,6 +5,10 @@ void rdma::UcQueuePair::connect(const Address &address) {
 }
 
 void rdma::UcQueuePair::connect(const Address &address, uint8_t port) {
+    if (connectEmulated(address)) {
+        return;
+    }
+
     using Access = ibv::AccessFlag;
     using Mod = ibv::queuepair::AttrMask;
 
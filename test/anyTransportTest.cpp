@@ -0,0 +1,60 @@
+#include "include/AnyTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t MESSAGES = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+void testAny(AnyTransportServer &server, AnyTransportClient &client, const std::string &connection) {
+    auto serverDone = std::async(std::launch::async, [&]() {
+        server.accept();
+        // locked in to the concrete transport
+        server.visit([](auto &transport) {
+            for (size_t i = 0; i < MESSAGES; ++i) {
+                size_t message;
+                transport.read(message);
+                if (message != i) {
+                    throw std::runtime_error{"received unexpected data"};
+                }
+                transport.write(message);
+            }
+        });
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        client.connect(connection);
+        // dispatched per call
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            client.write(i);
+            size_t answer;
+            client.read(answer);
+            if (answer != i) {
+                throw std::runtime_error{"received unexpected answer"};
+            }
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    {
+        auto server = AnyTransportServer::make<DomainSocketsTransportServer>("/tmp/anyTransportTest");
+        auto client = AnyTransportClient(make_transportClient<DomainSocketsTransportClient>());
+        if (not server.holds<DomainSocketsTransportServer>() || not client.holds<DomainSocketsTransportClient>()) {
+            throw std::runtime_error{"holds the wrong transport"};
+        }
+        testAny(server, client, "ipc:/tmp/anyTransportTest");
+    }
+    {
+        auto server = AnyTransportServer::make<SharedMemoryTransportServer<>>("/tmp/anyTransportTest");
+        auto client = AnyTransportClient::make<SharedMemoryTransportClient<>>();
+        testAny(server, client, "shm:/tmp/anyTransportTest");
+    }
+    return 0;
+}
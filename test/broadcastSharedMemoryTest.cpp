@@ -0,0 +1,123 @@
+#include "include/BroadcastSharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::LaggingReaders;
+
+const size_t CLIENTS = 4;
+const size_t MESSAGES = 64 * 1024;
+const size_t BUFFER_SIZE = 64 * 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// every client needs to see every message in order
+void testBroadcast() {
+    auto server = BroadcastSharedMemoryTransportServer("/tmp/broadcastTest", BUFFER_SIZE);
+
+    std::vector<std::future<void>> clientsDone;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        clientsDone.push_back(std::async(std::launch::async, []() {
+            auto client = BroadcastSharedMemoryTransportClient();
+            client.connect("/tmp/broadcastTest");
+            for (size_t i = 0; i < MESSAGES; ++i) {
+                size_t received;
+                client.read(received);
+                if (received != i) {
+                    throw std::runtime_error{"received unexpected data"};
+                }
+            }
+        }));
+    }
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        server.accept();
+    }
+    server.finishListen();
+
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            server.write(i);
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientsDone, deadline);
+}
+
+/// a client that doesn't read must not block the server, but notice that it was dropped
+void testDropLagging() {
+    auto server = BroadcastSharedMemoryTransportServer("/tmp/broadcastTest", BUFFER_SIZE, LaggingReaders::Drop);
+    auto client = BroadcastSharedMemoryTransportClient();
+    const auto connected = std::async(std::launch::async, [&]() { client.connect("/tmp/broadcastTest"); });
+    server.accept();
+    server.finishListen();
+    connected.wait();
+
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            server.write(i);
+        }
+    });
+    waitOrDie(serverDone, deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS)));
+
+    size_t received;
+    try {
+        client.read(received);
+    } catch (const std::runtime_error &) {
+        return;
+    }
+    throw std::runtime_error{"lagging client wasn't dropped"};
+}
+
+/// a dropped client keeps its slot until it detaches, so a new client can't lose its slot to the dropped one
+void testDroppedKeepsSlot() {
+    auto server = BroadcastSharedMemoryTransportServer("/tmp/broadcastTest", BUFFER_SIZE, LaggingReaders::Drop);
+    const auto connect = [&](BroadcastSharedMemoryTransportClient &client) {
+        const auto connected = std::async(std::launch::async, [&]() { client.connect("/tmp/broadcastTest"); });
+        server.accept();
+        connected.wait();
+    };
+    const auto overrun = [&]() {
+        for (size_t i = 0; i < BUFFER_SIZE / sizeof(size_t); ++i) {
+            server.write(i);
+        }
+    };
+    const auto isDropped = [](BroadcastSharedMemoryTransportClient &client) {
+        size_t received;
+        try {
+            client.read(received);
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    };
+
+    auto newClient = BroadcastSharedMemoryTransportClient();
+    {
+        auto droppedClient = BroadcastSharedMemoryTransportClient();
+        connect(droppedClient);
+        overrun();
+        connect(newClient);
+        if (not isDropped(droppedClient)) {
+            throw std::runtime_error{"lagging client wasn't dropped"};
+        }
+    }
+    server.finishListen();
+
+    // the writer still needs to track the new client after the dropped one detached
+    overrun();
+    if (not isDropped(newClient)) {
+        throw std::runtime_error{"new client lost its slot"};
+    }
+}
+
+int main() {
+    testBroadcast();
+    testDropLagging();
+    // with a stolen slot, the dropped client would wait for data forever
+    runWithTimeout(std::chrono::seconds(TIMEOUT_IN_SECONDS), testDroppedKeepsSlot);
+    return 0;
+}
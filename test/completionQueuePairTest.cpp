@@ -0,0 +1,140 @@
+#include "rdma/CompletionQueuePair.hpp"
+#include "rdma/Network.hpp"
+#include "rdma/RcQueuePair.h"
+#include "rdma/SelectiveSignaling.h"
+#include "test/testHelpers.h"
+#include <atomic>
+#include <future>
+#include <thread>
+
+using namespace std;
+using Perm = ibv::AccessFlag;
+
+const size_t ROUNDS = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+const uint64_t handledId = 1;
+const uint64_t readId = 42;
+const uint64_t firstCachedId = 100;
+const uint64_t signalingId = 7;
+
+void require(bool condition, const string &what) {
+    if (not condition) {
+        throw runtime_error{what};
+    }
+}
+
+/// Two connected queue pairs of the emulation. The first one has its own completion queue, which the tests share
+struct Connection {
+    rdma::Network network{rdma::Backend::Emulated};
+    rdma::CompletionQueuePair completionQueue = network.newCompletionQueuePair();
+    rdma::RcQueuePair local{network, completionQueue};
+    rdma::RcQueuePair remote{network};
+    uint64_t localValue = 0;
+    uint64_t remoteValue = 0;
+    rdma::MemoryRegion localMr = network.registerMr(&localValue, sizeof(localValue), {Perm::LOCAL_WRITE});
+    rdma::MemoryRegion remoteMr = network.registerMr(&remoteValue, sizeof(remoteValue),
+                                                     {Perm::REMOTE_WRITE, Perm::REMOTE_READ});
+
+    Connection() {
+        local.connect(rdma::Address{network.getGID(), remote.getQPN(), network.getLID()});
+        remote.connect(rdma::Address{network.getGID(), local.getQPN(), network.getLID()});
+    }
+
+    void write(uint64_t wrId) {
+        ibv::workrequest::Simple<ibv::workrequest::Write> wr;
+        wr.setLocalAddress(localMr->getSlice());
+        wr.setRemoteAddress(remoteMr->getRemoteAddress());
+        wr.setSignaled();
+        wr.setId(wrId);
+        local.postWorkRequest(wr);
+    }
+
+    void read() {
+        ibv::workrequest::Simple<ibv::workrequest::Read> wr;
+        wr.setLocalAddress(localMr->getSlice());
+        wr.setRemoteAddress(remoteMr->getRemoteAddress());
+        wr.setSignaled();
+        wr.setId(readId);
+        local.postWorkRequest(wr);
+    }
+};
+
+/// Handled, cached and waited for completions interleaved on one queue, while another thread dispatches. Each one
+/// needs to end up where it belongs, none may get lost
+void testDemultiplexing() {
+    auto connection = Connection();
+    auto &completionQueue = connection.completionQueue;
+    size_t handled = 0;
+    completionQueue.setSendHandler(handledId, [&](const auto &completion) {
+        require(completion.getOpcode() == ibv::workcompletion::Opcode::RDMA_WRITE, "unexpected handled completion");
+        ++handled;
+    });
+
+    atomic<bool> done = false;
+    auto dispatcher = async(launch::async, [&] {
+        while (not done) {
+            completionQueue.dispatchSendCompletions();
+            this_thread::yield();
+        }
+    });
+
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        connection.write(handledId);
+        connection.write(firstCachedId + i);
+        connection.remoteValue = i;
+        connection.read();
+        // the dispatcher might poll the read's completion, it still needs to arrive here
+        const auto completion = completionQueue.waitForSendCompletion(readId);
+        require(completion.getOpcode() == ibv::workcompletion::Opcode::RDMA_READ, "unexpected read completion");
+        require(connection.localValue == i, "read didn't arrive");
+        // the completions without handler stay cached, in order
+        require(completionQueue.pollSendCompletionQueue() == firstCachedId + i, "lost a cached completion");
+    }
+    done = true;
+    dispatcher.get();
+
+    completionQueue.dispatchSendCompletions();
+    require(handled == ROUNDS, "lost a handled completion");
+    require(completionQueue.pollSendCompletionQueue() == numeric_limits<uint64_t>::max(), "unexpected completion");
+}
+
+/// Waiting for a completion must not block the other users of the queue until it arrives
+void testWaitDoesNotBlock() {
+    auto connection = Connection();
+    auto &completionQueue = connection.completionQueue;
+    auto waiting = async(launch::async, [&] { return completionQueue.waitForSendCompletion(readId); });
+    this_thread::sleep_for(chrono::milliseconds(10));
+
+    // the read isn't posted yet, so this only returns, if the waiting thread lets go of the queue
+    completionQueue.setSendHandler(handledId, [](const auto &) {});
+    completionQueue.dispatchSendCompletions();
+    completionQueue.removeSendHandler(handledId);
+
+    connection.read();
+    require(waiting.get().getId() == readId, "unexpected completion");
+}
+
+/// The completions of a closed queue pair, that are still in flight, must neither pile up in the cache, nor keep their
+/// room in the queue reserved
+void testDiscardClosed() {
+    auto connection = Connection();
+    auto &completionQueue = connection.completionQueue;
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        auto signaling = rdma::SelectiveSignaling(completionQueue, signalingId, connection.local.getMaxSendWrs(), 1);
+        for (size_t j = 0; j < 4; ++j) {
+            require(signaling.prepare(), "every write should be signaled");
+            connection.write(signalingId);
+        }
+        require(signaling.outstanding() > 0, "no completion in flight when closing");
+    }
+    completionQueue.dispatchSendCompletions();
+    require(completionQueue.pollSendCompletionQueue() == numeric_limits<uint64_t>::max(), "completion wasn't dropped");
+    require(not completionQueue.hasReservedSendCompletions(), "dropped completion still reserved");
+}
+
+int main() {
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testDemultiplexing);
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testWaitDoesNotBlock);
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testDiscardClosed);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "util/copy.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using namespace l5::util;
+
+int main() {
+    std::vector<uint8_t> src(1024 * 1024 + 128);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    std::vector<uint8_t> dest(src.size());
+
+    for (auto kernel : {CopyKernel::Std, CopyKernel::SSE2, CopyKernel::AVX2, CopyKernel::AVX512}) {
+        if (not isSupported(kernel)) continue;
+        setCopyKernel(kernel);
+        for (auto threshold : {SIZE_MAX, size_t(0)}) {
+            setNonTemporalThreshold(threshold);
+            for (size_t size : {0, 1, 63, 255, 256, 257, 4096, 12345, 1024 * 1024}) {
+                for (size_t offset : {0, 1, 17, 64}) {
+                    std::fill(dest.begin(), dest.end(), 0);
+                    const auto begin = src.data() + offset;
+                    const auto end = copyBytes(begin, begin + size, dest.data() + offset + 3);
+                    if (end != dest.data() + offset + 3 + size ||
+                        not std::equal(begin, begin + size, dest.data() + offset + 3) ||
+                        dest[offset + 2] != 0 || dest[offset + 3 + size] != 0) {
+                        std::cerr << "copy failed: " << to_string(kernel) << ", size " << size << ", offset "
+                                  << offset << ", threshold " << threshold << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
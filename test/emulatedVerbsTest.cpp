@@ -0,0 +1,157 @@
+#include "rdma/EmulatedVerbs.h"
+#include "test/testHelpers.h"
+#include <algorithm>
+#include <future>
+#include <vector>
+
+using namespace std;
+using namespace rdma::emulated;
+
+const size_t ROUNDS = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+const int ACCESS = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
+
+void require(bool condition, const string &what) {
+    if (not condition) {
+        throw runtime_error{what};
+    }
+}
+
+ibv_wc pollBlocking(CompletionQueue &queue) {
+    ibv_wc completion{};
+    while (queue.poll(1, &completion) == 0) {
+        this_thread::yield();
+    }
+    return completion;
+}
+
+/// Two connected queue pairs with their own queues and a registered buffer each
+struct Endpoints {
+    Fabric fabric;
+    unique_ptr<CompletionQueue> sendQueues[2];
+    unique_ptr<CompletionQueue> receiveQueues[2];
+    unique_ptr<SharedReceiveQueue> receives[2];
+    unique_ptr<QueuePair> qps[2];
+    vector<uint8_t> buffers[2];
+    unique_ptr<MemoryRegion> mrs[2];
+
+    explicit Endpoints(LinkModel model) : fabric(model) {
+        for (size_t i = 0; i < 2; ++i) {
+            sendQueues[i] = fabric.createCompletionQueue();
+            receiveQueues[i] = fabric.createCompletionQueue();
+            receives[i] = fabric.createSrq();
+            qps[i] = fabric.createQueuePair(*sendQueues[i], *receiveQueues[i], *receives[i]);
+            buffers[i].resize(1024 * 1024);
+            mrs[i] = fabric.registerMr(buffers[i].data(), buffers[i].size(), ACCESS);
+        }
+        qps[0]->connect(qps[1]->getQPN());
+        qps[1]->connect(qps[0]->getQPN());
+    }
+
+    /// A signaled work request from 0 to 1, at offset in both buffers
+    ibv_wc post(ibv_wr_opcode opcode, size_t offset, size_t size, uint32_t rkey = 0) {
+        ibv_sge sge{reinterpret_cast<uintptr_t>(&buffers[0][offset]), static_cast<uint32_t>(size), mrs[0]->getLkey()};
+        ibv_send_wr wr{};
+        wr.wr_id = offset;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        wr.opcode = opcode;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        wr.imm_data = 42;
+        wr.wr.rdma.remote_addr = reinterpret_cast<uintptr_t>(&buffers[1][offset]);
+        wr.wr.rdma.rkey = rkey != 0 ? rkey : mrs[1]->getRkey();
+        qps[0]->postSend(wr);
+        return pollBlocking(*sendQueues[0]);
+    }
+
+    void postReceive(size_t offset, size_t size) {
+        ibv_sge sge{reinterpret_cast<uintptr_t>(&buffers[1][offset]), static_cast<uint32_t>(size), mrs[1]->getLkey()};
+        ibv_recv_wr wr{};
+        wr.wr_id = offset;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        receives[1]->postRecv(wr);
+    }
+};
+
+void testOperations() {
+    auto endpoints = Endpoints(LinkModel{});
+    auto &[local, remote] = endpoints.buffers;
+
+    fill(local.begin(), local.begin() + 100, 1);
+    auto completion = endpoints.post(IBV_WR_RDMA_WRITE, 0, 100);
+    require(completion.status == IBV_WC_SUCCESS && completion.opcode == IBV_WC_RDMA_WRITE, "write failed");
+    require(all_of(remote.begin(), remote.begin() + 100, [](uint8_t b) { return b == 1; }), "write didn't arrive");
+
+    fill(remote.begin() + 200, remote.begin() + 300, 2);
+    completion = endpoints.post(IBV_WR_RDMA_READ, 200, 100);
+    require(completion.status == IBV_WC_SUCCESS && completion.opcode == IBV_WC_RDMA_READ, "read failed");
+    require(all_of(local.begin() + 200, local.begin() + 300, [](uint8_t b) { return b == 2; }), "read didn't arrive");
+
+    // the send waits for the receive, like with an infinite RNR retry count
+    fill(local.begin() + 400, local.begin() + 450, 3);
+    auto sent = async(launch::async, [&] { return endpoints.post(IBV_WR_SEND, 400, 50); });
+    this_thread::sleep_for(chrono::milliseconds(10));
+    endpoints.postReceive(400, 64);
+    require(sent.get().status == IBV_WC_SUCCESS, "send failed");
+    completion = pollBlocking(*endpoints.receiveQueues[1]);
+    require(completion.opcode == IBV_WC_RECV && completion.byte_len == 50 && completion.wr_id == 400,
+            "unexpected receive completion");
+    require(all_of(remote.begin() + 400, remote.begin() + 450, [](uint8_t b) { return b == 3; }), "send didn't arrive");
+
+    endpoints.postReceive(0, 0);
+    completion = endpoints.post(IBV_WR_RDMA_WRITE_WITH_IMM, 500, 10);
+    require(completion.status == IBV_WC_SUCCESS, "write with immediate failed");
+    completion = pollBlocking(*endpoints.receiveQueues[1]);
+    require(completion.opcode == IBV_WC_RECV_RDMA_WITH_IMM && completion.imm_data == 42 &&
+            (completion.wc_flags & IBV_WC_WITH_IMM) != 0, "unexpected immediate completion");
+
+    // an invalid rkey breaks the connection, later requests are flushed
+    completion = endpoints.post(IBV_WR_RDMA_WRITE, 0, 10, 12345);
+    require(completion.status == IBV_WC_REM_ACCESS_ERR, "invalid rkey wasn't detected");
+    completion = endpoints.post(IBV_WR_RDMA_WRITE, 0, 10);
+    require(completion.status == IBV_WC_WR_FLUSH_ERR, "request after an error wasn't flushed");
+}
+
+void testLinkModel() {
+    const auto model = LinkModel{chrono::milliseconds(5), 100e6};
+    auto endpoints = Endpoints(model);
+    const auto start = chrono::steady_clock::now();
+    // 5ms latency + 1MB at 100MB/s
+    endpoints.post(IBV_WR_RDMA_WRITE, 0, 1024 * 1024);
+    require(chrono::steady_clock::now() - start >= chrono::milliseconds(15), "completed faster than the link allows");
+}
+
+/// Ping pong with writes with immediate, each side answers as soon as it receives
+void testPingPong() {
+    auto endpoints = Endpoints(LinkModel{});
+    auto pong = async(launch::async, [&] {
+        for (size_t i = 0; i < ROUNDS; ++i) {
+            endpoints.postReceive(0, 0);
+            const auto completion = pollBlocking(*endpoints.receiveQueues[1]);
+            require(completion.imm_data == i, "received unexpected ping");
+            ibv_send_wr wr{};
+            wr.opcode = IBV_WR_SEND_WITH_IMM;
+            wr.imm_data = static_cast<uint32_t>(i);
+            endpoints.qps[1]->postSend(wr);
+        }
+    });
+    for (size_t i = 0; i < ROUNDS; ++i) {
+        ibv_recv_wr receive{};
+        endpoints.receives[0]->postRecv(receive);
+        ibv_send_wr wr{};
+        wr.opcode = IBV_WR_SEND_WITH_IMM;
+        wr.imm_data = static_cast<uint32_t>(i);
+        endpoints.qps[0]->postSend(wr);
+        const auto completion = pollBlocking(*endpoints.receiveQueues[0]);
+        require(completion.imm_data == i, "received unexpected pong");
+    }
+    waitOrDie(pong, deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS)));
+}
+
+int main() {
+    testOperations();
+    testLinkModel();
+    testPingPong();
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "include/DomainSocketsTransport.h"
+#include "include/SharedMemoryTransport.h"
+#include "include/TcpTransport.h"
+#include "util/eventLoop.h"
+#include "test/testHelpers.h"
+#include <memory>
+#include <numeric>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::util::EventLoop;
+
+const size_t MESSAGES = 1024;
+const size_t TIMEOUT_IN_SECONDS = 10;
+/// Much larger than any socket buffer
+const size_t LARGE_SIZE = 16 * 1024 * 1024;
+
+/// Ping pong between both ends of a connection, driven by callbacks instead of threads
+template<typename Server, typename Client>
+struct Echo {
+    Server &server;
+    Client &client;
+    EventLoop &loop;
+    size_t ping = 0;
+    size_t serverReceived = 0;
+    size_t pong = 0;
+    size_t completed = 0;
+
+    void start() {
+        loop.read(server, serverReceived, [this] { serve(); });
+        sendPing();
+    }
+
+    void sendPing() {
+        loop.write(client, ping, [this] {
+            loop.read(client, pong, [this] { receivePong(); });
+        });
+    }
+
+    void serve() {
+        loop.write(server, serverReceived, [this] {
+            if (serverReceived + 1 < MESSAGES) {
+                loop.read(server, serverReceived, [this] { serve(); });
+            }
+        });
+    }
+
+    void receivePong() {
+        if (pong != ping) {
+            throw std::runtime_error{"received unexpected answer"};
+        }
+        ++completed;
+        if (++ping < MESSAGES) {
+            sendPing();
+        }
+    }
+};
+
+/// Both ends write more than fits into the socket buffers at the same time, before either reads. Only completes, if
+/// the loop never blocks in a write
+template<typename Server, typename Client>
+struct LargeExchange {
+    Server &server;
+    Client &client;
+    EventLoop &loop;
+    std::vector<uint8_t> request = std::vector<uint8_t>(LARGE_SIZE);
+    std::vector<uint8_t> answer = std::vector<uint8_t>(LARGE_SIZE, uint8_t(7));
+    std::vector<uint8_t> receivedRequest = std::vector<uint8_t>(LARGE_SIZE);
+    std::vector<uint8_t> receivedAnswer = std::vector<uint8_t>(LARGE_SIZE);
+    size_t completed = 0;
+
+    void start() {
+        std::iota(request.begin(), request.end(), uint8_t(0));
+        loop.write(client, request.data(), request.size(), [this] { ++completed; });
+        loop.write(server, answer.data(), answer.size(), [this] { ++completed; });
+        loop.read(server, receivedRequest.data(), receivedRequest.size(), [this] { ++completed; });
+        loop.read(client, receivedAnswer.data(), receivedAnswer.size(), [this] { ++completed; });
+    }
+
+    void check() const {
+        if (completed != 4 || receivedRequest != request || receivedAnswer != answer) {
+            throw std::runtime_error{"large exchange incomplete"};
+        }
+    }
+};
+
+void testLargeWrites() {
+    EventLoop loop;
+
+    auto tcpServer = TcpTransportServer("4715");
+    auto tcpClient = TcpTransportClient();
+    connectPair(tcpServer, tcpClient, "127.0.0.1:4715");
+    auto domainServer = DomainSocketsTransportServer("/tmp/eventLoopTestLarge");
+    auto domainClient = DomainSocketsTransportClient();
+    connectPair(domainServer, domainClient, "ipc:/tmp/eventLoopTestLarge");
+
+    auto tcpExchange = LargeExchange<TcpTransportServer, TcpTransportClient>{tcpServer, tcpClient, loop};
+    auto domainExchange = LargeExchange<DomainSocketsTransportServer, DomainSocketsTransportClient>{domainServer,
+                                                                                                 domainClient, loop};
+    tcpExchange.start();
+    domainExchange.start();
+    loop.run();
+    tcpExchange.check();
+    domainExchange.check();
+}
+
+void testEcho() {
+    EventLoop loop;
+
+    auto shmServers = std::vector<std::unique_ptr<SharedMemoryTransportServer<64 * 1024>>>();
+    auto shmClients = std::vector<std::unique_ptr<SharedMemoryTransportClient<64 * 1024>>>();
+    auto domainServers = std::vector<std::unique_ptr<DomainSocketsTransportServer>>();
+    auto domainClients = std::vector<std::unique_ptr<DomainSocketsTransportClient>>();
+    for (size_t i = 0; i < 4; ++i) {
+        const auto name = "/tmp/eventLoopTest" + std::to_string(i);
+        shmServers.push_back(std::make_unique<SharedMemoryTransportServer<64 * 1024>>(name + "shm"));
+        shmClients.push_back(std::make_unique<SharedMemoryTransportClient<64 * 1024>>());
+        connectPair(*shmServers.back(), *shmClients.back(), "shm:" + name + "shm");
+        domainServers.push_back(std::make_unique<DomainSocketsTransportServer>(name));
+        domainClients.push_back(std::make_unique<DomainSocketsTransportClient>());
+        connectPair(*domainServers.back(), *domainClients.back(), "ipc:" + name);
+    }
+    auto tcpServer = TcpTransportServer("4714");
+    auto tcpClient = TcpTransportClient();
+    connectPair(tcpServer, tcpClient, "127.0.0.1:4714");
+
+    using ShmEcho = Echo<SharedMemoryTransportServer<64 * 1024>, SharedMemoryTransportClient<64 * 1024>>;
+    using DomainEcho = Echo<DomainSocketsTransportServer, DomainSocketsTransportClient>;
+    auto shmEchos = std::vector<std::unique_ptr<ShmEcho>>();
+    auto domainEchos = std::vector<std::unique_ptr<DomainEcho>>();
+    for (size_t i = 0; i < 4; ++i) {
+        shmEchos.push_back(std::make_unique<ShmEcho>(ShmEcho{*shmServers[i], *shmClients[i], loop}));
+        shmEchos.back()->start();
+        domainEchos.push_back(std::make_unique<DomainEcho>(DomainEcho{*domainServers[i], *domainClients[i], loop}));
+        domainEchos.back()->start();
+    }
+    auto tcpEcho = Echo<TcpTransportServer, TcpTransportClient>{tcpServer, tcpClient, loop};
+    tcpEcho.start();
+
+    loop.run();
+
+    for (size_t i = 0; i < 4; ++i) {
+        if (shmEchos[i]->completed != MESSAGES || domainEchos[i]->completed != MESSAGES) {
+            throw std::runtime_error{"not all messages were echoed"};
+        }
+    }
+    if (tcpEcho.completed != MESSAGES) {
+        throw std::runtime_error{"not all messages were echoed"};
+    }
+}
+
+int main() {
+    runWithTimeout(std::chrono::seconds(TIMEOUT_IN_SECONDS), [] {
+        testEcho();
+        testLargeWrites();
+    });
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "include/DomainSocketsTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::util::domain::FdPassing;
+
+const size_t ROUNDS = 16;
+const size_t TIMEOUT_IN_SECONDS = 10;
+// small pool and threshold, so the writer has to wait for and grow pool files
+const auto OPTIONS = FdPassing{64 * 1024, 2};
+
+/// Mixes inline and pooled writes, the sizes grow, so pool files get replaced
+size_t messageSize(size_t round, size_t i) {
+    const size_t sizes[] = {100, 3 * 1024 * 1024, 3, 64 * 1024, 64 * 1024 - 1, 1024 * 1024 + round * 4096};
+    return sizes[i % 6];
+}
+
+uint8_t pattern(size_t round, size_t i, size_t offset) {
+    return static_cast<uint8_t>(round * 31 + i * 7 + offset);
+}
+
+/// A reader with a smaller pool than the writer rejects the pool files, that don't fit
+void testPoolSizeMismatch() {
+    auto server = DomainSocketsTransportServer("/tmp/fdPassingMismatchTest", OPTIONS);
+    auto client = DomainSocketsTransportClient(FdPassing{OPTIONS.threshold, 1});
+    connectPair(server, client, "/tmp/fdPassingMismatchTest");
+
+    // both are pooled before the client reads, so the second one needs another pool file
+    vector<uint8_t> message(OPTIONS.threshold);
+    server.write(message.data(), message.size());
+    server.write(message.data(), message.size());
+    client.read(message.data(), message.size());
+    try {
+        client.read(message.data(), message.size());
+    } catch (const runtime_error &) {
+        return;
+    }
+    throw runtime_error{"accepted a pool file beyond the pool size"};
+}
+
+void testTransfer() {
+    auto server = DomainSocketsTransportServer("/tmp/fdPassingTest", OPTIONS);
+    auto client = DomainSocketsTransportClient(OPTIONS);
+
+    auto serverDone = async(launch::async, [&]() {
+        server.accept();
+        vector<uint8_t> message;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            for (size_t i = 0; i < 6; ++i) {
+                message.resize(messageSize(round, i));
+                for (size_t offset = 0; offset < message.size(); ++offset) {
+                    message[offset] = pattern(round, i, offset);
+                }
+                if (i == 5) {
+                    // a single frame from two segments
+                    const auto half = message.size() / 2;
+                    server.writev({{message.data(), half}, {message.data() + half, message.size() - half}});
+                } else {
+                    server.write(message.data(), message.size());
+                }
+            }
+            size_t ack;
+            server.read(ack);
+            if (ack != round) {
+                throw runtime_error{"received unexpected ack"};
+            }
+        }
+    });
+
+    auto clientDone = async(launch::async, [&]() {
+        client.connect("/tmp/fdPassingTest");
+        vector<uint8_t> received;
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            size_t total = 0;
+            for (size_t i = 0; i < 6; ++i) {
+                total += messageSize(round, i);
+            }
+            // read the whole round at once, across frame boundaries, partly with tryRead
+            received.resize(total);
+            const auto head = size_t(50);
+            while (not client.tryRead(received.data(), head));
+            client.read(received.data() + head, total - head);
+
+            size_t position = 0;
+            for (size_t i = 0; i < 6; ++i) {
+                for (size_t offset = 0; offset < messageSize(round, i); ++offset, ++position) {
+                    if (received[position] != pattern(round, i, offset)) {
+                        throw runtime_error{"received unexpected data"};
+                    }
+                }
+            }
+            client.write(round);
+        }
+    });
+
+    const auto deadline = deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    testTransfer();
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testPoolSizeMismatch);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "include/SharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <atomic>
+#include <future>
+#include <thread>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::Batching;
+using l5::datastructure::WaitMode;
+
+const size_t ROUNDS = 8;
+const size_t MESSAGES_PER_BATCH = 10;
+/// Much longer than the spin time, so the waiting side goes to sleep on the futex
+const auto IDLE_TIME = std::chrono::milliseconds(20);
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// Both sides idle before they answer, so the other one has to be woken up every time
+void testIdleWakeup() {
+    auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/futexWaitTest", WaitMode::Futex);
+    auto client = SharedMemoryTransportClient<64 * 1024>(WaitMode::Futex);
+    connectPair(server, client, "shm:/tmp/futexWaitTest");
+
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            size_t received;
+            server.read(received);
+            std::this_thread::sleep_for(IDLE_TIME);
+            server.write(received + 1);
+        }
+    });
+
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        std::this_thread::sleep_for(IDLE_TIME);
+        client.write(round);
+        size_t response;
+        client.read(response);
+        if (response != round + 1) {
+            throw std::runtime_error{"received unexpected response"};
+        }
+    }
+    waitOrDie(serverDone, deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS)));
+}
+
+/// Staged sends don't wake the sleeping consumer, only the explicit flush publishes them
+void testFlushWakeup() {
+    auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/futexFlushTest", WaitMode::Futex);
+    auto client = SharedMemoryTransportClient<64 * 1024>(WaitMode::Futex);
+    client.setBatching(Batching{0, 0});
+    connectPair(server, client, "shm:/tmp/futexFlushTest");
+
+    std::atomic<size_t> received{0};
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            size_t sum = 0;
+            for (size_t i = 0; i < MESSAGES_PER_BATCH; ++i) {
+                size_t value;
+                server.read(value);
+                sum += value;
+                ++received;
+            }
+            server.write(sum);
+        }
+    });
+
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        size_t expected = 0;
+        for (size_t i = 0; i < MESSAGES_PER_BATCH; ++i) {
+            client.write(round + i);
+            expected += round + i;
+        }
+        std::this_thread::sleep_for(IDLE_TIME);
+        if (received != round * MESSAGES_PER_BATCH) {
+            throw std::runtime_error{"received staged sends before the flush"};
+        }
+        client.flush();
+        // the read would flush as well, so wait for the server to wake up and receive the batch before. Hangs until
+        // the timeout, if the flush doesn't wake it up
+        while (received != (round + 1) * MESSAGES_PER_BATCH) {
+            std::this_thread::yield();
+        }
+        size_t sum;
+        client.read(sum);
+        if (sum != expected) {
+            throw std::runtime_error{"received unexpected sum"};
+        }
+    }
+    waitOrDie(serverDone, deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS)));
+}
+
+int main() {
+    runWithTimeout(std::chrono::seconds(TIMEOUT_IN_SECONDS), [] {
+        testIdleWakeup();
+        testFlushWakeup();
+    });
+    return 0;
+}
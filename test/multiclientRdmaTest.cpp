@@ -0,0 +1,81 @@
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "include/MulticlientRDMARecvTransport.h"
+#include "rdma/Network.hpp"
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t CLIENTS = 2;
+const size_t MESSAGES = 256;
+const size_t TIMEOUT_IN_SECONDS = 10;
+
+/// Each client in its own process, so without an Infiniband device, the server's emulation serves several processes
+int main() {
+    if (not rdma::Network::hasDevice()) {
+        setenv("L5RDMA_EMULATED", "1", 0);
+    }
+
+    const auto serverPid = fork();
+    if (serverPid == 0) {
+        auto server = MulticlientRDMARecvTransportServer("4726", CLIENTS);
+        for (size_t i = 0; i < CLIENTS; ++i) {
+            server.accept();
+        }
+        server.finishListen();
+        vector<uint8_t> buffer(64);
+        for (size_t i = 0; i < CLIENTS * MESSAGES; ++i) {
+            const auto sender = server.receive(buffer.data(), buffer.size());
+            server.send(sender, buffer.data(), buffer.size());
+        }
+        return 0;
+    }
+
+    vector<pid_t> clientPids;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        const auto clientPid = fork();
+        if (clientPid == 0) {
+            sleep(1); // server needs some time to start
+            auto client = MulticlientRDMARecvTransportClient();
+            client.connect("127.0.0.1:4726");
+            vector<uint8_t> data(64);
+            vector<uint8_t> buffer(64);
+            for (size_t i = 0; i < MESSAGES; ++i) {
+                fill(data.begin(), data.end(), static_cast<uint8_t>(c + i));
+                client.send(data.data(), data.size());
+                client.receive(buffer.data(), buffer.size());
+                if (buffer != data) {
+                    cerr << "client " << c << " received unexpected data" << endl;
+                    return 1;
+                }
+            }
+            return 0;
+        }
+        clientPids.push_back(clientPid);
+    }
+
+    vector<pid_t> running = clientPids;
+    running.push_back(serverPid);
+    int failed = 0;
+    for (size_t secs = 0; not running.empty(); ++secs, sleep(1)) {
+        if (secs >= TIMEOUT_IN_SECONDS) {
+            cerr << "timeout" << endl;
+            for (const auto pid : running) {
+                kill(pid, SIGTERM);
+            }
+            return 1;
+        }
+        for (auto pid = running.begin(); pid != running.end();) {
+            int status = 1;
+            if (waitpid(*pid, &status, WNOHANG) != 0) {
+                failed += status != 0;
+                pid = running.erase(pid);
+            } else {
+                ++pid;
+            }
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,99 @@
+#include "include/MulticlientSharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::util::ConstSegment;
+
+const size_t CLIENTS = 4;
+const size_t MESSAGES = 1024; // ~ 1s
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// the door bells are polled 16 at once
+void testInvalidMaxClients() {
+    try {
+        auto server = MulticlientSharedMemoryTransportServer("/tmp/multiclientPingPong", 17);
+    } catch (const std::runtime_error &) {
+        return;
+    }
+    throw std::runtime_error{"accepted maxClients, that isn't a multiple of 16"};
+}
+
+/// A message, that doesn't fit, is dropped, alone or in a batch, and the next receive continues after it
+void testTooLarge() {
+    auto server = MulticlientSharedMemoryTransportServer("/tmp/multiclientTooLarge", 16);
+    auto client = MulticlientSharedMemoryTransportClient();
+    connectPair(server, client, "/tmp/multiclientTooLarge");
+    server.finishListen();
+
+    const size_t small[] = {1, 2, 3};
+    const std::vector<uint8_t> large(64);
+    auto clientDone = std::async(std::launch::async, [&]() {
+        const ConstSegment batch[] = {{&small[0], sizeof(small[0])}, {large.data(), large.size()},
+                                      {&small[1], sizeof(small[1])}};
+        client.sendBatch(batch, 3);
+        client.send(large.data(), large.size());
+        client.send(reinterpret_cast<const uint8_t *>(&small[2]), sizeof(small[2]));
+    });
+
+    const auto tooLarge = SIZE_MAX;
+    for (const auto expected : {small[0], tooLarge, small[1], tooLarge, small[2]}) {
+        size_t received = 0;
+        try {
+            server.read(received);
+        } catch (const std::runtime_error &) {
+            if (expected != tooLarge) throw;
+            continue;
+        }
+        if (received != expected) {
+            throw std::runtime_error{"received unexpected message after one, that didn't fit"};
+        }
+    }
+    waitOrDie(clientDone, deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS)));
+}
+
+int main() {
+    testInvalidMaxClients();
+    runWithTimeout(std::chrono::seconds(TIMEOUT_IN_SECONDS), testTooLarge);
+
+    auto server = MulticlientSharedMemoryTransportServer("/tmp/multiclientPingPong");
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t i = 0; i < CLIENTS; ++i) {
+            server.accept();
+        }
+        server.finishListen();
+        std::vector<uint8_t> buffer(64);
+        for (size_t i = 0; i < CLIENTS * MESSAGES; ++i) {
+            const auto sender = server.receive(buffer.data(), buffer.size());
+            server.send(sender, buffer.data(), buffer.size());
+        }
+        return true;
+    });
+
+    std::vector<std::future<bool>> clientsDone;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        clientsDone.push_back(std::async(std::launch::async, [c]() {
+            auto client = MulticlientSharedMemoryTransportClient();
+            client.connect("/tmp/multiclientPingPong");
+            std::vector<uint8_t> data(64);
+            std::vector<uint8_t> buffer(64);
+            for (size_t i = 0; i < MESSAGES; ++i) {
+                std::fill(data.begin(), data.end(), static_cast<uint8_t>(c + i));
+                client.send(data.data(), data.size());
+                client.receive(buffer.data(), buffer.size());
+                if (buffer != data) {
+                    throw std::runtime_error{"received unexpected data"};
+                }
+            }
+            return true;
+        }));
+    }
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(clientsDone, deadline);
+    waitOrDie(serverDone, deadline);
+    return 0;
+}
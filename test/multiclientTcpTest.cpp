@@ -0,0 +1,128 @@
+#include "include/MulticlientTCPTransport.h"
+#include "test/testHelpers.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t ROUNDS = 512;
+const size_t CLIENTS = 4;
+const size_t MAX_SIZE = 64 * 1024;
+const size_t TIMEOUT_IN_SECONDS = 10;
+
+/// Sizes vary from a few bytes to more than one socket read, so messages are split and coalesced in the server
+size_t messageSize(size_t client, size_t round) {
+    return 1 + (client * 4099 + round * 7919) % MAX_SIZE;
+}
+
+uint8_t messageByte(size_t client, size_t round) {
+    return static_cast<uint8_t>(client * 31 + round);
+}
+
+void test(MulticlientTcpBackend backend, const string &port) {
+    auto server = MulticlientTCPTransportServer(port, backend);
+
+    vector<future<void>> clientsDone;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        clientsDone.push_back(async(launch::async, [c, &port]() {
+            auto client = MulticlientTCPTransportClient();
+            for (int i = 0;; ++i) {
+                try {
+                    client.connect("127.0.0.1:" + port);
+                    break;
+                } catch (...) {
+                    std::this_thread::sleep_for(20ms);
+                    if (i > 10) throw;
+                }
+            }
+            client.write(c);
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                const auto message = vector<uint8_t>(messageSize(c, round), messageByte(c, round));
+                client.send(message.data(), message.size());
+                // only wait for an ack every few rounds, so several messages are in flight at once
+                if (round % 8 == 7) {
+                    size_t ack;
+                    client.read(ack);
+                    if (ack != round) {
+                        throw runtime_error{"received unexpected ack"};
+                    }
+                }
+            }
+        }));
+    }
+
+    auto serverDone = async(launch::async, [&]() {
+        for (size_t c = 0; c < CLIENTS; ++c) {
+            server.accept();
+        }
+        // the connection ids are in accept order, which isn't necessarily the clients' order
+        vector<size_t> clientOf(CLIENTS, CLIENTS);
+        vector<size_t> rounds(CLIENTS);
+        vector<uint8_t> buffer(MAX_SIZE);
+        for (size_t done = 0; done < CLIENTS;) {
+            const auto sender = server.receive(buffer.data(), buffer.size());
+            if (clientOf[sender] == CLIENTS) {
+                memcpy(&clientOf[sender], buffer.data(), sizeof(size_t));
+                continue;
+            }
+            const auto client = clientOf[sender];
+            const auto round = rounds[sender]++;
+            const auto begin = buffer.begin();
+            const auto end = begin + messageSize(client, round);
+            if (not all_of(begin, end, [&](uint8_t b) { return b == messageByte(client, round); })) {
+                throw runtime_error{"received unexpected message"};
+            }
+            if (round % 8 == 7) {
+                server.write(sender, round);
+            }
+            if (round + 1 == ROUNDS) ++done;
+        }
+        // the io_uring backend batches the answers until the next receive
+        server.flush();
+    });
+
+    const auto deadline = deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(clientsDone, deadline);
+    waitOrDie(serverDone, deadline);
+}
+
+/// A client announcing a huge message is dropped right after its header, the others are still served
+void testOversized(MulticlientTcpBackend backend, uint16_t port) {
+    auto server = MulticlientTCPTransportServer(to_string(port), backend);
+    const auto hostile = l5::util::Socket::create();
+    l5::util::tcp::connect(hostile, "127.0.0.1", port);
+    server.accept();
+    auto honest = MulticlientTCPTransportClient();
+    connectPair(server, honest, "127.0.0.1:" + to_string(port));
+
+    const size_t announced = SIZE_MAX - 4;
+    l5::util::tcp::write(hostile, announced);
+    l5::util::tcp::write(hostile, announced);
+    size_t received = 0;
+    if (server.receive(&received, sizeof(received), 100ms)) {
+        throw runtime_error{"received the oversized message"};
+    }
+    char eof;
+    if (::recv(hostile.get(), &eof, sizeof(eof), 0) != 0) {
+        throw runtime_error{"oversized message didn't drop the connection"};
+    }
+
+    honest.write(size_t(42));
+    if (server.read(received) != 1 || received != 42) {
+        throw runtime_error{"received unexpected message"};
+    }
+}
+
+int main() {
+    test(MulticlientTcpBackend::Epoll, "4717");
+    test(MulticlientTcpBackend::IoUring, "4718");
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), [] { testOversized(MulticlientTcpBackend::Epoll, 4728); });
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), [] { testOversized(MulticlientTcpBackend::IoUring, 4729); });
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "include/NegotiatedTransport.h"
+#include "test/testHelpers.h"
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <thread>
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t MESSAGES = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+void testNegotiation(const std::string &port, PeerCapabilities serverCapabilities,
+                     PeerCapabilities clientCapabilities, TransportKind expected) {
+    auto serverDone = std::async(std::launch::async, [&]() {
+        auto server = NegotiatedTransportServer<64 * 1024>(port, serverCapabilities);
+        server.accept();
+        if (server.kind() != expected) {
+            throw std::runtime_error{"server negotiated "s + to_string(server.kind())};
+        }
+        // the hot loop runs on the concrete transport
+        server.visit([](auto &transport) {
+            for (size_t i = 0; i < MESSAGES; ++i) {
+                size_t message;
+                transport.read(message);
+                if (message != i) {
+                    throw std::runtime_error{"received unexpected data"};
+                }
+                transport.write(message);
+            }
+        });
+        try {
+            server.accept();
+        } catch (const std::runtime_error &) {
+            return;
+        }
+        throw std::runtime_error{"accepted a second connection"};
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        auto client = NegotiatedTransportClient<64 * 1024>(clientCapabilities);
+        for (int i = 0;; ++i) {
+            try {
+                client.connect("127.0.0.1:" + port);
+                break;
+            } catch (...) {
+                std::this_thread::sleep_for(20ms);
+                if (i > 100) throw;
+            }
+        }
+        if (client.kind() != expected) {
+            throw std::runtime_error{"client negotiated "s + to_string(client.kind())};
+        }
+        // and the generic interface dispatches per call
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            client.write(i);
+            size_t answer;
+            client.read(answer);
+            if (answer != i) {
+                throw std::runtime_error{"received unexpected answer"};
+            }
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    // client and server share this host
+    testNegotiation("4715", localCapabilities(), localCapabilities(), TransportKind::SharedMemory);
+
+    // a crashed server left its domain socket behind
+    std::ofstream(rendezvousSocket(4727)).put('x');
+    testNegotiation("4727", localCapabilities(), localCapabilities(), TransportKind::SharedMemory);
+
+    // pretend to be on another host without RDMA
+    auto remote = localCapabilities();
+    remote.bootId = {'r', 'e', 'm', 'o', 't', 'e'};
+    remote.rdma = false;
+    testNegotiation("4716", localCapabilities(), remote, TransportKind::Tcp);
+
+    // the same host, but the client can't reach the server's domain socket, like from another container
+    auto container = localCapabilities();
+    container.rendezvousInode += 1;
+    container.rdma = false;
+    testNegotiation("4724", localCapabilities(), container, TransportKind::Tcp);
+
+    // both pretend to have a device, the emulation stands in for it
+    setenv("L5RDMA_EMULATED", "1", 1);
+    auto withRdma = localCapabilities();
+    withRdma.rdma = true;
+    remote.rdma = true;
+    testNegotiation("4725", withRdma, remote, TransportKind::Rdma);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "include/DomainSocketsTransport.h"
+#include "include/RdmaTransport.h"
+#include "include/SharedMemoryTransport.h"
+#include "include/TcpTransport.h"
+#include "test/testHelpers.h"
+#include <cstdlib>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::Framing;
+using l5::datastructure::WaitMode;
+using l5::util::domain::FdPassing;
+
+const size_t MESSAGES = 1024;
+const auto TIMEOUT = std::chrono::seconds(5);
+/// Much larger than any socket buffer, so it's only transferred piece by piece
+const size_t LARGE_SIZE = 16 * 1024 * 1024;
+
+/// Ping pong, where the server polls with tryRead instead of blocking
+template<typename Server, typename Client>
+void testNonBlocking(Server &server, Client &client, const std::string &connection) {
+    const auto deadline = deadlineIn(TIMEOUT);
+    auto serverDone = std::async(std::launch::async, [&]() {
+        server.accept();
+        if (server.readable()) {
+            throw std::runtime_error{"readable before anything was sent"};
+        }
+        size_t polls = 0;
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            size_t message;
+            while (not server.tryRead(message)) {
+                ++polls;
+                std::this_thread::yield();
+            }
+            if (message != i) {
+                throw std::runtime_error{"received unexpected data"};
+            }
+            if (not server.writable()) {
+                throw std::runtime_error{"not writable with an empty buffer"};
+            }
+            while (not server.tryWrite(message)) {
+                std::this_thread::yield();
+            }
+        }
+        if (polls == 0) {
+            throw std::runtime_error{"tryRead never returned false"};
+        }
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        client.connect(connection);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            // give the server a chance to poll an empty connection
+            if (i % 128 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            client.write(i);
+            size_t answer;
+            client.read(answer);
+            if (answer != i) {
+                throw std::runtime_error{"received unexpected answer"};
+            }
+        }
+    });
+
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+/// Both directions at once on a single thread, with transfers larger than the socket buffers. Only works, if a
+/// partial tryWrite / tryRead returns instead of blocking, and the next call continues where it stopped
+template<typename Server, typename Client>
+void testLargeTransfer(Server &server, Client &client, const std::string &connection) {
+    const auto deadline = deadlineIn(TIMEOUT);
+    auto connected = std::async(std::launch::async, [&]() { client.connect(connection); });
+    server.accept();
+    waitOrDie(connected, deadline);
+
+    auto done = std::async(std::launch::async, [&]() {
+        auto request = std::vector<uint8_t>(LARGE_SIZE);
+        std::iota(request.begin(), request.end(), uint8_t(0));
+        auto answer = std::vector<uint8_t>(LARGE_SIZE, uint8_t(1));
+        auto receivedRequest = std::vector<uint8_t>(LARGE_SIZE);
+        auto receivedAnswer = std::vector<uint8_t>(LARGE_SIZE);
+
+        bool requestSent = false, requestReceived = false, answerSent = false, answerReceived = false;
+        size_t rounds = 0;
+        while (not(requestSent && requestReceived && answerSent && answerReceived)) {
+            if (not requestSent) requestSent = client.tryWrite(request.data(), request.size());
+            if (not answerSent) answerSent = server.tryWrite(answer.data(), answer.size());
+            if (not requestReceived) requestReceived = server.tryRead(receivedRequest.data(), receivedRequest.size());
+            if (not answerReceived) answerReceived = client.tryRead(receivedAnswer.data(), receivedAnswer.size());
+            ++rounds;
+        }
+        if (rounds < 2) {
+            throw std::runtime_error{"the large transfer didn't need several tries"};
+        }
+        if (receivedRequest != request || receivedAnswer != answer) {
+            throw std::runtime_error{"received unexpected data"};
+        }
+
+        // the stream is still intact afterwards
+        while (not client.tryWrite(size_t(42)));
+        size_t message = 0;
+        while (not server.tryRead(message));
+        if (message != 42) {
+            throw std::runtime_error{"stream torn after the large transfer"};
+        }
+    });
+    waitOrDie(done, deadline);
+}
+
+int main() {
+    {
+        auto server = DomainSocketsTransportServer("/tmp/nonBlockingTest");
+        auto client = DomainSocketsTransportClient();
+        testNonBlocking(server, client, "ipc:/tmp/nonBlockingTest");
+    }
+    {
+        auto server = DomainSocketsTransportServer("/tmp/nonBlockingTest");
+        auto client = DomainSocketsTransportClient();
+        testLargeTransfer(server, client, "ipc:/tmp/nonBlockingTest");
+    }
+    {
+        // the frames are larger than the socket buffers, so they are sent over several tries
+        const auto inlineFrames = FdPassing{2 * LARGE_SIZE};
+        auto server = DomainSocketsTransportServer("/tmp/nonBlockingTest", inlineFrames);
+        auto client = DomainSocketsTransportClient(inlineFrames);
+        testLargeTransfer(server, client, "ipc:/tmp/nonBlockingTest");
+    }
+    {
+        auto server = TcpTransportServer("4713");
+        auto client = TcpTransportClient();
+        testNonBlocking(server, client, "127.0.0.1:4713");
+    }
+    {
+        auto server = TcpTransportServer("4714");
+        auto client = TcpTransportClient();
+        testLargeTransfer(server, client, "127.0.0.1:4714");
+    }
+    {
+        auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/nonBlockingTest");
+        auto client = SharedMemoryTransportClient<64 * 1024>();
+        testNonBlocking(server, client, "shm:/tmp/nonBlockingTest");
+    }
+    {
+        auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/nonBlockingTest", WaitMode::Spin, {}, Framing::Message);
+        auto client = SharedMemoryTransportClient<64 * 1024>(WaitMode::Spin, {}, Framing::Message);
+        testNonBlocking(server, client, "shm:/tmp/nonBlockingTest");
+    }
+    {
+        auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/nonBlockingTest");
+        auto client = SharedMemoryTransportClient<64 * 1024>();
+        testLargeTransfer(server, client, "shm:/tmp/nonBlockingTest");
+    }
+    {
+        // both ends in this process, so no Infiniband device is needed
+        setenv("L5RDMA_EMULATED", "1", 1);
+        auto server = RdmaTransportServer<64 * 1024>("4723");
+        auto client = RdmaTransportClient<64 * 1024>();
+        testLargeTransfer(server, client, "127.0.0.1:4723");
+    }
+    return 0;
+}
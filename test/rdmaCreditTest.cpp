@@ -0,0 +1,98 @@
+#include "datastructures/VirtualRDMARingBuffer.h"
+#include "include/RdmaTransport.h"
+#include "test/testHelpers.h"
+#include <cstdlib>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::VirtualRDMARingBuffer;
+using l5::util::Socket;
+
+const size_t BUFFER_SIZE = 64 * 1024;
+const size_t CREDIT_INTERVAL = 4 * 1024;
+const size_t MESSAGE_SIZE = 1000;
+/// fills the buffer many times over
+const size_t MESSAGES = 64 * BUFFER_SIZE / MESSAGE_SIZE;
+const size_t TIMEOUT_IN_SECONDS = 10;
+
+void require(bool condition, const string &what) {
+    if (not condition) {
+        throw runtime_error{what};
+    }
+}
+
+/// Stream through a ring, that the sender keeps full. Returns how often it read the remote read position
+size_t fetchesWhileStreaming(size_t creditInterval) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        throw runtime_error{"socketpair failed"};
+    }
+    const auto senderSocket = Socket::fromRaw(fds[0]);
+    const auto receiverSocket = Socket::fromRaw(fds[1]);
+
+    // both sides need to be constructed at once, they exchange their queue pairs and memory regions
+    auto receiver = async(launch::async, [&] {
+        auto ring = VirtualRDMARingBuffer(BUFFER_SIZE, receiverSocket, 0, creditInterval);
+        vector<uint8_t> buffer(MESSAGE_SIZE);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            require(ring.receive(buffer.data(), buffer.size()) == MESSAGE_SIZE, "received unexpected size");
+            require(buffer.front() == static_cast<uint8_t>(i) && buffer.back() == static_cast<uint8_t>(i),
+                    "received unexpected data");
+        }
+    });
+    size_t fetches = 0;
+    auto sender = async(launch::async, [&] {
+        auto ring = VirtualRDMARingBuffer(BUFFER_SIZE, senderSocket, 0, creditInterval);
+        vector<uint8_t> message(MESSAGE_SIZE);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            fill(message.begin(), message.end(), static_cast<uint8_t>(i));
+            ring.send(message.data(), message.size());
+        }
+        fetches = ring.getRemoteReadPosFetches();
+    });
+
+    const auto deadline = deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(receiver, deadline);
+    waitOrDie(sender, deadline);
+    return fetches;
+}
+
+/// The credit interval reaches the ring buffers of both sides of the transport
+void testTransport() {
+    auto server = RdmaTransportServer<BUFFER_SIZE>("4722", CREDIT_INTERVAL);
+    auto client = RdmaTransportClient<BUFFER_SIZE>(CREDIT_INTERVAL);
+    connectPair(server, client, "127.0.0.1:4722");
+
+    auto serverDone = async(launch::async, [&] {
+        vector<uint8_t> buffer(MESSAGE_SIZE);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            server.read(buffer.data(), buffer.size());
+            require(buffer.front() == static_cast<uint8_t>(i) && buffer.back() == static_cast<uint8_t>(i),
+                    "received unexpected data");
+        }
+        server.write(MESSAGES);
+    });
+    vector<uint8_t> message(MESSAGE_SIZE);
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        fill(message.begin(), message.end(), static_cast<uint8_t>(i));
+        client.write(message.data(), message.size());
+    }
+    size_t answer;
+    client.read(answer);
+    require(answer == MESSAGES, "received unexpected answer");
+    waitOrDie(serverDone, deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS)));
+}
+
+int main() {
+    // two fabrics in this process, so no Infiniband device is needed
+    setenv("L5RDMA_EMULATED", "1", 1);
+
+    require(fetchesWhileStreaming(0) > 0, "a full ring without credits needs to read the remote read position");
+    // with credits, the free space shows up without a single RDMA read
+    require(fetchesWhileStreaming(CREDIT_INTERVAL) == 0, "read the remote read position despite credits");
+
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testTransport);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <zconf.h>
 #include "apps/PingPong.h"
 #include "include/RdmaTransport.h"
+#include "rdma/Network.hpp"
 
 using namespace std;
 using namespace l5::transport;
@@ -17,6 +18,11 @@ int main(int, const char** args) {
         TIMEOUT_IN_SECONDS *= 32;
     }
 
+    // without an Infiniband device, both processes connect through the emulation
+    if (not rdma::Network::hasDevice()) {
+        setenv("L5RDMA_EMULATED", "1", 0);
+    }
+
     const auto serverPid = fork();
     if (serverPid == 0) {
         auto pong = Pong(make_transportServer<RdmaTransportServer<>>("1234"));
@@ -34,6 +40,7 @@ int main(int, const char** args) {
         for (size_t i = 0; i < MESSAGES; ++i) {
             ping.ping();
         }
+        return 0;
     }
 
     int serverStatus = 1;
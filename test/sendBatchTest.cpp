@@ -0,0 +1,120 @@
+#include "datastructures/VirtualRingBuffer.h"
+#include "include/MulticlientSharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::VirtualRingBuffer;
+using l5::util::ConstSegment;
+using l5::util::Socket;
+
+const size_t ROUNDS = 256;
+const size_t CLIENTS = 2;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// A burst of differently sized messages, each filled with its index in the burst
+struct Burst {
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<ConstSegment> segments;
+
+    explicit Burst(size_t round) {
+        for (size_t i = 0; i < 50 + round % 150; ++i) {
+            messages.emplace_back((round * 7 + i * 13) % 512, static_cast<uint8_t>(i));
+        }
+        for (const auto &message : messages) {
+            segments.push_back({message.data(), message.size()});
+        }
+    }
+};
+
+void check(const Burst &burst, size_t i, const uint8_t *begin, const uint8_t *end) {
+    if (static_cast<size_t>(end - begin) != burst.messages[i].size() ||
+        not std::equal(begin, end, burst.messages[i].begin())) {
+        throw std::runtime_error{"received unexpected message"};
+    }
+}
+
+void testRing() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        throw std::runtime_error{"socketpair failed"};
+    }
+    const auto producerSocket = Socket::fromRaw(fds[0]);
+    const auto consumerSocket = Socket::fromRaw(fds[1]);
+
+    // small enough, that the biggest bursts need to be split
+    const size_t ringSize = 32 * 1024;
+    auto consumer = std::async(std::launch::async, [&]() {
+        auto ring = VirtualRingBuffer(ringSize, consumerSocket);
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            const auto burst = Burst(round);
+            for (size_t i = 0; i < burst.messages.size(); ++i) {
+                ring.receive([&](const uint8_t *begin, const uint8_t *end) { check(burst, i, begin, end); });
+            }
+        }
+    });
+    auto producer = std::async(std::launch::async, [&]() {
+        auto ring = VirtualRingBuffer(ringSize, producerSocket);
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            const auto burst = Burst(round);
+            ring.sendBatch(burst.segments.data(), burst.segments.size());
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(producer, deadline);
+    waitOrDie(consumer, deadline);
+}
+
+void testMulticlient() {
+    auto server = MulticlientSharedMemoryTransportServer("/tmp/sendBatchTest");
+    auto serverDone = std::async(std::launch::async, [&]() {
+        for (size_t i = 0; i < CLIENTS; ++i) {
+            server.accept();
+        }
+        server.finishListen();
+        std::vector<size_t> rounds(CLIENTS);
+        std::vector<size_t> received(CLIENTS);
+        for (size_t done = 0; done < CLIENTS;) {
+            server.receive([&](size_t sender, const uint8_t *begin, const uint8_t *end) {
+                const auto burst = Burst(rounds[sender]);
+                check(burst, received[sender], begin, end);
+                if (++received[sender] == burst.messages.size()) {
+                    received[sender] = 0;
+                    if (++rounds[sender] == ROUNDS) ++done;
+                    server.write(sender, rounds[sender]);
+                }
+            });
+        }
+    });
+
+    std::vector<std::future<void>> clientsDone;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        clientsDone.push_back(std::async(std::launch::async, []() {
+            auto client = MulticlientSharedMemoryTransportClient();
+            client.connect("/tmp/sendBatchTest");
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                const auto burst = Burst(round);
+                client.sendBatch(burst.segments.data(), burst.segments.size());
+                size_t ack;
+                client.read(ack);
+                if (ack != round + 1) {
+                    throw std::runtime_error{"received unexpected ack"};
+                }
+            }
+        }));
+    }
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(clientsDone, deadline);
+    waitOrDie(serverDone, deadline);
+}
+
+int main() {
+    testRing();
+    testMulticlient();
+    return 0;
+}
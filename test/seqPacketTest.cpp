@@ -0,0 +1,133 @@
+#include "include/DomainSocketsTransport.h"
+#include "test/testHelpers.h"
+#include <algorithm>
+#include <future>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::util::ConstSegment;
+using l5::util::MutableSegment;
+
+const size_t ROUNDS = 256;
+const size_t MAX_MESSAGE_SIZE = 512;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// A burst of differently sized, non-empty messages, each filled with its index in the burst
+struct Burst {
+    vector<vector<uint8_t>> messages;
+    vector<ConstSegment> segments;
+
+    explicit Burst(size_t round) {
+        for (size_t i = 0; i < 1 + round % 100; ++i) {
+            messages.emplace_back(1 + (round * 7 + i * 13) % (MAX_MESSAGE_SIZE - 1), static_cast<uint8_t>(i));
+        }
+        for (const auto &message : messages) {
+            segments.push_back({message.data(), message.size()});
+        }
+    }
+};
+
+void check(const Burst &burst, size_t i, const uint8_t *begin, size_t size) {
+    if (size != burst.messages[i].size() || not equal(begin, begin + size, burst.messages[i].begin())) {
+        throw runtime_error{"received unexpected message"};
+    }
+}
+
+/// Once the client is gone, receiving fails instead of returning empty messages forever
+void testHangUp() {
+    auto server = DomainSocketsMessageTransportServer("/tmp/seqPacketHangUpTest");
+    {
+        auto client = DomainSocketsMessageTransportClient();
+        connectPair(server, client, "/tmp/seqPacketHangUpTest");
+        const uint8_t last = 42;
+        client.send(&last, sizeof(last));
+    }
+
+    uint8_t buffer[MAX_MESSAGE_SIZE];
+    auto segment = MutableSegment{buffer, sizeof(buffer)};
+    size_t size;
+    if (server.receiveBatch(&segment, 1, &size) != 1 || size != 1 || buffer[0] != 42) {
+        throw runtime_error{"didn't receive the last message before the hang up"};
+    }
+    for (const auto receiveBatch : {false, true}) {
+        try {
+            if (receiveBatch) {
+                server.receiveBatch(&segment, 1, &size);
+            } else {
+                server.receive(buffer, sizeof(buffer));
+            }
+        } catch (const runtime_error &) {
+            continue;
+        }
+        throw runtime_error{"hang up wasn't detected"};
+    }
+}
+
+void testMessages() {
+    auto server = DomainSocketsMessageTransportServer("/tmp/seqPacketTest");
+    auto client = DomainSocketsMessageTransportClient();
+
+    auto serverDone = async(launch::async, [&]() {
+        server.accept();
+        vector<vector<uint8_t>> buffers(32, vector<uint8_t>(MAX_MESSAGE_SIZE));
+        vector<MutableSegment> segments;
+        for (auto &buffer : buffers) {
+            segments.push_back({buffer.data(), buffer.size()});
+        }
+        vector<size_t> sizes(buffers.size());
+
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            const auto burst = Burst(round);
+            // message boundaries survive, no matter how many messages a single call drains
+            for (size_t received = 0; received < burst.messages.size();) {
+                const auto count = server.receiveBatch(segments.data(), segments.size(), sizes.data());
+                for (size_t i = 0; i < count; ++i) {
+                    check(burst, received + i, buffers[i].data(), sizes[i]);
+                }
+                received += count;
+            }
+            server.sendBatch(burst.segments.data(), burst.segments.size());
+        }
+
+        // a message, that doesn't fit, is an error instead of silently truncated
+        uint8_t tooSmall[8];
+        try {
+            server.receive(tooSmall, sizeof(tooSmall));
+        } catch (const runtime_error &) {
+            return;
+        }
+        throw runtime_error{"truncated message wasn't detected"};
+    });
+
+    auto clientDone = async(launch::async, [&]() {
+        client.connect("/tmp/seqPacketTest");
+        vector<uint8_t> buffer(MAX_MESSAGE_SIZE);
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            const auto burst = Burst(round);
+            if (round % 2 == 0) {
+                client.sendBatch(burst.segments.data(), burst.segments.size());
+            } else {
+                for (const auto &message : burst.messages) {
+                    client.send(message.data(), message.size());
+                }
+            }
+            for (size_t i = 0; i < burst.messages.size(); ++i) {
+                const auto size = client.receive(buffer.data(), buffer.size());
+                check(burst, i, buffer.data(), size);
+            }
+        }
+        const auto large = vector<uint8_t>(MAX_MESSAGE_SIZE);
+        client.send(large.data(), large.size());
+    });
+
+    const auto deadline = deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    testMessages();
+    runWithTimeout(chrono::seconds(TIMEOUT_IN_SECONDS), testHangUp);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "include/ShardedTCPTransport.h"
+#include "test/testHelpers.h"
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t ROUNDS = 1024;
+const size_t CLIENTS = 6;
+const size_t SHARDS = 3;
+const size_t TIMEOUT_IN_SECONDS = 10;
+
+struct Message {
+    size_t client;
+    size_t round;
+};
+
+void test(MulticlientTcpBackend backend, const string &port) {
+    auto server = ShardedTCPTransportServer(port, SHARDS, backend);
+
+    atomic<size_t> echoed = 0;
+    auto serverDone = async(launch::async, [&]() {
+        server.serve([&](ShardedTCPTransportServer::Shard &shard) {
+            // a shard can't know how many clients it gets, so it stops, once all messages have been echoed
+            while (echoed < CLIENTS * ROUNDS) {
+                Message message{};
+                const auto id = shard.receive(&message, sizeof(message), 10ms);
+                if (not id) continue;
+                if (server.shardOf(*id) != shard.index()) {
+                    throw runtime_error{"connection is served by the wrong shard"};
+                }
+                shard.write(*id, message);
+                shard.flush();
+                ++echoed;
+            }
+        });
+    });
+
+    vector<future<void>> clientsDone;
+    for (size_t c = 0; c < CLIENTS; ++c) {
+        clientsDone.push_back(async(launch::async, [c, &port]() {
+            auto client = MulticlientTCPTransportClient();
+            for (int i = 0;; ++i) {
+                try {
+                    client.connect("127.0.0.1:" + port);
+                    break;
+                } catch (...) {
+                    std::this_thread::sleep_for(20ms);
+                    if (i > 10) throw;
+                }
+            }
+            for (size_t round = 0; round < ROUNDS; ++round) {
+                client.write(Message{c, round});
+                Message answer{};
+                client.read(answer);
+                if (answer.client != c || answer.round != round) {
+                    throw runtime_error{"received unexpected answer"};
+                }
+            }
+        }));
+    }
+
+    const auto deadline = deadlineIn(chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(clientsDone, deadline);
+    waitOrDie(serverDone, deadline);
+}
+
+int main() {
+    test(MulticlientTcpBackend::Epoll, "4720");
+    test(MulticlientTcpBackend::IoUring, "4721");
+    return 0;
+}
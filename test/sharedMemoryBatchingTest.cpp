@@ -0,0 +1,85 @@
+#include "include/SharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::Batching;
+
+const size_t ROUNDS = 1024;
+const size_t MESSAGES_PER_ROUND = 100; // not a multiple of the batch size, so the implicit flush is needed
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+/// Sends are only visible to the server, once the one enabled threshold is reached. The other one being 0 must not
+/// publish every send
+void testSingleThreshold(Batching batching, size_t sendsPerBatch) {
+    auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/batchingThresholdTest");
+    auto client = SharedMemoryTransportClient<64 * 1024>();
+    client.setBatching(batching);
+    connectPair(server, client, "shm:/tmp/batchingThresholdTest");
+
+    for (size_t i = 0; i < sendsPerBatch - 1; ++i) {
+        client.write(i);
+    }
+    if (server.readable()) {
+        throw std::runtime_error{"published before the threshold was reached"};
+    }
+    client.write(sendsPerBatch - 1);
+    if (not server.readable()) {
+        throw std::runtime_error{"didn't publish at the threshold"};
+    }
+    for (size_t i = 0; i < sendsPerBatch; ++i) {
+        size_t received;
+        server.read(received);
+        if (received != i) {
+            throw std::runtime_error{"received unexpected data"};
+        }
+    }
+}
+
+void testRoundTrips() {
+    auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/batchingTest");
+    auto serverDone = std::async(std::launch::async, [&]() {
+        server.accept();
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            size_t sum = 0;
+            for (size_t i = 0; i < MESSAGES_PER_ROUND; ++i) {
+                size_t received;
+                server.read(received);
+                sum += received;
+            }
+            server.write(sum);
+        }
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        auto client = SharedMemoryTransportClient<64 * 1024>();
+        client.setBatching(Batching{0, 16});
+        client.connect("shm:/tmp/batchingTest");
+        for (size_t round = 0; round < ROUNDS; ++round) {
+            size_t expected = 0;
+            for (size_t i = 0; i < MESSAGES_PER_ROUND; ++i) {
+                client.write(round + i);
+                expected += round + i;
+            }
+            size_t sum;
+            client.read(sum);
+            if (sum != expected) {
+                throw std::runtime_error{"received unexpected sum"};
+            }
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    runWithTimeout(std::chrono::seconds(TIMEOUT_IN_SECONDS), [] {
+        testSingleThreshold(Batching{0, 16}, 16);
+        testSingleThreshold(Batching{4 * sizeof(size_t), 0}, 4);
+    });
+    testRoundTrips();
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "include/SharedMemoryTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::Framing;
+using l5::datastructure::WaitMode;
+
+const size_t MESSAGES = 16 * 1024;
+const size_t MAX_MESSAGESIZE = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+size_t messageSize(size_t i) {
+    return 1 + (i * 7) % MAX_MESSAGESIZE;
+}
+
+int main() {
+    auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/framedTest", WaitMode::Spin, {}, Framing::Message);
+    auto serverDone = std::async(std::launch::async, [&]() {
+        server.accept();
+        std::vector<uint8_t> buffer(MAX_MESSAGESIZE);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            const auto size = server.readSome(buffer.data(), buffer.size());
+            if (size != messageSize(i) || buffer[size - 1] != static_cast<uint8_t>(i)) {
+                throw std::runtime_error{"received partial or unexpected message"};
+            }
+            server.write(size);
+        }
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        auto client = SharedMemoryTransportClient<64 * 1024>(WaitMode::Spin, {}, Framing::Message);
+        client.connect("shm:/tmp/framedTest");
+        std::vector<uint8_t> data(MAX_MESSAGESIZE);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            std::fill(data.begin(), data.end(), static_cast<uint8_t>(i));
+            client.write(data.data(), messageSize(i));
+            size_t answer;
+            client.read(answer);
+            if (answer != messageSize(i)) {
+                throw std::runtime_error{"received unexpected answer"};
+            }
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "include/SharedMemoryTransport.h"
 #include "apps/PingPong.h"
+#include <algorithm>
 #include <future>
 #include <iostream>
 #include <sys/wait.h>
@@ -9,8 +10,39 @@ using namespace l5::transport;
 
 const size_t MESSAGES = 4 * 1024; // ~ 1s
 const size_t TIMEOUT_IN_SECONDS = 5;
+/// small enough, that the zero-copy messages wrap around its end
+const size_t ZC_BUFFER_SIZE = 4096;
+const size_t ZC_MESSAGES = 1024;
 
-int main() {
+/// sizes, that don't divide the buffer size, so a message regularly straddles the end of the ring
+size_t zeroCopyMessageSize(size_t i) {
+    return 1 + (i * 337) % 1500;
+}
+
+/// wait for both processes, kill them on timeout
+int waitForBoth(pid_t serverPid, pid_t clientPid) {
+    int serverStatus = 1;
+    int clientStatus = 1;
+    size_t secs = 0;
+    for (; secs < TIMEOUT_IN_SECONDS; ++secs, sleep(1)) {
+        auto serverTerminated = waitpid(serverPid, &serverStatus, WNOHANG) != 0;
+        auto clientTerminated = waitpid(clientPid, &clientStatus, WNOHANG) != 0;
+        if (serverTerminated && clientTerminated) {
+            break;
+        }
+    }
+
+    if (secs >= TIMEOUT_IN_SECONDS) {
+        std::cerr << "timeout" << std::endl;
+        kill(serverPid, SIGTERM);
+        kill(clientPid, SIGTERM);
+        return 1;
+    }
+
+    return serverStatus + clientStatus;
+}
+
+int pingPong() {
     const auto serverPid = fork();
     if (serverPid == 0) {
         auto pong = Pong(make_transportServer<SharedMemoryTransportServer<>>("/tmp/pingPong"));
@@ -18,7 +50,7 @@ int main() {
         for (size_t i = 0; i < MESSAGES; ++i) {
             pong.pong();
         }
-        return 0;
+        exit(0);
     }
 
     const auto clientPid = fork();
@@ -28,26 +60,63 @@ int main() {
         for (size_t i = 0; i < MESSAGES; ++i) {
             ping.ping();
         }
+        exit(0);
     }
 
-    int serverStatus = 1;
-    int clientStatus = 1;
-    size_t secs = 0;
-    for (; secs < TIMEOUT_IN_SECONDS; ++secs, sleep(1)) {
-        auto serverTerminated = waitpid(serverPid, &serverStatus, WNOHANG) != 0;
-        auto clientTerminated = waitpid(clientPid, &clientStatus, WNOHANG) != 0;
-        if (serverTerminated && clientTerminated) {
-            break;
+    return waitForBoth(serverPid, clientPid);
+}
+
+/// round trip with readZC and writeZC, the server checks each message in place and answers with the next byte value
+int zeroCopyPingPong() {
+    const auto serverPid = fork();
+    if (serverPid == 0) {
+        auto server = SharedMemoryTransportServer<ZC_BUFFER_SIZE>("/tmp/zeroCopyPingPong");
+        server.accept();
+        for (size_t i = 0; i < ZC_MESSAGES; ++i) {
+            size_t size = 0;
+            server.readZC([&](const uint8_t *begin, const uint8_t *end) {
+                size = static_cast<size_t>(end - begin);
+                if (size != zeroCopyMessageSize(i) ||
+                    std::any_of(begin, end, [&](uint8_t b) { return b != static_cast<uint8_t>(i); })) {
+                    throw std::runtime_error{"received unexpected data"};
+                }
+            });
+            server.writeZC(size, [&](uint8_t *begin) {
+                std::fill(begin, begin + size, static_cast<uint8_t>(i + 1));
+                return size;
+            });
         }
+        exit(0);
     }
 
-    if (secs >= TIMEOUT_IN_SECONDS) {
-        std::cerr << "timeout" << std::endl;
-        kill(serverPid, SIGTERM);
-        kill(clientPid, SIGTERM);
-        return 1;
+    const auto clientPid = fork();
+    if (clientPid == 0) {
+        sleep(1); // server needs some time to start
+        auto client = SharedMemoryTransportClient<ZC_BUFFER_SIZE>();
+        client.connect("/tmp/zeroCopyPingPong");
+        for (size_t i = 0; i < ZC_MESSAGES; ++i) {
+            const auto size = zeroCopyMessageSize(i);
+            client.writeZC(size, [&](uint8_t *begin) {
+                std::fill(begin, begin + size, static_cast<uint8_t>(i));
+                return size;
+            });
+            client.readZC([&](const uint8_t *begin, const uint8_t *end) {
+                if (static_cast<size_t>(end - begin) != size ||
+                    std::any_of(begin, end, [&](uint8_t b) { return b != static_cast<uint8_t>(i + 1); })) {
+                    throw std::runtime_error{"received unexpected answer"};
+                }
+            });
+        }
+        exit(0);
     }
 
-    return serverStatus + clientStatus;
+    return waitForBoth(serverPid, clientPid);
 }
 
+int main() {
+    const auto pingPongStatus = pingPong();
+    if (pingPongStatus != 0) {
+        return pingPongStatus;
+    }
+    return zeroCopyPingPong();
+}
@@ -5,26 +5,29 @@
 
 using namespace std;
 using namespace l5::transport;
+using l5::util::tcp::Profile;
 
 const size_t MESSAGES = 256 * 1024; // ~ 1s
+// spinning readers compete for the cpu on small machines, so keep this short
+const size_t LOW_LATENCY_MESSAGES = 4 * 1024;
 const size_t TIMEOUT_IN_SECONDS = 5;
 
-int main() {
-    auto pong = Pong(make_transportServer<TcpTransportServer>("1234"));
+bool pingPong(Profile profile, const string &port, size_t messages) {
+    auto pong = Pong(make_transportServer<TcpTransportServer>(port, profile));
     const auto server = std::async(std::launch::async, [&]() {
         pong.start();
-        for (size_t i = 0; i < MESSAGES; ++i) {
+        for (size_t i = 0; i < messages; ++i) {
             pong.pong();
         }
-        return MESSAGES;
+        return messages;
     });
 
-    auto ping = Ping(make_transportClient<l5::transport::TcpTransportClient>(), "127.0.0.1:1234");
+    auto ping = Ping(make_transportClient<l5::transport::TcpTransportClient>(profile), "127.0.0.1:" + port);
     const auto client = std::async(std::launch::async, [&]() {
-        for (size_t i = 0; i < MESSAGES; ++i) {
+        for (size_t i = 0; i < messages; ++i) {
             ping.ping();
         }
-        return MESSAGES;
+        return messages;
     });
 
     const auto serverStatus = server.wait_for(std::chrono::seconds(TIMEOUT_IN_SECONDS));
@@ -32,8 +35,17 @@ int main() {
 
     if (serverStatus != std::future_status::ready || clientStatus != std::future_status::ready) {
         std::cerr << "timeout" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    if (not pingPong(Profile::Default, "1234", MESSAGES)) {
+        return -1;
+    }
+    if (not pingPong(Profile::LowLatency, "1235", LOW_LATENCY_MESSAGES)) {
         return -1;
     }
     return 0;
 }
-
@@ -0,0 +1,50 @@
+#ifndef L5RDMA_TESTHELPERS_H
+#define L5RDMA_TESTHELPERS_H
+
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+inline Deadline deadlineIn(std::chrono::seconds timeout) {
+    return std::chrono::steady_clock::now() + timeout;
+}
+
+/// get() the future, so its exception fails the test, or exit with "timeout", if it isn't ready by the deadline. A hung
+/// test can't just throw: the other threads stay blocked and the destructor of a std::async future waits for them
+template<typename Future>
+void waitOrDie(Future &future, Deadline deadline) {
+    if (future.wait_until(deadline) != std::future_status::ready) {
+        std::cerr << "timeout" << std::endl;
+        std::quick_exit(1);
+    }
+    future.get();
+}
+
+template<typename Future>
+void waitOrDie(std::vector<Future> &futures, Deadline deadline) {
+    for (auto &future : futures) {
+        waitOrDie(future, deadline);
+    }
+}
+
+/// Run test on its own thread, so a test, that hangs, fails after timeout
+template<typename Test>
+void runWithTimeout(std::chrono::seconds timeout, Test &&test) {
+    auto done = std::async(std::launch::async, std::forward<Test>(test));
+    waitOrDie(done, deadlineIn(timeout));
+}
+
+/// Connect client to server, which accepts on another thread meanwhile
+template<typename Server, typename Client>
+void connectPair(Server &server, Client &client, const std::string &connection) {
+    auto accepted = std::async(std::launch::async, [&] { server.accept(); });
+    client.connect(connection);
+    accepted.get();
+}
+
+#endif //L5RDMA_TESTHELPERS_H
@@ -0,0 +1,90 @@
+#include "include/DomainSocketsTransport.h"
+#include "include/SharedMemoryTransport.h"
+#include "include/TcpTransport.h"
+#include "test/testHelpers.h"
+#include <future>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+using l5::datastructure::Framing;
+using l5::datastructure::WaitMode;
+
+const size_t MESSAGES = 1024;
+const size_t TIMEOUT_IN_SECONDS = 5;
+
+struct Header {
+    size_t id;
+    size_t payloadSize;
+};
+
+size_t payloadSize(size_t i) {
+    return (i * 13) % 4096;
+}
+
+/// header + payload + trailer from three places, received with a single readv
+template<typename Server, typename Client>
+void testVectored(Server &server, Client &client, const std::string &connection) {
+    auto serverDone = std::async(std::launch::async, [&]() {
+        server.accept();
+        std::vector<uint8_t> payload(4096);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            Header header{};
+            size_t trailer;
+            server.read(header);
+            server.readv({{payload.data(), header.payloadSize}, {&trailer, sizeof(trailer)}});
+            if (header.id != i || header.payloadSize != payloadSize(i) || trailer != ~i ||
+                std::any_of(payload.begin(), payload.begin() + header.payloadSize, [&](uint8_t b) {
+                    return b != static_cast<uint8_t>(i);
+                })) {
+                throw std::runtime_error{"received unexpected data"};
+            }
+            server.write(trailer);
+        }
+    });
+
+    auto clientDone = std::async(std::launch::async, [&]() {
+        client.connect(connection);
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            const auto header = Header{i, payloadSize(i)};
+            const auto payload = std::vector<uint8_t>(header.payloadSize, static_cast<uint8_t>(i));
+            const size_t trailer = ~i;
+            client.writev({{&header, sizeof(header)}, {payload.data(), payload.size()}, {&trailer, sizeof(trailer)}});
+            size_t answer;
+            client.readv({{&answer, sizeof(answer)}});
+            if (answer != trailer) {
+                throw std::runtime_error{"received unexpected answer"};
+            }
+        }
+    });
+
+    const auto deadline = deadlineIn(std::chrono::seconds(TIMEOUT_IN_SECONDS));
+    waitOrDie(serverDone, deadline);
+    waitOrDie(clientDone, deadline);
+}
+
+int main() {
+    {
+        auto server = DomainSocketsTransportServer("/tmp/vectoredTest");
+        auto client = DomainSocketsTransportClient();
+        testVectored(server, client, "ipc:/tmp/vectoredTest");
+    }
+    {
+        auto server = TcpTransportServer("4712");
+        auto client = TcpTransportClient();
+        testVectored(server, client, "127.0.0.1:4712");
+    }
+    {
+        using l5::util::tcp::Profile;
+        auto server = TcpTransportServer("4730", Profile::LowLatency);
+        auto client = TcpTransportClient(Profile::LowLatency);
+        testVectored(server, client, "127.0.0.1:4730");
+    }
+    {
+        auto server = SharedMemoryTransportServer<64 * 1024>("/tmp/vectoredTest");
+        auto client = SharedMemoryTransportClient<64 * 1024>();
+        testVectored(server, client, "shm:/tmp/vectoredTest");
+    }
+    return 0;
+}
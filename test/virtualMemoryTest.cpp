@@ -0,0 +1,110 @@
+#include "util/virtualMemory.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+
+using namespace std;
+using namespace l5::util;
+
+const size_t SIZE = 64 * 1024;
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t openFds() {
+    size_t count = 0;
+    const auto dir = opendir("/proc/self/fd");
+    while (readdir(dir) != nullptr) {
+        ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+template<typename Function>
+bool throws(Function &&function) {
+    try {
+        function();
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+/// the memory can't shrink anymore, and the seals can't be removed
+void testSealing() {
+    const auto fd = createSharedMemory("sealingTest", SIZE);
+    const auto seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0 || (seals & F_SEAL_SEAL) == 0) {
+        throw std::runtime_error{"shared memory isn't sealed"};
+    }
+    if (ftruncate(fd, SIZE / 2) == 0) {
+        throw std::runtime_error{"sealed shared memory could shrink"};
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE) == 0) {
+        throw std::runtime_error{"seals could be changed"};
+    }
+    checkSharedMemory(fd, SIZE);
+    ::close(fd);
+}
+
+/// received file descriptors, that might shrink or are too small, would SIGBUS the receiver
+void testCheckRejects() {
+    const auto unsealed = memfd_create("unsealedTest", MFD_CLOEXEC);
+    if (unsealed < 0 || ftruncate(unsealed, SIZE) != 0) {
+        throw std::runtime_error{"creating unsealed memory failed"};
+    }
+    if (not throws([&] { checkSharedMemory(unsealed, SIZE); })) {
+        throw std::runtime_error{"accepted unsealed shared memory"};
+    }
+    ::close(unsealed);
+
+    const auto shortFd = createSharedMemory("shortTest", SIZE);
+    if (not throws([&] { checkSharedMemory(shortFd, SIZE * 2); })) {
+        throw std::runtime_error{"accepted too small shared memory"};
+    }
+    if (not throws([&] { mmapRingBuffer(shortFd, SIZE * 2); })) {
+        throw std::runtime_error{"mapped too small shared memory"};
+    }
+    ::close(shortFd);
+}
+
+/// huge pages need sizes in multiples of the huge page size, and reserved huge pages to map them
+void testHugePages() {
+    if (not throws([] { createSharedMemory("hugeTest", SIZE, PageSize::Huge2MB); })) {
+        throw std::runtime_error{"accepted a size smaller than a huge page"};
+    }
+
+    const auto before = openFds();
+    try {
+        auto buffer = mmapSharedRingBuffer("hugeTest", HUGE_PAGE_SIZE, true, {PageSize::Huge2MB, true, false});
+        // the second mapping follows the first one directly
+        buffer.data.get()[0] = 42;
+        if (buffer.data.get()[HUGE_PAGE_SIZE] != 42) {
+            throw std::runtime_error{"huge page wraparound doesn't map the same memory"};
+        }
+    } catch (const std::runtime_error &e) {
+        // without reserved huge pages (vm.nr_hugepages), creating or mapping fails
+        std::cerr << "huge pages unavailable: " << e.what() << std::endl;
+    }
+    if (openFds() != before) {
+        throw std::runtime_error{"leaked the shared memory file descriptor"};
+    }
+}
+
+/// a failing mapping must not leak the shared memory it just created
+void testNoLeakOnFailure() {
+    const auto before = openFds();
+    if (not throws([] { mmapSharedRingBuffer("leakTest", SIZE + 1); })) {
+        throw std::runtime_error{"mapped a size, that isn't a multiple of the page size"};
+    }
+    if (openFds() != before) {
+        throw std::runtime_error{"leaked the shared memory file descriptor"};
+    }
+}
+
+int main() {
+    testSealing();
+    testCheckRejects();
+    testHugePages();
+    testNoLeakOnFailure();
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "include/TcpTransport.h"
+#include "test/testHelpers.h"
+#include <algorithm>
+#include <future>
+#include <vector>
+
+using namespace std;
+using namespace l5::transport;
+
+const size_t CHUNKS = 64;
+const size_t CHUNK_SIZE = 256 * 1024;
+const char *port = "4719";
+
+int main() {
+    auto server = TcpTransportServer(port);
+    auto client = TcpTransportClient();
+    connectPair(server, client, string("127.0.0.1:") + port);
+    // enabled after accept, and with a threshold, so the small writes are copied
+    server.enableZeroCopy(1024);
+
+    auto receiver = async(launch::async, [&]() {
+        vector<uint8_t> buffer(CHUNK_SIZE);
+        for (size_t chunk = 0; chunk < CHUNKS; ++chunk) {
+            const auto size = chunk % 2 == 0 ? CHUNK_SIZE : 100;
+            client.read(buffer.data(), size);
+            if (not all_of(buffer.begin(), buffer.begin() + size, [&](uint8_t b) { return b == uint8_t(chunk); })) {
+                throw runtime_error{"received unexpected data"};
+            }
+        }
+    });
+
+    vector<uint8_t> buffer(CHUNK_SIZE);
+    for (size_t chunk = 0; chunk < CHUNKS; ++chunk) {
+        const auto size = chunk % 2 == 0 ? CHUNK_SIZE : 100;
+        fill(buffer.begin(), buffer.begin() + size, uint8_t(chunk));
+        const auto ticket = server.writeZeroCopy(buffer.data(), size);
+        // only overwrite the buffer, when the kernel is done with it
+        server.waitUntilReusable(ticket);
+        if (not server.reusable(ticket)) {
+            throw runtime_error{"buffer isn't reusable after waiting for it"};
+        }
+    }
+
+    waitOrDie(receiver, deadlineIn(10s));
+    return 0;
+}
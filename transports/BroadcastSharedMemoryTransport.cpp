@@ -0,0 +1,54 @@
+#include "include/BroadcastSharedMemoryTransport.h"
+#include "util/socket/domain.h"
+
+namespace l5 {
+namespace transport {
+using namespace util;
+using namespace datastructure;
+
+BroadcastSharedMemoryTransportServer::BroadcastSharedMemoryTransportServer(std::string_view domainSocket,
+                                                                           size_t bufferSize,
+                                                                           LaggingReaders lagging)
+        : listenSock(domain::socket()),
+          file(domainSocket),
+          ring(bufferSize, lagging) {
+    domain::bind(listenSock, file);
+    domain::listen(listenSock);
+}
+
+BroadcastSharedMemoryTransportServer::~BroadcastSharedMemoryTransportServer() {
+    if (listenSock.get() >= 0) {
+        ::unlink(file.c_str());
+    }
+}
+
+void BroadcastSharedMemoryTransportServer::accept() {
+    // the socket is only needed for bootstrapping, the client detaches via the shared memory
+    const auto acced = domain::accept(listenSock);
+    ring.addReader(acced);
+}
+
+void BroadcastSharedMemoryTransportServer::finishListen() {
+    listenSock.close();
+    domain::unlink(file);
+}
+
+void BroadcastSharedMemoryTransportServer::send(const uint8_t *data, size_t size) {
+    ring.send(data, size);
+}
+
+BroadcastSharedMemoryTransportClient::BroadcastSharedMemoryTransportClient() : sock(domain::socket()) {}
+
+void BroadcastSharedMemoryTransportClient::connect(std::string_view whereTo) {
+    const auto pos = whereTo.find(':');
+    const auto file = std::string(whereTo.substr(pos == std::string_view::npos ? 0 : pos + 1));
+    domain::connect(sock, file);
+
+    ring = std::make_unique<BroadcastRingBufferReader>(sock);
+}
+
+size_t BroadcastSharedMemoryTransportClient::receive(void *whereTo, size_t maxSize) {
+    return ring->receive(whereTo, maxSize);
+}
+} // namespace transport
+} // namespace l5
@@ -5,9 +5,12 @@ namespace l5 {
 namespace transport {
 using namespace util;
 
-DomainSocketsTransportServer::DomainSocketsTransportServer(std::string file) :
+DomainSocketsTransportServer::DomainSocketsTransportServer(std::string file, domain::FdPassing fdPassing) :
         initialSocket(domain::socket()),
         file(std::move(file)) {
+    if (fdPassing.enabled()) {
+        this->fdPassing.emplace(fdPassing);
+    }
     domain::bind(initialSocket, this->file);
     domain::listen(initialSocket);
 }
@@ -16,21 +19,82 @@ DomainSocketsTransportServer::~DomainSocketsTransportServer() = default;
 
 void DomainSocketsTransportServer::accept_impl() {
     communicationSocket = domain::accept(initialSocket);
+    pendingRead = {};
+    pendingWrite = {};
 }
 
 void DomainSocketsTransportServer::write_impl(const uint8_t *data, size_t size) {
+    if (fdPassing) {
+        fdPassing->write(communicationSocket, data, size);
+        return;
+    }
     domain::write(communicationSocket, data, size);
 }
 
 void DomainSocketsTransportServer::read_impl(uint8_t *buffer, size_t size) {
+    if (fdPassing) {
+        fdPassing->read(communicationSocket, buffer, size);
+        return;
+    }
     domain::read(communicationSocket, buffer, size);
 }
 
+void DomainSocketsTransportServer::writev_impl(const ConstSegment *segments, size_t count) {
+    if (fdPassing) {
+        fdPassing->writev(communicationSocket, segments, count);
+        return;
+    }
+    domain::writev(communicationSocket, segments, count);
+}
+
+void DomainSocketsTransportServer::readv_impl(const MutableSegment *segments, size_t count) {
+    if (fdPassing) {
+        fdPassing->readv(communicationSocket, segments, count);
+        return;
+    }
+    domain::readv(communicationSocket, segments, count);
+}
+
+bool DomainSocketsTransportServer::tryRead_impl(uint8_t *buffer, size_t size) {
+    if (fdPassing) {
+        return fdPassing->tryRead(communicationSocket, buffer, size);
+    }
+    return domain::tryRead(communicationSocket, buffer, size, pendingRead);
+}
+
+bool DomainSocketsTransportServer::tryWrite_impl(const uint8_t *data, size_t size) {
+    if (fdPassing) {
+        return fdPassing->tryWrite(communicationSocket, data, size);
+    }
+    return domain::tryWrite(communicationSocket, data, size, pendingWrite);
+}
+
+bool DomainSocketsTransportServer::readable_impl() {
+    if (fdPassing) {
+        return fdPassing->readable(communicationSocket);
+    }
+    return domain::readable(communicationSocket);
+}
+
+bool DomainSocketsTransportServer::writable_impl() {
+    if (fdPassing) {
+        return fdPassing->writable(communicationSocket);
+    }
+    return domain::writable(communicationSocket);
+}
+
 size_t DomainSocketsTransportServer::readSome_impl(uint8_t *buffer, size_t maxSize) {
+    if (fdPassing) {
+        return fdPassing->readSome(communicationSocket, buffer, maxSize);
+    }
     return domain::readSome(communicationSocket, buffer, maxSize);
 }
 
-DomainSocketsTransportClient::DomainSocketsTransportClient() : socket(domain::socket()) {}
+DomainSocketsTransportClient::DomainSocketsTransportClient(domain::FdPassing fdPassing) : socket(domain::socket()) {
+    if (fdPassing.enabled()) {
+        this->fdPassing.emplace(fdPassing);
+    }
+}
 
 DomainSocketsTransportClient::~DomainSocketsTransportClient() = default;
 
@@ -42,15 +106,122 @@ void DomainSocketsTransportClient::connect_impl(std::string file) {
 }
 
 void DomainSocketsTransportClient::write_impl(const uint8_t *data, size_t size) {
+    if (fdPassing) {
+        fdPassing->write(socket, data, size);
+        return;
+    }
     domain::write(socket, data, size);
 }
 
 void DomainSocketsTransportClient::read_impl(uint8_t *buffer, size_t size) {
+    if (fdPassing) {
+        fdPassing->read(socket, buffer, size);
+        return;
+    }
     domain::read(socket, buffer, size);
 }
 
+void DomainSocketsTransportClient::writev_impl(const ConstSegment *segments, size_t count) {
+    if (fdPassing) {
+        fdPassing->writev(socket, segments, count);
+        return;
+    }
+    domain::writev(socket, segments, count);
+}
+
+void DomainSocketsTransportClient::readv_impl(const MutableSegment *segments, size_t count) {
+    if (fdPassing) {
+        fdPassing->readv(socket, segments, count);
+        return;
+    }
+    domain::readv(socket, segments, count);
+}
+
+bool DomainSocketsTransportClient::tryRead_impl(uint8_t *buffer, size_t size) {
+    if (fdPassing) {
+        return fdPassing->tryRead(socket, buffer, size);
+    }
+    return domain::tryRead(socket, buffer, size, pendingRead);
+}
+
+bool DomainSocketsTransportClient::tryWrite_impl(const uint8_t *data, size_t size) {
+    if (fdPassing) {
+        return fdPassing->tryWrite(socket, data, size);
+    }
+    return domain::tryWrite(socket, data, size, pendingWrite);
+}
+
+bool DomainSocketsTransportClient::readable_impl() {
+    if (fdPassing) {
+        return fdPassing->readable(socket);
+    }
+    return domain::readable(socket);
+}
+
+bool DomainSocketsTransportClient::writable_impl() {
+    if (fdPassing) {
+        return fdPassing->writable(socket);
+    }
+    return domain::writable(socket);
+}
+
 size_t DomainSocketsTransportClient::readSome_impl(uint8_t *buffer, size_t size) {
+    if (fdPassing) {
+        return fdPassing->readSome(socket, buffer, size);
+    }
     return domain::readSome(socket, buffer, size);
 }
+
+DomainSocketsMessageTransportServer::DomainSocketsMessageTransportServer(std::string file) :
+        initialSocket(domain::seqPacketSocket()),
+        file(std::move(file)) {
+    domain::bind(initialSocket, this->file);
+    domain::listen(initialSocket);
+}
+
+void DomainSocketsMessageTransportServer::accept() {
+    communicationSocket = domain::accept(initialSocket);
+}
+
+void DomainSocketsMessageTransportServer::send(const uint8_t *data, size_t size) {
+    domain::send(communicationSocket, data, size);
+}
+
+size_t DomainSocketsMessageTransportServer::receive(void *whereTo, size_t maxSize) {
+    return domain::receive(communicationSocket, whereTo, maxSize);
+}
+
+void DomainSocketsMessageTransportServer::sendBatch(const ConstSegment *messages, size_t count) {
+    domain::sendBatch(communicationSocket, messages, count);
+}
+
+size_t DomainSocketsMessageTransportServer::receiveBatch(const MutableSegment *buffers, size_t count, size_t *sizes) {
+    return domain::receiveBatch(communicationSocket, buffers, count, sizes);
+}
+
+DomainSocketsMessageTransportClient::DomainSocketsMessageTransportClient() : socket(domain::seqPacketSocket()) {}
+
+void DomainSocketsMessageTransportClient::connect(std::string file) {
+    const auto pos = file.find(':');
+    const auto whereTo = std::string(file.begin() + pos + 1, file.end());
+    domain::connect(socket, whereTo);
+    domain::unlink(whereTo);
+}
+
+void DomainSocketsMessageTransportClient::send(const uint8_t *data, size_t size) {
+    domain::send(socket, data, size);
+}
+
+size_t DomainSocketsMessageTransportClient::receive(void *whereTo, size_t maxSize) {
+    return domain::receive(socket, whereTo, maxSize);
+}
+
+void DomainSocketsMessageTransportClient::sendBatch(const ConstSegment *messages, size_t count) {
+    domain::sendBatch(socket, messages, count);
+}
+
+size_t DomainSocketsMessageTransportClient::receiveBatch(const MutableSegment *buffers, size_t count, size_t *sizes) {
+    return domain::receiveBatch(socket, buffers, count, sizes);
+}
 } // namespace transport
 } // namespace l5
@@ -1,9 +1,99 @@
 #include "include/LibRdmacmTransport.h"
+#include "util/socket/vectoredIo.h"
 
+#include <cerrno>
 #include <netdb.h>
+#include <poll.h>
 
 namespace l5 {
 namespace transport {
+namespace {
+// rsocket calls return early, e.g. rrecv with whatever arrived so far, so all of these continue with the rest
+void writeRsocket(int socket, const uint8_t *data, size_t size) {
+    for (size_t done = 0; done < size;) {
+        const auto written = rwrite(socket, data + done, size - done);
+        if (written <= 0) {
+            perror("rwrite");
+            throw std::runtime_error{"rwrite failed"};
+        }
+        done += static_cast<size_t>(written);
+    }
+}
+
+void readRsocket(int socket, uint8_t *buffer, size_t size) {
+    for (size_t done = 0; done < size;) {
+        const auto received = rread(socket, buffer + done, size - done);
+        if (received < 0) {
+            perror("rread");
+            throw std::runtime_error{"rread failed"};
+        }
+        if (received == 0) {
+            throw std::runtime_error{"connection closed"};
+        }
+        done += static_cast<size_t>(received);
+    }
+}
+
+void writevRsocket(int socket, const util::ConstSegment *segments, size_t count) {
+    util::transferSegments(segments, count, [&](msghdr &msg) {
+        const auto written = rwritev(socket, msg.msg_iov, static_cast<int>(msg.msg_iovlen));
+        if (written < 0) {
+            perror("rwritev");
+            throw std::runtime_error{"rwritev failed"};
+        }
+        return static_cast<size_t>(written);
+    });
+}
+
+void readvRsocket(int socket, const util::MutableSegment *segments, size_t count) {
+    util::transferSegments(segments, count, [&](msghdr &msg) {
+        const auto received = rreadv(socket, msg.msg_iov, static_cast<int>(msg.msg_iovlen));
+        if (received < 0) {
+            perror("rreadv");
+            throw std::runtime_error{"rreadv failed"};
+        }
+        return static_cast<size_t>(received);
+    });
+}
+
+bool tryReadRsocket(int socket, uint8_t *buffer, size_t size, util::PartialTransfer &transfer) {
+    return transfer.advance(size, [&](size_t offset) -> size_t {
+        const auto received = rrecv(socket, buffer + offset, size - offset, MSG_DONTWAIT);
+        if (received < 0) {
+            if (errno == EAGAIN) return 0;
+            perror("rrecv");
+            throw std::runtime_error{"rrecv failed"};
+        }
+        if (received == 0 && offset < size) {
+            throw std::runtime_error{"connection closed"};
+        }
+        return static_cast<size_t>(received);
+    });
+}
+
+bool tryWriteRsocket(int socket, const uint8_t *data, size_t size, util::PartialTransfer &transfer) {
+    return transfer.advance(size, [&](size_t offset) -> size_t {
+        const auto written = rsend(socket, data + offset, size - offset, MSG_DONTWAIT);
+        if (written < 0) {
+            if (errno == EAGAIN) return 0;
+            perror("rsend");
+            throw std::runtime_error{"rsend failed"};
+        }
+        return static_cast<size_t>(written);
+    });
+}
+
+bool pollRsocket(int socket, short events) {
+    pollfd pollFd{socket, events, 0};
+    const auto res = rpoll(&pollFd, 1, 0);
+    if (res < 0) {
+        perror("rpoll");
+        throw std::runtime_error{"rpoll failed"};
+    }
+    return res > 0;
+}
+} // namespace
+
 LibRdmacmTransportClient::LibRdmacmTransportClient() = default;
 
 LibRdmacmTransportClient::~LibRdmacmTransportClient() {
@@ -38,11 +128,35 @@ void LibRdmacmTransportClient::connect_impl(std::string_view connection) {
 }
 
 void LibRdmacmTransportClient::write_impl(const uint8_t *data, size_t size) {
-    rwrite(rdmaSocket, data, size);
+    writeRsocket(rdmaSocket, data, size);
 }
 
 void LibRdmacmTransportClient::read_impl(uint8_t *buffer, size_t size) {
-    rread(rdmaSocket, buffer, size);
+    readRsocket(rdmaSocket, buffer, size);
+}
+
+void LibRdmacmTransportClient::writev_impl(const util::ConstSegment *segments, size_t count) {
+    writevRsocket(rdmaSocket, segments, count);
+}
+
+void LibRdmacmTransportClient::readv_impl(const util::MutableSegment *segments, size_t count) {
+    readvRsocket(rdmaSocket, segments, count);
+}
+
+bool LibRdmacmTransportClient::tryRead_impl(uint8_t *buffer, size_t size) {
+    return tryReadRsocket(rdmaSocket, buffer, size, pendingRead);
+}
+
+bool LibRdmacmTransportClient::tryWrite_impl(const uint8_t *data, size_t size) {
+    return tryWriteRsocket(rdmaSocket, data, size, pendingWrite);
+}
+
+bool LibRdmacmTransportClient::readable_impl() {
+    return pollRsocket(rdmaSocket, POLLIN);
+}
+
+bool LibRdmacmTransportClient::writable_impl() {
+    return pollRsocket(rdmaSocket, POLLOUT);
 }
 
 LibRdmacmTransportServer::LibRdmacmTransportServer(std::string_view port) {
@@ -87,14 +201,39 @@ void LibRdmacmTransportServer::accept_impl() {
     sockaddr ignored{};
     socklen_t len = sizeof(ignored);
     commSocket = raccept(rdmaSocket, &ignored, &len);
+    pendingRead = {};
+    pendingWrite = {};
 }
 
 void LibRdmacmTransportServer::write_impl(const uint8_t *data, size_t size) {
-    rwrite(commSocket, data, size);
+    writeRsocket(commSocket, data, size);
 }
 
 void LibRdmacmTransportServer::read_impl(uint8_t *buffer, size_t size) {
-    rread(commSocket, buffer, size);
+    readRsocket(commSocket, buffer, size);
+}
+void LibRdmacmTransportServer::writev_impl(const util::ConstSegment *segments, size_t count) {
+    writevRsocket(commSocket, segments, count);
+}
+
+void LibRdmacmTransportServer::readv_impl(const util::MutableSegment *segments, size_t count) {
+    readvRsocket(commSocket, segments, count);
+}
+
+bool LibRdmacmTransportServer::tryRead_impl(uint8_t *buffer, size_t size) {
+    return tryReadRsocket(commSocket, buffer, size, pendingRead);
+}
+
+bool LibRdmacmTransportServer::tryWrite_impl(const uint8_t *data, size_t size) {
+    return tryWriteRsocket(commSocket, data, size, pendingWrite);
+}
+
+bool LibRdmacmTransportServer::readable_impl() {
+    return pollRsocket(commSocket, POLLIN);
+}
+
+bool LibRdmacmTransportServer::writable_impl() {
+    return pollRsocket(commSocket, POLLOUT);
 }
 } // namespace l5
 } // namespace transport
@@ -5,8 +5,10 @@
 namespace l5::transport {
 using namespace util;
 
-MulticlientRDMARecvTransportServer::MulticlientRDMARecvTransportServer(const std::string& port, size_t maxClients)
+MulticlientRDMARecvTransportServer::MulticlientRDMARecvTransportServer(const std::string& port, size_t maxClients,
+                                                                       uint32_t signalingWatermark)
    : MAX_CLIENTS(maxClients),
+     signalingWatermark(signalingWatermark),
      listenSock(Socket::create()),
      net(),
      sharedCq(&net.getSharedCompletionQueue()),
@@ -50,7 +52,9 @@ void MulticlientRDMARecvTransportServer::accept() {
    connection.answerWr.setLocalAddress(sendBuffer.getSlice());
    connection.answerWr.setRemoteAddress(receiveAddr);
    connection.answerWr.setInline();
-   connection.answerWr.setSignaled();
+   connection.answerWr.setId(clientId);
+   connection.signaling = std::make_unique<rdma::SelectiveSignaling>(*sharedCq, clientId, connection.qp.getMaxSendWrs(),
+                                                                     signalingWatermark);
 
    connection.qp.connect(address);
 }
@@ -98,16 +102,9 @@ void MulticlientRDMARecvTransportServer::send(size_t receiverId, const uint8_t*
    *validityPtr = validity;
 
    con.answerWr.setLocalAddress(sendBuffer.getSlice(0, totalLength));
-   // selective signaling needs to happen per queuepair / connection
-   ++con.sendCounter;
-   if (con.sendCounter % 1024 == 0) {
-      setWrFlags(con.answerWr, true, totalLength < 512);
-      con.qp.postWorkRequest(con.answerWr);
-      sharedCq->pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode::RDMA_WRITE);
-   } else {
-      setWrFlags(con.answerWr, false, totalLength < 512);
-      con.qp.postWorkRequest(con.answerWr);
-   }
+   // reaps the completions without blocking, unless the send queue is full
+   setWrFlags(con.answerWr, con.signaling->prepare(), totalLength < 512);
+   con.qp.postWorkRequest(con.answerWr);
 }
 
 void MulticlientRDMARecvTransportServer::finishListen() {
@@ -1,13 +1,16 @@
 #include <cassert>
 #include "include/MulticlientRDMATransport.h"
+#include "util/copy.h"
 #include "util/socket/tcp.h"
 
 namespace l5 {
 namespace transport {
 using namespace util;
 
-MulticlientRDMATransportServer::MulticlientRDMATransportServer(const std::string &port, size_t maxClients)
+MulticlientRDMATransportServer::MulticlientRDMATransportServer(const std::string &port, size_t maxClients,
+                                                               uint32_t signalingWatermark)
         : MAX_CLIENTS(maxClients),
+          signalingWatermark(signalingWatermark),
           listenSock(Socket::create()),
           net(),
           sharedCq(&net.getSharedCompletionQueue()),
@@ -48,9 +51,11 @@ void MulticlientRDMATransportServer::accept() {
     answer.setLocalAddress(sendBuffer.getSlice());
     answer.setRemoteAddress(receiveAddr);
     answer.setInline();
-    answer.setSignaled();
+    answer.setId(clientId);
 
-    connections.emplace_back(std::move(acced), std::move(qp), answer);
+    auto &connection = connections.emplace_back(std::move(acced), std::move(qp), answer);
+    connection.signaling = std::make_unique<rdma::SelectiveSignaling>(*sharedCq, clientId,
+                                                                      connection.qp.getMaxSendWrs(), signalingWatermark);
 }
 
 MulticlientRDMATransportServer::~MulticlientRDMATransportServer() = default;
@@ -98,7 +103,7 @@ MultiClientRDMATransportClient::MultiClientRDMATransportClient()
           dataWr(),
           doorBellWr() {
     dataWr.setLocalAddress(sendBuffer.getSlice());
-    dataWr.setSignaled();
+    // only the door bell is signaled. Its completion implies the data write's on a reliable connection
     dataWr.setInline();
 
     doorBellWr.setLocalAddress(doorBell.getSlice());
@@ -140,8 +145,37 @@ void MultiClientRDMATransportClient::connect(const std::string &ip, uint16_t por
     rdmaConnect();
 }
 
+void MultiClientRDMATransportClient::postWithDoorBell(size_t dataWrSize) {
+    dataWr.setLocalAddress(sendBuffer.getSlice(0, dataWrSize));
+    dataWr.setNext(&doorBellWr);
+    doorBell.data()[0] = 'X'; // could be anything, really
+    qp.postWorkRequest(dataWr); // transitively also posts doorBellWr
+
+    cq.pollSendCompletionQueueBlocking(ibv::workcompletion::Opcode::RDMA_WRITE);
+}
+
+void MultiClientRDMATransportClient::sendBatch(const ConstSegment *messages, size_t count) {
+    if (count == 0) return;
+    const auto dataWrSize = 2 * sizeof(size_t) + count * sizeof(size_t) + totalSize(messages, count);
+    if (dataWrSize > MAX_MESSAGESIZE) {
+        throw std::runtime_error("can't send batches > MAX_MESSAGESIZE");
+    }
+
+    const auto sizePtr = reinterpret_cast<size_t *>(sendBuffer.data());
+    auto frame = sendBuffer.data() + 2 * sizeof(size_t);
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(frame, &messages[i].size, sizeof(size_t));
+        const auto begin = reinterpret_cast<const uint8_t *>(messages[i].data);
+        frame = copyBytes(begin, begin + messages[i].size, frame + sizeof(size_t));
+    }
+    sizePtr[0] = dataWrSize - 2 * sizeof(size_t);
+    sizePtr[1] = count;
+
+    postWithDoorBell(dataWrSize);
+}
+
 void MultiClientRDMATransportClient::send(const uint8_t *data, size_t size) {
-    const auto dataWrSize = size + sizeof(size_t);
+    const auto dataWrSize = size + 2 * sizeof(size_t);
     if (dataWrSize > MAX_MESSAGESIZE) {
         throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
     }
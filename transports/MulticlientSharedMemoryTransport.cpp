@@ -0,0 +1,139 @@
+#include "include/MulticlientSharedMemoryTransport.h"
+#include "util/copy.h"
+#include "util/socket/domain.h"
+
+namespace l5 {
+namespace transport {
+using namespace util;
+using namespace multiclientshm;
+
+MulticlientSharedMemoryTransportServer::MulticlientSharedMemoryTransportServer(std::string_view domainSocket,
+                                                                               size_t maxClients)
+        : MAX_CLIENTS(maxClients),
+          listenSock(domain::socket()),
+          file(domainSocket),
+          doorBells(malloc_shared<char>("/multiclientDoorBells", maxClients)) {
+    if (maxClients == 0 || maxClients % 16 != 0) {
+        // the door bells are polled 16 at once
+        throw std::runtime_error("maxClients needs to be a multiple of 16");
+    }
+    domain::bind(listenSock, file);
+    domain::listen(listenSock);
+}
+
+MulticlientSharedMemoryTransportServer::~MulticlientSharedMemoryTransportServer() {
+    if (listenSock.get() >= 0) {
+        ::unlink(file.c_str());
+    }
+}
+
+void MulticlientSharedMemoryTransportServer::accept() {
+    const auto clientId = connections.size();
+    if (clientId >= MAX_CLIENTS) {
+        throw std::runtime_error("can't accept more than MAX_CLIENTS clients");
+    }
+
+    auto acced = domain::accept(listenSock);
+
+    // freshly created shared memory is zeroed, so don't touch all the pages
+    auto mailbox = malloc_shared<Mailbox>(createSharedMemory("/multiclientMailbox", sizeof(Mailbox)),
+                                          sizeof(Mailbox));
+
+    domain::send_fd(acced, doorBells.fd);
+    domain::send_fd(acced, mailbox.fd);
+    domain::write(acced, ConnectionInfo{clientId, MAX_CLIENTS});
+
+    connections.emplace_back(std::move(acced), std::move(mailbox));
+}
+
+void MulticlientSharedMemoryTransportServer::finishListen() {
+    listenSock.close();
+    domain::unlink(file);
+}
+
+size_t MulticlientSharedMemoryTransportServer::receive(void *whereTo, size_t maxSize) {
+    size_t res;
+    receive([&](auto sender, auto begin, auto end) {
+        res = sender;
+        const auto size = static_cast<size_t>(std::distance(begin, end));
+        if (maxSize < size) {
+            throw std::runtime_error("received message > maxSize");
+        }
+        copyBytes(begin, end, reinterpret_cast<uint8_t *>(whereTo));
+    });
+    return res;
+}
+
+void MulticlientSharedMemoryTransportServer::send(size_t receiverId, const uint8_t *data, size_t size) {
+    if (size > MAX_MESSAGESIZE) {
+        throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
+    }
+
+    send(receiverId, [&](auto begin) {
+        copyBytes(data, data + size, begin);
+        return size;
+    });
+}
+
+MulticlientSharedMemoryTransportClient::MulticlientSharedMemoryTransportClient() : sock(domain::socket()) {}
+
+void MulticlientSharedMemoryTransportClient::connect(std::string_view whereTo) {
+    const auto pos = whereTo.find(':');
+    const auto file = std::string(whereTo.substr(pos == std::string_view::npos ? 0 : pos + 1));
+    domain::connect(sock, file);
+
+    const auto doorBellsFd = domain::receive_fd(sock);
+    const auto mailboxFd = domain::receive_fd(sock);
+    const auto info = domain::read<ConnectionInfo>(sock);
+
+    clientId = info.clientId;
+    doorBells = malloc_shared<char>(doorBellsFd, info.maxClients);
+    mailbox = malloc_shared<Mailbox>(mailboxFd, sizeof(Mailbox));
+}
+
+void MulticlientSharedMemoryTransportClient::send(const uint8_t *data, size_t size) {
+    if (size > MAX_MESSAGESIZE) {
+        throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
+    }
+
+    send([&](auto begin) {
+        copyBytes(data, data + size, begin);
+        return size;
+    });
+}
+
+void MulticlientSharedMemoryTransportClient::sendBatch(const ConstSegment *messages, size_t count) {
+    if (count == 0) return;
+    if (totalSize(messages, count) + count * sizeof(size_t) > MAX_MESSAGESIZE) {
+        throw std::runtime_error("can't send batches > MAX_MESSAGESIZE");
+    }
+    // wait until the server consumed our previous request
+    loop_while([] {}, [&]() { return doorBell() != '\0'; });
+
+    auto &request = mailbox.data->request;
+    auto frame = request.data;
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(frame, &messages[i].size, sizeof(size_t));
+        const auto begin = reinterpret_cast<const uint8_t *>(messages[i].data);
+        frame = copyBytes(begin, begin + messages[i].size, frame + sizeof(size_t));
+    }
+    request.size = static_cast<size_t>(frame - request.data);
+    request.frames = count;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    doorBell() = 'X';
+}
+
+size_t MulticlientSharedMemoryTransportClient::receive(void *whereTo, size_t maxSize) {
+    size_t size;
+    receive([&](auto begin, auto end) {
+        size = static_cast<size_t>(std::distance(begin, end));
+        if (size > maxSize) {
+            throw std::runtime_error("received message > maxSize");
+        }
+        copyBytes(begin, end, reinterpret_cast<uint8_t *>(whereTo));
+    });
+    return size;
+}
+} // namespace transport
+} // namespace l5
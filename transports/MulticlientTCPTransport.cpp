@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <climits>
 #include <string>
 #include <arpa/inet.h>
 #include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include "util/socket/ioUring.h"
 #include "util/socket/tcp.h"
 #include "include/MulticlientTCPTransport.h"
 
@@ -9,8 +15,45 @@ namespace transport {
 using namespace std::string_literals;
 using namespace util;
 
-MulticlientTCPTransportServer::MulticlientTCPTransportServer(std::string_view port) :
-        serverSocket(Socket::create()) {
+namespace {
+/// Messages are prefixed with their size
+using Header = size_t;
+/// Read at least this many bytes at once, so small messages are batched into few syscalls
+constexpr size_t minimumRead = 4 * 1024;
+constexpr int maxEvents = 64;
+/// io_uring: room for a receive and a send per connection, more are submitted in several steps
+constexpr unsigned ringEntries = 256;
+constexpr uint16_t receiveGroup = 0;
+constexpr uint16_t receiveBufferCount = 256;
+/// Marks events of the listen socket, instead of a connection
+constexpr uint64_t listenerTag = ~uint64_t(0);
+
+Socket createEpoll() {
+    auto epoll = Socket::fromRaw(::epoll_create1(EPOLL_CLOEXEC));
+    if (epoll.get() < 0) {
+        throw std::runtime_error("Could not create epoll instance: "s + ::strerror(errno));
+    }
+    return epoll;
+}
+
+bool hasMessage(const std::vector<uint8_t> &buffer, size_t begin, size_t end) {
+    if (end - begin < sizeof(Header)) return false;
+    Header size;
+    std::memcpy(&size, &buffer[begin], sizeof(size));
+    // sizeof(Header) + size would overflow for hostile sizes
+    return end - begin - sizeof(Header) >= size;
+}
+} // namespace
+
+MulticlientTCPTransportServer::MulticlientTCPTransportServer(std::string_view port, MulticlientTcpBackend backend,
+                                                             MulticlientTcpAccept acceptMode) :
+        serverSocket(Socket::create()),
+        acceptMode(acceptMode),
+        epoll(backend == MulticlientTcpBackend::Epoll ? createEpoll() : Socket()) {
+    if (backend == MulticlientTcpBackend::IoUring) {
+        uring = std::make_unique<IoUring>(ringEntries);
+        receiveBuffers = std::make_unique<ProvidedBuffers>(*uring, receiveGroup, receiveBufferCount, minimumRead);
+    }
     auto p = std::stoi(std::string(port.data(), port.size()));
     listen(p);
 }
@@ -21,50 +64,361 @@ void MulticlientTCPTransportServer::listen(uint16_t port) {
     addr.sin_port = htons(port);
     addr.sin_addr.s_addr = INADDR_ANY;
 
+    if (acceptMode == MulticlientTcpAccept::Automatic) {
+        // the kernel balances the connections across all listen sockets with SO_REUSEPORT on the same port
+        const int enable = 1;
+        if (::setsockopt(serverSocket.get(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            throw std::runtime_error("Could not set SO_REUSEPORT: "s + ::strerror(errno));
+        }
+    }
     tcp::bind(serverSocket, addr);
     tcp::listen(serverSocket);
+
+    if (acceptMode == MulticlientTcpAccept::Explicit) return;
+    if (uring) {
+        armAccept();
+        return;
+    }
+    // accepting happens in acceptPending, which must not block
+    if (::fcntl(serverSocket.get(), F_SETFL, ::fcntl(serverSocket.get(), F_GETFL) | O_NONBLOCK) < 0) {
+        throw std::runtime_error("Could not make listen socket non-blocking: "s + ::strerror(errno));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = listenerTag;
+    if (::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, serverSocket.get(), &event) < 0) {
+        throw std::runtime_error("Could not add socket to epoll: "s + ::strerror(errno));
+    }
 }
 
-MulticlientTCPTransportServer::~MulticlientTCPTransportServer() = default;
+MulticlientTCPTransportServer::~MulticlientTCPTransportServer() {
+    if (not uring) return;
+    // the batched sends still reference our buffers
+    try {
+        flush();
+    } catch (...) {
+        // clients, that already hung up, won't miss their answers
+    }
+}
 
 void MulticlientTCPTransportServer::accept() {
+    assert(acceptMode == MulticlientTcpAccept::Explicit);
     sockaddr_in ignored{};
-    connections.push_back(tcp::accept(serverSocket, ignored));
-    pollfd p{};
-    p.fd = connections.back().get();
-    p.events = POLLIN;
-    pollFds.push_back(p);
+    addConnection(tcp::accept(serverSocket, ignored));
+}
+
+void MulticlientTCPTransportServer::acceptPending() {
+    for (;;) {
+        const auto raw = ::accept4(serverSocket.get(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (raw < 0) {
+            if (errno == EAGAIN) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            throw std::runtime_error("Could not accept: "s + ::strerror(errno));
+        }
+        addConnection(Socket::fromRaw(raw));
+    }
+}
+
+void MulticlientTCPTransportServer::addConnection(Socket socket) {
+    const auto id = connections.size();
+    connections.emplace_back(std::move(socket));
+
+    if (uring) {
+        armReceive(id);
+        return;
+    }
+    // edge triggered: we get notified once per arrival and need to read until the socket runs dry
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = id;
+    if (::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, connections.back().socket.get(), &event) < 0) {
+        throw std::runtime_error("Could not add socket to epoll: "s + ::strerror(errno));
+    }
 }
 
 void MulticlientTCPTransportServer::send(size_t receiverId, const uint8_t *data, size_t size) {
     assert(receiverId < connections.size());
-    tcp::write(connections[receiverId], data, size);
+    auto &connection = connections[receiverId];
+    const Header header = size;
+    if (not uring) {
+        const ConstSegment segments[] = {{&header, sizeof(header)}, {data, size}};
+        tcp::writev(connection.socket, segments, 2);
+        return;
+    }
+
+    auto &outbox = connection.outbox;
+    if (outbox.empty()) {
+        unsent.push_back(receiverId);
+    }
+    const auto headerBytes = reinterpret_cast<const uint8_t *>(&header);
+    outbox.insert(outbox.end(), headerBytes, headerBytes + sizeof(header));
+    outbox.insert(outbox.end(), data, data + size);
 }
 
-size_t MulticlientTCPTransportServer::receive(void *whereTo, size_t maxSize) {
-    const auto readable = [&] {
-        for (;;) {
-            const auto ret = ::poll(pollFds.data(), pollFds.size(), 5 * 1000); // 5 seconds timeout
-            if (ret < 0) {
-                throw std::runtime_error("Could not poll sockets: "s + ::strerror(errno));
+void MulticlientTCPTransportServer::flush() {
+    if (not uring) return;
+    while (sendsInFlight > 0 || not unsent.empty()) {
+        submitAndReap();
+    }
+}
+
+void MulticlientTCPTransportServer::waitForEvents(int timeoutMs) {
+    if (uring) {
+        submitAndReap(timeoutMs);
+        return;
+    }
+
+    epoll_event events[maxEvents];
+    int count;
+    do {
+        count = ::epoll_wait(epoll.get(), events, maxEvents, timeoutMs);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        throw std::runtime_error("Could not wait for epoll events: "s + ::strerror(errno));
+    }
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.u64 == listenerTag) {
+            acceptPending();
+            continue;
+        }
+        auto &connection = connections[events[i].data.u64];
+        if (not connection.queued) {
+            connection.queued = true;
+            ready.push_back(events[i].data.u64);
+        }
+    }
+}
+
+void MulticlientTCPTransportServer::reserve(Connection &connection, size_t bytes) {
+    auto &buffer = connection.buffer;
+    // first try moving the unconsumed bytes to the front, then grow
+    if (buffer.size() - connection.end < bytes) {
+        std::copy(buffer.begin() + connection.begin, buffer.begin() + connection.end, buffer.begin());
+        connection.end -= connection.begin;
+        connection.begin = 0;
+    }
+    if (buffer.size() - connection.end < bytes) {
+        buffer.resize(std::max(2 * buffer.size(), connection.end + bytes));
+    }
+}
+
+bool MulticlientTCPTransportServer::fill(Connection &connection) {
+    auto &buffer = connection.buffer;
+    while (not hasMessage(buffer, connection.begin, connection.end)) {
+        if (connection.closed) return false;
+        reserve(connection, minimumRead);
+
+        const auto res = ::recv(connection.socket.get(), &buffer[connection.end], buffer.size() - connection.end,
+                                MSG_DONTWAIT);
+        if (res < 0) {
+            if (errno == EAGAIN) return false;
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Could not receive: "s + ::strerror(errno));
+        }
+        if (res == 0) {
+            // the client hung up, nothing will arrive anymore
+            connection.closed = true;
+            ::epoll_ctl(epoll.get(), EPOLL_CTL_DEL, connection.socket.get(), nullptr);
+            return false;
+        }
+        connection.end += static_cast<size_t>(res);
+        if (dropOversized(connection)) return false;
+    }
+    return true;
+}
+
+bool MulticlientTCPTransportServer::dropOversized(Connection &connection) {
+    if (connection.end - connection.begin < sizeof(Header)) return false;
+    Header size;
+    std::memcpy(&size, &connection.buffer[connection.begin], sizeof(size));
+    if (size <= MAX_MESSAGESIZE) return false;
+
+    // buffering the message could exhaust our memory, and the stream can't be resynchronized without it
+    connection.closed = true;
+    connection.buffer = {};
+    connection.begin = connection.end = 0;
+    if (not uring) {
+        ::epoll_ctl(epoll.get(), EPOLL_CTL_DEL, connection.socket.get(), nullptr);
+    }
+    // also ends a pending multishot receive
+    ::shutdown(connection.socket.get(), SHUT_RDWR);
+    return true;
+}
+
+void MulticlientTCPTransportServer::armReceive(size_t id) {
+    // a single submission keeps receiving into whichever provided buffer is free, until it runs out of buffers
+    auto &sqe = uring->prepare();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = connections[id].socket.get();
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = receiveGroup;
+    sqe.user_data = id << 1;
+}
+
+void MulticlientTCPTransportServer::armAccept() {
+    auto &sqe = uring->prepare();
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = serverSocket.get();
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe.accept_flags = SOCK_CLOEXEC;
+    sqe.user_data = listenerTag;
+}
+
+void MulticlientTCPTransportServer::prepareSends() {
+    const auto stillUnsent = std::remove_if(unsent.begin(), unsent.end(), [&](size_t id) {
+        auto &connection = connections[id];
+        // only one send per connection at a time, so the stream can't be reordered
+        if (not connection.sending.empty()) return false;
+        std::swap(connection.outbox, connection.sending);
+        prepareSend(id);
+        return true;
+    });
+    unsent.erase(stillUnsent, unsent.end());
+}
+
+void MulticlientTCPTransportServer::prepareSend(size_t id) {
+    auto &connection = connections[id];
+    auto &sqe = uring->prepare();
+    sqe.opcode = IORING_OP_SEND;
+    sqe.fd = connection.socket.get();
+    sqe.addr = reinterpret_cast<uintptr_t>(connection.sending.data() + connection.sent);
+    sqe.len = static_cast<uint32_t>(std::min<size_t>(connection.sending.size() - connection.sent, UINT32_MAX));
+    sqe.msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe.user_data = id << 1 | 1;
+    ++sendsInFlight;
+}
+
+void MulticlientTCPTransportServer::submitAndReap(int timeoutMs) {
+    prepareSends();
+    uring->submit(1, timeoutMs);
+    uring->forEachCompletion([&](const io_uring_cqe &cqe) {
+        if (cqe.user_data == listenerTag) {
+            if (cqe.res >= 0) {
+                addConnection(Socket::fromRaw(cqe.res));
+            } else if (cqe.res != -ECONNABORTED && cqe.res != -EINTR) {
+                throw std::runtime_error("Could not accept: "s + ::strerror(-cqe.res));
+            }
+            if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                armAccept();
+            }
+            return;
+        }
+
+        const auto id = cqe.user_data >> 1;
+        auto &connection = connections[id];
+
+        if ((cqe.user_data & 1) != 0) {
+            --sendsInFlight;
+            if (cqe.res < 0) {
+                throw std::runtime_error("Could not send: "s + ::strerror(-cqe.res));
             }
-            const auto &res = std::find_if(pollFds.begin(), pollFds.end(), [](const pollfd &pollFd) {
-                // check, that only POLLIN flag is set
-                return ((pollFd.revents & ~POLLIN) == 0 &&
-                        pollFd.revents & POLLIN) != 0;
-            });
-
-            if (res != pollFds.end()) {
-                return res;
+            connection.sent += static_cast<size_t>(cqe.res);
+            if (connection.sent < connection.sending.size()) {
+                // MSG_WAITALL only returns early, when interrupted. The rest goes out with the next submission
+                prepareSend(id);
+                return;
             }
+            connection.sent = 0;
+            // keep the allocation for the next batch
+            connection.sending.clear();
+            if (connection.outbox.empty()) {
+                std::swap(connection.outbox, connection.sending);
+            }
+            return;
+        }
+
+        if ((cqe.flags & IORING_CQE_F_BUFFER) != 0) {
+            const auto bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            const auto received = static_cast<size_t>(std::max(cqe.res, 0));
+            // a dropped connection may still have had receives in flight
+            if (not connection.closed) {
+                reserve(connection, received);
+                const auto data = receiveBuffers->buffer(bufferId);
+                std::copy(data, data + received, &connection.buffer[connection.end]);
+                connection.end += received;
+                dropOversized(connection);
+            }
+            receiveBuffers->recycle(bufferId);
+        }
+        if (cqe.res == 0 || cqe.res == -ECONNRESET) {
+            // the client hung up, nothing will arrive anymore
+            connection.closed = true;
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            throw std::runtime_error("Could not receive: "s + ::strerror(-cqe.res));
+        }
+        // the multishot receive stops on errors and when all provided buffers are in use
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0 && not connection.closed) {
+            armReceive(id);
         }
-    }();
-    ::recv(readable->fd, whereTo, maxSize, 0);
-    return static_cast<size_t>(std::distance(pollFds.begin(), readable));
+        if (not connection.queued && hasMessage(connection.buffer, connection.begin, connection.end)) {
+            connection.queued = true;
+            ready.push_back(id);
+        }
+    });
 }
 
-MulticlientTCPTransportClient::MulticlientTCPTransportClient() : socket(Socket::create()) {
+std::optional<size_t> MulticlientTCPTransportServer::receiveReady(void *whereTo, size_t maxSize) {
+    while (not ready.empty()) {
+        const auto id = ready.front();
+        ready.pop_front();
+        auto &connection = connections[id];
+        const auto complete = uring ? hasMessage(connection.buffer, connection.begin, connection.end)
+                                    : fill(connection);
+        if (not complete) {
+            // ran dry, the next edge or receive completion puts the connection back in the queue
+            connection.queued = false;
+            continue;
+        }
+
+        Header size;
+        std::memcpy(&size, &connection.buffer[connection.begin], sizeof(size));
+        if (size > maxSize) {
+            throw std::runtime_error("received message > maxSize");
+        }
+        const auto begin = connection.buffer.begin() + connection.begin + sizeof(Header);
+        std::copy(begin, begin + size, reinterpret_cast<uint8_t *>(whereTo));
+        connection.begin += sizeof(Header) + size;
+        if (connection.begin == connection.end) {
+            connection.begin = connection.end = 0;
+        }
+
+        // there might be more buffered or unread, but serve the others first
+        ready.push_back(id);
+        return id;
+    }
+    return std::nullopt;
+}
 
+size_t MulticlientTCPTransportServer::receive(void *whereTo, size_t maxSize) {
+    for (;;) {
+        if (const auto id = receiveReady(whereTo, maxSize)) {
+            return *id;
+        }
+        waitForEvents(-1);
+    }
+}
+
+std::optional<size_t>
+MulticlientTCPTransportServer::receive(void *whereTo, size_t maxSize, std::chrono::milliseconds timeout) {
+    using namespace std::chrono;
+    const auto deadline = steady_clock::now() + timeout;
+    for (;;) {
+        if (const auto id = receiveReady(whereTo, maxSize)) {
+            return id;
+        }
+        const auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if (left < 0) {
+            return std::nullopt;
+        }
+        waitForEvents(static_cast<int>(left));
+    }
+}
+
+MulticlientTCPTransportClient::MulticlientTCPTransportClient(tcp::Profile profile) :
+        socket(Socket::create()),
+        profile(profile) {
+    tcp::setProfile(socket, profile);
 }
 
 MulticlientTCPTransportClient::~MulticlientTCPTransportClient() = default;
@@ -89,11 +443,29 @@ void MulticlientTCPTransportClient::connect(std::string_view whereTo) {
 }
 
 void MulticlientTCPTransportClient::send(const uint8_t *data, size_t size) {
-    tcp::write(socket, data, size);
+    if (size > MulticlientTCPTransportServer::MAX_MESSAGESIZE) {
+        throw std::runtime_error("can't send messages > MAX_MESSAGESIZE");
+    }
+    const Header header = size;
+    const ConstSegment segments[] = {{&header, sizeof(header)}, {data, size}};
+    tcp::writev(socket, segments, 2);
+}
+
+void MulticlientTCPTransportClient::readExactly(void *whereTo, size_t size) {
+    if (profile == tcp::Profile::LowLatency) {
+        tcp::readSpinning(socket, whereTo, size);
+    } else {
+        tcp::read(socket, whereTo, size);
+    }
 }
 
 void MulticlientTCPTransportClient::receive(void *whereTo, size_t maxSize) {
-    return tcp::read(socket, whereTo, maxSize);
+    Header size;
+    readExactly(&size, sizeof(size));
+    if (size > maxSize) {
+        throw std::runtime_error("received message > maxSize");
+    }
+    readExactly(whereTo, size);
 }
 } // namespace transport
 } // namespace l5
@@ -0,0 +1,64 @@
+#include "include/NegotiatedTransport.h"
+#include "rdma/Network.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace l5 {
+namespace transport {
+namespace {
+/// Where the shared memory transport's domain socket lives
+constexpr auto rendezvousDirectory = "/tmp";
+
+/// Changes on every boot and is the same for all containers on a host
+std::array<char, 37> readBootId() {
+    auto result = std::array<char, 37>{};
+    auto file = std::ifstream("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    if (file >> id) {
+        std::copy_n(id.begin(), std::min(id.size(), result.size() - 1), result.begin());
+    }
+    return result;
+}
+} // namespace
+
+const char *to_string(TransportKind kind) {
+    switch (kind) {
+        case TransportKind::Tcp:
+            return "tcp";
+        case TransportKind::SharedMemory:
+            return "shm";
+        case TransportKind::Rdma:
+            return "rdma";
+    }
+    throw std::runtime_error{"unknown transport kind"};
+}
+
+PeerCapabilities localCapabilities() {
+    auto result = PeerCapabilities{};
+    result.bootId = readBootId();
+    // peers in different mount namespaces, e.g. containers, might not see each other's domain socket, even on the
+    // same host. The shared memory itself is passed as file descriptors through that socket
+    struct stat directory{};
+    if (::stat(rendezvousDirectory, &directory) == 0) {
+        result.rendezvousDevice = directory.st_dev;
+        result.rendezvousInode = directory.st_ino;
+    }
+    result.rdma = rdma::Network::hasDevice();
+    return result;
+}
+
+TransportKind chooseTransport(const PeerCapabilities &a, const PeerCapabilities &b) {
+    const auto sameHost = a.bootId[0] != '\0' && a.bootId == b.bootId;
+    const auto sameDirectory = a.rendezvousInode != 0 && a.rendezvousDevice == b.rendezvousDevice &&
+                               a.rendezvousInode == b.rendezvousInode;
+    if (sameHost && sameDirectory) return TransportKind::SharedMemory;
+    if (a.rdma && b.rdma) return TransportKind::Rdma;
+    return TransportKind::Tcp;
+}
+
+std::string rendezvousSocket(uint16_t port) {
+    return std::string(rendezvousDirectory) + "/l5negotiated-" + std::to_string(port);
+}
+} // namespace transport
+} // namespace l5
@@ -5,8 +5,9 @@ namespace l5 {
 namespace transport {
 using namespace util;
 
-TcpTransportServer::TcpTransportServer(const std::string &port) :
-        initialSocket(Socket::create()) {
+TcpTransportServer::TcpTransportServer(const std::string &port, tcp::Profile profile) :
+        initialSocket(Socket::create()),
+        profile(profile) {
     auto p = std::stoi(std::string(port.data(), port.size()));
     listen(p);
 }
@@ -23,18 +24,88 @@ void TcpTransportServer::write_impl(const uint8_t *data, size_t size) {
 }
 
 void TcpTransportServer::read_impl(uint8_t *buffer, size_t size) {
-    tcp::read(communicationSocket, buffer, size);
+    if (profile == tcp::Profile::LowLatency) {
+        tcp::readSpinning(communicationSocket, buffer, size);
+    } else {
+        tcp::read(communicationSocket, buffer, size);
+    }
+}
+
+void TcpTransportServer::writev_impl(const ConstSegment *segments, size_t count) {
+    tcp::writev(communicationSocket, segments, count);
+}
+
+void TcpTransportServer::readv_impl(const MutableSegment *segments, size_t count) {
+    if (profile == tcp::Profile::LowLatency) {
+        tcp::readvSpinning(communicationSocket, segments, count);
+    } else {
+        tcp::readv(communicationSocket, segments, count);
+    }
+}
+
+bool TcpTransportServer::tryRead_impl(uint8_t *buffer, size_t size) {
+    return tcp::tryRead(communicationSocket, buffer, size, pendingRead);
+}
+
+bool TcpTransportServer::tryWrite_impl(const uint8_t *data, size_t size) {
+    return tcp::tryWrite(communicationSocket, data, size, pendingWrite);
+}
+
+bool TcpTransportServer::readable_impl() {
+    return tcp::readable(communicationSocket);
+}
+
+bool TcpTransportServer::writable_impl() {
+    return tcp::writable(communicationSocket);
 }
 
 size_t TcpTransportServer::readSome_impl(uint8_t *buffer, size_t maxSize) {
+    if (profile == tcp::Profile::LowLatency) {
+        return tcp::readSomeSpinning(communicationSocket, buffer, maxSize);
+    }
     return tcp::readSome(communicationSocket, buffer, maxSize);
 }
 
 void TcpTransportServer::accept_impl() {
     communicationSocket = tcp::accept(initialSocket);
+    pendingRead = {};
+    pendingWrite = {};
+    tcp::setProfile(communicationSocket, profile);
+    if (zeroCopy) {
+        zeroCopy.emplace(zeroCopy->threshold);
+        tcp::ZeroCopy::enable(communicationSocket);
+    }
 }
 
-TcpTransportClient::TcpTransportClient() : socket(Socket::create()) {}
+void TcpTransportServer::enableZeroCopy(size_t threshold) {
+    zeroCopy.emplace(threshold);
+    // otherwise, accept enables it
+    if (communicationSocket.get() >= 0) {
+        tcp::ZeroCopy::enable(communicationSocket);
+    }
+}
+
+uint64_t TcpTransportServer::writeZeroCopy(const uint8_t *data, size_t size) {
+    if (not zeroCopy) {
+        tcp::write(communicationSocket, data, size);
+        return 0;
+    }
+    return zeroCopy->write(communicationSocket, data, size);
+}
+
+bool TcpTransportServer::reusable(uint64_t ticket) {
+    return not zeroCopy || zeroCopy->reusable(communicationSocket, ticket);
+}
+
+void TcpTransportServer::waitUntilReusable(uint64_t ticket) {
+    if (zeroCopy) {
+        zeroCopy->waitUntilReusable(communicationSocket, ticket);
+    }
+}
+
+TcpTransportClient::TcpTransportClient(tcp::Profile profile) : socket(Socket::create()), profile(profile) {
+    tcp::setProfile(socket, profile);
+}
 
 TcpTransportClient::~TcpTransportClient() = default;
 
@@ -54,11 +125,69 @@ void TcpTransportClient::write_impl(const uint8_t *data, size_t size) {
 }
 
 void TcpTransportClient::read_impl(uint8_t *buffer, size_t size) {
-    tcp::read(socket, buffer, size);
+    if (profile == tcp::Profile::LowLatency) {
+        tcp::readSpinning(socket, buffer, size);
+    } else {
+        tcp::read(socket, buffer, size);
+    }
+}
+
+void TcpTransportClient::writev_impl(const ConstSegment *segments, size_t count) {
+    tcp::writev(socket, segments, count);
+}
+
+void TcpTransportClient::readv_impl(const MutableSegment *segments, size_t count) {
+    if (profile == tcp::Profile::LowLatency) {
+        tcp::readvSpinning(socket, segments, count);
+    } else {
+        tcp::readv(socket, segments, count);
+    }
+}
+
+bool TcpTransportClient::tryRead_impl(uint8_t *buffer, size_t size) {
+    return tcp::tryRead(socket, buffer, size, pendingRead);
+}
+
+bool TcpTransportClient::tryWrite_impl(const uint8_t *data, size_t size) {
+    return tcp::tryWrite(socket, data, size, pendingWrite);
+}
+
+bool TcpTransportClient::readable_impl() {
+    return tcp::readable(socket);
+}
+
+bool TcpTransportClient::writable_impl() {
+    return tcp::writable(socket);
 }
 
 size_t TcpTransportClient::readSome_impl(uint8_t *buffer, size_t size) {
+    if (profile == tcp::Profile::LowLatency) {
+        return tcp::readSomeSpinning(socket, buffer, size);
+    }
     return tcp::readSome(socket, buffer, size);
 }
+
+void TcpTransportClient::enableZeroCopy(size_t threshold) {
+    tcp::ZeroCopy::enable(socket);
+    zeroCopy.emplace(threshold);
+}
+
+uint64_t TcpTransportClient::writeZeroCopy(const uint8_t *data, size_t size) {
+    if (not zeroCopy) {
+        tcp::write(socket, data, size);
+        return 0;
+    }
+    return zeroCopy->write(socket, data, size);
+}
+
+bool TcpTransportClient::reusable(uint64_t ticket) {
+    return not zeroCopy || zeroCopy->reusable(socket, ticket);
+}
+
+void TcpTransportClient::waitUntilReusable(uint64_t ticket) {
+    if (zeroCopy) {
+        zeroCopy->waitUntilReusable(socket, ticket);
+    }
+}
 } // namespace transport
 } // namespace l5
@@ -41,5 +41,21 @@ void sendRmrInfo(const Socket &sock, const ibv::memoryregion::MemoryRegion &buff
     rmrInfo.readPosAddress = reinterpret_cast<uintptr_t>(readPos.getAddr());
     tcp::write(sock, &rmrInfo, sizeof(rmrInfo));
 }
+
+void sendCreditInfo(const Socket &sock, const ibv::memoryregion::MemoryRegion &readPos, size_t interval) {
+    CreditInfo creditInfo{};
+    creditInfo.readPosKey = readPos.getRkey();
+    creditInfo.readPosAddress = reinterpret_cast<uintptr_t>(readPos.getAddr());
+    creditInfo.interval = interval;
+    tcp::write(sock, &creditInfo, sizeof(creditInfo));
+}
+
+size_t receiveCreditInfo(const Socket &sock, ibv::memoryregion::RemoteAddress &readPos) {
+    CreditInfo creditInfo{};
+    tcp::read(sock, &creditInfo, sizeof(creditInfo));
+    readPos.rkey = creditInfo.readPosKey;
+    readPos.address = creditInfo.readPosAddress;
+    return creditInfo.interval;
+}
 } // namespace util
 } // namespace l5
@@ -24,6 +24,14 @@ struct RmrInfo {
     uintptr_t readPosAddress;
 };
 
+/// Where and how often to write the read position, for credit based flow control
+struct CreditInfo {
+    uint32_t readPosKey;
+    uintptr_t readPosAddress;
+    /// 0, if the sender doesn't want its credits written
+    size_t interval;
+};
+
 void
 receiveAndSetupRmr(const Socket &sock, ibv::memoryregion::RemoteAddress &buffer,
                    ibv::memoryregion::RemoteAddress &readPos);
@@ -31,6 +39,12 @@ receiveAndSetupRmr(const Socket &sock, ibv::memoryregion::RemoteAddress &buffer,
 void
 sendRmrInfo(const Socket &sock, const ibv::memoryregion::MemoryRegion &buffer,
             const ibv::memoryregion::MemoryRegion &readPos);
+
+/// Ask the remote side to RDMA write its read position to readPos, whenever it consumed interval bytes
+void sendCreditInfo(const Socket &sock, const ibv::memoryregion::MemoryRegion &readPos, size_t interval);
+
+/// Receive the remote side's sendCreditInfo. Returns the interval, 0 if it doesn't want credits
+size_t receiveCreditInfo(const Socket &sock, ibv::memoryregion::RemoteAddress &readPos);
 } // namespace util
 } // namespace l5
 #endif //L5RDMA_RDMANETWORKING_H
@@ -1,6 +1,7 @@
 #ifndef L5RDMA_BUSYWAIT_H
 #define L5RDMA_BUSYWAIT_H
 
+#include <sched.h>
 #include <unistd.h>
 #include <xmmintrin.h>
 
@@ -0,0 +1,197 @@
+#include "copy.h"
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+
+namespace l5 {
+namespace util {
+namespace {
+/// Below this, the vector loops don't pay off and memcpy is at least as fast
+constexpr size_t minVectorCopy = 256;
+
+using CopyFunction = void (*)(uint8_t *dest, const uint8_t *src, size_t size);
+
+/// Non-temporal stores need an aligned destination, so copy the unaligned head normally
+inline size_t alignDestination(uint8_t *&dest, const uint8_t *&src, size_t size, size_t alignment) {
+    const auto head = (alignment - (reinterpret_cast<uintptr_t>(dest) & (alignment - 1))) & (alignment - 1);
+    std::memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    return size - head;
+}
+
+void copyStd(uint8_t *dest, const uint8_t *src, size_t size) {
+    std::memcpy(dest, src, size);
+}
+
+template<bool nonTemporal>
+__attribute__((target("sse2")))
+void copySSE2(uint8_t *dest, const uint8_t *src, size_t size) {
+    constexpr size_t width = sizeof(__m128i);
+    if constexpr (nonTemporal) size = alignDestination(dest, src, size, width);
+    for (; size >= 4 * width; size -= 4 * width, src += 4 * width, dest += 4 * width) {
+        const auto s = reinterpret_cast<const __m128i *>(src);
+        const auto d = reinterpret_cast<__m128i *>(dest);
+        const auto a = _mm_loadu_si128(s), b = _mm_loadu_si128(s + 1);
+        const auto c = _mm_loadu_si128(s + 2), e = _mm_loadu_si128(s + 3);
+        if constexpr (nonTemporal) {
+            _mm_stream_si128(d, a), _mm_stream_si128(d + 1, b), _mm_stream_si128(d + 2, c), _mm_stream_si128(d + 3, e);
+        } else {
+            _mm_storeu_si128(d, a), _mm_storeu_si128(d + 1, b), _mm_storeu_si128(d + 2, c), _mm_storeu_si128(d + 3, e);
+        }
+    }
+    std::memcpy(dest, src, size);
+    // streaming stores are weakly ordered, make them visible before the caller publishes the data
+    if constexpr (nonTemporal) _mm_sfence();
+}
+
+template<bool nonTemporal>
+__attribute__((target("avx2")))
+void copyAVX2(uint8_t *dest, const uint8_t *src, size_t size) {
+    constexpr size_t width = sizeof(__m256i);
+    if constexpr (nonTemporal) size = alignDestination(dest, src, size, width);
+    for (; size >= 4 * width; size -= 4 * width, src += 4 * width, dest += 4 * width) {
+        const auto s = reinterpret_cast<const __m256i *>(src);
+        const auto d = reinterpret_cast<__m256i *>(dest);
+        const auto a = _mm256_loadu_si256(s), b = _mm256_loadu_si256(s + 1);
+        const auto c = _mm256_loadu_si256(s + 2), e = _mm256_loadu_si256(s + 3);
+        if constexpr (nonTemporal) {
+            _mm256_stream_si256(d, a), _mm256_stream_si256(d + 1, b);
+            _mm256_stream_si256(d + 2, c), _mm256_stream_si256(d + 3, e);
+        } else {
+            _mm256_storeu_si256(d, a), _mm256_storeu_si256(d + 1, b);
+            _mm256_storeu_si256(d + 2, c), _mm256_storeu_si256(d + 3, e);
+        }
+    }
+    std::memcpy(dest, src, size);
+    if constexpr (nonTemporal) _mm_sfence();
+}
+
+template<bool nonTemporal>
+__attribute__((target("avx512f")))
+void copyAVX512(uint8_t *dest, const uint8_t *src, size_t size) {
+    constexpr size_t width = sizeof(__m512i);
+    if constexpr (nonTemporal) size = alignDestination(dest, src, size, width);
+    for (; size >= 4 * width; size -= 4 * width, src += 4 * width, dest += 4 * width) {
+        const auto s = reinterpret_cast<const __m512i *>(src);
+        const auto d = reinterpret_cast<__m512i *>(dest);
+        const auto a = _mm512_loadu_si512(s), b = _mm512_loadu_si512(s + 1);
+        const auto c = _mm512_loadu_si512(s + 2), e = _mm512_loadu_si512(s + 3);
+        if constexpr (nonTemporal) {
+            _mm512_stream_si512(d, a), _mm512_stream_si512(d + 1, b);
+            _mm512_stream_si512(d + 2, c), _mm512_stream_si512(d + 3, e);
+        } else {
+            _mm512_storeu_si512(d, a), _mm512_storeu_si512(d + 1, b);
+            _mm512_storeu_si512(d + 2, c), _mm512_storeu_si512(d + 3, e);
+        }
+    }
+    std::memcpy(dest, src, size);
+    if constexpr (nonTemporal) _mm_sfence();
+}
+
+struct CopyConfig {
+    CopyKernel kernel;
+    CopyFunction temporal;
+    CopyFunction nonTemporal;
+    size_t nonTemporalThreshold = 8 * 1024 * 1024;
+
+    void select(CopyKernel newKernel) {
+        kernel = newKernel;
+        switch (newKernel) {
+            case CopyKernel::Std:
+                temporal = nonTemporal = copyStd;
+                return;
+            case CopyKernel::SSE2:
+                temporal = copySSE2<false>;
+                nonTemporal = copySSE2<true>;
+                return;
+            case CopyKernel::AVX2:
+                temporal = copyAVX2<false>;
+                nonTemporal = copyAVX2<true>;
+                return;
+            case CopyKernel::AVX512:
+                temporal = copyAVX512<false>;
+                nonTemporal = copyAVX512<true>;
+                return;
+        }
+        throw std::runtime_error{"unknown copy kernel"};
+    }
+};
+
+CopyConfig &config() {
+    static CopyConfig instance = [] {
+        CopyConfig c{};
+        c.select(bestCopyKernel());
+        return c;
+    }();
+    return instance;
+}
+} // namespace
+
+const char *to_string(CopyKernel kernel) {
+    switch (kernel) {
+        case CopyKernel::Std:
+            return "std";
+        case CopyKernel::SSE2:
+            return "sse2";
+        case CopyKernel::AVX2:
+            return "avx2";
+        case CopyKernel::AVX512:
+            return "avx512";
+    }
+    throw std::runtime_error{"unknown copy kernel"};
+}
+
+bool isSupported(CopyKernel kernel) {
+    __builtin_cpu_init();
+    switch (kernel) {
+        case CopyKernel::Std:
+            return true;
+        case CopyKernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case CopyKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case CopyKernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+
+CopyKernel bestCopyKernel() {
+    for (auto kernel : {CopyKernel::AVX512, CopyKernel::AVX2, CopyKernel::SSE2}) {
+        if (isSupported(kernel)) return kernel;
+    }
+    return CopyKernel::Std;
+}
+
+CopyKernel getCopyKernel() {
+    return config().kernel;
+}
+
+void setCopyKernel(CopyKernel kernel) {
+    if (not isSupported(kernel)) {
+        throw std::runtime_error{std::string("copy kernel not supported by this CPU: ") + to_string(kernel)};
+    }
+    config().select(kernel);
+}
+
+size_t getNonTemporalThreshold() {
+    return config().nonTemporalThreshold;
+}
+
+void setNonTemporalThreshold(size_t bytes) {
+    config().nonTemporalThreshold = bytes;
+}
+
+uint8_t *copyBytes(const uint8_t *begin, const uint8_t *end, uint8_t *dest) {
+    const auto size = static_cast<size_t>(end - begin);
+    if (size < minVectorCopy) {
+        std::memcpy(dest, begin, size);
+    } else {
+        const auto &c = config();
+        (size >= c.nonTemporalThreshold ? c.nonTemporal : c.temporal)(dest, begin, size);
+    }
+    return dest + size;
+}
+} // namespace util
+} // namespace l5
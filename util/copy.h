@@ -0,0 +1,42 @@
+#ifndef L5RDMA_COPY_H
+#define L5RDMA_COPY_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace l5 {
+namespace util {
+/// Copy implementations, selected at runtime depending on what the CPU supports
+enum class CopyKernel {
+    /// plain memcpy, never uses non-temporal stores
+    Std,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+const char *to_string(CopyKernel kernel);
+
+bool isSupported(CopyKernel kernel);
+
+/// The widest kernel this CPU supports. Used by default
+CopyKernel bestCopyKernel();
+
+CopyKernel getCopyKernel();
+
+/// Switch the kernel used by copyBytes, e.g. for benchmarking. Not thread safe, set this before any transfers
+void setCopyKernel(CopyKernel kernel);
+
+/// Copies of at least this many bytes use non-temporal stores, so large transfers don't evict the ring buffers from
+/// the last level cache. Defaults to 8MB, SIZE_MAX disables non-temporal stores
+size_t getNonTemporalThreshold();
+
+void setNonTemporalThreshold(size_t bytes);
+
+/// Drop-in replacement for std::copy on bytes, using the selected copy kernel
+/// Returns the end of the destination range
+uint8_t *copyBytes(const uint8_t *begin, const uint8_t *end, uint8_t *dest);
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_COPY_H
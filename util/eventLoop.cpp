@@ -0,0 +1,146 @@
+#include "eventLoop.h"
+#include "busywait.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <utility>
+#include <vector>
+
+namespace l5 {
+namespace util {
+EventLoop::EventLoop() : epoll(Socket::fromRaw(::epoll_create1(EPOLL_CLOEXEC))) {
+    if (epoll.get() < 0) {
+        throw std::runtime_error(std::string("Couldn't create epoll instance: ") + strerror(errno));
+    }
+}
+
+void EventLoop::enqueue(const void *connection, int fd, Direction direction, std::function<bool()> tryComplete,
+                        Continuation done) {
+    operations.push_back(Operation{connection, fd, direction, std::move(tryComplete), std::move(done)});
+}
+
+void EventLoop::post(Continuation work) {
+    enqueue(nullptr, -1, Direction::Read, [] { return true; }, std::move(work));
+}
+
+void EventLoop::watch() {
+    std::unordered_map<int, uint32_t> wanted;
+    for (const auto &operation : operations) {
+        if (operation.waiting) {
+            wanted[operation.fd] |= operation.direction == Direction::Read ? EPOLLIN : EPOLLOUT;
+        }
+    }
+    for (auto it = registered.begin(); it != registered.end();) {
+        if (wanted.count(it->first) == 0) {
+            // fails, if the socket was closed in the meantime, which already removed it
+            ::epoll_ctl(epoll.get(), EPOLL_CTL_DEL, it->first, nullptr);
+            it = registered.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const auto &[fd, events] : wanted) {
+        const auto known = registered.find(fd);
+        if (known != registered.end() && known->second == events) {
+            continue;
+        }
+        auto event = epoll_event{};
+        event.events = events;
+        event.data.fd = fd;
+        auto res = ::epoll_ctl(epoll.get(), known == registered.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event);
+        // a closed socket leaves the epoll set, and its number might have been reused since
+        if (res < 0 && errno == ENOENT) {
+            res = ::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, fd, &event);
+        } else if (res < 0 && errno == EEXIST) {
+            res = ::epoll_ctl(epoll.get(), EPOLL_CTL_MOD, fd, &event);
+        }
+        if (res < 0) {
+            throw std::runtime_error(std::string("Couldn't watch socket with epoll: ") + strerror(errno));
+        }
+        registered[fd] = events;
+    }
+}
+
+void EventLoop::poll(int timeout) {
+    ready.clear();
+    if (registered.empty()) {
+        return;
+    }
+    epoll_event events[64];
+    const auto count = ::epoll_wait(epoll.get(), events, 64, timeout);
+    if (count < 0) {
+        if (errno == EINTR) return;
+        throw std::runtime_error(std::string("Couldn't wait for sockets with epoll: ") + strerror(errno));
+    }
+    // level triggered, so sockets not reported this time, because there were too many, are reported next time
+    for (int i = 0; i < count; ++i) {
+        ready[events[i].data.fd] |= events[i].events;
+    }
+}
+
+bool EventLoop::isReady(const Operation &operation) const {
+    if (not operation.waiting) {
+        return true;
+    }
+    const auto events = ready.find(operation.fd);
+    if (events == ready.end()) {
+        return false;
+    }
+    // errors and hang ups are reported to the operation itself, by trying it
+    const uint32_t wanted = (operation.direction == Direction::Read ? EPOLLIN : EPOLLOUT) | EPOLLERR | EPOLLHUP;
+    return (events->second & wanted) != 0;
+}
+
+bool EventLoop::runOnce() {
+    return runRound(0);
+}
+
+bool EventLoop::runRound(int timeout) {
+    watch();
+    poll(timeout);
+
+    // only look at the operations, that were queued before this round. Continuations may queue new ones
+    auto todo = std::exchange(operations, {});
+    // the connections with a pending operation ahead, per direction
+    std::unordered_set<const void *> blocked[2];
+    std::vector<Continuation> completed;
+    onlyWaiting = true;
+    for (auto &operation : todo) {
+        auto &blockedConnections = blocked[operation.direction == Direction::Read ? 0 : 1];
+        const auto isBlocked = operation.connection != nullptr && blockedConnections.count(operation.connection) != 0;
+        if (not isBlocked && isReady(operation)) {
+            if (operation.tryComplete()) {
+                completed.push_back(std::move(operation.done));
+                continue;
+            }
+            operation.waiting = operation.fd >= 0;
+            onlyWaiting = onlyWaiting && operation.waiting;
+        }
+        if (operation.connection != nullptr) blockedConnections.insert(operation.connection);
+        operations.push_back(std::move(operation));
+    }
+    // the still pending operations go first, so they keep their order relative to newly queued ones
+    for (auto &done : completed) {
+        done();
+    }
+    return not completed.empty();
+}
+
+void EventLoop::run() {
+    int tries = 0;
+    bool sleep = false;
+    while (not operations.empty()) {
+        const auto progress = runRound(sleep ? -1 : 0);
+        // only the kernel can make progress, so there's nothing to spin for. The next round sleeps in epoll_wait
+        sleep = not progress && onlyWaiting;
+        if (progress) {
+            tries = 0;
+        } else if (not onlyWaiting) {
+            yield(tries++);
+        }
+    }
+}
+} // namespace util
+} // namespace l5
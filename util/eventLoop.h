@@ -0,0 +1,122 @@
+#ifndef L5RDMA_EVENTLOOP_H
+#define L5RDMA_EVENTLOOP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include "util/socket/Socket.h"
+
+namespace l5 {
+namespace util {
+/// Drives many transport connections from a single thread. Reads and writes are queued together with a continuation,
+/// which is called as soon as the operation could be completed without blocking. Continuations typically queue the
+/// next operation on the same connection, so one connection is a chain of callbacks instead of an OS thread.
+/// Works with every transport, that supports tryRead / tryWrite, so shared memory, RDMA and socket connections can be
+/// mixed in one loop. Not thread safe, use one loop per core.
+/// Socket connections tell the loop their file descriptor with pollFd(). Once an operation on them didn't complete, it's
+/// only retried after epoll reported the socket ready again, and while only such operations are pending, the loop
+/// sleeps in epoll_wait. Everything else is retried every round.
+class EventLoop {
+public:
+    using Continuation = std::function<void()>;
+
+    EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /// Read exactly size bytes from connection, then call done
+    template<typename Connection>
+    void read(Connection &connection, uint8_t *whereTo, size_t size, Continuation done) {
+        enqueue(&connection, pollFd(connection, 0), Direction::Read, [&connection, whereTo, size] {
+            return connection.tryRead(whereTo, size);
+        }, std::move(done));
+    }
+
+    template<typename Connection, typename TriviallyCopyable>
+    void read(Connection &connection, TriviallyCopyable &data, Continuation done) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        read(connection, reinterpret_cast<uint8_t *>(&data), sizeof(data), std::move(done));
+    }
+
+    /// Write size bytes to connection, then call done. The data needs to stay valid until then
+    template<typename Connection>
+    void write(Connection &connection, const uint8_t *data, size_t size, Continuation done) {
+        enqueue(&connection, pollFd(connection, 0), Direction::Write, [&connection, data, size] {
+            return connection.tryWrite(data, size);
+        }, std::move(done));
+    }
+
+    template<typename Connection, typename TriviallyCopyable>
+    void write(Connection &connection, const TriviallyCopyable &data, Continuation done) {
+        static_assert(std::is_trivially_copyable<TriviallyCopyable>::value, "");
+        write(connection, reinterpret_cast<const uint8_t *>(&data), sizeof(data), std::move(done));
+    }
+
+    /// Call work on the next iteration of the loop
+    void post(Continuation work);
+
+    /// Try every pending operation once, that might be able to complete. Returns whether any of them completed
+    bool runOnce();
+
+    /// Run until there are no more pending operations. Backs off, or sleeps in epoll_wait, while no connection makes
+    /// progress
+    void run();
+
+    size_t pending() const { return operations.size(); }
+
+private:
+    enum class Direction {
+        Read, Write
+    };
+
+    struct Operation {
+        /// Operations on the same connection and direction need to complete in order, to keep the stream intact
+        const void *connection;
+        /// The socket of the connection, or -1, if it can't be watched with epoll
+        int fd;
+        Direction direction;
+        std::function<bool()> tryComplete;
+        Continuation done;
+        /// Tried, but didn't complete, so wait until epoll reports fd ready
+        bool waiting = false;
+    };
+
+    template<typename Connection>
+    static auto pollFd(Connection &connection, int) -> decltype(connection.pollFd()) { return connection.pollFd(); }
+
+    template<typename Connection>
+    static int pollFd(Connection &, long) { return -1; }
+
+    void enqueue(const void *connection, int fd, Direction direction, std::function<bool()> tryComplete,
+                 Continuation done);
+
+    /// Make the epoll set match the sockets and directions, the waiting operations need
+    void watch();
+
+    /// Collect the ready sockets, waiting up to timeout milliseconds for one
+    void poll(int timeout);
+
+    /// runOnce, but wait up to timeout milliseconds for a socket to become ready first
+    bool runRound(int timeout);
+
+    bool isReady(const Operation &operation) const;
+
+    std::deque<Operation> operations;
+    const Socket epoll;
+    /// The events, each socket in the epoll set is registered for
+    std::unordered_map<int, uint32_t> registered;
+    /// The events, epoll reported in this round
+    std::unordered_map<int, uint32_t> ready;
+    /// Whether all operations, that didn't complete in the last round, are waiting for epoll
+    bool onlyWaiting = false;
+};
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_EVENTLOOP_H
@@ -0,0 +1,38 @@
+#ifndef L5RDMA_FUTEX_H
+#define L5RDMA_FUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace l5 {
+namespace util {
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words need to be plain 32 bit integers");
+
+/// Sleep until woken by futexWakeAll, but only if futex still contains expected.
+/// Spurious wakeups are possible, so callers need to re-check their condition.
+/// Uses the non-private futex operations, so this also works on memory shared between processes
+inline void futexWait(std::atomic<uint32_t> &futex, uint32_t expected) {
+   ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&futex), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+/// Like futexWait, but wake up after timeout at the latest
+inline void futexWait(std::atomic<uint32_t> &futex, uint32_t expected, std::chrono::nanoseconds timeout) {
+   const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+   const timespec relative{seconds.count(), (timeout - seconds).count()};
+   ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&futex), FUTEX_WAIT, expected, &relative, nullptr, 0);
+}
+
+/// Wake all threads sleeping on futex
+inline void futexWakeAll(std::atomic<uint32_t> &futex) {
+   ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&futex), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_FUTEX_H
@@ -0,0 +1,38 @@
+#include "segments.h"
+#include "copy.h"
+#include <algorithm>
+
+namespace l5 {
+namespace util {
+/// Calls func(segment, offsetInSegment, bytesInSegment, offsetInRange) for each segment overlapping the range
+template<typename Segment, typename Func>
+static void forEachInRange(const Segment *segments, size_t count, size_t offset, size_t size, Func &&func) {
+    size_t done = 0;
+    for (size_t i = 0; i < count && done < size; ++i) {
+        if (offset >= segments[i].size) {
+            offset -= segments[i].size;
+            continue;
+        }
+        const auto todo = std::min(segments[i].size - offset, size - done);
+        func(segments[i], offset, todo, done);
+        done += todo;
+        offset = 0;
+    }
+}
+
+void gather(const ConstSegment *segments, size_t count, size_t offset, size_t size, uint8_t *dest) {
+    forEachInRange(segments, count, offset, size, [&](const ConstSegment &segment, size_t from, size_t todo,
+                                                      size_t done) {
+        const auto begin = reinterpret_cast<const uint8_t *>(segment.data) + from;
+        copyBytes(begin, begin + todo, dest + done);
+    });
+}
+
+void scatter(const uint8_t *src, size_t size, const MutableSegment *segments, size_t count, size_t offset) {
+    forEachInRange(segments, count, offset, size, [&](const MutableSegment &segment, size_t from, size_t todo,
+                                                      size_t done) {
+        copyBytes(src + done, src + done + todo, reinterpret_cast<uint8_t *>(segment.data) + from);
+    });
+}
+} // namespace util
+} // namespace l5
@@ -0,0 +1,42 @@
+#ifndef L5RDMA_SEGMENTS_H
+#define L5RDMA_SEGMENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+namespace l5 {
+namespace util {
+/// A piece of memory to gather data from, for scatter / gather I/O. Layout compatible to struct iovec
+struct ConstSegment {
+    const void *data;
+    size_t size;
+};
+
+/// A piece of memory to scatter data to, for scatter / gather I/O. Layout compatible to struct iovec
+struct MutableSegment {
+    void *data;
+    size_t size;
+};
+
+static_assert(sizeof(ConstSegment) == sizeof(iovec) && offsetof(ConstSegment, size) == offsetof(iovec, iov_len));
+static_assert(sizeof(MutableSegment) == sizeof(iovec) && offsetof(MutableSegment, size) == offsetof(iovec, iov_len));
+
+template<typename Segment>
+size_t totalSize(const Segment *segments, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += segments[i].size;
+    }
+    return total;
+}
+
+/// Copy size bytes, starting at offset of the concatenated segments, to dest
+void gather(const ConstSegment *segments, size_t count, size_t offset, size_t size, uint8_t *dest);
+
+/// Copy size bytes from src to the concatenated segments, starting at offset
+void scatter(const uint8_t *src, size_t size, const MutableSegment *segments, size_t count, size_t offset);
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_SEGMENTS_H
@@ -2,6 +2,8 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <array>
+#include "nonBlocking.h"
+#include "vectoredIo.h"
 
 namespace l5 {
 namespace util {
@@ -13,6 +15,10 @@ Socket socket() {
    return Socket::create(AF_UNIX, SOCK_STREAM, 0);
 }
 
+Socket seqPacketSocket() {
+   return Socket::create(AF_UNIX, SOCK_SEQPACKET, 0);
+}
+
 void listen(const Socket &sock) {
    if (::listen(sock.get(), SOMAXCONN) < 0) {
       throw std::runtime_error{"error close'ing"s + strerror(errno)};
@@ -54,6 +60,26 @@ void read(const Socket &sock, void* buffer, std::size_t size) {
    }
 }
 
+void writev(const Socket &sock, const ConstSegment *segments, size_t count) {
+   transferSegments(segments, count, [&](msghdr &msg) {
+      auto res = ::sendmsg(sock.get(), &msg, 0);
+      if (res < 0) {
+         throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+      }
+      return static_cast<size_t>(res);
+   });
+}
+
+void readv(const Socket &sock, const MutableSegment *segments, size_t count) {
+   transferSegments(segments, count, [&](msghdr &msg) {
+      auto res = ::recvmsg(sock.get(), &msg, MSG_WAITALL);
+      if (res < 0) {
+         throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+      }
+      return static_cast<size_t>(res);
+   });
+}
+
 size_t readSome(const Socket &sock, void *buffer, size_t maxSize) {
     auto res = ::recv(sock.get(), buffer, maxSize, 0);
     if (res < 0) {
@@ -62,6 +88,104 @@ size_t readSome(const Socket &sock, void *buffer, size_t maxSize) {
     return res;
 }
 
+bool tryRead(const Socket &sock, void *buffer, std::size_t size, PartialTransfer &transfer) {
+   return tryReceive(sock.get(), buffer, size, transfer);
+}
+
+bool tryWrite(const Socket &sock, const void *buffer, std::size_t size, PartialTransfer &transfer) {
+   return trySend(sock.get(), buffer, size, transfer);
+}
+
+bool readable(const Socket &sock) {
+   return pollNow(sock.get(), POLLIN);
+}
+
+bool writable(const Socket &sock) {
+   return pollNow(sock.get(), POLLOUT);
+}
+
+void send(const Socket &sock, const void *message, std::size_t size) {
+   if (size == 0) {
+      throw std::runtime_error("can't send empty messages");
+   }
+   // messages are sent atomically, a partial send is impossible
+   if (::send(sock.get(), message, size, 0) < 0) {
+      throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+   }
+}
+
+size_t receive(const Socket &sock, void *buffer, std::size_t maxSize) {
+   auto iov = iovec{buffer, maxSize};
+   auto msg = msghdr();
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   const auto res = ::recvmsg(sock.get(), &msg, 0);
+   if (res < 0) {
+      throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+   }
+   if (res == 0) {
+      // messages are never empty, this is the peer hanging up
+      throw std::runtime_error("Couldn't read from socket: connection closed");
+   }
+   if ((msg.msg_flags & MSG_TRUNC) != 0) {
+      throw std::runtime_error("received message is larger than the buffer");
+   }
+   return static_cast<size_t>(res);
+}
+
+void sendBatch(const Socket &sock, const ConstSegment *messages, size_t count) {
+   std::array<mmsghdr, 64> headers{};
+   while (count > 0) {
+      const auto window = std::min(count, headers.size());
+      for (size_t i = 0; i < window; ++i) {
+         if (messages[i].size == 0) {
+            throw std::runtime_error("can't send empty messages");
+         }
+         headers[i] = mmsghdr();
+         // ConstSegment is layout compatible to iovec
+         headers[i].msg_hdr.msg_iov = reinterpret_cast<iovec *>(const_cast<ConstSegment *>(&messages[i]));
+         headers[i].msg_hdr.msg_iovlen = 1;
+      }
+      // sendmmsg stops at the first message, that doesn't fit into the socket buffer, so continue from there
+      const auto res = ::sendmmsg(sock.get(), headers.data(), static_cast<unsigned>(window), 0);
+      if (res < 0) {
+         throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+      }
+      messages += res;
+      count -= static_cast<size_t>(res);
+   }
+}
+
+size_t receiveBatch(const Socket &sock, const MutableSegment *buffers, size_t count, size_t *sizes) {
+   if (count == 0) {
+      return 0;
+   }
+   std::array<mmsghdr, 64> headers{};
+   const auto window = std::min(count, headers.size());
+   for (size_t i = 0; i < window; ++i) {
+      headers[i].msg_hdr.msg_iov = reinterpret_cast<iovec *>(const_cast<MutableSegment *>(&buffers[i]));
+      headers[i].msg_hdr.msg_iovlen = 1;
+   }
+   const auto res = ::recvmmsg(sock.get(), headers.data(), static_cast<unsigned>(window), MSG_WAITFORONE, nullptr);
+   if (res < 0) {
+      throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+   }
+   for (size_t i = 0; i < static_cast<size_t>(res); ++i) {
+      if (headers[i].msg_len == 0) {
+         // the peer hung up after the messages before, the next call reports it
+         if (i == 0) {
+            throw std::runtime_error("Couldn't read from socket: connection closed");
+         }
+         return i;
+      }
+      if ((headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+         throw std::runtime_error("received message is larger than the buffer");
+      }
+      sizes[i] = headers[i].msg_len;
+   }
+   return static_cast<size_t>(res);
+}
+
 void bind(const Socket &sock, const std::string &pathToFile) {
    // c.f. http://beej.us/guide/bgipc/output/html/multipage/unixsock.html
    ::sockaddr_un local{};
@@ -2,6 +2,8 @@
 
 #include <string>
 #include "Socket.h"
+#include "util/segments.h"
+#include "util/socket/nonBlocking.h"
 
 namespace l5 {
 namespace util {
@@ -10,6 +12,9 @@ struct sockaddr_un;
 
 Socket socket();
 
+/// A socket, that keeps message boundaries: every receive returns exactly one message, as it was sent
+Socket seqPacketSocket();
+
 void listen(const Socket &sock);
 
 void connect(const Socket &sock, const std::string &pathToFile);
@@ -24,8 +29,28 @@ void write(const Socket &sock, const T &object) {
 
 void read(const Socket &sock, void* buffer, std::size_t size);
 
+/// Send all segments, with as few sendmsg calls as possible
+void writev(const Socket &sock, const ConstSegment *segments, size_t count);
+
+/// Fill all segments, with as few recvmsg calls as possible
+void readv(const Socket &sock, const MutableSegment *segments, size_t count);
+
 size_t readSome(const Socket &sock, void *buffer, size_t maxSize);
 
+/// Read exactly size bytes, without blocking. What's available is read right away, and transfer remembers how far it
+/// got. Returns true, once all size bytes arrived, until then call again with the same buffer, size and transfer
+bool tryRead(const Socket &sock, void *buffer, std::size_t size, PartialTransfer &transfer);
+
+/// Write exactly size bytes, without blocking, like tryRead. Never tears the stream, since the remainder is only
+/// written by the next calls
+bool tryWrite(const Socket &sock, const void *buffer, std::size_t size, PartialTransfer &transfer);
+
+/// Whether a read won't block
+bool readable(const Socket &sock);
+
+/// Whether a write won't block
+bool writable(const Socket &sock);
+
 template<typename T>
 void read(const Socket &sock, T &object) {
    static_assert(std::is_trivially_copyable<T>::value, "");
@@ -40,6 +65,21 @@ T read(const Socket &sock) {
    return res;
 }
 
+/// Send a single message over a seqPacketSocket. Messages can't be empty, the peer can't tell them from a hang up
+void send(const Socket &sock, const void *message, std::size_t size);
+
+/// Receive a single message from a seqPacketSocket into buffer, which needs to fit the whole message. Returns its size.
+/// Throws, when the peer hung up
+size_t receive(const Socket &sock, void *buffer, std::size_t maxSize);
+
+/// Send each segment as its own message over a seqPacketSocket, with as few sendmmsg calls as possible
+void sendBatch(const Socket &sock, const ConstSegment *messages, size_t count);
+
+/// Receive up to count messages from a seqPacketSocket with a single recvmmsg call, one message per buffer. Blocks until
+/// at least one message is available, but doesn't wait for more. Returns the number of messages, sizes receives the
+/// size of each of them
+size_t receiveBatch(const Socket &sock, const MutableSegment *buffers, size_t count, size_t *sizes);
+
 void bind(const Socket &sock, const std::string &pathToFile);
 
 Socket accept(const Socket &sock, sockaddr_un &inAddr);
@@ -0,0 +1,386 @@
+#include "fdPassing.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <new>
+#include <optional>
+#include <unistd.h>
+#include "domain.h"
+#include "nonBlocking.h"
+#include "util/copy.h"
+#include "util/futex.h"
+
+namespace l5 {
+namespace util {
+namespace domain {
+using namespace std::string_literals;
+
+/// Start of every pool file, the payload follows after dataOffset
+struct PoolFileHeader {
+    /// set by the writer while the file holds a frame, cleared by the reader once it read all of it
+    std::atomic<uint32_t> busy;
+};
+
+static constexpr size_t dataOffset = 64;
+static_assert(sizeof(PoolFileHeader) <= dataOffset);
+
+static PoolFileHeader &headerOf(const ShmMapping<uint8_t> &mapping) {
+    return *reinterpret_cast<PoolFileHeader *>(mapping.data.get());
+}
+
+/// sendmsg, that attaches fd, unless it is -1, to the first byte of data. Returns the bytes sent, 0 if that would block
+/// with MSG_DONTWAIT
+static size_t sendWithFd(const Socket &sock, const void *data, size_t size, int fd, int flags) {
+    auto iov = iovec();
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+
+    auto ctrl_buf = std::array<char, CMSG_SPACE(sizeof(int))>();
+    auto msg = msghdr();
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd >= 0) {
+        msg.msg_control = ctrl_buf.data();
+        msg.msg_controllen = ctrl_buf.size();
+
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        *reinterpret_cast<int *>(CMSG_DATA(cmsg)) = fd;
+    }
+
+    const auto res = ::sendmsg(sock.get(), &msg, flags);
+    if (res < 0) {
+        if ((flags & MSG_DONTWAIT) != 0 && errno == EAGAIN) return 0;
+        throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+    }
+    return static_cast<size_t>(res);
+}
+
+/// Read exactly size bytes. Returns the descriptor attached to them or -1
+static int receiveWithFd(const Socket &sock, void *data, size_t size) {
+    int fd = -1;
+    for (size_t done = 0; done < size;) {
+        auto iov = iovec();
+        iov.iov_base = reinterpret_cast<uint8_t *>(data) + done;
+        iov.iov_len = size - done;
+
+        auto ctrl_buf = std::array<char, CMSG_SPACE(sizeof(int))>();
+        auto msg = msghdr();
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl_buf.data();
+        msg.msg_controllen = ctrl_buf.size();
+
+        const auto res = ::recvmsg(sock.get(), &msg, MSG_CMSG_CLOEXEC);
+        if (res < 0) {
+            throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+        }
+        if (res == 0) {
+            throw std::runtime_error("Couldn't read from socket: connection closed");
+        }
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                fd = *reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            }
+        }
+        done += static_cast<size_t>(res);
+    }
+    return fd;
+}
+
+FdPassingStream::FdPassingStream(FdPassing options) : options(options) {
+    if (options.poolSize == 0) {
+        throw std::runtime_error{"fd passing needs at least one pool file"};
+    }
+}
+
+bool FdPassingStream::claimSlot(size_t size, bool block, uint32_t &slot, bool &newFile) {
+    while (true) {
+        // prefer a free file, that is large enough, then growing a free one, then a new file
+        std::optional<uint32_t> fitting, replaceable;
+        std::optional<uint32_t> oldest;
+        for (uint32_t i = 0; i < pool.size(); ++i) {
+            if (headerOf(pool[i].mapping).busy.load(std::memory_order_acquire) != 0) {
+                if (not oldest || pool[i].lastUse < pool[*oldest].lastUse) oldest = i;
+                continue;
+            }
+            if (pool[i].capacity >= size) {
+                fitting = i;
+                break;
+            }
+            if (not replaceable) replaceable = i;
+        }
+
+        if (fitting) {
+            slot = *fitting;
+            newFile = false;
+        } else if (pool.size() < options.poolSize || replaceable) {
+            slot = replaceable ? *replaceable : static_cast<uint32_t>(pool.size());
+            if (slot == pool.size()) pool.emplace_back();
+            const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const auto fileSize = (size + dataOffset + pageSize - 1) / pageSize * pageSize;
+            // drop the old mapping first, so the old and the new file are never both mapped
+            pool[slot] = PoolFile();
+            pool[slot].mapping = malloc_shared<uint8_t>("fdPassing" + std::to_string(slot), fileSize);
+            pool[slot].capacity = fileSize - dataOffset;
+            new(pool[slot].mapping.data.get()) PoolFileHeader{};
+            newFile = true;
+        } else if (not block) {
+            return false;
+        } else {
+            // the reader consumes the frames in order, so the least recently used file gets free first
+            auto &busy = headerOf(pool[*oldest].mapping).busy;
+            futexWait(busy, 1);
+            continue;
+        }
+
+        headerOf(pool[slot].mapping).busy.store(1, std::memory_order_relaxed);
+        pool[slot].lastUse = ++pooledWrites;
+        return true;
+    }
+}
+
+void FdPassingStream::writeInline(const Socket &sock, const ConstSegment *segments, size_t count, size_t size) {
+    const auto header = FrameHeader{FrameKind::Inline, 0, size};
+    auto framed = std::vector<ConstSegment>();
+    framed.reserve(count + 1);
+    framed.push_back({&header, sizeof(header)});
+    framed.insert(framed.end(), segments, segments + count);
+    domain::writev(sock, framed.data(), framed.size());
+}
+
+FdPassingStream::FrameHeader FdPassingStream::fillPoolFile(const ConstSegment *segments, size_t count, size_t size,
+                                                            uint32_t slot, bool newFile) {
+    gather(segments, count, 0, size, pool[slot].mapping.data.get() + dataOffset);
+    // the reader only looks at the file after receiving the header, the system call orders the stores before that
+    return FrameHeader{newFile ? FrameKind::PooledNewFile : FrameKind::Pooled, slot, size};
+}
+
+void FdPassingStream::writePooled(const Socket &sock, const ConstSegment *segments, size_t count, size_t size,
+                                  uint32_t slot, bool newFile) {
+    const auto header = fillPoolFile(segments, count, size, slot, newFile);
+    if (newFile) {
+        const auto sent = sendWithFd(sock, &header, sizeof(header), pool[slot].mapping.fd, 0);
+        // the descriptor went with the first byte, the rest is a plain stream
+        domain::write(sock, reinterpret_cast<const uint8_t *>(&header) + sent, sizeof(header) - sent);
+    } else {
+        domain::write(sock, &header, sizeof(header));
+    }
+}
+
+bool FdPassingStream::sendUnsent(const Socket &sock, bool block) {
+    while (not unsent.empty()) {
+        const auto sent = unsentProgress.advance(unsent.size(), [&](size_t offset) {
+            // the descriptor goes with the first byte, the rest is a plain stream
+            const auto fd = offset == 0 ? unsentFd : -1;
+            return sendWithFd(sock, unsent.data() + offset, unsent.size() - offset, fd, block ? 0 : MSG_DONTWAIT);
+        });
+        if (sent) {
+            unsent.clear();
+            unsentFd = -1;
+        } else if (not block) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FdPassingStream::nextFrame(const Socket &sock, bool block) {
+    if (current.remaining > 0) {
+        return true;
+    }
+    // headers are sent in one piece, so once enough bytes are available, the whole header is
+    if (not block && bytesAvailable(sock.get()) < sizeof(FrameHeader)) {
+        return false;
+    }
+    FrameHeader header{};
+    const auto fd = receiveWithFd(sock, &header, sizeof(header));
+    if (header.kind != FrameKind::PooledNewFile && fd >= 0) {
+        ::close(fd);
+        throw std::runtime_error{"received an unexpected file descriptor"};
+    }
+    switch (header.kind) {
+        case FrameKind::Inline:
+            current = Frame{FrameKind::Inline, 0, 0, header.size};
+            return true;
+        case FrameKind::PooledNewFile: {
+            if (fd < 0) {
+                throw std::runtime_error{"pool file without file descriptor"};
+            }
+            // the slot comes from the peer, so don't let it size our pool
+            if (header.slot >= options.poolSize) {
+                ::close(fd);
+                throw std::runtime_error{"pool file slot exceeds the pool size"};
+            }
+            const auto fileSize = ::lseek(fd, 0, SEEK_END);
+            if (fileSize < 0 || static_cast<size_t>(fileSize) < dataOffset) {
+                ::close(fd);
+                throw std::runtime_error{"invalid pool file"};
+            }
+            if (header.slot >= peerPool.size()) {
+                peerPool.resize(header.slot + 1);
+            }
+            auto &file = peerPool[header.slot];
+            file = PoolFile();
+            try {
+                file.mapping = malloc_shared<uint8_t>(fd, static_cast<size_t>(fileSize));
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+            file.capacity = static_cast<size_t>(fileSize) - dataOffset;
+            [[fallthrough]];
+        }
+        case FrameKind::Pooled:
+            if (header.slot >= peerPool.size() || peerPool[header.slot].capacity < header.size) {
+                throw std::runtime_error{"frame doesn't fit its pool file"};
+            }
+            current = Frame{FrameKind::Pooled, header.slot, 0, header.size};
+            return true;
+    }
+    throw std::runtime_error{"unknown frame kind"};
+}
+
+size_t FdPassingStream::consume(const Socket &sock, uint8_t *buffer, size_t size, bool block) {
+    const auto todo = std::min(size, current.remaining);
+    if (current.kind == FrameKind::Inline) {
+        const auto res = ::recv(sock.get(), buffer, todo, block ? 0 : MSG_DONTWAIT);
+        if (res < 0) {
+            if (not block && errno == EAGAIN) return 0;
+            throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+        }
+        if (res == 0) {
+            throw std::runtime_error("Couldn't read from socket: connection closed");
+        }
+        current.remaining -= static_cast<size_t>(res);
+        return static_cast<size_t>(res);
+    }
+
+    const auto &file = peerPool[current.slot];
+    const auto begin = file.mapping.data.get() + dataOffset + current.offset;
+    copyBytes(begin, begin + todo, buffer);
+    current.offset += todo;
+    current.remaining -= todo;
+    if (current.remaining == 0) {
+        auto &busy = headerOf(file.mapping).busy;
+        busy.store(0, std::memory_order_release);
+        futexWakeAll(busy);
+    }
+    return todo;
+}
+
+size_t FdPassingStream::unstage(uint8_t *buffer, size_t size) {
+    const auto todo = std::min(size, staged.size());
+    std::copy(staged.begin(), staged.begin() + todo, buffer);
+    staged.erase(staged.begin(), staged.begin() + todo);
+    return todo;
+}
+
+void FdPassingStream::write(const Socket &sock, const void *data, size_t size) {
+    const auto segment = ConstSegment{data, size};
+    writev(sock, &segment, 1);
+}
+
+void FdPassingStream::writev(const Socket &sock, const ConstSegment *segments, size_t count) {
+    // the frame of an unfinished tryWrite comes first
+    sendUnsent(sock, true);
+    const auto size = totalSize(segments, count);
+    if (size == 0) {
+        return;
+    }
+    if (size < options.threshold) {
+        writeInline(sock, segments, count, size);
+        return;
+    }
+    uint32_t slot = 0;
+    bool newFile = false;
+    claimSlot(size, true, slot, newFile);
+    writePooled(sock, segments, count, size, slot, newFile);
+}
+
+void FdPassingStream::read(const Socket &sock, void *buffer, size_t size) {
+    const auto bytes = reinterpret_cast<uint8_t *>(buffer);
+    for (auto done = unstage(bytes, size); done < size;) {
+        nextFrame(sock, true);
+        done += consume(sock, bytes + done, size - done, true);
+    }
+}
+
+void FdPassingStream::readv(const Socket &sock, const MutableSegment *segments, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        read(sock, segments[i].data, segments[i].size);
+    }
+}
+
+size_t FdPassingStream::readSome(const Socket &sock, void *buffer, size_t maxSize) {
+    const auto bytes = reinterpret_cast<uint8_t *>(buffer);
+    if (not staged.empty() || maxSize == 0) {
+        return unstage(bytes, maxSize);
+    }
+    nextFrame(sock, true);
+    return consume(sock, bytes, maxSize, true);
+}
+
+bool FdPassingStream::tryRead(const Socket &sock, void *buffer, size_t size) {
+    // the bytes might be spread over several frames, so collect what's there, until there is enough
+    while (staged.size() < size && nextFrame(sock, false)) {
+        const auto before = staged.size();
+        staged.resize(size);
+        const auto got = consume(sock, staged.data() + before, size - before, false);
+        staged.resize(before + got);
+        if (got == 0) break;
+    }
+    if (staged.size() < size) {
+        return false;
+    }
+    unstage(reinterpret_cast<uint8_t *>(buffer), size);
+    return true;
+}
+
+bool FdPassingStream::tryWrite(const Socket &sock, const void *data, size_t size) {
+    if (not unsent.empty()) {
+        // the frame is staged already, this call only continues sending it
+        if (size != unsentWrite) {
+            throw std::runtime_error("a partial transfer needs to be continued with the same size");
+        }
+        return sendUnsent(sock, false);
+    }
+    if (size == 0) {
+        return true;
+    }
+    const auto segment = ConstSegment{data, size};
+    auto header = FrameHeader{FrameKind::Inline, 0, size};
+    if (size >= options.threshold) {
+        uint32_t slot = 0;
+        bool newFile = false;
+        if (not claimSlot(size, false, slot, newFile)) {
+            return false;
+        }
+        header = fillPoolFile(&segment, 1, size, slot, newFile);
+        unsentFd = newFile ? pool[slot].mapping.fd : -1;
+    }
+
+    // stage the whole frame, so whatever doesn't fit into the socket now can be sent by the next calls
+    const auto headerBytes = reinterpret_cast<const uint8_t *>(&header);
+    unsent.assign(headerBytes, headerBytes + sizeof(header));
+    if (header.kind == FrameKind::Inline) {
+        const auto bytes = reinterpret_cast<const uint8_t *>(data);
+        unsent.insert(unsent.end(), bytes, bytes + size);
+    }
+    unsentWrite = size;
+    return sendUnsent(sock, false);
+}
+
+bool FdPassingStream::readable(const Socket &sock) const {
+    const auto pooledData = current.remaining > 0 && current.kind != FrameKind::Inline;
+    return not staged.empty() || pooledData || domain::readable(sock);
+}
+
+bool FdPassingStream::writable(const Socket &sock) const {
+    return domain::writable(sock);
+}
+} // namespace domain
+} // namespace util
+} // namespace l5
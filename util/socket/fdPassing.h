@@ -0,0 +1,140 @@
+#ifndef L5RDMA_FDPASSING_H
+#define L5RDMA_FDPASSING_H
+
+#include <cstdint>
+#include <vector>
+#include "util/segments.h"
+#include "util/socket/Socket.h"
+#include "util/socket/nonBlocking.h"
+#include "util/virtualMemory.h"
+
+namespace l5 {
+namespace util {
+namespace domain {
+/// Configuration of FdPassingStream. Both ends of a connection need to agree on whether it is used
+struct FdPassing {
+    /// Writes of at least this many bytes go through a shared memory file instead of the socket, 0 disables fd passing
+    size_t threshold = 0;
+    /// Number of shared memory files per direction. A writer blocks, when all of them still wait to be read. A reader
+    /// rejects pool files beyond its own poolSize, so it must not be smaller than the writer's
+    uint32_t poolSize = 4;
+
+    bool enabled() const { return threshold != 0; }
+};
+
+/**
+ * Byte stream over a domain socket, that moves large writes through pooled memfds instead of the socket buffers.
+ * Each write becomes a frame: small ones carry their data inline, large ones are copied into a free pool file and
+ * only a small header goes through the socket. A pool file's descriptor is passed along the first time it is used
+ * and the receiver keeps the mapping, so later writes into the same file don't need any fd passing or mmap.
+ * The reader copies straight out of its mapping, so the payload is copied once on each side instead of through the
+ * kernel's socket buffers, which helps for multi-MB writes.
+ * How the data was cut into writes is invisible to the reader, which still sees a plain stream.
+ */
+class FdPassingStream {
+    enum class FrameKind : uint32_t {
+        /// the data follows on the socket
+        Inline,
+        /// the data is in a pool file, that the receiver already mapped
+        Pooled,
+        /// like Pooled, but the pool file is new and its descriptor is attached to the frame header
+        PooledNewFile
+    };
+
+    struct FrameHeader {
+        FrameKind kind;
+        uint32_t slot;
+        uint64_t size;
+    };
+
+    struct PoolFile {
+        ShmMapping<uint8_t> mapping;
+        /// payload bytes, that fit into the file
+        size_t capacity = 0;
+        /// writer only: number of the last pooled write into this file
+        uint64_t lastUse = 0;
+    };
+
+    /// The frame, that is currently being read
+    struct Frame {
+        FrameKind kind = FrameKind::Inline;
+        uint32_t slot = 0;
+        size_t offset = 0;
+        size_t remaining = 0;
+    };
+
+    FdPassing options;
+    /// our pool files, that we write to
+    std::vector<PoolFile> pool;
+    /// the peer's pool files, that we read from, by slot
+    std::vector<PoolFile> peerPool;
+    Frame current;
+    /// tryRead only: bytes taken out of frames, but not yet handed out
+    std::vector<uint8_t> staged;
+
+    /// number of pooled writes so far, the reader frees the files in the order of their lastUse
+    uint64_t pooledWrites = 0;
+
+    /// tryWrite only: the rest of the frame, that didn't fit into the socket yet. The frame header, followed by the
+    /// data for inline frames
+    std::vector<uint8_t> unsent;
+    PartialTransfer unsentProgress;
+    /// the pool file's descriptor, that needs to go with the first byte of unsent, or -1
+    int unsentFd = -1;
+    /// size of the tryWrite, that unsent belongs to
+    size_t unsentWrite = 0;
+
+    /// Mark a pool file, that fits size bytes, as in use. Replaces or adds a file, if none of the free ones is large
+    /// enough. Waits for the reader to free a file with block, returns false otherwise
+    bool claimSlot(size_t size, bool block, uint32_t &slot, bool &newFile);
+
+    void writeInline(const Socket &sock, const ConstSegment *segments, size_t count, size_t size);
+
+    /// Copy the frame's data into a claimed pool file and return the header, that announces it
+    FrameHeader fillPoolFile(const ConstSegment *segments, size_t count, size_t size, uint32_t slot, bool newFile);
+
+    void writePooled(const Socket &sock, const ConstSegment *segments, size_t count, size_t size, uint32_t slot,
+                     bool newFile);
+
+    /// Send the rest of the frame staged by tryWrite. Returns false, if that would block
+    bool sendUnsent(const Socket &sock, bool block);
+
+    /// Make sure there is a current frame with unread data. Returns false, if that would block
+    bool nextFrame(const Socket &sock, bool block);
+
+    /// Read up to size bytes of the current frame. Returns 0 only without block, if no data is available
+    size_t consume(const Socket &sock, uint8_t *buffer, size_t size, bool block);
+
+    /// Hand out up to size staged bytes
+    size_t unstage(uint8_t *buffer, size_t size);
+
+public:
+    explicit FdPassingStream(FdPassing options);
+
+    void write(const Socket &sock, const void *data, size_t size);
+
+    /// All segments form a single frame, so they either all go inline or together into one pool file
+    void writev(const Socket &sock, const ConstSegment *segments, size_t count);
+
+    void read(const Socket &sock, void *buffer, size_t size);
+
+    void readv(const Socket &sock, const MutableSegment *segments, size_t count);
+
+    size_t readSome(const Socket &sock, void *buffer, size_t maxSize);
+
+    /// Read exactly size bytes, but only if they are available already
+    bool tryRead(const Socket &sock, void *buffer, size_t size);
+
+    /// Write without blocking, if, for large writes, a pool file is free. A frame, that doesn't fit into the socket at
+    /// once, is kept and the next calls, with the same size, continue sending it, until one returns true
+    bool tryWrite(const Socket &sock, const void *data, size_t size);
+
+    bool readable(const Socket &sock) const;
+
+    bool writable(const Socket &sock) const;
+};
+} // namespace domain
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_FDPASSING_H
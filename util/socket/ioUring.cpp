@@ -0,0 +1,164 @@
+#include "ioUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace l5 {
+namespace util {
+using namespace std::string_literals;
+
+namespace {
+template<typename T>
+std::shared_ptr<T> mapRing(int fd, size_t size, off_t offset) {
+    const auto mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map io_uring: "s + ::strerror(errno));
+    }
+    return std::shared_ptr<T>(reinterpret_cast<T *>(mapping), [size](T *p) { ::munmap(p, size); });
+}
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params{};
+    const auto fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        throw std::runtime_error("Could not set up io_uring: "s + ::strerror(errno));
+    }
+    ring = Socket::fromRaw(fd);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+        throw std::runtime_error("io_uring needs IORING_FEAT_SINGLE_MMAP (Linux 5.4)");
+    }
+
+    // submission and completion queue share a single mapping
+    const auto sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const auto cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    rings = mapRing<uint8_t>(fd, std::max(sqSize, cqSize), IORING_OFF_SQ_RING);
+    sqes = mapRing<io_uring_sqe>(fd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+
+    const auto base = rings.get();
+    sqHead = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    // we always fill the entries in order, so the indirection array is the identity
+    const auto sqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) {
+        sqArray[i] = i;
+    }
+
+    cqHead = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+}
+
+io_uring_sqe &IoUring::prepare() {
+    const auto tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+        submit();
+    }
+    auto &sqe = sqes.get()[tail & sqMask];
+    std::memset(&sqe, 0, sizeof(sqe));
+    // the kernel only looks at the entry, once it's submitted with io_uring_enter
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted;
+    return sqe;
+}
+
+bool IoUring::submit(unsigned waitFor, int timeoutMs) {
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    __kernel_timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000 * 1000};
+    io_uring_getevents_arg arg{};
+    void *extraArg = nullptr;
+    size_t extraArgSize = 0;
+    if (waitFor > 0 && timeoutMs >= 0) {
+        arg.ts = reinterpret_cast<uintptr_t>(&timeout);
+        flags |= IORING_ENTER_EXT_ARG;
+        extraArg = &arg;
+        extraArgSize = sizeof(arg);
+    }
+
+    while (unsubmitted > 0 || waitFor > 0) {
+        const auto res = ::syscall(__NR_io_uring_enter, ring.get(), unsubmitted, waitFor, flags, extraArg,
+                                   extraArgSize);
+        if (res < 0) {
+            if (errno == ETIME) return false;
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Could not submit to io_uring: "s + ::strerror(errno));
+        }
+        unsubmitted -= static_cast<unsigned>(res);
+        waitFor = 0;
+    }
+    return true;
+}
+
+ProvidedBuffers::ProvidedBuffers(const IoUring &uring, uint16_t group, uint16_t count, uint32_t bufferSize) :
+        uring(Socket::fromRaw(::fcntl(uring.get(), F_DUPFD_CLOEXEC, 0))),
+        buffers(std::make_unique<uint8_t[]>(size_t(count) * bufferSize)),
+        group(group),
+        count(count),
+        bufferSize(bufferSize) {
+    if (this->uring.get() < 0) {
+        throw std::runtime_error("Could not duplicate io_uring: "s + ::strerror(errno));
+    }
+    if (count == 0 || (count & (count - 1)) != 0) {
+        throw std::runtime_error("The number of provided buffers needs to be a power of two");
+    }
+    const auto ringSize = count * sizeof(io_uring_buf);
+    const auto mapping = ::mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not allocate buffer ring: "s + ::strerror(errno));
+    }
+    ring = std::shared_ptr<io_uring_buf_ring>(reinterpret_cast<io_uring_buf_ring *>(mapping),
+                                              [ringSize](io_uring_buf_ring *p) { ::munmap(p, ringSize); });
+
+    io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<uintptr_t>(mapping);
+    registration.ring_entries = count;
+    registration.bgid = group;
+    if (::syscall(__NR_io_uring_register, this->uring.get(), IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        throw std::runtime_error("Could not register buffer ring (needs Linux 5.19): "s + ::strerror(errno));
+    }
+
+    for (uint16_t id = 0; id < count; ++id) {
+        recycle(id);
+    }
+}
+
+ProvidedBuffers::~ProvidedBuffers() {
+    // a receive, that the kernel didn't complete yet, might still pick a buffer. The requests don't say which group
+    // they use, so cancel all of them and wait until they are gone
+    io_uring_sync_cancel_reg cancel{};
+    cancel.flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+    cancel.timeout.tv_sec = -1;
+    cancel.timeout.tv_nsec = -1;
+    const auto cancelled = ::syscall(__NR_io_uring_register, uring.get(), IORING_REGISTER_SYNC_CANCEL, &cancel, 1) >= 0
+                           || errno == ENOENT;
+    // afterwards, the kernel doesn't look at the buffer ring anymore
+    io_uring_buf_reg registration{};
+    registration.bgid = group;
+    ::syscall(__NR_io_uring_register, uring.get(), IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    if (not cancelled) {
+        // without synchronous cancellation (Linux 6.0), a receive might still be writing to the buffer it picked.
+        // Rather leak the buffers, than have them overwritten after they are freed
+        buffers.release();
+    }
+}
+
+void ProvidedBuffers::recycle(uint16_t id) {
+    // don't use ring->bufs: C++ pads the empty struct, that the kernel headers put in front of the flexible array
+    auto &entry = reinterpret_cast<io_uring_buf *>(ring.get())[tail & (count - 1)];
+    entry.addr = reinterpret_cast<uintptr_t>(buffer(id));
+    entry.len = bufferSize;
+    entry.bid = id;
+    ++tail;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+} // namespace util
+} // namespace l5
@@ -0,0 +1,94 @@
+#ifndef L5RDMA_IOURING_H
+#define L5RDMA_IOURING_H
+
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <memory>
+#include "util/NonCopyable.h"
+#include "util/socket/Socket.h"
+
+namespace l5 {
+namespace util {
+/**
+ * Minimal io_uring, talking to the kernel directly, so we don't depend on liburing.
+ * Only one thread may use a ring at a time.
+ */
+class IoUring : NonCopyable {
+    Socket ring;
+    std::shared_ptr<uint8_t> rings;
+    std::shared_ptr<io_uring_sqe> sqes;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    /// Prepared, but not yet submitted entries
+    unsigned unsubmitted = 0;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+
+public:
+    explicit IoUring(unsigned entries);
+
+    IoUring(IoUring &&) noexcept = default;
+
+    IoUring &operator=(IoUring &&) noexcept = default;
+
+    int get() const noexcept { return ring.get(); }
+
+    /// A cleared submission queue entry, which is submitted with the next submit. Submits, if the queue is full
+    io_uring_sqe &prepare();
+
+    /// Submit all prepared entries and wait until at least waitFor completions are available. Gives up waiting after
+    /// timeoutMs, if it is not negative, and returns false then (needs Linux 5.11)
+    bool submit(unsigned waitFor = 0, int timeoutMs = -1);
+
+    /// Call consumer for every available completion, without a system call. Returns the number of completions
+    template<typename CompletionConsumer>
+    size_t forEachCompletion(CompletionConsumer &&consumer) {
+        auto head = *cqHead;
+        const auto tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        size_t count = 0;
+        for (; head != tail; ++head, ++count) {
+            const io_uring_cqe cqe = cqes[head & cqMask];
+            // free the slot before calling the consumer, which might submit and generate new completions
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            consumer(cqe);
+        }
+        return count;
+    }
+};
+
+/**
+ * A ring of equally sized buffers, registered with an IoUring as a buffer group. Receives with IOSQE_BUFFER_SELECT on
+ * that group pick a buffer on their own, so no buffer needs to be reserved for idle connections.
+ */
+class ProvidedBuffers : NonCopyable {
+    /// our own descriptor of the IoUring, so we can still take the buffers back, after it is closed
+    Socket uring;
+    std::shared_ptr<io_uring_buf_ring> ring;
+    std::unique_ptr<uint8_t[]> buffers;
+    const uint16_t group;
+    const uint16_t count;
+    const uint32_t bufferSize;
+    uint16_t tail = 0;
+
+public:
+    /// count needs to be a power of two
+    ProvidedBuffers(const IoUring &uring, uint16_t group, uint16_t count, uint32_t bufferSize);
+
+    /// Cancels the requests of the IoUring, which might still receive into a buffer, and unregisters the group
+    ~ProvidedBuffers();
+
+    uint8_t *buffer(uint16_t id) { return &buffers[size_t(id) * bufferSize]; }
+
+    /// Hand the buffer back to the kernel, after its contents were consumed
+    void recycle(uint16_t id);
+};
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_IOURING_H
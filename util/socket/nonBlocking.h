@@ -0,0 +1,100 @@
+#ifndef L5RDMA_NONBLOCKING_H
+#define L5RDMA_NONBLOCKING_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+namespace l5 {
+namespace util {
+/// Poll a single socket for events, without blocking
+inline bool pollNow(int fd, short events) {
+    pollfd pollFd{fd, events, 0};
+    const auto res = ::poll(&pollFd, 1, 0);
+    if (res < 0) {
+        throw std::runtime_error(std::string("Could not poll socket: ") + strerror(errno));
+    }
+    // also report errors and hang ups, so the following operation doesn't block, but reports them
+    return res > 0 && (pollFd.revents & (events | POLLERR | POLLHUP)) != 0;
+}
+
+/// Bytes that can be read from a stream socket without blocking
+inline size_t bytesAvailable(int fd) {
+    int available = 0;
+    if (::ioctl(fd, FIONREAD, &available) < 0) {
+        throw std::runtime_error(std::string("Couldn't query available bytes: ") + strerror(errno));
+    }
+    return static_cast<size_t>(available);
+}
+
+/// Send as much as possible without blocking, 0 if the send buffer is full
+inline size_t sendNonBlocking(int fd, const void *buffer, size_t size) {
+    const auto res = ::send(fd, buffer, size, MSG_DONTWAIT);
+    if (res < 0) {
+        if (errno == EAGAIN) return 0;
+        throw std::runtime_error(std::string("Couldn't write to socket: ") + strerror(errno));
+    }
+    return static_cast<size_t>(res);
+}
+
+/// Receive as much as possible without blocking, 0 if nothing is available
+inline size_t receiveNonBlocking(int fd, void *buffer, size_t size) {
+    const auto res = ::recv(fd, buffer, size, MSG_DONTWAIT);
+    if (res < 0) {
+        if (errno == EAGAIN) return 0;
+        throw std::runtime_error(std::string("Couldn't read from socket: ") + strerror(errno));
+    }
+    if (res == 0 && size != 0) {
+        throw std::runtime_error("Couldn't read from socket: connection closed");
+    }
+    return static_cast<size_t>(res);
+}
+
+/// How far a non-blocking transfer on a stream socket got. A transfer, that doesn't fit into the socket buffer, takes
+/// several tries, each continuing where the last one stopped. Keep one per connection and direction
+class PartialTransfer {
+    size_t done = 0;
+    size_t size = 0;
+
+public:
+    /// Transfer with move, which moves as many bytes as possible without blocking, starting at the offset given to it.
+    /// Returns whether all size bytes are transferred now, then the next call starts a new transfer
+    template<typename Move>
+    bool advance(size_t transferSize, Move &&move) {
+        if (done != 0 && transferSize != size) {
+            throw std::runtime_error("a partial transfer needs to be continued with the same size");
+        }
+        size = transferSize;
+        done += move(done);
+        if (done < size) {
+            return false;
+        }
+        done = 0;
+        return true;
+    }
+
+    bool inProgress() const { return done != 0; }
+};
+
+/// Continue receiving exactly size bytes into buffer without blocking. Returns true, once all of them arrived
+inline bool tryReceive(int fd, void *buffer, size_t size, PartialTransfer &transfer) {
+    return transfer.advance(size, [&](size_t offset) {
+        return receiveNonBlocking(fd, reinterpret_cast<uint8_t *>(buffer) + offset, size - offset);
+    });
+}
+
+/// Continue sending exactly size bytes from buffer without blocking. Returns true, once all of them are sent
+inline bool trySend(int fd, const void *buffer, size_t size, PartialTransfer &transfer) {
+    return transfer.advance(size, [&](size_t offset) {
+        return sendNonBlocking(fd, reinterpret_cast<const uint8_t *>(buffer) + offset, size - offset);
+    });
+}
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_NONBLOCKING_H
@@ -1,11 +1,61 @@
+#include <chrono>
 #include <cstring>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <xmmintrin.h>
 #include "tcp.h"
 #include "util/socket/Socket.h"
+#include "util/socket/nonBlocking.h"
+#include "util/socket/vectoredIo.h"
 
 using namespace std::string_literals;
 
+namespace {
+/// How long a low latency socket busy polls, in the kernel as well as in readSpinning
+constexpr auto busyPollTime = std::chrono::microseconds(50);
+
+/// Call receive with MSG_DONTWAIT until it gets any data, or with blockingFlags after deadline. receive returns, what
+/// recv or recvmsg returned, the result is what it received, 0 on hang up
+template<typename Receive>
+size_t receiveSpinning(Receive &&receive, int blockingFlags, std::chrono::steady_clock::time_point deadline) {
+   bool block = false;
+   for (size_t tries = 0;; ++tries) {
+      const auto res = receive(block ? blockingFlags : MSG_DONTWAIT);
+      if (res >= 0) {
+         return static_cast<size_t>(res);
+      }
+      if (errno != EINTR && (block || errno != EAGAIN)) {
+         throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+      }
+      // don't ask the clock every time
+      if (tries % 64 == 63 && std::chrono::steady_clock::now() > deadline) {
+         block = true;
+      }
+      if (not block) {
+         _mm_pause();
+      }
+   }
+}
+} // namespace
+
+void l5::util::tcp::setProfile(const Socket &sock, Profile profile) {
+   if (profile == Profile::Default) return;
+
+   const int enable = 1;
+   if (::setsockopt(sock.get(), IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) < 0) {
+      throw std::runtime_error("Couldn't set TCP_NODELAY: "s + strerror(errno));
+   }
+   // busy polling longer than net.core.busy_read and preferring it over interrupts needs CAP_NET_ADMIN.
+   // Without it, we still spin in user space, so failures are fine
+   const int busyPoll = static_cast<int>(busyPollTime.count());
+   ::setsockopt(sock.get(), SOL_SOCKET, SO_BUSY_POLL, &busyPoll, sizeof(busyPoll));
+   ::setsockopt(sock.get(), SOL_SOCKET, SO_PREFER_BUSY_POLL, &enable, sizeof(enable));
+}
+
 void l5::util::tcp::connect(const l5::util::Socket &sock, const sockaddr_in &dest) {
    auto addr = reinterpret_cast<const sockaddr*>(&dest);
    if (::connect(sock.get(), addr, sizeof(dest)) < 0) {
@@ -47,6 +97,48 @@ void l5::util::tcp::read(const l5::util::Socket &sock, void* buffer, std::size_t
    }
 }
 
+void l5::util::tcp::readSpinning(const Socket &sock, void *buffer, std::size_t size) {
+   auto current = reinterpret_cast<uint8_t *>(buffer);
+   const auto deadline = std::chrono::steady_clock::now() + busyPollTime;
+   while (size > 0) {
+      const auto res = receiveSpinning([&](int flags) { return ::recv(sock.get(), current, size, flags); },
+                                       MSG_WAITALL, deadline);
+      if (res == 0) {
+         throw std::runtime_error("Couldn't read from socket: connection closed");
+      }
+      current += res;
+      size -= res;
+   }
+}
+
+void l5::util::tcp::writev(const Socket &sock, const ConstSegment *segments, size_t count) {
+   transferSegments(segments, count, [&](msghdr &msg) {
+      auto res = ::sendmsg(sock.get(), &msg, 0);
+      if (res < 0) {
+         throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+      }
+      return static_cast<size_t>(res);
+   });
+}
+
+void l5::util::tcp::readv(const Socket &sock, const MutableSegment *segments, size_t count) {
+   transferSegments(segments, count, [&](msghdr &msg) {
+      auto res = ::recvmsg(sock.get(), &msg, MSG_WAITALL);
+      if (res < 0) {
+         throw std::runtime_error("Couldn't read from socket: "s + strerror(errno));
+      }
+      return static_cast<size_t>(res);
+   });
+}
+
+void l5::util::tcp::readvSpinning(const Socket &sock, const MutableSegment *segments, size_t count) {
+   // one deadline for all recvmsg calls, like readSpinning
+   const auto deadline = std::chrono::steady_clock::now() + busyPollTime;
+   transferSegments(segments, count, [&](msghdr &msg) {
+      return receiveSpinning([&](int flags) { return ::recvmsg(sock.get(), &msg, flags); }, MSG_WAITALL, deadline);
+   });
+}
+
 size_t l5::util::tcp::readSome(const Socket &sock, void *buffer, size_t maxSize) {
     auto res = ::recv(sock.get(), buffer, maxSize, 0);
     if (res < 0) {
@@ -55,6 +147,108 @@ size_t l5::util::tcp::readSome(const Socket &sock, void *buffer, size_t maxSize)
     return res;
 }
 
+size_t l5::util::tcp::readSomeSpinning(const Socket &sock, void *buffer, size_t maxSize) {
+   const auto deadline = std::chrono::steady_clock::now() + busyPollTime;
+   return receiveSpinning([&](int flags) { return ::recv(sock.get(), buffer, maxSize, flags); }, 0, deadline);
+}
+
+bool l5::util::tcp::tryRead(const Socket &sock, void *buffer, std::size_t size, PartialTransfer &transfer) {
+   return tryReceive(sock.get(), buffer, size, transfer);
+}
+
+bool l5::util::tcp::tryWrite(const Socket &sock, const void *buffer, std::size_t size, PartialTransfer &transfer) {
+   return trySend(sock.get(), buffer, size, transfer);
+}
+
+bool l5::util::tcp::readable(const Socket &sock) {
+   return pollNow(sock.get(), POLLIN);
+}
+
+bool l5::util::tcp::writable(const Socket &sock) {
+   return pollNow(sock.get(), POLLOUT);
+}
+
+void l5::util::tcp::ZeroCopy::enable(const Socket &sock) {
+   const int enable = 1;
+   if (::setsockopt(sock.get(), SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) < 0) {
+      throw std::runtime_error("Couldn't enable zero copy: "s + strerror(errno));
+   }
+}
+
+uint64_t l5::util::tcp::ZeroCopy::write(const Socket &sock, const void *buffer, std::size_t size) {
+   if (size < threshold || copied) {
+      tcp::write(sock, buffer, size);
+      // nothing to wait for
+      return 0;
+   }
+   for (size_t current = 0; current < size;) {
+      auto res = ::send(sock.get(), reinterpret_cast<const char *>(buffer) + current, size - current, MSG_ZEROCOPY);
+      if (res < 0) {
+         // too many pinned sends, wait for some to complete
+         if (errno == ENOBUFS && sent > completed) {
+            waitUntilReusable(sock, completed + 1);
+            continue;
+         }
+         throw std::runtime_error("Couldn't write to socket: "s + strerror(errno));
+      }
+      // every successful send gets its own notification
+      ++sent;
+      current += res;
+   }
+   return sent;
+}
+
+bool l5::util::tcp::ZeroCopy::reusable(const Socket &sock, uint64_t ticket) {
+   if (completed >= ticket) return true;
+   reap(sock);
+   return completed >= ticket;
+}
+
+void l5::util::tcp::ZeroCopy::waitUntilReusable(const Socket &sock, uint64_t ticket) {
+   while (not reusable(sock, ticket)) {
+      // errors are always reported, so this only wakes up for notifications or hang ups
+      pollfd pollFd{sock.get(), 0, 0};
+      if (::poll(&pollFd, 1, -1) < 0 && errno != EINTR) {
+         throw std::runtime_error("Couldn't poll socket: "s + strerror(errno));
+      }
+      if ((pollFd.revents & POLLERR) == 0 && (pollFd.revents & POLLHUP) != 0) {
+         throw std::runtime_error("Connection closed while waiting for zero copy completions");
+      }
+   }
+}
+
+bool l5::util::tcp::ZeroCopy::reap(const Socket &sock) {
+   bool any = false;
+   for (;;) {
+      char control[CMSG_SPACE(sizeof(sock_extended_err)) + 64];
+      msghdr msg{};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(sock.get(), &msg, MSG_ERRQUEUE) < 0) {
+         if (errno == EAGAIN) return any;
+         if (errno == EINTR) continue;
+         throw std::runtime_error("Couldn't read socket error queue: "s + strerror(errno));
+      }
+      for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+         const auto isRecvErr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                                (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+         if (not isRecvErr) continue;
+         sock_extended_err error;
+         std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+         if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            throw std::runtime_error("Couldn't write to socket: "s + strerror(static_cast<int>(error.ee_errno)));
+         }
+         // [ee_info, ee_data] is the range of completed sends, which complete in order on TCP
+         const uint32_t newlyCompleted = error.ee_data + 1 - static_cast<uint32_t>(completed);
+         completed += newlyCompleted;
+         if ((error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) {
+            copied = true;
+         }
+         any = true;
+      }
+   }
+}
+
 void l5::util::tcp::bind(const l5::util::Socket &sock, const sockaddr_in &addr) {
    auto what = reinterpret_cast<const sockaddr*>(&addr);
    if (::bind(sock.get(), what, sizeof(addr)) < 0) {
@@ -71,6 +265,15 @@ void l5::util::tcp::bind(const l5::util::Socket &sock, uint16_t port) {
    bind(sock, addr);
 }
 
+uint16_t l5::util::tcp::localPort(const l5::util::Socket &sock) {
+   sockaddr_in addr{};
+   socklen_t addrLen = sizeof(addr);
+   if (::getsockname(sock.get(), reinterpret_cast<sockaddr*>(&addr), &addrLen) < 0) {
+      throw std::runtime_error("Couldn't get the socket's address: "s + strerror(errno));
+   }
+   return ntohs(addr.sin_port);
+}
+
 void l5::util::tcp::listen(const l5::util::Socket &sock) {
    if (::listen(sock.get(), SOMAXCONN) < 0) {
       throw std::runtime_error("Couldn't listen on socket: "s + strerror(errno));
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include "util/segments.h"
+#include "util/socket/nonBlocking.h"
 
 struct sockaddr_in;
 
@@ -8,6 +11,17 @@ namespace l5 {
 namespace util {
 class Socket;
 namespace tcp {
+/// How to tune a connection's socket
+enum class Profile {
+    /// the kernel's defaults, which favor throughput
+    Default,
+    /// no Nagle, kernel busy polling where permitted, and reads, that spin on non-blocking receives before blocking
+    LowLatency
+};
+
+/// Set the socket options of profile
+void setProfile(const Socket &sock, Profile profile);
+
 void connect(const Socket &sock, const sockaddr_in &dest);
 
 void connect(const Socket &sock, const std::string &ip, uint16_t port);
@@ -22,8 +36,77 @@ void write(const Socket &sock, const T &object) {
 
 void read(const Socket &sock, void *buffer, std::size_t size);
 
+/// Like read, but spin on non-blocking receives for a few microseconds, before blocking. Saves the wake up latency,
+/// when the data arrives soon
+void readSpinning(const Socket &sock, void *buffer, std::size_t size);
+
+/// Send all segments, with as few sendmsg calls as possible
+void writev(const Socket &sock, const ConstSegment *segments, size_t count);
+
+/// Fill all segments, with as few recvmsg calls as possible
+void readv(const Socket &sock, const MutableSegment *segments, size_t count);
+
+/// readv, that spins like readSpinning
+void readvSpinning(const Socket &sock, const MutableSegment *segments, size_t count);
+
 size_t readSome(const Socket &sock, void *buffer, size_t maxSize);
 
+/// readSome, that spins like readSpinning, until anything arrives
+size_t readSomeSpinning(const Socket &sock, void *buffer, size_t maxSize);
+
+/// Read exactly size bytes, without blocking. What's available is read right away, and transfer remembers how far it
+/// got. Returns true, once all size bytes arrived, until then call again with the same buffer, size and transfer
+bool tryRead(const Socket &sock, void *buffer, std::size_t size, PartialTransfer &transfer);
+
+/// Write exactly size bytes, without blocking, like tryRead. Never tears the stream, since the remainder is only
+/// written by the next calls
+bool tryWrite(const Socket &sock, const void *buffer, std::size_t size, PartialTransfer &transfer);
+
+/// Whether a read won't block
+bool readable(const Socket &sock);
+
+/// Whether a write won't block
+bool writable(const Socket &sock);
+
+/**
+ * Writes with MSG_ZEROCOPY (Linux 4.14). Instead of copying into the socket buffer, the kernel pins the pages and
+ * sends from them directly, so the memory must not be modified until the kernel reports the write as completed.
+ * That only pays off for large writes, smaller ones are copied as usual.
+ */
+class ZeroCopy {
+    /// The kernel numbers the zero copy sends of a socket 0, 1, 2, ... we count them without wrapping around
+    uint64_t sent = 0;
+    /// All sends < completed are done
+    uint64_t completed = 0;
+    /// The kernel reported, that it had to copy anyway (e.g. on loopback)
+    bool copied = false;
+
+public:
+    /// Writes smaller than this are copied
+    size_t threshold;
+
+    explicit ZeroCopy(size_t threshold = 16 * 1024) : threshold(threshold) {}
+
+    /// Set SO_ZEROCOPY on the socket, needed before the first write
+    static void enable(const Socket &sock);
+
+    /// Write all of buffer. Returns a ticket, which becomes reusable, when the kernel doesn't need buffer anymore
+    uint64_t write(const Socket &sock, const void *buffer, std::size_t size);
+
+    /// Whether the buffer of the write with ticket may be modified again. Doesn't block
+    bool reusable(const Socket &sock, uint64_t ticket);
+
+    /// Block until the buffer of the write with ticket may be modified again
+    void waitUntilReusable(const Socket &sock, uint64_t ticket);
+
+    /// Whether the kernel had to copy the data anyway, so zero copy is just overhead. Later writes are copied then
+    bool fellBackToCopy() const { return copied; }
+
+private:
+    /// Process all completion notifications in the socket's error queue. Returns whether there were any
+    bool reap(const Socket &sock);
+};
+
 template<typename T>
 void read(const Socket &sock, T &object) {
     static_assert(std::is_trivially_copyable<T>::value, "");
@@ -42,6 +125,9 @@ void bind(const Socket &sock, const sockaddr_in &addr);
 
 void bind(const Socket &sock, uint16_t port);
 
+/// The port sock is bound to, e.g. the one the kernel picked for port 0
+uint16_t localPort(const Socket &sock);
+
 void listen(const Socket &sock);
 
 Socket accept(const Socket &sock, sockaddr_in &inAddr);
@@ -0,0 +1,54 @@
+#ifndef L5RDMA_VECTOREDIO_H
+#define L5RDMA_VECTOREDIO_H
+
+#include <array>
+#include <stdexcept>
+#include <sys/socket.h>
+#include "util/segments.h"
+
+namespace l5 {
+namespace util {
+/**
+ * Transfer all segments with sendmsg / recvmsg. Those might transfer only parts of the data, so this keeps a copy of
+ * the remaining iovecs, which it can advance. Handles at most a window of segments per system call
+ * @param transfer [](msghdr &msg) -> size_t, bytes transferred, throws on errors
+ */
+template<typename Segment, typename Transfer>
+void transferSegments(const Segment *segments, size_t count, Transfer &&transfer) {
+    std::array<iovec, 64> iov{};
+    while (count > 0) {
+        const auto window = std::min(count, iov.size());
+        for (size_t i = 0; i < window; ++i) {
+            iov[i].iov_base = const_cast<void *>(segments[i].data);
+            iov[i].iov_len = segments[i].size;
+        }
+
+        for (size_t first = 0;;) {
+            while (first < window && iov[first].iov_len == 0) ++first;
+            if (first == window) break;
+
+            msghdr msg{};
+            msg.msg_iov = &iov[first];
+            msg.msg_iovlen = window - first;
+            auto done = transfer(msg);
+            if (done == 0) {
+                throw std::runtime_error{"connection closed"};
+            }
+
+            for (; first < window && done >= iov[first].iov_len; ++first) {
+                done -= iov[first].iov_len;
+            }
+            if (first < window) {
+                iov[first].iov_base = reinterpret_cast<uint8_t *>(iov[first].iov_base) + done;
+                iov[first].iov_len -= done;
+            }
+        }
+
+        segments += window;
+        count -= window;
+    }
+}
+} // namespace util
+} // namespace l5
+
+#endif //L5RDMA_VECTOREDIO_H
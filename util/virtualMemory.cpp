@@ -1,51 +1,128 @@
 #include "virtualMemory.h"
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <linux/memfd.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
 
 namespace l5 {
 namespace util {
-WraparoundBuffer mmapSharedRingBuffer(const std::string &name, size_t size, bool init) {
-    // create a new mapping in /dev/shm
-    auto pos = name.rfind('/');
-    if (pos == std::string::npos) {
-        pos = 0;
+static unsigned memfdFlags(PageSize pageSize) {
+    switch (pageSize) {
+        case PageSize::Normal:
+            return MFD_CLOEXEC | MFD_ALLOW_SEALING;
+        case PageSize::Huge2MB:
+            return MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB | MFD_HUGE_2MB;
+        case PageSize::Huge1GB:
+            return MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB | MFD_HUGE_1GB;
     }
-    const auto fd = shm_open(name.c_str() + pos, O_CREAT | O_TRUNC | O_RDWR | O_EXCL, 0666);
+    throw std::runtime_error{"unknown page size"};
+}
+
+static size_t pageSizeOf(int fd) {
+    struct statfs fs{};
+    if (fstatfs(fd, &fs) != 0) {
+        throw std::runtime_error{std::string("fstatfs failed ") + strerror(errno)};
+    }
+    if (fs.f_type == HUGETLBFS_MAGIC) {
+        return static_cast<size_t>(fs.f_bsize);
+    }
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+int createSharedMemory(const std::string &name, size_t size, PageSize pageSize) {
+    // memfd names are limited to 249 bytes and don't need to be unique
+    const auto fd = memfd_create(name.substr(0, 249).c_str(), memfdFlags(pageSize));
     if (fd < 0) {
-        perror("shm_open");
-        throw std::runtime_error{"shm_open failed"};
+        throw std::runtime_error{std::string("memfd_create failed ") + strerror(errno)};
     }
-    if (shm_unlink(name.c_str()) < 0) {
-        perror("shm_unlink");
-        throw std::runtime_error{"shm_unlink failed"};
+    if (pageSize != PageSize::Normal && size % pageSizeOf(fd) != 0) {
+        ::close(fd);
+        throw std::runtime_error{"size needs to be a multiple of the huge page size"};
+    }
+    if (ftruncate(fd, size) != 0) {
+        ::close(fd);
+        throw std::runtime_error{std::string("ftruncate failed ") + strerror(errno)};
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) != 0) {
+        ::close(fd);
+        throw std::runtime_error{std::string("sealing shared memory failed ") + strerror(errno)};
+    }
+    return fd;
+}
+
+void checkSharedMemory(int fd, size_t size) {
+    const auto seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+        throw std::runtime_error{"shared memory needs to be sealed with F_SEAL_SHRINK"};
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        throw std::runtime_error{std::string("fstat failed ") + strerror(errno)};
+    }
+    if (static_cast<size_t>(info.st_size) < size) {
+        throw std::runtime_error{"shared memory is smaller than expected"};
+    }
+}
+
+WraparoundBuffer mmapSharedRingBuffer(const std::string &name, size_t size, bool init, MappingOptions options) {
+    const auto fd = createSharedMemory(name, size, options.pageSize);
+    try {
+        return mmapRingBuffer(fd, size, init, options);
+    } catch (...) {
+        ::close(fd);
+        throw;
     }
-    return mmapRingBuffer(fd, size, init);
 }
 
 // see https://github.com/willemt/cbuffer
-WraparoundBuffer mmapRingBuffer(int fd, size_t size, bool init) {
-    if (ftruncate(fd, size) != 0) {
-        perror("ftruncate");
-        throw std::runtime_error{"ftruncate failed"};
+WraparoundBuffer mmapRingBuffer(int fd, size_t size, bool init, MappingOptions options) {
+    checkSharedMemory(fd, size);
+    // huge pages can only be mapped to addresses aligned to the huge page size
+    const auto alignment = pageSizeOf(fd);
+    if (size % alignment != 0) {
+        throw std::runtime_error{"size needs to be a multiple of the page size"};
     }
 
     // first acquire enough continuous memory
-    auto ptr = reinterpret_cast<uint8_t *>(
-            mmap(nullptr, size * 2, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0)
+    const auto reserved = size * 2 + alignment;
+    auto reservation = reinterpret_cast<uint8_t *>(
+            mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0)
     );
+    if (reservation == MAP_FAILED) {
+        throw std::runtime_error{std::string("reserving the wraparound failed ") + strerror(errno)};
+    }
+    const auto offset = (alignment - reinterpret_cast<uintptr_t>(reservation) % alignment) % alignment;
+    auto ptr = reservation + offset;
+    // give back the unaligned parts of the reservation
+    if (offset > 0) {
+        munmap(reservation, offset);
+    }
+    munmap(ptr + size * 2, reserved - offset - size * 2);
+
     const auto deleter = [size](void *p) {
         // unmap the whole continuous memory mapping
         munmap(p, size * 2);
     };
 
+    const auto flags = MAP_SHARED | MAP_FIXED | (options.prefault ? MAP_POPULATE : 0);
     // map the shared memory to the first half
-    if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != ptr) {
+    if (mmap(ptr, size, PROT_READ | PROT_WRITE, flags, fd, 0) != ptr) {
+        munmap(ptr, size * 2);
         throw std::runtime_error{std::string("mmaping the first wraparound failed ") + strerror(errno)};
     }
     // and also to the second half
-    if (mmap(&ptr[size], size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != &ptr[size]) {
-        throw std::runtime_error{std::string("mmaping the second wraparound failed ") +  + strerror(errno)};
+    if (mmap(&ptr[size], size, PROT_READ | PROT_WRITE, flags, fd, 0) != &ptr[size]) {
+        munmap(ptr, size * 2);
+        throw std::runtime_error{std::string("mmaping the second wraparound failed ") + strerror(errno)};
     }
     // because of the overlap, we need no deleter and unmapping for those mappings
 
+    if (options.lock && mlock(ptr, size * 2) != 0) {
+        munmap(ptr, size * 2);
+        throw std::runtime_error{std::string("mlock'ing the wraparound failed ") + strerror(errno)};
+    }
+
     if (init) {
         memset(ptr, 0, size);
     }
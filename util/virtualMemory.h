@@ -4,9 +4,11 @@
 #include <memory>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <cerrno>
 #include <cstring>
 #include <sys/file.h>
 #include <stdexcept>
+#include <string>
 
 namespace l5 {
 namespace util {
@@ -63,34 +65,50 @@ public:
     ~ShmMapping() { if(fd > 0) ::close(fd); }
 };
 
+/// Page size backing a shared memory mapping
+enum class PageSize {
+    Normal,
+    /// MFD_HUGETLB with 2MB pages, needs reserved huge pages (vm.nr_hugepages)
+    Huge2MB,
+    /// MFD_HUGETLB with 1GB pages, needs reserved huge pages (hugepagesz=1G)
+    Huge1GB
+};
+
+/// Additional setup for shared memory mappings
+struct MappingOptions {
+    /// only relevant when creating the memory, the remote side detects the page size of received fds
+    PageSize pageSize = PageSize::Normal;
+    /// fault in all pages while setting up the mapping, instead of on first touch
+    bool prefault = false;
+    /// mlock(2) the mapping, so it never gets swapped out. Limited by RLIMIT_MEMLOCK
+    bool lock = false;
+};
+
 /**
+ * Create an anonymous shared memory file of the given size, that can be passed to other processes via domain::send_fd
  * see: https://dvdhrm.wordpress.com/2014/06/10/memfd_create2/
- * TODO: in the future maybe check of availability of (Linux 3.17+) `memfd_create` and use it instead of shm_open
  * For reliability, the server should not mmap(2) client's objects for read-access as the client might truncate the file
  * simultaneously, causing SIGBUS on the server. A server can protect itself via SIGBUS-handlers, but sealing is a much
  * simpler way. By requiring F_SEAL_SHRINK, the server can be sure, the file will never shrink.
+ * @param name only used for debugging purposes, e.g. in /proc/self/fd
  */
+int createSharedMemory(const std::string &name, size_t size, PageSize pageSize = PageSize::Normal);
+
+/// Make sure the shared memory of fd is at least size bytes and can't shrink anymore
+void checkSharedMemory(int fd, size_t size);
+
 template<typename T>
 ShmMapping<T> malloc_shared(const std::string &name, size_t size, void *addr = nullptr) {
-    // create a new mapping in /dev/shm
-    const auto fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_EXCL, 0666);
-    if (fd < 0) {
-        perror("shm_open");
-        throw std::runtime_error{"shm_open failed"};
-    }
-    if (shm_unlink(name.c_str()) < 0) {
-        perror("shm_unlink");
-        throw std::runtime_error{"shm_unlink failed"};
-    }
-    if (ftruncate(fd, size) != 0) {
-        perror("ftruncate");
-        throw std::runtime_error{"ftruncate failed"};
-    }
+    const auto fd = createSharedMemory(name, size);
 
     auto deleter = [size](void *p) {
         munmap(p, size);
     };
     auto ptr = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error{std::string("mmap failed ") + strerror(errno)};
+    }
 
     ::memset(ptr, 0, size);
 
@@ -99,17 +117,24 @@ ShmMapping<T> malloc_shared(const std::string &name, size_t size, void *addr = n
 
 template<typename T>
 ShmMapping<T> malloc_shared(int fd, size_t size, void *addr = nullptr) {
+   checkSharedMemory(fd, size);
    auto deleter = [size](void *p) {
       munmap(p, size);
    };
    auto ptr = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (ptr == MAP_FAILED) {
+      throw std::runtime_error{std::string("mmap failed ") + strerror(errno)};
+   }
 
    return ShmMapping<T>( fd, std::shared_ptr<T>(reinterpret_cast<T *>(ptr), deleter) );
 }
 
-WraparoundBuffer mmapRingBuffer(int fd, size_t size, bool init = false);
+/// Map the shared memory of fd twice, back to back, so accesses of up to size bytes never need to wrap around
+WraparoundBuffer mmapRingBuffer(int fd, size_t size, bool init = false, MappingOptions options = {});
 
-WraparoundBuffer mmapSharedRingBuffer(const std::string &name, size_t size, bool init = false);
+/// Create new shared memory and map it as ring buffer, see createSharedMemory and mmapRingBuffer
+WraparoundBuffer mmapSharedRingBuffer(const std::string &name, size_t size, bool init = false,
+                                      MappingOptions options = {});
 } // namespace util
 } // namespace l5
 
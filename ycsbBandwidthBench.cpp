@@ -102,6 +102,58 @@ void doRun(bool isClient, std::string connection) {
    }
 }
 
+/// Same as doRun, but (de)serializing the responses directly in the shared memory buffers
+template<class Server, class Client>
+void doRunZeroCopy(bool isClient, std::string connection) {
+   constexpr size_t responseSize = 128 * sizeof(YcsbDataSet);
+
+   if (isClient) {
+      sleep(1);
+      auto client = Client();
+
+      for (int i = 0;; ++i) {
+         try {
+            client.connect(connection);
+            break;
+         } catch (...) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            if (i > 10) throw;
+         }
+      }
+
+      std::cout << "connected to " << connection << '\n';
+
+      auto data = YcsbDataSet{};
+      for (size_t i = 0; i < ycsb_tuple_count;) {
+         client.readZC([&](auto begin, auto end) {
+            for (auto it = begin; it < end; it += sizeof(YcsbDataSet)) {
+               ++i;
+               DoNotOptimize(data);
+               std::copy(it, it + sizeof(YcsbDataSet), data.begin());
+               ClobberMemory();
+            }
+         });
+      }
+   } else { // server
+      auto server = Server(connection);
+      const auto database = YcsbDatabase();
+      server.accept();
+      // measure bytes / s
+      bench(ycsb_tuple_count * sizeof(YcsbDataSet), [&] {
+         for (auto lookupIt = database.database.begin(); lookupIt != database.database.end();) {
+            server.writeZC(responseSize, [&](uint8_t* begin) {
+               size_t written = 0;
+               for (; written < responseSize && lookupIt != database.database.end(); ++lookupIt) {
+                  std::copy(lookupIt->second.begin(), lookupIt->second.end(), begin + written);
+                  written += sizeof(YcsbDataSet);
+               }
+               return written;
+            });
+         }
+      }, printResults);
+   }
+}
+
 /**
  * Bandwidth benchmark with pagination
  * i.e. request batching
@@ -135,6 +187,8 @@ int main(int argc, char** argv) {
       doRun<DomainSocketsTransportServer, DomainSocketsTransportClient>(isClient, "/tmp/testSocket");
       std::cout << "shared memory, ";
       doRun<SharedMemoryTransportServer<1_m>, SharedMemoryTransportClient<1_m>>(isClient, "/tmp/testSocket");
+      std::cout << "shared memory zerocopy, ";
+      doRunZeroCopy<SharedMemoryTransportServer<1_m>, SharedMemoryTransportClient<1_m>>(isClient, "/tmp/testSocket");
    }
    std::cout << "tcp, ";
    doRun<TcpTransportServer, TcpTransportClient>(isClient, connection);